@@ -0,0 +1,137 @@
+// codegen_throughput.c -- code generation speed in MB of assembly per second
+//
+// Parses and analyzes a .stola file (or, with no argument, a synthetic
+// program of a few thousand functions) once, then generates its assembly
+// several times on one thread and reports the best time.
+//
+//   make bench
+//   make bench BENCH_ARGS=path/to/program.stola
+//
+// Lexing, parsing and semantic analysis are not timed.
+
+#include "../src/arena.h"
+#include "../src/codegen.h"
+#include "../src/intern.h"
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "../src/semantic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 5
+#define SYNTHETIC_FUNCTIONS 4000
+
+static const char *const synthetic_function =
+    "function procesar_%d(registro, totales, indice)\n"
+    "  nombre = registro[\"nombre\"]\n"
+    "  cantidad = to_number(registro[\"cantidad\"])\n"
+    "  if cantidad greater than 100 and not (nombre equals \"\")\n"
+    "    totales[\"grandes\"] = totales[\"grandes\"] plus cantidad\n"
+    "  elif cantidad less or equals 10\n"
+    "    totales[\"pequenos\"] = totales[\"pequenos\"] plus 1\n"
+    "  else\n"
+    "    totales[\"medios\"] = (totales[\"medios\"] times 2) divided by 3\n"
+    "  end\n"
+    "  loop i from 0 to indice step 2\n"
+    "    valores = [i, i modulo 7, i times i, 'texto', null, true]\n"
+    "  end\n"
+    "  while indice greater than 0\n"
+    "    indice = indice minus 1\n"
+    "  end\n"
+    "  for clave in totales\n"
+    "    print(clave, totales[clave])\n"
+    "  end\n"
+    "  return {nombre: nombre, cantidad: cantidad, activo: false}\n"
+    "end\n\n";
+
+static double now_seconds(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static char *build_synthetic(void) {
+  size_t chunk = strlen(synthetic_function) + 16;
+  size_t capacity = chunk * SYNTHETIC_FUNCTIONS + 64;
+  char *buf = malloc(capacity);
+  if (!buf)
+    return NULL;
+  size_t len = 0;
+  for (int i = 0; i < SYNTHETIC_FUNCTIONS; i++)
+    len += snprintf(buf + len, capacity - len, synthetic_function, i);
+  snprintf(buf + len, capacity - len, "print(procesar_0({}, {}, 3))\n");
+  return buf;
+}
+
+static char *read_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0L, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+  char *buf = malloc((size_t)size + 1);
+  if (!buf) {
+    fclose(f);
+    return NULL;
+  }
+  size_t n = fread(buf, 1, (size_t)size, f);
+  buf[n] = '\0';
+  fclose(f);
+  return buf;
+}
+
+int main(int argc, char **argv) {
+  char *source = argc > 1 ? read_file(argv[1]) : build_synthetic();
+  if (!source) {
+    fprintf(stderr, "codegen_throughput: cannot load %s\n",
+            argc > 1 ? argv[1] : "synthetic source");
+    return 1;
+  }
+
+  Lexer lexer;
+  lexer_init(&lexer, source);
+  Parser parser;
+  parser_init(&parser, &lexer);
+  ASTNode *program = parser_parse_program(&parser);
+  SemanticAnalyzer analyzer;
+  semantic_init(&analyzer, 0);
+  if (parser.error_count > 0 || !semantic_analyze(&analyzer, program)) {
+    fprintf(stderr, "codegen_throughput: program does not compile\n");
+    return 1;
+  }
+
+  double best = 0.0;
+  long bytes = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    FILE *out = tmpfile();
+    if (!out) {
+      fprintf(stderr, "codegen_throughput: cannot create a temporary file\n");
+      return 1;
+    }
+    double start = now_seconds();
+    int ok = codegen_generate(program, &analyzer, out, 0, 1);
+    fflush(out);
+    double elapsed = now_seconds() - start;
+    bytes = ftell(out);
+    fclose(out);
+    if (!ok) {
+      fprintf(stderr, "codegen_throughput: code generation failed\n");
+      return 1;
+    }
+    if (best == 0.0 || elapsed < best)
+      best = elapsed;
+  }
+
+  double mb = (double)bytes / (1024.0 * 1024.0);
+  printf("codegen: %.1f MB of assembly, best of %d: %.1f ms\n", mb,
+         BENCH_ROUNDS, best * 1000.0);
+  printf("codegen: %.1f MB/s\n", mb / best);
+  semantic_free(&analyzer);
+  intern_release();
+  arena_release(&compile_arena);
+  free(source);
+  return 0;
+}
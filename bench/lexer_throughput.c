@@ -0,0 +1,114 @@
+// lexer_throughput.c -- lexer throughput in MB/s
+//
+// Lexes a .stola file (or, with no argument, a synthetic ~32 MB program built
+// in memory) several times and reports the best MB/s and tokens/s.
+//
+//   make bench
+//   make bench BENCH_ARGS=path/to/program.stola
+//
+// Only the lexer is linked in, so the numbers do not include parsing.
+
+#include "../src/lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 5
+#define SYNTHETIC_BYTES (32u * 1024 * 1024)
+
+static const char *const synthetic_chunk =
+    "// accumulate totals for every record\n"
+    "function procesar_registro(registro, totales, indice)\n"
+    "  nombre = registro[\"nombre\"]\n"
+    "  cantidad = to_number(registro[\"cantidad\"])\n"
+    "  if cantidad greater than 100 and not (nombre equals \"\")\n"
+    "    totales[\"grandes\"] = totales[\"grandes\"] plus cantidad\n"
+    "  elif cantidad less or equals 10\n"
+    "    totales[\"pequenos\"] = totales[\"pequenos\"] plus 1\n"
+    "  else\n"
+    "    totales[\"medios\"] = (totales[\"medios\"] times 2) divided by 3\n"
+    "  end\n"
+    "  loop i from 0 to indice step 2\n"
+    "    valores = [i, i modulo 7, i power 2, 3.25, 'texto', null, true]\n"
+    "  end\n"
+    "  for clave in keys(totales)\n"
+    "    print(clave, totales[clave])\n"
+    "  end\n"
+    "  return {nombre: nombre, cantidad: cantidad, activo: false}\n"
+    "end\n\n";
+
+static double now_seconds(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static char *build_synthetic(size_t *out_len) {
+  size_t chunk = strlen(synthetic_chunk);
+  size_t count = SYNTHETIC_BYTES / chunk;
+  char *buf = malloc(count * chunk + 1);
+  if (!buf)
+    return NULL;
+  for (size_t i = 0; i < count; i++)
+    memcpy(buf + i * chunk, synthetic_chunk, chunk);
+  buf[count * chunk] = '\0';
+  *out_len = count * chunk;
+  return buf;
+}
+
+static char *read_file(const char *path, size_t *out_len) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+  fseek(f, 0L, SEEK_END);
+  long size = ftell(f);
+  rewind(f);
+  char *buf = malloc((size_t)size + 1);
+  if (!buf) {
+    fclose(f);
+    return NULL;
+  }
+  size_t n = fread(buf, 1, (size_t)size, f);
+  buf[n] = '\0';
+  fclose(f);
+  *out_len = n;
+  return buf;
+}
+
+int main(int argc, char **argv) {
+  size_t len = 0;
+  char *source = argc > 1 ? read_file(argv[1], &len) : build_synthetic(&len);
+  if (!source) {
+    fprintf(stderr, "lexer_throughput: cannot load %s\n",
+            argc > 1 ? argv[1] : "synthetic source");
+    return 1;
+  }
+
+  double best = 0.0;
+  long tokens = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    Lexer lexer;
+    lexer_init(&lexer, source);
+    long count = 0;
+    double start = now_seconds();
+    for (;;) {
+      Token tok = lexer_next_token(&lexer);
+      count++;
+      if (tok.type == TOKEN_EOF)
+        break;
+    }
+    double elapsed = now_seconds() - start;
+    if (best == 0.0 || elapsed < best)
+      best = elapsed;
+    tokens = count;
+  }
+
+  double mb = (double)len / (1024.0 * 1024.0);
+  printf("lexer: %.1f MB, %ld tokens, best of %d: %.1f ms\n", mb, tokens,
+         BENCH_ROUNDS, best * 1000.0);
+  printf("lexer: %.1f MB/s, %.1f Mtokens/s\n", mb / best,
+         (double)tokens / best / 1e6);
+  free(source);
+  return 0;
+}
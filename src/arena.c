@@ -0,0 +1,95 @@
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_CHUNK_SIZE (256 * 1024)
+#define ARENA_ALIGN 16
+
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t size;
+  size_t used;
+  // Keeps data[] at ARENA_ALIGN on every platform.
+  _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+Arena compile_arena = {NULL, 0};
+
+static ArenaChunk *arena_new_chunk(size_t size) {
+  ArenaChunk *chunk = malloc(sizeof(ArenaChunk) + size);
+  if (!chunk) {
+    abort();
+  }
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->next = NULL;
+  return chunk;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if (size == 0)
+    size = ARENA_ALIGN;
+  arena->used += size;
+
+  ArenaChunk *head = arena->head;
+  if (head && head->size - head->used >= size) {
+    void *p = head->data + head->used;
+    head->used += size;
+    return p;
+  }
+
+  // Oversized requests get a dedicated chunk linked behind the head so the
+  // space left in the current chunk is not abandoned.
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    ArenaChunk *big = arena_new_chunk(size);
+    big->used = size;
+    if (head) {
+      big->next = head->next;
+      head->next = big;
+    } else {
+      arena->head = big;
+    }
+    return big->data;
+  }
+
+  ArenaChunk *chunk = arena_new_chunk(ARENA_CHUNK_SIZE);
+  chunk->next = head;
+  arena->head = chunk;
+  chunk->used = size;
+  return chunk->data;
+}
+
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+  char *copy = arena_alloc(arena, len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+  return arena_strndup(arena, s, strlen(s));
+}
+
+void *arena_grow(Arena *arena, void *array, int count, size_t elem_size) {
+  // Full when count is 0 or a power of two >= 4.
+  if (array && (count < 4 || (count & (count - 1)) != 0))
+    return array;
+  int capacity = count < 4 ? 4 : count * 2;
+  void *grown = arena_alloc(arena, elem_size * (size_t)capacity);
+  if (array && count > 0)
+    memcpy(grown, array, elem_size * (size_t)count);
+  return grown;
+}
+
+void arena_release(Arena *arena) {
+  ArenaChunk *chunk = arena->head;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  arena->head = NULL;
+  arena->used = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for compiler data that lives as long as one compilation:
+// source buffers, token text, AST nodes and their child arrays. Individual
+// allocations are never freed; the whole arena is dropped with
+// arena_release().
+
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+  ArenaChunk *head; // chunk currently being carved (newest first)
+  size_t used;      // total bytes handed out
+} Arena;
+
+// Arena shared by the lexer, parser and AST constructors.
+extern Arena compile_arena;
+
+void *arena_alloc(Arena *arena, size_t size);
+char *arena_strndup(Arena *arena, const char *s, size_t len);
+char *arena_strdup(Arena *arena, const char *s);
+
+// Append-only arrays: returns `array` with room for element `count` (the
+// next one to be written). Capacity is implicit -- the smallest power of two
+// >= count, minimum 4 -- so callers only track the element count. Arrays
+// that were not created through arena_grow must not be grown with it.
+void *arena_grow(Arena *arena, void *array, int count, size_t elem_size);
+
+void arena_release(Arena *arena);
+
+#endif // ARENA_H
@@ -1,6 +1,7 @@
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
 #include "token.h"
 
 typedef enum {
@@ -48,8 +49,11 @@ typedef struct ASTNode ASTNode;
 
 // --- Expressions ---
 
+struct Symbol;
+
 typedef struct {
-  char *value;
+  char *value;           // interned
+  struct Symbol *symbol; // set by the semantic pass; NULL if unresolved
 } IdentifierNode;
 
 typedef struct {
@@ -153,6 +157,7 @@ typedef struct {
   char *iterator_name;
   ASTNode *iterable; // e.g. CallExpr range(...) or Identifier (arr)
   ASTNode *body;     // BlockNode
+  int id;            // sequence number; names codegen's hidden iterator slot
 } ForStmtNode;
 
 typedef struct {
@@ -265,12 +270,14 @@ struct ASTNode {
   } as;
 };
 
-// Allocation functions
+// Allocation functions. String arguments are stored, not copied: pass text
+// allocated from compile_arena (or a string constant).
+ASTNode *ast_create_node(ASTNodeType type);
 ASTNode *ast_create_program();
 ASTNode *ast_create_block();
-ASTNode *ast_create_identifier(const char *value);
-ASTNode *ast_create_number_literal(const char *value);
-ASTNode *ast_create_string_literal(const char *value);
+ASTNode *ast_create_identifier(char *value);
+ASTNode *ast_create_number_literal(char *value);
+ASTNode *ast_create_string_literal(char *value);
 ASTNode *ast_create_boolean_literal(int value);
 ASTNode *ast_create_null_literal();
 ASTNode *ast_create_binary_op(Token op, ASTNode *left, ASTNode *right);
@@ -281,10 +288,10 @@ ASTNode *ast_create_assignment(ASTNode *target, ASTNode *value);
 ASTNode *ast_create_if_stmt(ASTNode *condition, ASTNode *consequence,
                             ASTNode *alternative);
 ASTNode *ast_create_while_stmt(ASTNode *condition, ASTNode *body);
-ASTNode *ast_create_loop_stmt(const char *iterator_name, ASTNode *start_expr,
+ASTNode *ast_create_loop_stmt(char *iterator_name, ASTNode *start_expr,
                               ASTNode *end_expr, ASTNode *step_expr,
                               ASTNode *body);
-ASTNode *ast_create_for_stmt(const char *iterator_name, ASTNode *iterable,
+ASTNode *ast_create_for_stmt(char *iterator_name, ASTNode *iterable,
                              ASTNode *body);
 ASTNode *ast_create_match_stmt(ASTNode *condition);
 ASTNode *ast_create_return_stmt(ASTNode *return_value);
@@ -292,24 +299,24 @@ ASTNode *ast_create_array_literal();
 ASTNode *ast_create_dict_literal();
 ASTNode *ast_create_member_access(ASTNode *object, ASTNode *property,
                                   int is_computed);
-ASTNode *ast_create_function_decl(const char *name, ASTNode *body);
-ASTNode *ast_create_struct_decl(const char *name);
-ASTNode *ast_create_class_decl(const char *name);
+ASTNode *ast_create_function_decl(char *name, ASTNode *body);
+ASTNode *ast_create_struct_decl(char *name);
+ASTNode *ast_create_class_decl(char *name);
 ASTNode *ast_create_new_expr(ASTNode *class_name);
 ASTNode *ast_create_this();
-ASTNode *ast_create_import_native(const char *dll_name);
-ASTNode *ast_create_c_function_decl(const char *name, const char *return_type);
-ASTNode *ast_create_try_catch(ASTNode *try_block, const char *catch_var,
+ASTNode *ast_create_import_native(char *dll_name);
+ASTNode *ast_create_c_function_decl(char *name, char *return_type);
+ASTNode *ast_create_try_catch(ASTNode *try_block, char *catch_var,
                               ASTNode *catch_block);
 ASTNode *ast_create_throw(ASTNode *exception_value);
-ASTNode *ast_create_asm_block(const char *code);
+ASTNode *ast_create_asm_block(char *code);
 
 // Utility list modifiers
 void ast_program_add_statement(ASTNode *program, ASTNode *stmt);
 void ast_block_add_statement(ASTNode *block, ASTNode *stmt);
 void ast_call_add_arg(ASTNode *call, ASTNode *arg);
-void ast_function_add_param(ASTNode *func, const char *param);
-void ast_struct_add_field(ASTNode *struc, const char *field);
+void ast_function_add_param(ASTNode *func, char *param);
+void ast_struct_add_field(ASTNode *struc, char *field);
 void ast_class_add_method(ASTNode *class_decl, ASTNode *method);
 void ast_new_expr_add_arg(ASTNode *new_expr, ASTNode *arg);
 void ast_if_add_elif(ASTNode *if_node, ASTNode *cond, ASTNode *cons);
@@ -317,10 +324,7 @@ void ast_match_add_case(ASTNode *match_node, ASTNode *case_expr,
                         ASTNode *consequence);
 void ast_array_add_element(ASTNode *array_node, ASTNode *element);
 void ast_dict_add_pair(ASTNode *dict_node, ASTNode *key, ASTNode *value);
-void ast_c_function_add_param_type(ASTNode *c_func, const char *type_name);
-void ast_function_add_param_type(ASTNode *func, const char *type_name);
-
-// Cleanup
-void ast_free(ASTNode *node);
+void ast_c_function_add_param_type(ASTNode *c_func, char *type_name);
+void ast_function_add_param_type(ASTNode *func, char *type_name);
 
 #endif // AST_H
@@ -1,3 +1,6 @@
+#ifndef _WIN32
+#define _GNU_SOURCE
+#endif
 #include "runtime.h"
 #include <stdint.h>
 #include <stdio.h>
@@ -64,284 +67,1573 @@ static char *ws_base64_encode(const unsigned char *data, size_t len) {
 }
 
 // ============================================================
-// Socket Operations using WinSock2
+// Shared helpers: DNS cache
 // ============================================================
-
+// Every connect path (socket_connect, http_*, ws_connect) resolves names
+// through dns_lookup.  Answers are kept for dns_ttl_ms and failures for
+// dns_negative_ttl_ms.  getaddrinfo does not report record TTLs, so the
+// lifetime is the configured one (dns_set_ttl).  IP literals skip the
+// cache entirely.
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
-#pragma comment(lib, "ws2_32.lib")
+static void ensure_wsa(void);
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <time.h>
+#endif
 
-static int wsa_initialized = 0;
+#define DNS_CACHE_SLOTS 64
+#define DNS_MAX_ADDRS   8
 
-static void ensure_wsa(void) {
-  if (!wsa_initialized) {
-    WSADATA wsa;
-    WSAStartup(MAKEWORD(2, 2), &wsa);
-    wsa_initialized = 1;
-  }
-}
+typedef struct DnsEntry {
+  char host[256];                 /* lowercased */
+  struct in_addr addrs[DNS_MAX_ADDRS];
+  int naddrs;                     /* 0: cached failure */
+  int64_t expires;
+  struct DnsEntry *next;
+} DnsEntry;
 
-StolaValue *stola_socket_connect(StolaValue *host, StolaValue *port) {
-  if (!host || host->type != STOLA_STRING || !port)
-    return stola_new_int(-1);
+static DnsEntry *dns_table[DNS_CACHE_SLOTS];
+static volatile char dns_lock;
+static int64_t dns_ttl_ms = 60000, dns_negative_ttl_ms = 5000;
+static int64_t dns_hits, dns_misses, dns_negative_hits;
 
-  ensure_wsa();
+static void dns_acquire(void) { while (__atomic_test_and_set(&dns_lock, __ATOMIC_ACQUIRE)) {} }
+static void dns_release(void) { __atomic_clear(&dns_lock, __ATOMIC_RELEASE); }
 
-  const char *hostname = host->as.str_val;
-  int port_num = (int)port->as.int_val;
+static int64_t dns_now_ms(void) {
+#ifdef _WIN32
+  return (int64_t)GetTickCount64();
+#else
+  struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
 
-  struct addrinfo hints, *result = NULL;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET;
-  hints.ai_socktype = SOCK_STREAM;
-  hints.ai_protocol = IPPROTO_TCP;
+static unsigned dns_slot(const char *key) {
+  unsigned h = 2166136261u;
+  for (; *key; key++) h = (h ^ (unsigned char)*key) * 16777619u;
+  return h % DNS_CACHE_SLOTS;
+}
 
-  char port_str[16];
-  snprintf(port_str, sizeof(port_str), "%d", port_num);
+// Resolve host into out (port in host order).  0 on success, -1 if the
+// name does not resolve (now or according to a cached failure).
+static int dns_lookup(const char *host, int port, struct sockaddr_in *out) {
+  memset(out, 0, sizeof(*out));
+  out->sin_family = AF_INET;
+  out->sin_port = htons((unsigned short)port);
+  if (inet_pton(AF_INET, host, &out->sin_addr) == 1) return 0;
+  char key[256]; size_t k = 0;
+  for (; host[k] && k < sizeof(key) - 1; k++)
+    key[k] = (char)((host[k] >= 'A' && host[k] <= 'Z') ? host[k] + 32 : host[k]);
+  key[k] = '\0';
+  unsigned slot = dns_slot(key);
+  int64_t now = dns_now_ms();
+  dns_acquire();
+  for (DnsEntry *e = dns_table[slot]; e; e = e->next) {
+    if (strcmp(e->host, key) != 0 || e->expires <= now) continue;
+    int ok = e->naddrs > 0;
+    if (ok) { out->sin_addr = e->addrs[0]; dns_hits++; }
+    else dns_negative_hits++;
+    dns_release();
+    return ok ? 0 : -1;
+  }
+  dns_misses++;
+  dns_release();
 
-  if (getaddrinfo(hostname, port_str, &hints, &result) != 0) {
-    return stola_new_int(-1);
+  struct in_addr addrs[DNS_MAX_ADDRS]; int n = 0;
+  struct addrinfo hints, *res = NULL;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(key, NULL, &hints, &res) == 0) {
+    for (struct addrinfo *ai = res; ai && n < DNS_MAX_ADDRS; ai = ai->ai_next)
+      addrs[n++] = ((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+    freeaddrinfo(res);
   }
 
-  SOCKET sock =
-      socket(result->ai_family, result->ai_socktype, result->ai_protocol);
-  if (sock == INVALID_SOCKET) {
-    freeaddrinfo(result);
-    return stola_new_int(-1);
+  dns_acquire();
+  DnsEntry **pp = &dns_table[slot], *e = NULL;
+  while (*pp) { /* reuse our entry, drop expired neighbours */
+    if (strcmp((*pp)->host, key) == 0) { e = *pp; pp = &e->next; }
+    else if ((*pp)->expires <= now) { DnsEntry *dead = *pp; *pp = dead->next; free(dead); }
+    else pp = &(*pp)->next;
+  }
+  if (!e) {
+    e = (DnsEntry *)calloc(1, sizeof(DnsEntry));
+    strcpy(e->host, key);
+    e->next = dns_table[slot]; dns_table[slot] = e;
   }
+  memcpy(e->addrs, addrs, sizeof(struct in_addr) * (size_t)n);
+  e->naddrs = n;
+  e->expires = now + (n ? dns_ttl_ms : dns_negative_ttl_ms);
+  dns_release();
+  if (!n) return -1;
+  out->sin_addr = addrs[0];
+  return 0;
+}
 
-  if (connect(sock, result->ai_addr, (int)result->ai_addrlen) == SOCKET_ERROR) {
-    closesocket(sock);
-    freeaddrinfo(result);
-    return stola_new_int(-1);
+StolaValue *stola_dns_cache_flush(void) {
+  dns_acquire();
+  for (int i = 0; i < DNS_CACHE_SLOTS; i++) {
+    while (dns_table[i]) { DnsEntry *e = dns_table[i]; dns_table[i] = e->next; free(e); }
   }
+  dns_release();
+  return stola_new_null();
+}
 
-  freeaddrinfo(result);
-  return stola_new_int((int64_t)sock);
+// dns_prewarm(host | [hosts]) -> how many of them resolved
+StolaValue *stola_dns_prewarm(StolaValue *hosts) {
+#ifdef _WIN32
+  ensure_wsa();
+#endif
+  struct sockaddr_in tmp;
+  int ok = 0;
+  if (hosts && hosts->type == STOLA_STRING)
+    ok = dns_lookup(hosts->as.str_val, 0, &tmp) == 0;
+  else if (hosts && hosts->type == STOLA_ARRAY)
+    for (int i = 0; i < hosts->as.array_val.count; i++) {
+      StolaValue *h = hosts->as.array_val.items[i];
+      if (h && h->type == STOLA_STRING && dns_lookup(h->as.str_val, 0, &tmp) == 0) ok++;
+    }
+  return stola_new_int(ok);
 }
 
-StolaValue *stola_socket_send(StolaValue *fd, StolaValue *data) {
-  if (!fd || !data || data->type != STOLA_STRING)
-    return stola_new_int(-1);
+StolaValue *stola_dns_cache_stats(void) {
+  int entries = 0;
+  int64_t now = dns_now_ms();
+  dns_acquire();
+  for (int i = 0; i < DNS_CACHE_SLOTS; i++)
+    for (DnsEntry *e = dns_table[i]; e; e = e->next) entries += e->expires > now;
+  StolaValue *r = stola_new_dict();
+  stola_dict_set(r, stola_new_string("hits"), stola_new_int(dns_hits));
+  stola_dict_set(r, stola_new_string("misses"), stola_new_int(dns_misses));
+  stola_dict_set(r, stola_new_string("negative_hits"), stola_new_int(dns_negative_hits));
+  dns_release();
+  stola_dict_set(r, stola_new_string("entries"), stola_new_int(entries));
+  return r;
+}
 
-  SOCKET sock = (SOCKET)fd->as.int_val;
-  const char *buf = data->as.str_val;
-  int len = (int)strlen(buf);
-  int sent = send(sock, buf, len, 0);
-  return stola_new_int(sent);
+// dns_set_ttl(seconds, negative_seconds); 0 disables that kind of caching
+StolaValue *stola_dns_set_ttl(StolaValue *ttl, StolaValue *negative_ttl) {
+  if (ttl && ttl->type == STOLA_INT && ttl->as.int_val >= 0) dns_ttl_ms = ttl->as.int_val * 1000;
+  if (negative_ttl && negative_ttl->type == STOLA_INT && negative_ttl->as.int_val >= 0)
+    dns_negative_ttl_ms = negative_ttl->as.int_val * 1000;
+  return stola_new_null();
 }
 
-StolaValue *stola_socket_receive(StolaValue *fd) {
-  if (!fd)
-    return stola_new_string("");
+// ============================================================
+// Shared helpers: buffered socket reads
+// ============================================================
+// socket_receive_some / socket_receive_exact / socket_read_line keep the
+// bytes they read past what the caller asked for in a per-socket buffer, so
+// protocol code can consume a stream piece by piece.  The buffer is reused
+// (compacted, never shrunk) and capped at SOCKBUF_MAX unless a single
+// socket_receive_exact asks for more; socket_close frees it.
+//
+// Results: the requested data; "" when a non-blocking socket has nothing
+// (yet) to satisfy the request; null on end of stream or error.
+
+#define SOCKBUF_INIT 4096
+#define SOCKBUF_MAX  (1024 * 1024)
+
+// A WebSocket message being reassembled from fragments (see the WebSocket
+// framing helpers below).
+typedef struct WsMsg {
+  char *data;
+  size_t len, cap;
+  int opcode, compressed;         /* opcode 0: no message in progress */
+} WsMsg;
+
+typedef struct SockBuf {
+  int64_t fd;
+  char *data;
+  size_t start, len, cap;         /* unread bytes: data[start .. start+len) */
+  int nonblock;                   /* set by socket_set_nonblocking */
+  int ws_server;                  /* server end of a WebSocket: send unmasked */
+  int ws_deflate;                 /* permessage-deflate negotiated */
+  WsMsg *ws_msg;
+  struct SockBuf *next;
+} SockBuf;
+
+static SockBuf *sockbuf_table[256];
+static volatile char sockbuf_lock;
+
+// One recv() into buf: >0 bytes, 0 end of stream, -1 error, -2 would block.
+static long sock_recv_some(int64_t fd, char *buf, size_t n, int nonblock);
+
+static void sockbuf_acquire(void) { while (__atomic_test_and_set(&sockbuf_lock, __ATOMIC_ACQUIRE)) {} }
+static void sockbuf_release(void) { __atomic_clear(&sockbuf_lock, __ATOMIC_RELEASE); }
+
+static SockBuf *sockbuf_get(int64_t fd, int create) {
+  unsigned h = (unsigned)((uint64_t)fd * 0x9E3779B1u) >> 24;
+  sockbuf_acquire();
+  SockBuf *b = sockbuf_table[h];
+  while (b && b->fd != fd) b = b->next;
+  if (!b && create) {
+    b = (SockBuf *)calloc(1, sizeof(SockBuf));
+    b->fd = fd;
+    b->next = sockbuf_table[h]; sockbuf_table[h] = b;
+  }
+  sockbuf_release();
+  return b;
+}
 
-  SOCKET sock = (SOCKET)fd->as.int_val;
+static void sockbuf_drop(int64_t fd) {
+  unsigned h = (unsigned)((uint64_t)fd * 0x9E3779B1u) >> 24;
+  sockbuf_acquire();
+  for (SockBuf **pp = &sockbuf_table[h]; *pp; pp = &(*pp)->next)
+    if ((*pp)->fd == fd) {
+      SockBuf *b = *pp; *pp = b->next;
+      if (b->ws_msg) { free(b->ws_msg->data); free(b->ws_msg); }
+      free(b->data); free(b);
+      break;
+    }
+  sockbuf_release();
+}
 
-  size_t total = 0;
-  size_t cap = 4096;
-  char *buf = (char *)malloc(cap);
+// Read more bytes into b, making room for at least `want` unread bytes.
+static long sockbuf_fill(SockBuf *b, size_t want) {
+  if (b->start && b->start + b->len + SOCKBUF_INIT > b->cap) {
+    memmove(b->data, b->data + b->start, b->len);
+    b->start = 0;
+  }
+  size_t need = b->len + SOCKBUF_INIT;
+  if (want > need) need = want;
+  if (need > b->cap) {
+    size_t cap = b->cap ? b->cap : SOCKBUF_INIT;
+    while (cap < need) cap *= 2;
+    b->data = (char *)realloc(b->data, cap);
+    b->cap = cap;
+  }
+  long r = sock_recv_some(b->fd, b->data + b->start + b->len, b->cap - b->start - b->len, b->nonblock);
+  if (r > 0) b->len += (size_t)r;
+  return r;
+}
 
-  while (1) {
-    if (total + 4096 > cap) {
-      cap *= 2;
-      buf = (char *)realloc(buf, cap);
-    }
-    int received = recv(sock, buf + total, 4096, 0);
-    if (received <= 0)
-      break;
-    total += received;
+static StolaValue *sockbuf_take(SockBuf *b, size_t n, size_t skip) {
+  char *out = (char *)malloc(n + 1);
+  memcpy(out, b->data + b->start, n);
+  out[n] = '\0';
+  b->start += n + skip; b->len -= n + skip;
+  if (!b->len) b->start = 0;
+  return stola_new_string_owned(out);
+}
+
+// Hand everything buffered to the caller (socket_receive drains it first).
+static size_t sockbuf_drain(int64_t fd, char **buf, size_t *cap) {
+  SockBuf *b = sockbuf_get(fd, 0);
+  size_t n = b ? b->len : 0;
+  *cap = n + 4096;
+  *buf = (char *)malloc(*cap);
+  if (n) { memcpy(*buf, b->data + b->start, n); b->start = b->len = 0; }
+  return n;
+}
+
+StolaValue *stola_socket_receive_some(StolaValue *fd, StolaValue *max) {
+  if (!fd || fd->type != STOLA_INT) return stola_new_null();
+  size_t limit = (max && max->type == STOLA_INT && max->as.int_val > 0) ? (size_t)max->as.int_val : SOCKBUF_INIT;
+  SockBuf *b = sockbuf_get(fd->as.int_val, 1);
+  if (!b->len) {
+    long r = sockbuf_fill(b, 0);
+    if (r == -2) return stola_new_string("");
+    if (r <= 0) return stola_new_null();
   }
+  return sockbuf_take(b, b->len < limit ? b->len : limit, 0);
+}
 
-  buf[total] = '\0';
-  return stola_new_string_owned(buf);
+StolaValue *stola_socket_receive_exact(StolaValue *fd, StolaValue *n) {
+  if (!fd || fd->type != STOLA_INT || !n || n->type != STOLA_INT || n->as.int_val < 0) return stola_new_null();
+  size_t want = (size_t)n->as.int_val;
+  SockBuf *b = sockbuf_get(fd->as.int_val, 1);
+  while (b->len < want) {
+    long r = sockbuf_fill(b, want);
+    if (r == -2) return stola_new_string("");
+    if (r <= 0) return stola_new_null();
+  }
+  return sockbuf_take(b, want, 0);
 }
 
-void stola_socket_close(StolaValue *fd) {
-  if (!fd)
-    return;
-  closesocket((SOCKET)fd->as.int_val);
+// Next line without its "\n" / "\r\n".  At end of stream a final
+// unterminated line is still returned; a line longer than SOCKBUF_MAX comes
+// back in SOCKBUF_MAX pieces.
+StolaValue *stola_socket_read_line(StolaValue *fd) {
+  if (!fd || fd->type != STOLA_INT) return stola_new_null();
+  SockBuf *b = sockbuf_get(fd->as.int_val, 1);
+  size_t scanned = 0;
+  for (;;) {
+    char *nl = b->len > scanned ? (char *)memchr(b->data + b->start + scanned, '\n', b->len - scanned) : NULL;
+    if (nl) {
+      size_t n = (size_t)(nl - (b->data + b->start));
+      size_t skip = 1;
+      if (n && b->data[b->start + n - 1] == '\r') { n--; skip = 2; }
+      return sockbuf_take(b, n, skip);
+    }
+    if (b->len >= SOCKBUF_MAX) return sockbuf_take(b, SOCKBUF_MAX, 0);
+    scanned = b->len;
+    long r = sockbuf_fill(b, 0);
+    if (r == -2) return stola_new_string("");
+    if (r <= 0) return b->len ? sockbuf_take(b, b->len, 0) : stola_new_null();
+  }
 }
 
 // ============================================================
-// Native HTTP GET using WinHTTP (supports HTTPS!)
+// Shared helpers: WebSocket framing
 // ============================================================
+// Masking is the hot loop for large frames: every payload byte is XORed
+// with a 4-byte key.  ws_mask does it 32/16 bytes at a time with AVX2/SSE2
+// (chosen once at runtime on x86-64) and 8 bytes at a time elsewhere.
+// Frames are read through the socket's SockBuf, so a single recv() can
+// carry several frames and the buffer is reused for the life of the
+// connection.  Sends are gather writes of header + payload: server frames
+// go out without copying the payload, client frames (which must be masked)
+// through a reusable per-thread scratch buffer.
+//
+// Fragmented messages are reassembled into the connection's WsMsg; control
+// frames may arrive between fragments and are handled in the same loop.
+// Built with -DSTOLA_WITH_ZLIB (and -lz), both ends offer / accept
+// permessage-deflate (RFC 7692) without context takeover, so every message
+// is compressed on its own and no per-connection zlib state is kept.
 
-#include <winhttp.h>
-#pragma comment(lib, "winhttp.lib")
+#include <time.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define WS_MASK_X86 1
+#endif
+#ifdef STOLA_WITH_ZLIB
+#include <zlib.h>
+#endif
 
-StolaValue *stola_http_fetch(StolaValue *url_val) {
-  if (!url_val || url_val->type != STOLA_STRING)
-    return stola_new_null();
+#define WS_SCRATCH      (64 * 1024)
+#define WS_MAX_MESSAGE  (64 * 1024 * 1024)
+#define WS_DEFLATE_MIN  128        /* smaller messages are sent uncompressed */
 
-  const char *url_str = url_val->as.str_val;
+typedef struct {
+  int fin, rsv1, opcode, masked;
+  size_t hlen;                    /* header bytes, mask key included */
+  uint64_t plen;
+} WsFrame;
 
-  // Convert URL to wide string
-  int wlen = MultiByteToWideChar(65001, 0, url_str, -1, NULL, 0);
-  wchar_t *wurl = (wchar_t *)malloc(wlen * sizeof(wchar_t));
-  MultiByteToWideChar(65001, 0, url_str, -1, wurl, wlen);
+// Gather write of a then b (b may be empty): 0, or -1 on error.  Per platform.
+static int sock_sendv(int64_t fd, const void *a, size_t alen, const void *b, size_t blen);
 
-  // Crack the URL
-  URL_COMPONENTS uc;
-  memset(&uc, 0, sizeof(uc));
-  uc.dwStructSize = sizeof(uc);
+// One destination of ws_broadcast: header + payload, shared between sockets.
+typedef struct {
+  int64_t fd;
+  const unsigned char *hdr; size_t hlen;
+  const char *payload; size_t plen;
+  size_t done;                    /* bytes of hdr + payload already sent */
+  int failed;
+} WsBcast;
+
+// Send every item, as concurrently as the platform allows; sets ->failed.
+static void sock_broadcast(WsBcast *items, int n);
+
+static void ws_mask_scalar(unsigned char *dst, const unsigned char *src, size_t n, uint32_t key) {
+  uint64_t k8 = (uint64_t)key | ((uint64_t)key << 32);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t w; memcpy(&w, src + i, 8); w ^= k8; memcpy(dst + i, &w, 8);
+  }
+  const unsigned char *kb = (const unsigned char *)&key;
+  for (; i < n; i++) dst[i] = src[i] ^ kb[i & 3];
+}
 
-  wchar_t host[256] = {0};
-  wchar_t path[2048] = {0};
-  uc.lpszHostName = host;
-  uc.dwHostNameLength = 256;
-  uc.lpszUrlPath = path;
-  uc.dwUrlPathLength = 2048;
+#ifdef WS_MASK_X86
+static void ws_mask_sse2(unsigned char *dst, const unsigned char *src, size_t n, uint32_t key) {
+  __m128i k = _mm_set1_epi32((int)key);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)), k));
+  ws_mask_scalar(dst + i, src + i, n - i, key);
+}
 
-  if (!WinHttpCrackUrl(wurl, 0, 0, &uc)) {
-    free(wurl);
-    stola_throw(stola_new_string("Invalid URL format for http_fetch"));
-    return stola_new_null();
-  }
+__attribute__((target("avx2")))
+static void ws_mask_avx2(unsigned char *dst, const unsigned char *src, size_t n, uint32_t key) {
+  __m256i k = _mm256_set1_epi32((int)key);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(src + i)), k));
+  ws_mask_sse2(dst + i, src + i, n - i, key);
+}
+#endif
 
-  HINTERNET hSession =
-      WinHttpOpen(L"StolasScript/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-                  WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
-  if (!hSession) {
-    free(wurl);
-    stola_throw(stola_new_string("winhttp module: WinHttpOpen failed"));
-    return stola_new_null();
+// dst[i] = src[i] ^ mask[(phase + i) % 4]; dst may equal src.
+static void ws_mask(unsigned char *dst, const unsigned char *src, size_t n,
+                    const unsigned char mask[4], size_t phase) {
+  static void (*impl)(unsigned char *, const unsigned char *, size_t, uint32_t);
+  if (!impl) {
+#ifdef WS_MASK_X86
+    impl = __builtin_cpu_supports("avx2") ? ws_mask_avx2 : ws_mask_sse2;
+#else
+    impl = ws_mask_scalar;
+#endif
   }
+  unsigned char rot[4];
+  for (int i = 0; i < 4; i++) rot[i] = mask[(phase + (size_t)i) & 3];
+  uint32_t key; memcpy(&key, rot, 4);
+  impl(dst, src, n, key);
+}
 
-  HINTERNET hConnect = WinHttpConnect(hSession, host, uc.nPort, 0);
-  if (!hConnect) {
-    WinHttpCloseHandle(hSession);
-    free(wurl);
-    stola_throw(stola_new_string("HTTP Connection Failed: Host not found"));
-    return stola_new_null();
-  }
+// b0 is the first header byte: FIN | RSV1 | opcode.
+static size_t ws_frame_header(unsigned char *hdr, int b0, uint64_t plen, const unsigned char *mask) {
+  size_t h = 0;
+  unsigned char m = mask ? 0x80 : 0x00;
+  hdr[h++] = (unsigned char)b0;
+  if (plen <= 125) hdr[h++] = m | (unsigned char)plen;
+  else if (plen <= 65535) { hdr[h++] = m | 126; hdr[h++] = (unsigned char)(plen >> 8); hdr[h++] = (unsigned char)plen; }
+  else { hdr[h++] = m | 127; for (int i = 7; i >= 0; i--) hdr[h++] = (unsigned char)(plen >> (i * 8)); }
+  if (mask) { memcpy(hdr + h, mask, 4); h += 4; }
+  return h;
+}
 
-  DWORD flags = (uc.nScheme == INTERNET_SCHEME_HTTPS) ? WINHTTP_FLAG_SECURE : 0;
-  HINTERNET hRequest =
-      WinHttpOpenRequest(hConnect, L"GET", path, NULL, WINHTTP_NO_REFERER,
-                         WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
-  if (!hRequest) {
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    free(wurl);
-    stola_throw(stola_new_string("Failed to initialize HTTP GET Request"));
-    return stola_new_null();
+// Decode the frame at p.  Returns its total size once all of it is in the
+// first len bytes, 0 while incomplete (f->hlen / f->plen are then filled in
+// as far as known, so callers can size their reads).
+static size_t ws_parse_frame(const unsigned char *p, size_t len, WsFrame *f) {
+  f->hlen = 2; f->plen = 0;
+  if (len < 2) return 0;
+  f->fin = p[0] >> 7; f->rsv1 = (p[0] >> 6) & 1; f->opcode = p[0] & 0x0F;
+  f->masked = p[1] >> 7;
+  uint64_t plen = p[1] & 0x7F;
+  size_t h = 2 + (plen == 126 ? 2 : plen == 127 ? 8 : 0) + (f->masked ? 4 : 0);
+  f->hlen = h;
+  if (len < h) return 0;
+  if (plen == 126) plen = ((uint64_t)p[2] << 8) | p[3];
+  else if (plen == 127) { plen = 0; for (int i = 0; i < 8; i++) plen = (plen << 8) | p[2 + i]; }
+  f->plen = plen;
+  if (plen > WS_MAX_MESSAGE || len - h < plen) return 0;
+  return h + (size_t)plen;
+}
+
+#ifdef STOLA_WITH_ZLIB
+// Raw-deflate a whole message, dropping the 00 00 FF FF tail (RFC 7692 7.2.1).
+static char *ws_deflate(const char *in, size_t n, size_t *out_len) {
+  static __thread z_stream *zs;
+  if (!zs) {
+    zs = (z_stream *)calloc(1, sizeof(z_stream));
+    if (deflateInit2(zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) { free(zs); zs = NULL; return NULL; }
+  } else deflateReset(zs);
+  size_t cap = deflateBound(zs, (uLong)n) + 8;
+  char *out = (char *)malloc(cap);
+  zs->next_in = (Bytef *)in; zs->avail_in = (uInt)n;
+  zs->next_out = (Bytef *)out; zs->avail_out = (uInt)cap;
+  if (deflate(zs, Z_SYNC_FLUSH) != Z_OK) { free(out); return NULL; }
+  *out_len = cap - zs->avail_out;
+  if (*out_len >= 4) *out_len -= 4;
+  return out;
+}
+
+// Inflate one compressed message (tail re-appended); NUL-terminated.
+static char *ws_inflate(const char *in, size_t n, size_t *out_len) {
+  static __thread z_stream *zs;
+  if (!zs) {
+    zs = (z_stream *)calloc(1, sizeof(z_stream));
+    if (inflateInit2(zs, -15) != Z_OK) { free(zs); zs = NULL; return NULL; }
+  } else inflateReset(zs);
+  static const unsigned char tail[4] = {0x00, 0x00, 0xFF, 0xFF};
+  size_t cap = n * 4 + 64, len = 0;
+  char *out = (char *)malloc(cap + 1);
+  for (int part = 0; part < 2; part++) {
+    zs->next_in = (Bytef *)(part ? tail : (const unsigned char *)in);
+    zs->avail_in = (uInt)(part ? 4 : n);
+    while (zs->avail_in) {
+      if (len == cap) {
+        if (cap >= WS_MAX_MESSAGE) { free(out); return NULL; }
+        cap *= 2; out = (char *)realloc(out, cap + 1);
+      }
+      zs->next_out = (Bytef *)out + len; zs->avail_out = (uInt)(cap - len);
+      int rc = inflate(zs, Z_SYNC_FLUSH);
+      len = cap - zs->avail_out;
+      if (rc != Z_OK && rc != Z_STREAM_END && rc != Z_BUF_ERROR) { free(out); return NULL; }
+      if (rc == Z_BUF_ERROR && zs->avail_out) break;
+    }
   }
+  out[len] = '\0';
+  *out_len = len;
+  return out;
+}
+#endif
 
-  if (!WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0,
-                          WINHTTP_NO_REQUEST_DATA, 0, 0, 0)) {
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    free(wurl);
-    stola_throw(stola_new_string("Failed to dispatch HTTP HTTP GET Request"));
-    return stola_new_null();
+// Add a data frame (payload still masked if f->masked) to m.  Returns 1 when
+// m now holds a whole message, 0 when more fragments are expected, or a
+// close code (1002 protocol error, 1009 too big) to fail the connection.
+static int ws_msg_feed(WsMsg *m, const WsFrame *f, const unsigned char *payload, int deflate_ok) {
+  if (f->opcode == 0x0) {
+    if (!m->opcode || f->rsv1) return 1002;
+  } else {
+    if (m->opcode) return 1002;    /* new message inside a fragmented one */
+    if (f->rsv1 && !deflate_ok) return 1002;
+    m->opcode = f->opcode; m->compressed = f->rsv1; m->len = 0;
   }
+  if (m->len + f->plen > WS_MAX_MESSAGE) return 1009;
+  if (m->len + f->plen + 1 > m->cap) {
+    size_t cap = m->cap ? m->cap : 256;
+    while (m->len + f->plen + 1 > cap) cap *= 2;
+    m->data = (char *)realloc(m->data, cap);
+    m->cap = cap;
+  }
+  if (f->masked) ws_mask((unsigned char *)m->data + m->len, payload, (size_t)f->plen, payload - 4, 0);
+  else memcpy(m->data + m->len, payload, (size_t)f->plen);
+  m->len += (size_t)f->plen;
+  return f->fin ? 1 : 0;
+}
 
-  if (!WinHttpReceiveResponse(hRequest, NULL)) {
-    WinHttpCloseHandle(hRequest);
-    WinHttpCloseHandle(hConnect);
-    WinHttpCloseHandle(hSession);
-    free(wurl);
-    stola_throw(
-        stola_new_string("Network Error: WinHttpReceiveResponse Timeout"));
-    return stola_new_null();
+// Hand over the message completed by ws_msg_feed (decompressed if needed)
+// as a NUL-terminated buffer, or NULL if it does not inflate.
+static char *ws_msg_take(WsMsg *m, size_t *len, int *binary) {
+  char *out = m->data;
+  *len = m->len; *binary = m->opcode == 0x2;
+  out[m->len] = '\0';
+  m->data = NULL; m->len = m->cap = 0;
+  int compressed = m->compressed;
+  m->opcode = m->compressed = 0;
+  if (compressed) {
+#ifdef STOLA_WITH_ZLIB
+    char *plain = ws_inflate(out, *len, len);
+    free(out);
+    return plain;
+#else
+    free(out);
+    return NULL;
+#endif
   }
+  return out;
+}
 
-  // Read status code
-  DWORD status = 0;
-  DWORD status_size = sizeof(status);
-  WinHttpQueryHeaders(hRequest,
-                      WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-                      WINHTTP_HEADER_NAME_BY_INDEX, &status, &status_size,
-                      WINHTTP_NO_HEADER_INDEX);
+static uint32_t ws_random(void) {
+  static __thread uint64_t s;
+  if (!s) s = ((uint64_t)time(NULL) << 20) ^ (uint64_t)(uintptr_t)&s ^ 0x9E3779B97F4A7C15ull;
+  s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+  return (uint32_t)(s >> 16);
+}
 
-  // Read body
-  size_t total = 0;
-  size_t cap = 8192;
-  char *body = (char *)malloc(cap);
+// Send one frame (b0 = FIN | RSV1 | opcode); bytes written or -1.  Server
+// ends (b->ws_server) send unmasked, clients mask through the scratch buffer.
+static int ws_send_frame(int64_t fd, int b0, const char *payload, size_t plen) {
+  SockBuf *b = sockbuf_get(fd, 0);
+  unsigned char hdr[14];
+  if (b && b->ws_server) {
+    size_t h = ws_frame_header(hdr, b0, plen, NULL);
+    return sock_sendv(fd, hdr, h, payload, plen) < 0 ? -1 : (int)(h + plen);
+  }
+  static __thread unsigned char *scratch;
+  if (!scratch) scratch = (unsigned char *)malloc(WS_SCRATCH);
+  uint32_t key = ws_random();
+  unsigned char mask[4]; memcpy(mask, &key, 4);
+  size_t h = ws_frame_header(hdr, b0, plen, mask);
+  size_t off = 0;
+  do {
+    size_t n = plen - off < WS_SCRATCH ? plen - off : WS_SCRATCH;
+    ws_mask(scratch, (const unsigned char *)payload + off, n, mask, off);
+    if (sock_sendv(fd, off ? NULL : hdr, off ? 0 : h, scratch, n) < 0) return -1;
+    off += n;
+  } while (off < plen);
+  return (int)(h + plen);
+}
 
-  DWORD bytes_available = 0;
-  while (WinHttpQueryDataAvailable(hRequest, &bytes_available) &&
-         bytes_available > 0) {
-    if (total + bytes_available + 1 > cap) {
-      cap = (total + bytes_available + 1) * 2;
-      body = (char *)realloc(body, cap);
+// Send a whole text (0x1) or binary (0x2) message, compressed when
+// permessage-deflate was negotiated and it is worth it.
+static int ws_send_message(int64_t fd, int opcode, const char *payload, size_t plen) {
+#ifdef STOLA_WITH_ZLIB
+  SockBuf *b = sockbuf_get(fd, 0);
+  if (b && b->ws_deflate && plen >= WS_DEFLATE_MIN) {
+    size_t zlen;
+    char *z = ws_deflate(payload, plen, &zlen);
+    if (z) {
+      int r = ws_send_frame(fd, 0x80 | 0x40 | opcode, z, zlen);
+      free(z);
+      return r;
     }
-    DWORD bytes_read = 0;
-    WinHttpReadData(hRequest, body + total, bytes_available, &bytes_read);
-    total += bytes_read;
   }
-  body[total] = '\0';
+#endif
+  return ws_send_frame(fd, 0x80 | opcode, payload, plen);
+}
 
-  WinHttpCloseHandle(hRequest);
-  WinHttpCloseHandle(hConnect);
-  WinHttpCloseHandle(hSession);
-  free(wurl);
+static void ws_send_close(int64_t fd, int code) {
+  unsigned char body[2] = {(unsigned char)(code >> 8), (unsigned char)code};
+  ws_send_frame(fd, 0x88, (const char *)body, code ? 2 : 0);
+}
 
-  // Build response dict: {status: N, body: "..."}
-  StolaValue *result = stola_new_dict();
-  stola_dict_set(result, stola_new_string("status"),
-                 stola_new_int((int64_t)status));
-  stola_dict_set(result, stola_new_string("body"),
-                 stola_new_string_owned(body));
-  return result;
+// Reply to a control frame whose (unmasked) payload is `payload`.  Returns
+// 0 when the connection is closing.
+static int ws_control(int64_t fd, const WsFrame *f, const unsigned char *payload) {
+  if (f->opcode == 0x8) {
+    int code = f->plen >= 2 ? (payload[0] << 8) | payload[1] : 0;
+    ws_send_close(fd, code);
+    return 0;
+  }
+  if (f->opcode == 0x9) ws_send_frame(fd, 0x8A, (const char *)payload, (size_t)f->plen);
+  return 1;
 }
 
-// ============================================================
-// Real Parallelism (Windows Threads & Mutexes)
-// ============================================================
+#define WS_EXT_OFFER "permessage-deflate; client_no_context_takeover; server_no_context_takeover"
+#ifdef STOLA_WITH_ZLIB
+#define WS_CLIENT_EXT "Sec-WebSocket-Extensions: " WS_EXT_OFFER "\r\n"
+#else
+#define WS_CLIENT_EXT ""
+#endif
 
-typedef StolaValue *(*ThreadFunc)(StolaValue *, StolaValue *, StolaValue *,
-                                  StolaValue *);
+// Build the "101 Switching Protocols" reply for an upgrade request held in
+// req (NUL-terminated).  Returns the reply length, or -1 without a key;
+// *deflate is set when permessage-deflate was offered and accepted.
+static int ws_handshake_reply(const char *req, char *out, size_t cap, int *deflate) {
+  const char *kh=strstr(req,"Sec-WebSocket-Key:");
+  if (!kh) return -1;
+  kh+=18; while(*kh==' ')kh++;
+  char key[64]={0}; int ki=0;
+  while(*kh&&*kh!='\r'&&*kh!='\n'&&ki<63) key[ki++]=*kh++;
+  char combined[256];
+  snprintf(combined,sizeof(combined),"%s%s",key,"258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+  unsigned char sha1_out[20];
+  ws_sha1((unsigned char*)combined,strlen(combined),sha1_out);
+  char *accept_key=ws_base64_encode(sha1_out,20);
+  *deflate = 0;
+#ifdef STOLA_WITH_ZLIB
+  *deflate = strstr(req,"permessage-deflate") != NULL;
+#endif
+  int n=snprintf(out,cap,"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+    "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n%s%s%s\r\n",accept_key,
+    *deflate ? "Sec-WebSocket-Extensions: " : "", *deflate ? WS_EXT_OFFER : "", *deflate ? "\r\n" : "");
+  free(accept_key);
+  return n;
+}
 
-typedef struct {
-  ThreadFunc func;
-  StolaValue *arg;
-  StolaValue *result;   /* filled by worker, read by join */
-} ThreadData;
+// Mark fd as the server end of a WebSocket (its frames go out unmasked).
+static void ws_set_server(int64_t fd, int deflate) {
+  SockBuf *b = sockbuf_get(fd, 1);
+  b->ws_server = 1; b->ws_deflate = deflate;
+}
 
-static DWORD WINAPI stola_thread_start_routine(LPVOID lpParam) {
-  ThreadData *data = (ThreadData *)lpParam;
-  StolaValue *null_val = stola_new_null();
-  StolaValue *r = data->func(data->arg, null_val, null_val, null_val);
-  data->result = r;
-  /* do NOT free(data) here — thread_join reads result then frees */
-  return 0;
+// Read the server's handshake reply through fd's SockBuf, leaving any frame
+// bytes that arrived with it buffered.  1 when the upgrade was accepted.
+static int ws_client_handshake(int64_t fd) {
+  SockBuf *b = sockbuf_get(fd, 1);
+  size_t scanned = 0;
+  for (;;) {
+    const char *d = b->data + b->start;
+    for (size_t i = scanned; i + 4 <= b->len; i++)
+      if (d[i] == '\r' && d[i + 1] == '\n' && d[i + 2] == '\r' && d[i + 3] == '\n') {
+        int ok = b->len >= 12 && memcmp(d, "HTTP/1.1 101", 12) == 0;
+#ifdef STOLA_WITH_ZLIB
+        for (size_t j = 0; ok && j + 18 <= i; j++)
+          if (memcmp(d + j, "permessage-deflate", 18) == 0) { b->ws_deflate = 1; break; }
+#endif
+        b->start += i + 4; b->len -= i + 4;
+        if (!b->len) b->start = 0;
+        return ok;
+      }
+    if (b->len >= 3) scanned = b->len - 3;
+    if (b->len > 16384 || sockbuf_fill(b, 0) <= 0) return 0;
+  }
 }
 
-/* Windows: wrap HANDLE + ThreadData pointer inside a small struct */
-typedef struct { HANDLE hThread; ThreadData *data; } ThreadHandle;
+// Receive the next complete message (text or binary), or NULL on close /
+// error.  *len is the payload size; binary payloads may contain NULs.
+static char *ws_recv_message(int64_t fd, size_t *len, int *binary) {
+  SockBuf *b = sockbuf_get(fd, 1);
+  if (!b->ws_msg) b->ws_msg = (WsMsg *)calloc(1, sizeof(WsMsg));
+  for (;;) {
+    WsFrame f;
+    size_t total;
+    while ((total = ws_parse_frame((unsigned char *)b->data + b->start, b->len, &f)) == 0) {
+      if (f.plen > WS_MAX_MESSAGE) { ws_send_close(fd, 1009); return NULL; }
+      if (sockbuf_fill(b, f.hlen + (size_t)f.plen) <= 0) return NULL;
+    }
+    unsigned char *payload = (unsigned char *)b->data + b->start + f.hlen;
+    int rc = 1;
+    if (f.opcode >= 0x8) {
+      if (!f.fin || f.plen > 125) rc = -1002;
+      else {
+        if (f.masked) ws_mask(payload, payload, (size_t)f.plen, payload - 4, 0);
+        rc = ws_control(fd, &f, payload) ? 0 : -1;
+      }
+    } else if (f.opcode <= 0x2) {
+      rc = ws_msg_feed(b->ws_msg, &f, payload, b->ws_deflate);
+      if (rc > 1) rc = -rc;
+      else rc = rc ? 2 : 0;
+    } else rc = -1002;
+    b->start += total; b->len -= total;
+    if (!b->len) b->start = 0;
+    if (rc == -1) return NULL;
+    if (rc < -1) { ws_send_close(fd, -rc); return NULL; }
+    if (rc == 2) {
+      char *msg = ws_msg_take(b->ws_msg, len, binary);
+      if (!msg) ws_send_close(fd, 1007);
+      return msg;
+    }
+  }
+}
 
-StolaValue *stola_thread_spawn(void *func_ptr, StolaValue *arg) {
-  ThreadData *data = (ThreadData *)malloc(sizeof(ThreadData));
-  data->func   = (ThreadFunc)func_ptr;
-  data->arg    = arg;
-  data->result = NULL;
-  ThreadHandle *th = (ThreadHandle *)malloc(sizeof(ThreadHandle));
-  th->data    = data;
-  th->hThread = CreateThread(NULL, 0, stola_thread_start_routine, data, 0, NULL);
-  return stola_new_int((int64_t)(uintptr_t)th);
+// Text-only view used by ws_receive and the thread-per-connection server.
+static char *ws_recv_frame(int64_t fd) {
+  size_t len; int binary;
+  return ws_recv_message(fd, &len, &binary);
 }
 
-StolaValue *stola_thread_join(StolaValue *hThread_val) {
-  if (!hThread_val || hThread_val->type != STOLA_INT)
-    return stola_new_null();
-  ThreadHandle *th = (ThreadHandle *)(uintptr_t)hThread_val->as.int_val;
-  WaitForSingleObject(th->hThread, INFINITE);
-  CloseHandle(th->hThread);
-  StolaValue *ret = th->data->result ? th->data->result : stola_new_null();
-  free(th->data);
-  free(th);
-  return ret;
+// ws_receive_message(handle) -> {type: "text" | "binary", data, length},
+// or null once the connection is closed.
+StolaValue *stola_ws_receive_message(StolaValue *handle) {
+  if (!handle || handle->type != STOLA_INT) return stola_new_null();
+  size_t len; int binary;
+  char *data = ws_recv_message(handle->as.int_val, &len, &binary);
+  if (!data) return stola_new_null();
+  StolaValue *d = stola_new_dict();
+  stola_dict_set(d, stola_new_string("type"), stola_new_string(binary ? "binary" : "text"));
+  stola_dict_set(d, stola_new_string("data"), stola_new_string_owned(data));
+  stola_dict_set(d, stola_new_string("length"), stola_new_int((int64_t)len));
+  return d;
 }
 
-StolaValue *stola_mutex_create(void) {
-  HANDLE hMutex = CreateMutex(NULL, FALSE, NULL);
-  return stola_new_int((int64_t)hMutex);
+// ws_send_binary(handle, data): like ws_send with the binary opcode.
+StolaValue *stola_ws_send_binary(StolaValue *handle, StolaValue *data) {
+  const char *p; size_t n;
+  if (!handle || handle->type != STOLA_INT || !stola_str_span(data, &p, &n)) return stola_new_int(-1);
+  return stola_new_int(ws_send_message(handle->as.int_val, 0x2, p, n));
 }
 
-StolaValue *stola_mutex_lock(StolaValue *hMutex_val) {
+// ws_broadcast(handles, msg) -> {sent, failed}: send one text message to
+// many server-side connections.  The frame header is built once (and the
+// message deflated once for connections that negotiated it), then the same
+// buffers go to every socket in a single batch.  A socket that errors, or
+// has not taken the whole frame WS_BCAST_TIMEOUT_MS after the call started,
+// lands in `failed` without holding up the rest; if it got part of the
+// frame it is also shut down.  Client-side handles fall back to ws_send.
+StolaValue *stola_ws_broadcast(StolaValue *handles, StolaValue *msg) {
+  StolaValue *failed = stola_new_array();
+  StolaValue *result = stola_new_dict();
+  int64_t sent = 0;
+  const char *payload;
+  size_t plen;
+  if (handles && handles->type == STOLA_ARRAY && stola_str_span(msg, &payload, &plen)) {
+    unsigned char hdr[10], zhdr[10];
+    size_t hlen = ws_frame_header(hdr, 0x81, plen, NULL), zhlen = 0, zlen = 0;
+    char *z = NULL;
+    int n = handles->as.array_val.count, m = 0;
+    WsBcast *items = (WsBcast *)calloc((size_t)(n ? n : 1), sizeof(WsBcast));
+    StolaValue **who = (StolaValue **)calloc((size_t)(n ? n : 1), sizeof(StolaValue *));
+    for (int i = 0; i < n; i++) {
+      StolaValue *h = handles->as.array_val.items[i];
+      if (!h || h->type != STOLA_INT) { stola_push(failed, h ? h : stola_new_null()); continue; }
+      SockBuf *b = sockbuf_get(h->as.int_val, 0);
+      if (!b || !b->ws_server) {
+        if (ws_send_message(h->as.int_val, 0x1, payload, plen) < 0) stola_push(failed, h);
+        else sent++;
+        continue;
+      }
+      WsBcast *it = &items[m];
+      it->fd = h->as.int_val;
+      it->hdr = hdr; it->hlen = hlen; it->payload = payload; it->plen = plen;
+#ifdef STOLA_WITH_ZLIB
+      if (b->ws_deflate && plen >= WS_DEFLATE_MIN) {
+        if (!z && (z = ws_deflate(payload, plen, &zlen)) != NULL)
+          zhlen = ws_frame_header(zhdr, 0xC1, zlen, NULL);
+        if (z) { it->hdr = zhdr; it->hlen = zhlen; it->payload = z; it->plen = zlen; }
+      }
+#else
+      (void)zhdr; (void)zhlen; (void)zlen;
+#endif
+      who[m++] = h;
+    }
+    sock_broadcast(items, m);
+    for (int i = 0; i < m; i++) {
+      if (items[i].failed) stola_push(failed, who[i]);
+      else sent++;
+    }
+    free(z); free(items); free(who);
+  }
+  stola_dict_set(result, stola_new_string("sent"), stola_new_int(sent));
+  stola_dict_set(result, stola_new_string("failed"), failed);
+  return result;
+}
+
+// ============================================================
+// Shared helpers: HTTP/1.1 messages
+// ============================================================
+
+// "Key: value\r\n" lines for a headers dict (values via to_string).
+static char *http_header_lines(StolaValue *headers) {
+  size_t cap = 256, len = 0;
+  char *out = (char *)malloc(cap);
+  out[0] = '\0';
+  if (!headers || headers->type != STOLA_DICT) return out;
+  for (int i = 0; i < headers->as.dict_val.count; i++) {
+    const char *k = headers->as.dict_val.entries[i].key;
+    StolaValue *sv = stola_to_string(headers->as.dict_val.entries[i].value);
+    size_t need = strlen(k) + strlen(sv->as.str_val) + 5;
+    if (len + need > cap) { while (len + need > cap) cap *= 2; out = (char *)realloc(out, cap); }
+    len += (size_t)sprintf(out + len, "%s: %s\r\n", k, sv->as.str_val);
+  }
+  return out;
+}
+
+// Add one "Key: value" response header to dict, key lowercased.  Repeated
+// headers are joined with ", " as RFC 9110 allows.
+static void http_add_header(StolaValue *dict, const char *line, size_t n) {
+  const char *colon = memchr(line, ':', n);
+  if (!colon) return;
+  size_t kl = (size_t)(colon - line);
+  char *key = (char *)malloc(kl + 1);
+  for (size_t i = 0; i < kl; i++) key[i] = (char)((line[i] >= 'A' && line[i] <= 'Z') ? line[i] + 32 : line[i]);
+  key[kl] = '\0';
+  const char *v = colon + 1, *end = line + n;
+  while (v < end && (*v == ' ' || *v == '\t')) v++;
+  while (end > v && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+  StolaValue *kv = stola_new_string_owned(key);
+  StolaValue *prev = stola_dict_get(dict, kv);
+  size_t pl = (prev && prev->type == STOLA_STRING) ? strlen(prev->as.str_val) : 0;
+  char *val = (char *)malloc(pl + 2 + (size_t)(end - v) + 1);
+  size_t o = 0;
+  if (pl) { memcpy(val, prev->as.str_val, pl); memcpy(val + pl, ", ", 2); o = pl + 2; }
+  memcpy(val + o, v, (size_t)(end - v)); val[o + (size_t)(end - v)] = '\0';
+  stola_dict_set(dict, kv, stola_new_string_owned(val));
+}
+
+static StolaValue *http_result(int status, char *body, StolaValue *headers) {
+  StolaValue *result = stola_new_dict();
+  stola_dict_set(result, stola_new_string("status"), stola_new_int((int64_t)status));
+  stola_dict_set(result, stola_new_string("body"), stola_new_string_owned(body));
+  stola_dict_set(result, stola_new_string("headers"), headers);
+  return result;
+}
+
+// ============================================================
+// Shared helpers: HTTP/1.1 server
+// ============================================================
+// http_server_create parses requests in place: the request line and headers
+// become (pointer, length) spans into the connection's receive buffer, so a
+// request costs no allocation until the handler looks at it.  The handler
+// gets a small dict (method, path, query, version, body); headers are only
+// turned into StolaValues when http_header / http_headers ask for them.
+// Responses are appended to a per-thread output buffer that is flushed once
+// per batch of pipelined requests.
+
+#define HTTPD_MAX_HEADERS 64
+#define HTTPD_MAX_HEAD    16384
+#define HTTPD_MAX_BODY    (8 * 1024 * 1024)
+
+typedef struct { const char *p; int n; } HttpdStr;
+
+typedef struct {
+  HttpdStr method, path, query, version, body;
+  HttpdStr name[HTTPD_MAX_HEADERS], value[HTTPD_MAX_HEADERS];
+  int nheaders, keep_alive, head;
+  StolaValue *dict;               /* what the handler was given */
+} HttpdReq;
+
+typedef struct { char *data; size_t len, cap; } HttpdBuf;
+
+typedef StolaValue *(*HttpdHandler)(StolaValue *, StolaValue *, StolaValue *, StolaValue *);
+
+// The request whose handler is running on this thread (for http_header).
+static __thread HttpdReq *httpd_current;
+static __thread HttpdBuf httpd_out;
+
+// Opens a static file for a {file: path} response: fd, or -1.  Per platform.
+static int httpd_open_file(const char *path, int64_t *size);
+
+static int httpd_ieq(HttpdStr s, const char *lit) {
+  int i = 0;
+  for (; i < s.n && lit[i]; i++) {
+    char c = s.p[i];
+    if (c >= 'A' && c <= 'Z') c += 32;
+    if (c != lit[i]) return 0;
+  }
+  return i == s.n && !lit[i];
+}
+
+// Does a comma-separated header value contain `token` (lowercase)?
+static int httpd_has_token(HttpdStr v, const char *token) {
+  int i = 0;
+  while (i < v.n) {
+    while (i < v.n && (v.p[i] == ' ' || v.p[i] == '\t' || v.p[i] == ',')) i++;
+    int s = i;
+    while (i < v.n && v.p[i] != ',') i++;
+    int e = i;
+    while (e > s && (v.p[e - 1] == ' ' || v.p[e - 1] == '\t')) e--;
+    HttpdStr t = {v.p + s, e - s};
+    if (t.n && httpd_ieq(t, token)) return 1;
+  }
+  return 0;
+}
+
+// Parse one request from buf.  Returns its total length once head and body
+// are complete, 0 when more bytes are needed, or -status for a request that
+// must be refused (the connection is then closed).
+static long httpd_parse(const char *buf, size_t len, HttpdReq *r) {
+  const char *p = buf, *end = buf + len;
+  while (p + 1 < end && p[0] == '\r' && p[1] == '\n') p += 2; /* RFC 9112 2.2 */
+  const char *hend = NULL;
+  for (const char *q = p; q + 3 < end; q++) {
+    q = memchr(q, '\r', (size_t)(end - q - 3));
+    if (!q) break;
+    if (q[1] == '\n' && q[2] == '\r' && q[3] == '\n') { hend = q; break; }
+  }
+  if (!hend) return len - (size_t)(p - buf) > HTTPD_MAX_HEAD ? -431 : 0;
+  if (hend - p > HTTPD_MAX_HEAD) return -431;
+
+  const char *eol = memchr(p, '\r', (size_t)(hend - p + 1));
+  const char *sp1 = memchr(p, ' ', (size_t)(eol - p));
+  if (!sp1 || sp1 == p) return -400;
+  const char *sp2 = memchr(sp1 + 1, ' ', (size_t)(eol - sp1 - 1));
+  if (!sp2 || sp2 == sp1 + 1) return -400;
+  r->method.p = p; r->method.n = (int)(sp1 - p);
+  const char *t = sp1 + 1, *qm = memchr(t, '?', (size_t)(sp2 - t));
+  r->path.p = t; r->path.n = (int)((qm ? qm : sp2) - t);
+  r->query.p = qm ? qm + 1 : sp2; r->query.n = qm ? (int)(sp2 - qm - 1) : 0;
+  r->version.p = sp2 + 1; r->version.n = (int)(eol - sp2 - 1);
+  if (r->version.n != 8 || memcmp(r->version.p, "HTTP/1.", 7) != 0) return -505;
+
+  int minor1 = r->version.p[7] == '1', conn_close = 0, conn_keep = 0;
+  int64_t clen = 0;
+  r->nheaders = 0;
+  for (const char *l = eol + 2; l < hend + 2; ) {
+    const char *le = memchr(l, '\r', (size_t)(hend + 2 - l));
+    if (!le) le = hend;
+    const char *colon = memchr(l, ':', (size_t)(le - l));
+    if (!colon || colon == l) return -400;
+    if (r->nheaders == HTTPD_MAX_HEADERS) return -431;
+    const char *v = colon + 1, *ve = le;
+    while (v < ve && (*v == ' ' || *v == '\t')) v++;
+    while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+    HttpdStr name = {l, (int)(colon - l)}, value = {v, (int)(ve - v)};
+    r->name[r->nheaders] = name; r->value[r->nheaders] = value; r->nheaders++;
+    if (httpd_ieq(name, "content-length")) {
+      clen = 0;
+      for (int i = 0; i < value.n; i++) {
+        if (value.p[i] < '0' || value.p[i] > '9') return -400;
+        clen = clen * 10 + (value.p[i] - '0');
+        if (clen > HTTPD_MAX_BODY) return -413;
+      }
+    } else if (httpd_ieq(name, "transfer-encoding")) {
+      if (!httpd_ieq(value, "identity")) return -501;
+    } else if (httpd_ieq(name, "connection")) {
+      conn_close |= httpd_has_token(value, "close");
+      conn_keep |= httpd_has_token(value, "keep-alive");
+    }
+    l = le + 2;
+  }
+  r->keep_alive = minor1 ? !conn_close : conn_keep;
+  r->head = httpd_ieq(r->method, "head");
+  size_t total = (size_t)(hend + 4 - buf) + (size_t)clen;
+  if (len < total) return 0;
+  r->body.p = hend + 4; r->body.n = (int)clen;
+  r->dict = NULL;
+  return (long)total;
+}
+
+static StolaValue *httpd_string(HttpdStr s) {
+  char *out = (char *)malloc((size_t)s.n + 1);
+  memcpy(out, s.p, (size_t)s.n); out[s.n] = '\0';
+  return stola_new_string_owned(out);
+}
+
+static StolaValue *httpd_request_dict(HttpdReq *r) {
+  StolaValue *d = stola_new_dict();
+  stola_dict_set(d, stola_new_string("method"), httpd_string(r->method));
+  stola_dict_set(d, stola_new_string("path"), httpd_string(r->path));
+  stola_dict_set(d, stola_new_string("query"), httpd_string(r->query));
+  stola_dict_set(d, stola_new_string("version"), httpd_string(r->version));
+  stola_dict_set(d, stola_new_string("body"), httpd_string(r->body));
+  r->dict = d;
+  return d;
+}
+
+static void httpd_append(HttpdBuf *b, const char *s, size_t n) {
+  if (b->len + n > b->cap) {
+    size_t cap = b->cap ? b->cap : 16384;
+    while (b->len + n > cap) cap *= 2;
+    b->data = (char *)realloc(b->data, cap);
+    b->cap = cap;
+  }
+  memcpy(b->data + b->len, s, n);
+  b->len += n;
+}
+
+static void httpd_appends(HttpdBuf *b, const char *s) { httpd_append(b, s, strlen(s)); }
+
+static const char *httpd_reason(int status) {
+  switch (status) {
+  case 200: return "OK";                    case 201: return "Created";
+  case 204: return "No Content";            case 301: return "Moved Permanently";
+  case 302: return "Found";                 case 304: return "Not Modified";
+  case 400: return "Bad Request";           case 401: return "Unauthorized";
+  case 403: return "Forbidden";             case 404: return "Not Found";
+  case 405: return "Method Not Allowed";    case 413: return "Content Too Large";
+  case 431: return "Request Header Fields Too Large";
+  case 500: return "Internal Server Error"; case 501: return "Not Implemented";
+  case 503: return "Service Unavailable";   case 505: return "HTTP Version Not Supported";
+  default:  return "Unknown";
+  }
+}
+
+static const char *httpd_mime(const char *path) {
+  static const char *const types[][2] = {
+    {".html", "text/html; charset=utf-8"}, {".htm", "text/html; charset=utf-8"},
+    {".css", "text/css"}, {".js", "text/javascript"}, {".json", "application/json"},
+    {".txt", "text/plain; charset=utf-8"}, {".svg", "image/svg+xml"},
+    {".png", "image/png"}, {".jpg", "image/jpeg"}, {".jpeg", "image/jpeg"},
+    {".gif", "image/gif"}, {".ico", "image/x-icon"}, {".wasm", "application/wasm"},
+  };
+  const char *dot = strrchr(path, '.');
+  if (dot)
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+      if (strcmp(dot, types[i][0]) == 0) return types[i][1];
+  return "application/octet-stream";
+}
+
+// "Date: ...\r\n", formatted at most once per second per thread.
+static const char *httpd_date(void) {
+  static __thread char line[48];
+  static __thread time_t last;
+  time_t now = time(NULL);
+  if (now != last) {
+    struct tm tm;
+#ifdef _WIN32
+    gmtime_s(&tm, &now);
+#else
+    gmtime_r(&now, &tm);
+#endif
+    strftime(line, sizeof(line), "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm);
+    last = now;
+  }
+  return line;
+}
+
+static void httpd_head(HttpdBuf *out, int status, int keep_alive, int http10,
+                       const char *ctype, int64_t clen, StolaValue *extra) {
+  char line[160];
+  int n = snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\nServer: stolascript\r\n",
+                   status, httpd_reason(status));
+  httpd_append(out, line, (size_t)n);
+  httpd_appends(out, httpd_date());
+  int has_ctype = 0;
+  if (extra && extra->type == STOLA_DICT) {
+    for (int i = 0; i < extra->as.dict_val.count; i++) {
+      const char *k = extra->as.dict_val.entries[i].key;
+      StolaValue *sv = stola_to_string(extra->as.dict_val.entries[i].value);
+      HttpdStr ks = {k, (int)strlen(k)};
+      if (httpd_ieq(ks, "content-length") || httpd_ieq(ks, "connection")) continue;
+      has_ctype |= httpd_ieq(ks, "content-type");
+      httpd_appends(out, k); httpd_append(out, ": ", 2);
+      httpd_appends(out, sv->as.str_val); httpd_append(out, "\r\n", 2);
+    }
+  }
+  if (!has_ctype && ctype) { httpd_appends(out, "Content-Type: "); httpd_appends(out, ctype); httpd_append(out, "\r\n", 2); }
+  n = snprintf(line, sizeof(line), "Content-Length: %lld\r\n", (long long)clen);
+  httpd_append(out, line, (size_t)n);
+  if (!keep_alive) httpd_appends(out, "Connection: close\r\n");
+  else if (http10) httpd_appends(out, "Connection: keep-alive\r\n");
+  httpd_append(out, "\r\n", 2);
+}
+
+static void httpd_error(HttpdBuf *out, int status) {
+  const char *reason = httpd_reason(status);
+  httpd_head(out, status, 0, 0, "text/plain; charset=utf-8", (int64_t)strlen(reason), NULL);
+  httpd_appends(out, reason);
+}
+
+// Append the response for handler result `res`.  A string is a 200 HTML
+// body; arrays are sent as JSON; a dict may carry status, headers and either
+// body (a non-string body is JSON-encoded) or file (a path streamed by the
+// caller with sendfile).  null is a 404.  Sets *file_fd when the caller
+// must send *file_size bytes from it after flushing the head.
+static void httpd_respond(HttpdReq *r, StolaValue *res, HttpdBuf *out,
+                          int *file_fd, int64_t *file_size) {
+  int status = 200, http10 = r->version.p[7] == '0';
+  const char *ctype = "text/html; charset=utf-8";
+  StolaValue *headers = NULL, *body = res;
+  *file_fd = -1;
+  if (!res || res->type == STOLA_NULL) {
+    status = 404; body = stola_new_string(httpd_reason(404));
+    ctype = "text/plain; charset=utf-8";
+  } else if (res->type == STOLA_DICT) {
+    StolaValue *sv = stola_struct_get(res, "status");
+    if (sv->type == STOLA_INT) status = (int)sv->as.int_val;
+    headers = stola_struct_get(res, "headers");
+    StolaValue *fv = stola_struct_get(res, "file");
+    if (fv->type == STOLA_STRING) {
+      *file_fd = httpd_open_file(fv->as.str_val, file_size);
+      if (*file_fd >= 0) {
+        httpd_head(out, status, r->keep_alive, http10, httpd_mime(fv->as.str_val), *file_size, headers);
+        if (r->head) { *file_size = 0; }
+        return;
+      }
+      status = 404; body = stola_new_string(httpd_reason(404));
+      ctype = "text/plain; charset=utf-8";
+    } else {
+      body = stola_struct_get(res, "body");
+    }
+  }
+  if (body->type == STOLA_ARRAY || body->type == STOLA_DICT ||
+      body->type == STOLA_JSON) {
+    body = stola_json_encode(body);
+    ctype = "application/json";
+  } else if (body->type == STOLA_NULL) {
+    body = stola_new_string("");
+  } else if (body->type != STOLA_STRING) {
+    body = stola_to_string(body);
+  }
+  size_t blen = strlen(body->as.str_val);
+  int no_body = status == 204 || status == 304 || (status >= 100 && status < 200);
+  httpd_head(out, status, r->keep_alive, http10, no_body ? NULL : ctype,
+             no_body ? 0 : (int64_t)blen, headers);
+  if (!r->head && !no_body) httpd_append(out, body->as.str_val, blen);
+}
+
+// Run the handler over every complete request at the front of buf and
+// append the responses to httpd_out.  *used gets the bytes consumed.
+// Returns 1 to keep the connection, 0 to close it after flushing, and
+// stops early (returning 2) when a file response needs to be streamed:
+// *file_fd / *file_size describe it and the caller resumes afterwards.
+static int httpd_serve(HttpdHandler handler, char *buf, size_t len, size_t *used,
+                       int *file_fd, int64_t *file_size, int *keep) {
+  size_t off = 0;
+  *file_fd = -1;
+  *keep = 1;
+  while (off < len) {
+    HttpdReq r;
+    long n = httpd_parse(buf + off, len - off, &r);
+    if (n == 0) break;
+    if (n < 0) { httpd_error(&httpd_out, (int)-n); *used = len; *keep = 0; return 0; }
+    StolaValue *nv = stola_new_null();
+    httpd_current = &r;
+    StolaValue *res = handler(httpd_request_dict(&r), nv, nv, nv);
+    httpd_current = NULL;
+    httpd_respond(&r, res, &httpd_out, file_fd, file_size);
+    off += (size_t)n;
+    *keep = r.keep_alive;
+    if (*file_fd >= 0) { *used = off; return 2; }
+    if (!r.keep_alive) break;
+  }
+  *used = off;
+  return *keep;
+}
+
+// http_header(req, name): one request header (case-insensitive), or null.
+StolaValue *stola_http_header(StolaValue *req, StolaValue *name) {
+  if (!name || name->type != STOLA_STRING) return stola_new_null();
+  char lower[128];
+  size_t n = strlen(name->as.str_val);
+  if (n >= sizeof(lower)) return stola_new_null();
+  for (size_t i = 0; i <= n; i++) {
+    char c = name->as.str_val[i];
+    lower[i] = (char)((c >= 'A' && c <= 'Z') ? c + 32 : c);
+  }
+  HttpdReq *r = httpd_current;
+  if (r && r->dict == req) {
+    for (int i = 0; i < r->nheaders; i++)
+      if (httpd_ieq(r->name[i], lower)) return httpd_string(r->value[i]);
+    return stola_new_null();
+  }
+  /* outside the handler: use the dict built by http_headers, if any */
+  if (!req || req->type != STOLA_DICT) return stola_new_null();
+  StolaValue *h = stola_struct_get(req, "headers");
+  return h->type == STOLA_DICT ? stola_struct_get(h, lower) : stola_new_null();
+}
+
+// http_headers(req): every header as a dict with lowercased keys.  The dict
+// is built on first use and cached in req["headers"].
+StolaValue *stola_http_headers(StolaValue *req) {
+  if (!req || req->type != STOLA_DICT) return stola_new_dict();
+  StolaValue *h = stola_struct_get(req, "headers");
+  if (h->type == STOLA_DICT) return h;
+  h = stola_new_dict();
+  HttpdReq *r = httpd_current;
+  if (r && r->dict == req)
+    for (int i = 0; i < r->nheaders; i++)
+      http_add_header(h, r->name[i].p, (size_t)(r->value[i].p + r->value[i].n - r->name[i].p));
+  stola_struct_set(req, "headers", h);
+  return h;
+}
+
+// ============================================================
+// Socket Operations using WinSock2
+// ============================================================
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+
+static int wsa_initialized = 0;
+
+static void ensure_wsa(void) {
+  if (!wsa_initialized) {
+    WSADATA wsa;
+    WSAStartup(MAKEWORD(2, 2), &wsa);
+    wsa_initialized = 1;
+  }
+}
+
+StolaValue *stola_socket_connect(StolaValue *host, StolaValue *port) {
+  host = stola_as_string(host);
+  if (!host || host->type != STOLA_STRING || !port)
+    return stola_new_int(-1);
+
+  ensure_wsa();
+
+  struct sockaddr_in addr;
+  if (dns_lookup(host->as.str_val, (int)port->as.int_val, &addr) != 0)
+    return stola_new_int(-1);
+
+  SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock == INVALID_SOCKET)
+    return stola_new_int(-1);
+
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == SOCKET_ERROR) {
+    closesocket(sock);
+    return stola_new_int(-1);
+  }
+
+  return stola_new_int((int64_t)sock);
+}
+
+StolaValue *stola_socket_send(StolaValue *fd, StolaValue *data) {
+  const char *buf;
+  size_t n;
+  if (!fd || !stola_str_span(data, &buf, &n))
+    return stola_new_int(-1);
+
+  SOCKET sock = (SOCKET)fd->as.int_val;
+  int len = (int)n;
+  int sent = send(sock, buf, len, 0);
+  return stola_new_int(sent);
+}
+
+StolaValue *stola_socket_receive(StolaValue *fd) {
+  if (!fd)
+    return stola_new_string("");
+
+  SOCKET sock = (SOCKET)fd->as.int_val;
+
+  size_t cap;
+  char *buf;
+  size_t total = sockbuf_drain(fd->as.int_val, &buf, &cap);
+
+  while (1) {
+    if (total + 4096 > cap) {
+      cap *= 2;
+      buf = (char *)realloc(buf, cap);
+    }
+    int received = recv(sock, buf + total, 4096, 0);
+    if (received <= 0)
+      break;
+    total += received;
+  }
+
+  buf[total] = '\0';
+  return stola_new_string_owned(buf);
+}
+
+void stola_socket_close(StolaValue *fd) {
+  if (!fd)
+    return;
+  sockbuf_drop(fd->as.int_val);
+  closesocket((SOCKET)fd->as.int_val);
+}
+
+static long sock_recv_some(int64_t fd, char *buf, size_t n, int nonblock) {
+  (void)nonblock;
+  int r = recv((SOCKET)fd, buf, (int)(n > 0x7FFFFFFF ? 0x7FFFFFFF : n), 0);
+  if (r >= 0)
+    return r;
+  return WSAGetLastError() == WSAEWOULDBLOCK ? -2 : -1;
+}
+
+StolaValue *stola_socket_set_nonblocking(StolaValue *fd, StolaValue *on) {
+  if (!fd || fd->type != STOLA_INT)
+    return stola_new_bool(0);
+  u_long mode = (on && stola_is_truthy(on)) ? 1 : 0;
+  if (ioctlsocket((SOCKET)fd->as.int_val, FIONBIO, &mode) != 0)
+    return stola_new_bool(0);
+  sockbuf_get(fd->as.int_val, 1)->nonblock = (int)mode;
+  return stola_new_bool(1);
+}
+
+// ============================================================
+// Native HTTP client using WinHTTP (supports HTTPS!)
+// ============================================================
+// One session serves the whole process; WinHTTP keeps idle connections per
+// host inside it, so repeated requests skip the TCP/TLS handshake.
+// http_set_timeout applies to that session.  WinHTTP does not pipeline:
+// http_pipeline sends its requests one after another on the pooled
+// connections.
+
+#include <winhttp.h>
+#pragma comment(lib, "winhttp.lib")
+
+static HINTERNET http_session = NULL;
+static INIT_ONCE http_session_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK http_session_init(PINIT_ONCE o, PVOID p, PVOID *c) {
+  (void)o; (void)p; (void)c;
+  http_session =
+      WinHttpOpen(L"StolasScript/1.0", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+                  WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+  return TRUE;
+}
+
+static wchar_t *http_widen(const char *s) {
+  int wlen = MultiByteToWideChar(65001, 0, s, -1, NULL, 0);
+  wchar_t *w = (wchar_t *)malloc(wlen * sizeof(wchar_t));
+  MultiByteToWideChar(65001, 0, s, -1, w, wlen);
+  return w;
+}
+
+// One request; NULL with *err set on failure.
+static StolaValue *http_do(const char *method, const char *url_str,
+                           StolaValue *body, StolaValue *headers,
+                           const char **err) {
+  InitOnceExecuteOnce(&http_session_once, http_session_init, NULL, NULL);
+  if (!http_session) {
+    *err = "winhttp module: WinHttpOpen failed";
+    return NULL;
+  }
+
+  wchar_t *wurl = http_widen(url_str);
+
+  // Crack the URL
+  URL_COMPONENTS uc;
+  memset(&uc, 0, sizeof(uc));
+  uc.dwStructSize = sizeof(uc);
+
+  wchar_t host[256] = {0};
+  wchar_t path[2048] = {0};
+  uc.lpszHostName = host;
+  uc.dwHostNameLength = 256;
+  uc.lpszUrlPath = path;
+  uc.dwUrlPathLength = 2048;
+
+  if (!WinHttpCrackUrl(wurl, 0, 0, &uc)) {
+    free(wurl);
+    *err = "Invalid URL format for http_fetch";
+    return NULL;
+  }
+  free(wurl);
+
+  HINTERNET hConnect = WinHttpConnect(http_session, host, uc.nPort, 0);
+  if (!hConnect) {
+    *err = "HTTP Connection Failed: Host not found";
+    return NULL;
+  }
+
+  DWORD flags = (uc.nScheme == INTERNET_SCHEME_HTTPS) ? WINHTTP_FLAG_SECURE : 0;
+  wchar_t *wmethod = http_widen(method);
+  HINTERNET hRequest =
+      WinHttpOpenRequest(hConnect, wmethod, path, NULL, WINHTTP_NO_REFERER,
+                         WINHTTP_DEFAULT_ACCEPT_TYPES, flags);
+  free(wmethod);
+  if (!hRequest) {
+    WinHttpCloseHandle(hConnect);
+    *err = "Failed to initialize HTTP Request";
+    return NULL;
+  }
+
+  char *extra = http_header_lines(headers);
+  wchar_t *wextra = extra[0] ? http_widen(extra) : NULL;
+  free(extra);
+  const char *b = NULL;
+  if (body && body->type == STOLA_STRING)
+    b = body->as.str_val;
+  else if (body && body->type != STOLA_NULL)
+    b = stola_to_string(body)->as.str_val;
+  DWORD blen = b ? (DWORD)strlen(b) : 0;
+
+  BOOL sent = WinHttpSendRequest(
+      hRequest, wextra ? wextra : WINHTTP_NO_ADDITIONAL_HEADERS,
+      wextra ? (DWORD)-1L : 0, b ? (LPVOID)b : WINHTTP_NO_REQUEST_DATA, blen,
+      blen, 0);
+  free(wextra);
+  if (!sent) {
+    WinHttpCloseHandle(hRequest);
+    WinHttpCloseHandle(hConnect);
+    *err = "Failed to dispatch HTTP Request";
+    return NULL;
+  }
+
+  if (!WinHttpReceiveResponse(hRequest, NULL)) {
+    WinHttpCloseHandle(hRequest);
+    WinHttpCloseHandle(hConnect);
+    *err = "Network Error: WinHttpReceiveResponse Timeout";
+    return NULL;
+  }
+
+  // Read status code
+  DWORD status = 0;
+  DWORD status_size = sizeof(status);
+  WinHttpQueryHeaders(hRequest,
+                      WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+                      WINHTTP_HEADER_NAME_BY_INDEX, &status, &status_size,
+                      WINHTTP_NO_HEADER_INDEX);
+
+  // Response headers, one "Key: value" per CRLF line
+  StolaValue *resp_headers = stola_new_dict();
+  DWORD hsize = 0;
+  WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                      WINHTTP_HEADER_NAME_BY_INDEX, NULL, &hsize,
+                      WINHTTP_NO_HEADER_INDEX);
+  if (hsize > 0) {
+    wchar_t *wh = (wchar_t *)malloc(hsize + sizeof(wchar_t));
+    if (WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_RAW_HEADERS_CRLF,
+                            WINHTTP_HEADER_NAME_BY_INDEX, wh, &hsize,
+                            WINHTTP_NO_HEADER_INDEX)) {
+      int nlen = WideCharToMultiByte(65001, 0, wh, -1, NULL, 0, NULL, NULL);
+      char *raw = (char *)malloc(nlen);
+      WideCharToMultiByte(65001, 0, wh, -1, raw, nlen, NULL, NULL);
+      char *line = strstr(raw, "\r\n"); // skip the status line
+      while (line && line[2]) {
+        line += 2;
+        char *end = strstr(line, "\r\n");
+        size_t n = end ? (size_t)(end - line) : strlen(line);
+        if (n)
+          http_add_header(resp_headers, line, n);
+        line = end;
+      }
+      free(raw);
+    }
+    free(wh);
+  }
+
+  // Read body
+  size_t total = 0;
+  size_t cap = 8192;
+  char *rbody = (char *)malloc(cap);
+
+  DWORD bytes_available = 0;
+  while (WinHttpQueryDataAvailable(hRequest, &bytes_available) &&
+         bytes_available > 0) {
+    if (total + bytes_available + 1 > cap) {
+      cap = (total + bytes_available + 1) * 2;
+      rbody = (char *)realloc(rbody, cap);
+    }
+    DWORD bytes_read = 0;
+    WinHttpReadData(hRequest, rbody + total, bytes_available, &bytes_read);
+    total += bytes_read;
+  }
+  rbody[total] = '\0';
+
+  /* closing the request hands the connection back to the session pool */
+  WinHttpCloseHandle(hRequest);
+  WinHttpCloseHandle(hConnect);
+
+  *err = NULL;
+  return http_result((int)status, rbody, resp_headers);
+}
+
+StolaValue *stola_http_request(StolaValue *method, StolaValue *url,
+                               StolaValue *body, StolaValue *headers) {
+  method = stola_as_string(method);
+  url = stola_as_string(url);
+  if (!method || method->type != STOLA_STRING || !url ||
+      url->type != STOLA_STRING)
+    return stola_new_null();
+  const char *err;
+  StolaValue *resp =
+      http_do(method->as.str_val, url->as.str_val, body, headers, &err);
+  if (!resp) {
+    stola_throw(stola_new_string(err));
+    return stola_new_null();
+  }
+  return resp;
+}
+
+StolaValue *stola_http_fetch(StolaValue *url_val) {
+  url_val = stola_as_string(url_val);
+  if (!url_val || url_val->type != STOLA_STRING)
+    return stola_new_null();
+  return stola_http_request(stola_new_string("GET"), url_val, NULL, NULL);
+}
+
+StolaValue *stola_http_pipeline(StolaValue *requests) {
+  StolaValue *out = stola_new_array();
+  if (!requests || requests->type != STOLA_ARRAY)
+    return out;
+  StolaValue *k_method = stola_new_string("method");
+  StolaValue *k_url = stola_new_string("url");
+  StolaValue *k_body = stola_new_string("body");
+  StolaValue *k_headers = stola_new_string("headers");
+  for (int i = 0; i < requests->as.array_val.count; i++) {
+    StolaValue *r = requests->as.array_val.items[i];
+    StolaValue *m = stola_dict_get(r, k_method), *u = stola_dict_get(r, k_url);
+    const char *err;
+    StolaValue *resp = NULL;
+    if (u && u->type == STOLA_STRING)
+      resp = http_do((m && m->type == STOLA_STRING) ? m->as.str_val : "GET",
+                     u->as.str_val, stola_dict_get(r, k_body),
+                     stola_dict_get(r, k_headers), &err);
+    stola_push(out, resp ? resp : stola_new_null());
+  }
+  return out;
+}
+
+StolaValue *stola_http_set_timeout(StolaValue *ms) {
+  InitOnceExecuteOnce(&http_session_once, http_session_init, NULL, NULL);
+  int t = (ms && ms->type == STOLA_INT && ms->as.int_val > 0)
+              ? (int)ms->as.int_val
+              : 0; // 0 = infinite in WinHTTP
+  if (http_session)
+    WinHttpSetTimeouts(http_session, t, t, t, t);
+  return stola_new_null();
+}
+
+// ============================================================
+// Real Parallelism (Windows Threads & Mutexes)
+// ============================================================
+
+typedef StolaValue *(*ThreadFunc)(StolaValue *, StolaValue *, StolaValue *,
+                                  StolaValue *);
+
+typedef struct {
+  ThreadFunc func;
+  StolaValue *arg;
+  StolaValue *result;   /* filled by worker, read by join */
+} ThreadData;
+
+static DWORD WINAPI stola_thread_start_routine(LPVOID lpParam) {
+  ThreadData *data = (ThreadData *)lpParam;
+  StolaValue *null_val = stola_new_null();
+  StolaValue *r = data->func(data->arg, null_val, null_val, null_val);
+  data->result = r;
+  /* do NOT free(data) here — thread_join reads result then frees */
+  return 0;
+}
+
+/* Windows: wrap HANDLE + ThreadData pointer inside a small struct */
+typedef struct { HANDLE hThread; ThreadData *data; } ThreadHandle;
+
+StolaValue *stola_thread_spawn(void *func_ptr, StolaValue *arg) {
+  ThreadData *data = (ThreadData *)malloc(sizeof(ThreadData));
+  data->func   = (ThreadFunc)func_ptr;
+  data->arg    = arg;
+  data->result = NULL;
+  ThreadHandle *th = (ThreadHandle *)malloc(sizeof(ThreadHandle));
+  th->data    = data;
+  th->hThread = CreateThread(NULL, 0, stola_thread_start_routine, data, 0, NULL);
+  return stola_new_int((int64_t)(uintptr_t)th);
+}
+
+StolaValue *stola_thread_join(StolaValue *hThread_val) {
+  if (!hThread_val || hThread_val->type != STOLA_INT)
+    return stola_new_null();
+  ThreadHandle *th = (ThreadHandle *)(uintptr_t)hThread_val->as.int_val;
+  WaitForSingleObject(th->hThread, INFINITE);
+  CloseHandle(th->hThread);
+  StolaValue *ret = th->data->result ? th->data->result : stola_new_null();
+  free(th->data);
+  free(th);
+  return ret;
+}
+
+StolaValue *stola_mutex_create(void) {
+  HANDLE hMutex = CreateMutex(NULL, FALSE, NULL);
+  return stola_new_int((int64_t)hMutex);
+}
+
+StolaValue *stola_mutex_lock(StolaValue *hMutex_val) {
   if (!hMutex_val || hMutex_val->type != STOLA_INT)
     return stola_new_null();
   HANDLE hMutex = (HANDLE)hMutex_val->as.int_val;
@@ -357,53 +1649,186 @@ StolaValue *stola_mutex_unlock(StolaValue *hMutex_val) {
   return stola_new_null();
 }
 
+// ============================================================
+// Coroutines (green threads) - Windows Fibers
+// Same scheduler as the POSIX build, with SwitchToFiber as the
+// context switch.  There is no reactor here: a socket read inside a
+// coroutine blocks its thread; sleep() still parks on the timer list.
+// ============================================================
+
+#define CORO_STACK_SIZE (256 * 1024)
+enum { CORO_READY, CORO_RUNNING, CORO_WAITING, CORO_DONE };
+
+typedef struct StolaCoro {
+  LPVOID fiber;
+  ThreadFunc func;
+  StolaValue *arg, *result;
+  int state;
+  struct TryCatchNode *try_stack; /* each coroutine keeps its own try chain */
+  struct StolaCoro *next;         /* run queue / sleep list link */
+  struct StolaCoro *waiter;       /* coroutine blocked in await() on us */
+  ULONGLONG wake_at;              /* GetTickCount64 ms, for sleep() */
+  int detached;                   /* no handle: freed as soon as it finishes */
+} StolaCoro;
+
+typedef struct {
+  LPVOID fiber;                   /* the thread's own fiber */
+  StolaCoro *current;
+  StolaCoro *head, *tail;
+  StolaCoro *sleepers;
+} CoroSched;
+
+static __declspec(thread) CoroSched coro_sched;
+extern __declspec(thread) struct TryCatchNode *stola_try_stack;
+
+static void coro_enqueue(StolaCoro *c) {
+  c->state = CORO_READY; c->next = NULL;
+  if (coro_sched.tail) coro_sched.tail->next = c; else coro_sched.head = c;
+  coro_sched.tail = c;
+}
+
+static VOID CALLBACK coro_fiber_main(LPVOID p) {
+  StolaCoro *c = (StolaCoro *)p;
+  StolaValue *nv = stola_new_null();
+  stola_try_stack = NULL;
+  c->result = c->func(c->arg, nv, nv, nv);
+  c->state = CORO_DONE;
+  SwitchToFiber(coro_sched.fiber); /* never resumed */
+}
+
+static void coro_suspend(void) {
+  StolaCoro *c = coro_sched.current;
+  c->try_stack = stola_try_stack;
+  SwitchToFiber(coro_sched.fiber);
+  stola_try_stack = c->try_stack;
+}
+
+static void coro_resume(StolaCoro *c) {
+  struct TryCatchNode *saved = stola_try_stack;
+  coro_sched.current = c; c->state = CORO_RUNNING;
+  SwitchToFiber(c->fiber);
+  coro_sched.current = NULL;
+  stola_try_stack = saved;
+  if (c->state == CORO_DONE) {
+    DeleteFiber(c->fiber); c->fiber = NULL;
+    if (c->waiter) coro_enqueue(c->waiter);
+    else if (c->detached) free(c);
+  }
+}
+
+static int coro_run_once(int block) {
+  if (!coro_sched.head) {
+    if (!coro_sched.sleepers) return 0;
+    ULONGLONG now = GetTickCount64();
+    if (block && coro_sched.sleepers->wake_at > now)
+      Sleep((DWORD)(coro_sched.sleepers->wake_at - now));
+    now = GetTickCount64();
+    while (coro_sched.sleepers && coro_sched.sleepers->wake_at <= now) {
+      StolaCoro *c = coro_sched.sleepers; coro_sched.sleepers = c->next;
+      coro_enqueue(c);
+    }
+  }
+  StolaCoro *last = coro_sched.tail;
+  while (coro_sched.head) {
+    StolaCoro *c = coro_sched.head;
+    coro_sched.head = c->next;
+    if (!coro_sched.head) coro_sched.tail = NULL;
+    coro_resume(c);
+    if (c == last) break;
+  }
+  return 1;
+}
+
+static StolaCoro *coro_create(void *func_ptr, StolaValue *arg) {
+  if (!coro_sched.fiber) {
+    coro_sched.fiber = ConvertThreadToFiber(NULL);
+    if (!coro_sched.fiber) coro_sched.fiber = GetCurrentFiber();
+  }
+  StolaCoro *c = (StolaCoro *)calloc(1, sizeof(StolaCoro));
+  c->func = (ThreadFunc)func_ptr; c->arg = arg;
+  c->fiber = CreateFiber(CORO_STACK_SIZE, coro_fiber_main, c);
+  if (!c->fiber) { free(c); stola_throw(stola_new_string("spawn: cannot create fiber")); return NULL; }
+  coro_enqueue(c);
+  return c;
+}
+
+StolaValue *stola_coro_spawn(void *func_ptr, StolaValue *arg) {
+  StolaCoro *c = coro_create(func_ptr, arg);
+  return c ? stola_new_int((int64_t)(uintptr_t)c) : stola_new_null();
+}
+
+// spawn() whose handle is discarded: nobody can await it, so the record is
+// freed by the scheduler as soon as the coroutine finishes.
+StolaValue *stola_coro_go(void *func_ptr, StolaValue *arg) {
+  StolaCoro *c = coro_create(func_ptr, arg);
+  if (c) c->detached = 1;
+  return stola_new_null();
+}
+
+StolaValue *stola_coro_yield(void) {
+  if (coro_sched.current) { coro_enqueue(coro_sched.current); coro_suspend(); }
+  else coro_run_once(0);
+  return stola_new_null();
+}
+
+StolaValue *stola_coro_await(StolaValue *h) {
+  if (!h || h->type != STOLA_INT || !h->as.int_val) return stola_new_null();
+  StolaCoro *c = (StolaCoro *)(uintptr_t)h->as.int_val;
+  if (c->state != CORO_DONE) {
+    if (coro_sched.current) {
+      if (c->waiter || c == coro_sched.current) return stola_new_null();
+      c->waiter = coro_sched.current; coro_sched.current->state = CORO_WAITING;
+      coro_suspend();
+    } else {
+      while (c->state != CORO_DONE && coro_run_once(1)) {}
+      if (c->state != CORO_DONE) return stola_new_null(); /* deadlocked */
+    }
+  }
+  StolaValue *r = c->result ? c->result : stola_new_null();
+  free(c);
+  return r;
+}
+
+int stola_coro_sleep(int64_t ms) {
+  StolaCoro *c = coro_sched.current;
+  if (!c) return 0;
+  c->wake_at = GetTickCount64() + (ULONGLONG)ms; c->state = CORO_WAITING;
+  StolaCoro **pp = &coro_sched.sleepers;
+  while (*pp && (*pp)->wake_at <= c->wake_at) pp = &(*pp)->next;
+  c->next = *pp; *pp = c;
+  coro_suspend();
+  return 1;
+}
+
+// ---- I/O engine ----
+// Windows has no io_uring; sockets and files stay on blocking Winsock/stdio.
+int stola_io_read_file(const char *path, char **out) { (void)path; (void)out; return -1; }
+int stola_io_write_file(const char *path, const char *data, size_t len, int append) {
+  (void)path; (void)data; (void)len; (void)append;
+  return -1;
+}
+StolaValue *stola_io_engine(void) { return stola_new_string("winsock"); }
+
 // ============================================================
 // WebSocket Support (RFC 6455) - Windows
 // ============================================================
 
-// Send text frame client→server (with mask)
-static int ws_send_frame(SOCKET sock, const char *payload, size_t plen) {
-  unsigned char mask[4];
-  srand((unsigned int)GetTickCount());
-  for (int i=0;i<4;i++) mask[i]=rand()&0xFF;
-  unsigned char hdr[14]; int hlen=0;
-  hdr[hlen++]=0x81;
-  if (plen<=125) hdr[hlen++]=0x80|(unsigned char)plen;
-  else if (plen<=65535) {hdr[hlen++]=0x80|126;hdr[hlen++]=(plen>>8)&0xFF;hdr[hlen++]=plen&0xFF;}
-  else {hdr[hlen++]=0x80|127;for(int i=7;i>=0;i--)hdr[hlen++]=(plen>>(i*8))&0xFF;}
-  memcpy(hdr+hlen,mask,4); hlen+=4;
-  unsigned char *frame=(unsigned char*)malloc(hlen+plen);
-  memcpy(frame,hdr,hlen);
-  for (size_t i=0;i<plen;i++) frame[hlen+i]=((unsigned char)payload[i])^mask[i%4];
-  int sent=send(sock,(const char*)frame,(int)(hlen+plen),0);
-  free(frame); return sent;
-}
-
-// Receive one frame server→client
-static char *ws_recv_frame(SOCKET sock) {
-  unsigned char hdr[2];
-  if (recv(sock,(char*)hdr,2,MSG_WAITALL)!=2) return NULL;
-  int opcode=hdr[0]&0x0F;
-  int masked=(hdr[1]>>7)&1;
-  uint64_t plen=hdr[1]&0x7F;
-  if (plen==126) {unsigned char e[2];if(recv(sock,(char*)e,2,MSG_WAITALL)!=2)return NULL;plen=((uint64_t)e[0]<<8)|e[1];}
-  else if(plen==127){unsigned char e[8];if(recv(sock,(char*)e,8,MSG_WAITALL)!=8)return NULL;plen=0;for(int i=0;i<8;i++)plen=(plen<<8)|e[i];}
-  unsigned char mask[4]={0};
-  if (masked && recv(sock,(char*)mask,4,MSG_WAITALL)!=4) return NULL;
-  if (opcode==0x8) return NULL; // close
-  char *payload=(char*)malloc(plen+1);
-  size_t got=0;
-  while (got<plen) {int r=recv(sock,payload+got,(int)(plen-got),0);if(r<=0){free(payload);return NULL;}got+=r;}
-  payload[plen]='\0';
-  if (masked) for(size_t i=0;i<plen;i++) payload[i]^=mask[i%4];
-  if (opcode==0x9) { // ping → pong
-    unsigned char pong[2]={0x8A,0x00}; send(sock,(const char*)pong,2,0);
-    free(payload); return ws_recv_frame(sock);
-  }
-  return payload;
+static int sock_sendv(int64_t fd, const void *a, size_t alen, const void *b, size_t blen) {
+  WSABUF bufs[2];
+  bufs[0].buf = (char *)a; bufs[0].len = (ULONG)alen;
+  bufs[1].buf = (char *)b; bufs[1].len = (ULONG)blen;
+  DWORD sent = 0;
+  /* blocking WSASend completes the whole gather list or fails */
+  return WSASend((SOCKET)fd, bufs, 2, &sent, 0, NULL, NULL) == 0 ? 0 : -1;
+}
+
+static void sock_broadcast(WsBcast *items, int n) {
+  for (int i = 0; i < n; i++)
+    items[i].failed = sock_sendv(items[i].fd, items[i].hdr, items[i].hlen, items[i].payload, items[i].plen) < 0;
 }
 
 StolaValue *stola_ws_connect(StolaValue *url_val) {
+  url_val=stola_as_string(url_val);
   if (!url_val||url_val->type!=STOLA_STRING) return stola_new_int(-1);
   ensure_wsa();
   const char *url=url_val->as.str_val;
@@ -418,14 +1843,11 @@ StolaValue *stola_ws_connect(StolaValue *url_val) {
   } else if (slash) strncpy(host,p,(slash-p)<255?(slash-p):255);
   else strncpy(host,p,255);
   if (slash) strncpy(path,slash,1023);
-  char port_str[16]; snprintf(port_str,sizeof(port_str),"%d",port);
-  struct addrinfo hints,*res=NULL; memset(&hints,0,sizeof(hints));
-  hints.ai_family=AF_INET; hints.ai_socktype=SOCK_STREAM;
-  if (getaddrinfo(host,port_str,&hints,&res)!=0) return stola_new_int(-1);
-  SOCKET sock=socket(res->ai_family,res->ai_socktype,res->ai_protocol);
-  if (sock==INVALID_SOCKET){freeaddrinfo(res);return stola_new_int(-1);}
-  if (connect(sock,res->ai_addr,(int)res->ai_addrlen)==SOCKET_ERROR){closesocket(sock);freeaddrinfo(res);return stola_new_int(-1);}
-  freeaddrinfo(res);
+  struct sockaddr_in addr;
+  if (dns_lookup(host,port,&addr)!=0) return stola_new_int(-1);
+  SOCKET sock=socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+  if (sock==INVALID_SOCKET) return stola_new_int(-1);
+  if (connect(sock,(struct sockaddr*)&addr,sizeof(addr))==SOCKET_ERROR){closesocket(sock);return stola_new_int(-1);}
   unsigned char key_bytes[16]; srand((unsigned int)GetTickCount());
   for (int i=0;i<16;i++) key_bytes[i]=rand()&0xFF;
   char *key=ws_base64_encode(key_bytes,16);
@@ -433,163 +1855,1052 @@ StolaValue *stola_ws_connect(StolaValue *url_val) {
   snprintf(req,sizeof(req),
     "GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\n"
     "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\n"
-    "Sec-WebSocket-Version: 13\r\n\r\n",path,host,port,key);
+    "Sec-WebSocket-Version: 13\r\n" WS_CLIENT_EXT "\r\n",path,host,port,key);
   free(key);
   send(sock,req,(int)strlen(req),0);
-  char resp[2048]={0}; recv(sock,resp,sizeof(resp)-1,0);
-  if (!strstr(resp,"101")){closesocket(sock);return stola_new_int(-1);}
+  if (!ws_client_handshake((int64_t)sock)){sockbuf_drop((int64_t)sock);closesocket(sock);return stola_new_int(-1);}
   return stola_new_int((int64_t)sock);
 }
 
-StolaValue *stola_ws_send(StolaValue *handle, StolaValue *msg) {
-  if (!handle||handle->type!=STOLA_INT) return stola_new_int(-1);
-  if (!msg||msg->type!=STOLA_STRING) return stola_new_int(-1);
-  SOCKET sock=(SOCKET)handle->as.int_val;
-  const char *payload=msg->as.str_val;
-  return stola_new_int(ws_send_frame(sock,payload,strlen(payload)));
+StolaValue *stola_ws_send(StolaValue *handle, StolaValue *msg) {
+  if (!handle||handle->type!=STOLA_INT) return stola_new_int(-1);
+  const char *p; size_t n;
+  if (!stola_str_span(msg,&p,&n)) return stola_new_int(-1);
+  return stola_new_int(ws_send_message(handle->as.int_val,0x1,p,n));
+}
+
+StolaValue *stola_ws_receive(StolaValue *handle) {
+  if (!handle||handle->type!=STOLA_INT) return stola_new_null();
+  char *payload=ws_recv_frame(handle->as.int_val);
+  if (!payload) return stola_new_null();
+  return stola_new_string_owned(payload);
+}
+
+StolaValue *stola_ws_close(StolaValue *handle) {
+  if (!handle||handle->type!=STOLA_INT) return stola_new_null();
+  ws_send_close(handle->as.int_val,1000);
+  sockbuf_drop(handle->as.int_val);
+  closesocket((SOCKET)handle->as.int_val);
+  return stola_new_null();
+}
+
+StolaValue *stola_ws_server_create(StolaValue *port_val) {
+  if (!port_val||port_val->type!=STOLA_INT) return stola_new_int(-1);
+  ensure_wsa();
+  SOCKET server=socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+  if (server==INVALID_SOCKET) return stola_new_int(-1);
+  int opt=1;
+  setsockopt(server,SOL_SOCKET,SO_REUSEADDR,(const char*)&opt,sizeof(opt));
+  struct sockaddr_in addr; memset(&addr,0,sizeof(addr));
+  addr.sin_family=AF_INET; addr.sin_addr.s_addr=INADDR_ANY;
+  addr.sin_port=htons((unsigned short)port_val->as.int_val);
+  if (bind(server,(struct sockaddr*)&addr,sizeof(addr))==SOCKET_ERROR){closesocket(server);return stola_new_int(-1);}
+  if (listen(server,SOMAXCONN)==SOCKET_ERROR){closesocket(server);return stola_new_int(-1);}
+  return stola_new_int((int64_t)server);
+}
+
+StolaValue *stola_ws_server_accept(StolaValue *server_val) {
+  if (!server_val||server_val->type!=STOLA_INT) return stola_new_int(-1);
+  SOCKET client=accept((SOCKET)server_val->as.int_val,NULL,NULL);
+  if (client==INVALID_SOCKET) return stola_new_int(-1);
+  /* read until the blank line ends the request headers */
+  char buf[4096]={0}; size_t got=0;
+  while (got<sizeof(buf)-1 && !strstr(buf,"\r\n\r\n")) {
+    int r=recv(client,buf+got,(int)(sizeof(buf)-1-got),0);
+    if (r<=0) break;
+    got+=(size_t)r; buf[got]='\0';
+  }
+  char response[512]; int deflate;
+  int rlen=ws_handshake_reply(buf,response,sizeof(response),&deflate);
+  if (rlen<0){closesocket(client);return stola_new_int(-1);}
+  send(client,response,rlen,0);
+  ws_set_server((int64_t)client,deflate);
+  return stola_new_int((int64_t)client);
+}
+
+StolaValue *stola_ws_server_close(StolaValue *server_val) {
+  if (!server_val||server_val->type!=STOLA_INT) return stola_new_null();
+  closesocket((SOCKET)server_val->as.int_val);
+  return stola_new_null();
+}
+
+// ── Multi-core server ────────────────────────────────────────────────────────
+// ws_server_run(port, handler, workers): same contract as the POSIX version.
+// Windows has no SO_REUSEPORT; the calling thread accepts and every
+// connection gets its own thread running the handshake and frame loop, so a
+// slow client still only blocks itself.  `workers` is ignored.
+typedef StolaValue *(*WsRunHandler)(StolaValue *, StolaValue *, StolaValue *, StolaValue *);
+typedef struct { SOCKET sock; WsRunHandler handler; } WsRunConn;
+typedef struct WsRunServer { int port; SOCKET listener; volatile LONG stop; struct WsRunServer *next; } WsRunServer;
+
+static WsRunServer *ws_run_servers = NULL;
+static CRITICAL_SECTION ws_run_lock;
+static INIT_ONCE ws_run_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK ws_run_lock_init(PINIT_ONCE o, PVOID p, PVOID *c) {
+  (void)o; (void)p; (void)c;
+  InitializeCriticalSection(&ws_run_lock);
+  return TRUE;
+}
+
+static DWORD WINAPI ws_run_conn_thread(LPVOID p) {
+  WsRunConn *c = (WsRunConn *)p;
+  StolaValue *h = stola_new_int((int64_t)c->sock), *nv = stola_new_null();
+  c->handler(h, nv, stola_new_string("open"), nv);
+  char *msg; size_t len; int binary;
+  while ((msg = ws_recv_message((int64_t)c->sock, &len, &binary)) != NULL)
+    c->handler(h, stola_new_string_owned(msg), stola_new_string(binary ? "binary" : "message"), nv);
+  c->handler(h, nv, stola_new_string("close"), nv);
+  sockbuf_drop((int64_t)c->sock);
+  closesocket(c->sock);
+  free(c);
+  return 0;
+}
+
+StolaValue *stola_ws_server_run(StolaValue *port_val, void *handler, StolaValue *workers_val) {
+  (void)workers_val;
+  if (!port_val||port_val->type!=STOLA_INT||!handler) return stola_new_bool(0);
+  StolaValue *lv = stola_ws_server_create(port_val);
+  if (lv->as.int_val < 0) return stola_new_bool(0);
+  InitOnceExecuteOnce(&ws_run_once, ws_run_lock_init, NULL, NULL);
+  WsRunServer srv; srv.port = (int)port_val->as.int_val;
+  srv.listener = (SOCKET)lv->as.int_val; srv.stop = 0;
+  EnterCriticalSection(&ws_run_lock);
+  srv.next = ws_run_servers; ws_run_servers = &srv;
+  LeaveCriticalSection(&ws_run_lock);
+  while (!srv.stop) {
+    StolaValue *cv = stola_ws_server_accept(lv);
+    if (cv->as.int_val < 0) continue; /* failed handshake, or stopped */
+    WsRunConn *c = (WsRunConn *)malloc(sizeof(WsRunConn));
+    c->sock = (SOCKET)cv->as.int_val; c->handler = (WsRunHandler)handler;
+    HANDLE t = CreateThread(NULL, 0, ws_run_conn_thread, c, 0, NULL);
+    if (t) CloseHandle(t); else { closesocket(c->sock); free(c); }
+  }
+  EnterCriticalSection(&ws_run_lock);
+  for (WsRunServer **pp = &ws_run_servers; *pp; pp = &(*pp)->next)
+    if (*pp == &srv) { *pp = srv.next; break; }
+  LeaveCriticalSection(&ws_run_lock);
+  return stola_new_bool(1);
+}
+
+StolaValue *stola_ws_server_stop(StolaValue *port_val) {
+  if (!port_val||port_val->type!=STOLA_INT) return stola_new_bool(0);
+  InitOnceExecuteOnce(&ws_run_once, ws_run_lock_init, NULL, NULL);
+  int found = 0;
+  EnterCriticalSection(&ws_run_lock);
+  for (WsRunServer *srv = ws_run_servers; srv; srv = srv->next)
+    if (srv->port == (int)port_val->as.int_val) {
+      InterlockedExchange(&srv->stop, 1);
+      closesocket(srv->listener); /* unblocks accept() */
+      found = 1;
+    }
+  LeaveCriticalSection(&ws_run_lock);
+  return stola_new_bool(found);
+}
+
+// ── HTTP server ──────────────────────────────────────────────────────────────
+// http_server_create(port, handler) / http_server_stop(port): same contract
+// as the POSIX version.  A background thread accepts and each connection
+// gets its own thread; static files are read and sent in 64 KiB chunks.
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+typedef struct HttpSrv { int port; SOCKET listener; HttpdHandler handler; HANDLE thread; struct HttpSrv *next; } HttpSrv;
+typedef struct { SOCKET sock; HttpdHandler handler; } HttpSrvConn;
+
+static HttpSrv *http_srvs = NULL;
+
+static int httpd_open_file(const char *path, int64_t *size) {
+  int fd = _open(path, _O_RDONLY | _O_BINARY);
+  if (fd < 0) return -1;
+  struct _stati64 st;
+  if (_fstati64(fd, &st) < 0 || !(st.st_mode & _S_IFREG)) { _close(fd); return -1; }
+  *size = (int64_t)st.st_size;
+  return fd;
+}
+
+static int httpd_send_all(SOCKET s, const char *buf, size_t n) {
+  while (n > 0) {
+    int r = send(s, buf, n > 0x40000000 ? 0x40000000 : (int)n, 0);
+    if (r <= 0) return -1;
+    buf += r; n -= (size_t)r;
+  }
+  return 0;
+}
+
+static DWORD WINAPI http_conn_thread(LPVOID p) {
+  HttpSrvConn *c = (HttpSrvConn *)p;
+  size_t cap = 8192, len = 0;
+  char *buf = (char *)malloc(cap);
+  for (;;) {
+    if (len == cap) { cap *= 2; buf = (char *)realloc(buf, cap); }
+    int r = recv(c->sock, buf + len, (int)(cap - len), 0);
+    if (r <= 0) break;
+    len += (size_t)r;
+    size_t off = 0;
+    int rc;
+    for (;;) {
+      size_t used = 0; int ffd = -1, keep = 1; int64_t fsize = 0;
+      rc = httpd_serve(c->handler, buf + off, len - off, &used, &ffd, &fsize, &keep);
+      off += used;
+      if (httpd_out.len) {
+        if (httpd_send_all(c->sock, httpd_out.data, httpd_out.len) < 0) rc = 0;
+        httpd_out.len = 0;
+      }
+      if (ffd >= 0) {
+        char chunk[65536]; int n;
+        while (rc && fsize > 0 && (n = _read(ffd, chunk, sizeof(chunk))) > 0) {
+          if (httpd_send_all(c->sock, chunk, (size_t)n) < 0) rc = 0;
+          fsize -= n;
+        }
+        _close(ffd);
+      }
+      if (!keep) rc = 0;
+      if (rc != 2) break;
+    }
+    if (!rc) break;
+    memmove(buf, buf + off, len - off); len -= off;
+  }
+  free(buf);
+  closesocket(c->sock);
+  free(c);
+  return 0;
+}
+
+static DWORD WINAPI http_accept_thread(LPVOID p) {
+  HttpSrv *srv = (HttpSrv *)p;
+  for (;;) {
+    SOCKET cs = accept(srv->listener, NULL, NULL);
+    if (cs == INVALID_SOCKET) break; /* listener closed by http_server_stop */
+    HttpSrvConn *c = (HttpSrvConn *)malloc(sizeof(HttpSrvConn));
+    c->sock = cs; c->handler = srv->handler;
+    HANDLE t = CreateThread(NULL, 0, http_conn_thread, c, 0, NULL);
+    if (t) CloseHandle(t); else { closesocket(cs); free(c); }
+  }
+  return 0;
+}
+
+StolaValue *stola_http_server_create(StolaValue *port_val, void *handler) {
+  if (!port_val||port_val->type!=STOLA_INT||!handler) return stola_new_int(-1);
+  StolaValue *lv = stola_ws_server_create(port_val);
+  if (lv->as.int_val < 0) return stola_new_int(-1);
+  InitOnceExecuteOnce(&ws_run_once, ws_run_lock_init, NULL, NULL);
+  HttpSrv *srv = (HttpSrv *)calloc(1, sizeof(HttpSrv));
+  srv->port = (int)port_val->as.int_val; srv->listener = (SOCKET)lv->as.int_val;
+  srv->handler = (HttpdHandler)handler;
+  srv->thread = CreateThread(NULL, 0, http_accept_thread, srv, 0, NULL);
+  if (!srv->thread) { closesocket(srv->listener); free(srv); return stola_new_int(-1); }
+  EnterCriticalSection(&ws_run_lock);
+  srv->next = http_srvs; http_srvs = srv;
+  LeaveCriticalSection(&ws_run_lock);
+  return stola_new_int((int64_t)srv->port);
+}
+
+StolaValue *stola_http_server_stop(StolaValue *port_val) {
+  if (!port_val||port_val->type!=STOLA_INT) return stola_new_bool(0);
+  InitOnceExecuteOnce(&ws_run_once, ws_run_lock_init, NULL, NULL);
+  HttpSrv *srv = NULL;
+  EnterCriticalSection(&ws_run_lock);
+  for (HttpSrv **pp = &http_srvs; *pp; pp = &(*pp)->next)
+    if ((*pp)->port == (int)port_val->as.int_val) { srv = *pp; *pp = srv->next; break; }
+  LeaveCriticalSection(&ws_run_lock);
+  if (!srv) return stola_new_bool(0);
+  closesocket(srv->listener); /* unblocks accept() */
+  WaitForSingleObject(srv->thread, INFINITE);
+  CloseHandle(srv->thread);
+  free(srv);
+  return stola_new_bool(1);
+}
+
+// ── I/O Multiplexing ─────────────────────────────────────────────────────────
+// stola_ws_select(handles: array<int>, timeout_ms: int) -> array<int>
+// Returns the subset of socket handles that have data ready to read.
+// timeout_ms < 0 → block; timeout_ms == 0 → non-blocking poll.
+// WSAPoll takes a plain array, so there is no FD_SETSIZE (64) cap.
+StolaValue *stola_ws_select(StolaValue *handles, StolaValue *timeout_ms_val) {
+  StolaValue *result = stola_new_array();
+  if (!handles || handles->type != STOLA_ARRAY) return result;
+  int timeout_ms = (timeout_ms_val && timeout_ms_val->type == STOLA_INT)
+                   ? (int)timeout_ms_val->as.int_val : -1;
+  int count = (int)handles->as.array_val.count, n = 0;
+  WSAPOLLFD *pfds = (WSAPOLLFD *)malloc(sizeof(WSAPOLLFD) * (count ? count : 1));
+  for (int i = 0; i < count; i++) {
+    StolaValue *h = handles->as.array_val.items[i];
+    if (h && h->type == STOLA_INT) {
+      pfds[n].fd = (SOCKET)h->as.int_val; pfds[n].events = POLLRDNORM; pfds[n].revents = 0; n++;
+    }
+  }
+  if (n > 0 && WSAPoll(pfds, (ULONG)n, timeout_ms) > 0) {
+    for (int i = 0; i < n; i++)
+      if (pfds[i].revents & (POLLRDNORM | POLLHUP | POLLERR))
+        stola_push(result, stola_new_int((int64_t)pfds[i].fd));
+  }
+  free(pfds);
+  return result;
+}
+
+// ── Persistent poller ────────────────────────────────────────────────────────
+// poller_create() / poller_add(p, fd, events) / poller_remove(p, fd) /
+// poller_wait(p, timeout_ms) -> array<int> / poller_close(p)
+// events: 1 = readable, 2 = writable, 4 = edge-triggered (ignored here;
+// WSAPoll is level-triggered).  The fd set lives in the poller, so callers
+// no longer rebuild it on every wait.  A socket closed without
+// poller_remove comes back as POLLNVAL and is dropped from the set.
+#define POLLER_READ  1
+#define POLLER_WRITE 2
+#define POLLER_EDGE  4
+
+typedef struct { WSAPOLLFD *fds; int count, cap; } StolaPoller;
+
+StolaValue *stola_poller_create(void) {
+  ensure_wsa();
+  StolaPoller *p = (StolaPoller *)calloc(1, sizeof(StolaPoller));
+  return stola_new_int((int64_t)(uintptr_t)p);
+}
+
+StolaValue *stola_poller_add(StolaValue *pv, StolaValue *fd, StolaValue *events) {
+  if (!pv || pv->type != STOLA_INT || !fd || fd->type != STOLA_INT) return stola_new_bool(0);
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  int ev = (events && events->type == STOLA_INT) ? (int)events->as.int_val : POLLER_READ;
+  SHORT want = (SHORT)(((ev & POLLER_READ) ? POLLRDNORM : 0) | ((ev & POLLER_WRITE) ? POLLWRNORM : 0));
+  for (int i = 0; i < p->count; i++)
+    if (p->fds[i].fd == (SOCKET)fd->as.int_val) { p->fds[i].events = want; return stola_new_bool(1); }
+  if (p->count == p->cap) {
+    p->cap = p->cap ? p->cap * 2 : 64;
+    p->fds = (WSAPOLLFD *)realloc(p->fds, sizeof(WSAPOLLFD) * p->cap);
+  }
+  p->fds[p->count].fd = (SOCKET)fd->as.int_val;
+  p->fds[p->count].events = want;
+  p->fds[p->count].revents = 0;
+  p->count++;
+  return stola_new_bool(1);
+}
+
+StolaValue *stola_poller_remove(StolaValue *pv, StolaValue *fd) {
+  if (!pv || pv->type != STOLA_INT || !fd || fd->type != STOLA_INT) return stola_new_bool(0);
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  for (int i = 0; i < p->count; i++)
+    if (p->fds[i].fd == (SOCKET)fd->as.int_val) { p->fds[i] = p->fds[--p->count]; return stola_new_bool(1); }
+  return stola_new_bool(0);
+}
+
+StolaValue *stola_poller_wait(StolaValue *pv, StolaValue *timeout_ms_val) {
+  StolaValue *result = stola_new_array();
+  if (!pv || pv->type != STOLA_INT) return result;
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  int timeout_ms = (timeout_ms_val && timeout_ms_val->type == STOLA_INT)
+                   ? (int)timeout_ms_val->as.int_val : -1;
+  if (p->count == 0) { if (timeout_ms > 0) Sleep((DWORD)timeout_ms); return result; }
+  if (WSAPoll(p->fds, (ULONG)p->count, timeout_ms) <= 0) return result;
+  for (int i = 0; i < p->count; i++) {
+    if (p->fds[i].revents & POLLNVAL) { p->fds[i--] = p->fds[--p->count]; continue; }
+    if (p->fds[i].revents) stola_push(result, stola_new_int((int64_t)p->fds[i].fd));
+  }
+  return result;
+}
+
+StolaValue *stola_poller_close(StolaValue *pv) {
+  if (!pv || pv->type != STOLA_INT) return stola_new_null();
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  free(p->fds); free(p);
+  return stola_new_null();
+}
+
+#else
+// ============================================================
+// POSIX / Linux implementation
+// ============================================================
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+
+// ---- Coroutines (green threads) ----
+// spawn(fn, arg) runs fn on its own mmap'd stack; yield() hands the CPU to
+// the next ready coroutine; await(h) waits for h and returns fn's result.
+// Each OS thread owns an independent M:1 scheduler.  Socket and WebSocket
+// reads issued from inside a coroutine park it on an epoll reactor instead
+// of blocking the whole thread, and sleep() parks it on a timer list.
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <poll.h>
+#include <errno.h>
+
+#define CORO_STACK_SIZE  (256 * 1024) /* reserved; pages commit on first touch */
+#define CORO_STACK_CACHE 64
+
+typedef StolaValue *(*CoroFunc)(StolaValue *, StolaValue *, StolaValue *, StolaValue *);
+enum { CORO_READY, CORO_RUNNING, CORO_WAITING, CORO_DONE };
+
+typedef struct StolaCoro {
+  int64_t sp;                     /* saved RSP while switched out */
+  char *stack;                    /* mapping base; lowest page is the guard */
+  CoroFunc func;
+  StolaValue *arg, *result;
+  int state;
+  struct TryCatchNode *try_stack; /* each coroutine keeps its own try chain */
+  struct StolaCoro *next;         /* run queue / sleep list link */
+  struct StolaCoro *waiter;       /* coroutine blocked in await() on us */
+  struct StolaCoro *fd_next;      /* other coroutines parked on the same fd */
+  uint32_t events;                /* what we are parked for */
+  int64_t wake_at;                /* CLOCK_MONOTONIC ms, for sleep() */
+  int timed_fd;                   /* fd of a coro_wait_fd_until, else -1 */
+  int detached;                   /* no handle: freed as soon as it finishes */
+} StolaCoro;
+
+typedef struct {
+  int64_t sp;                     /* thread's own stack while a coroutine runs */
+  StolaCoro *current;             /* NULL on the thread's own stack */
+  StolaCoro *head, *tail;         /* FIFO run queue */
+  StolaCoro *sleepers;            /* sorted by wake_at */
+  int epfd, parked;
+  StolaCoro **fd_waiters; int fd_cap; /* parked coroutines, indexed by fd */
+  char *stacks[CORO_STACK_CACHE]; int nstacks;
+} CoroSched;
+
+static __thread CoroSched coro_sched = {0, NULL, NULL, NULL, NULL, -1, 0, NULL, 0, {NULL}, 0};
+extern __thread struct TryCatchNode *stola_try_stack;
+
+void stola_coro_switch(int64_t *save_sp, int64_t next_sp);
+void stola_coro_boot(void);
+
+// Context switch, written like stola_setjmp/stola_longjmp in codegen but
+// stack based: push the callee-saved registers, store RSP through ARG0,
+// load the target RSP from ARG1 and pop its registers in reverse order.
+// A fresh stack is seeded so that the first switch "returns" into
+// stola_coro_boot with the coroutine pointer in r12.
+__asm__(
+  ".text\n"
+  ".intel_syntax noprefix\n"
+  ".global stola_coro_switch\n"
+  "stola_coro_switch:\n"
+  "    push rbp\n"
+  "    push rbx\n"
+  "    push r12\n"
+  "    push r13\n"
+  "    push r14\n"
+  "    push r15\n"
+  "    mov [rdi], rsp\n"
+  "    mov rsp, rsi\n"
+  "    pop r15\n"
+  "    pop r14\n"
+  "    pop r13\n"
+  "    pop r12\n"
+  "    pop rbx\n"
+  "    pop rbp\n"
+  "    ret\n"
+  ".global stola_coro_boot\n"
+  "stola_coro_boot:\n"
+  "    mov rdi, r12\n"
+  "    call stola_coro_entry\n"
+  "    ud2\n"
+  ".att_syntax prefix\n");
+
+static int64_t coro_now_ms(void) {
+  struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void coro_enqueue(StolaCoro *c) {
+  c->state = CORO_READY; c->next = NULL;
+  if (coro_sched.tail) coro_sched.tail->next = c; else coro_sched.head = c;
+  coro_sched.tail = c;
+}
+
+void stola_coro_entry(StolaCoro *c) {
+  StolaValue *nv = stola_new_null();
+  stola_try_stack = NULL;
+  c->result = c->func(c->arg, nv, nv, nv);
+  c->state = CORO_DONE;
+  stola_coro_switch(&c->sp, coro_sched.sp); /* never resumed */
+}
+
+static char *coro_stack_alloc(void) {
+  if (coro_sched.nstacks > 0) return coro_sched.stacks[--coro_sched.nstacks];
+  char *base = (char *)mmap(NULL, CORO_STACK_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+  if (base == MAP_FAILED) return NULL;
+  mprotect(base, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE); /* overflow faults, no heap smash */
+  return base;
+}
+
+static void coro_stack_release(char *base) {
+  if (coro_sched.nstacks < CORO_STACK_CACHE) coro_sched.stacks[coro_sched.nstacks++] = base;
+  else munmap(base, CORO_STACK_SIZE);
+}
+
+// Running coroutine → scheduler.  Returns when something resumes us.
+static void coro_suspend(void) {
+  StolaCoro *c = coro_sched.current;
+  c->try_stack = stola_try_stack;
+  stola_coro_switch(&c->sp, coro_sched.sp);
+  stola_try_stack = c->try_stack;
+}
+
+// Scheduler → coroutine c, until it yields, parks or finishes.
+static void coro_resume(StolaCoro *c) {
+  struct TryCatchNode *saved = stola_try_stack;
+  coro_sched.current = c; c->state = CORO_RUNNING;
+  stola_coro_switch(&coro_sched.sp, c->sp);
+  coro_sched.current = NULL;
+  stola_try_stack = saved;
+  if (c->state == CORO_DONE) {
+    coro_stack_release(c->stack); c->stack = NULL;
+    if (c->waiter) coro_enqueue(c->waiter);
+    else if (c->detached) free(c);
+  }
+}
+
+// ---- I/O engine: io_uring (optional) ----
+// When the kernel supports it, socket send/receive issued from coroutines,
+// WebSocket frames and whole-file reads/writes go through a per-thread
+// io_uring instead of plain syscalls (blocking socket calls outside a
+// coroutine stay plain so SO_RCVTIMEO/SO_SNDTIMEO keep working).
+// Requests issued from coroutines are only queued; the scheduler submits
+// everything queued during a round with a single io_uring_enter()
+// and the ring fd sits in the reactor's epoll set, so completions wake the
+// waiting coroutines like any other fd event.  Receives land in buffers
+// registered with the kernel once (no per-request page pinning).
+// STOLA_IO_ENGINE=epoll disables it; otherwise it is probed on first use
+// and silently replaced by the epoll/blocking path if setup fails.
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#ifdef IORING_FEAT_FAST_POLL /* 5.7+: SEND/RECV/CLOSE opcodes are there too */
+#define STOLA_HAVE_URING 1
+#endif
+#endif
+#endif
+
+#ifdef STOLA_HAVE_URING
+#define URING_ENTRIES  256
+#define URING_BUFS     8
+#define URING_BUF_SIZE (16 * 1024)
+
+typedef struct {
+  int res, done;
+  StolaCoro *waiter;              /* resumed when this request completes */
+} UringOp;
+
+typedef struct {
+  int state;                      /* 0 not probed, 1 ready, -1 unavailable */
+  int fd, watched;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, sq_entries, sq_local_tail;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  unsigned to_submit, inflight;
+  char *bufs; uint32_t buf_free;  /* registered receive buffers, bit = free */
+} StolaUring;
+
+static __thread StolaUring uring = {0, -1, 0, NULL, NULL, NULL, NULL, 0, 0,
+                                    NULL, NULL, NULL, NULL, NULL, 0, 0, NULL, 0};
+
+static int uring_setup(void) {
+  const char *eng = getenv("STOLA_IO_ENGINE");
+  if (eng && *eng && strcmp(eng, "io_uring") != 0) return -1;
+  struct io_uring_params p; memset(&p, 0, sizeof(p));
+  int fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+  if (fd < 0) return -1;
+  size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  size_t ring_len = sq_len > cq_len ? sq_len : cq_len;
+  char *ring = MAP_FAILED;
+  void *sqes = MAP_FAILED;
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    ring = (char *)mmap(NULL, ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  }
+  if (ring == MAP_FAILED || sqes == MAP_FAILED) { close(fd); return -1; }
+  uring.fd = fd;
+  uring.sq_head = (unsigned *)(ring + p.sq_off.head);
+  uring.sq_tail = (unsigned *)(ring + p.sq_off.tail);
+  uring.sq_mask = (unsigned *)(ring + p.sq_off.ring_mask);
+  uring.sq_array = (unsigned *)(ring + p.sq_off.array);
+  uring.sq_entries = p.sq_entries;
+  uring.sq_local_tail = *uring.sq_tail;
+  uring.cq_head = (unsigned *)(ring + p.cq_off.head);
+  uring.cq_tail = (unsigned *)(ring + p.cq_off.tail);
+  uring.cq_mask = (unsigned *)(ring + p.cq_off.ring_mask);
+  uring.cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+  uring.sqes = (struct io_uring_sqe *)sqes;
+  /* Registered buffers are optional: RLIMIT_MEMLOCK may refuse them */
+  char *bufs = (char *)mmap(NULL, URING_BUFS * URING_BUF_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (bufs != MAP_FAILED) {
+    struct iovec iov[URING_BUFS];
+    for (int i = 0; i < URING_BUFS; i++) { iov[i].iov_base = bufs + i * URING_BUF_SIZE; iov[i].iov_len = URING_BUF_SIZE; }
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, URING_BUFS) == 0) {
+      uring.bufs = bufs; uring.buf_free = (1u << URING_BUFS) - 1;
+    } else munmap(bufs, URING_BUFS * URING_BUF_SIZE);
+  }
+  return 0;
+}
+
+static int uring_ready(void) {
+  if (uring.state == 0) uring.state = uring_setup() == 0 ? 1 : -1;
+  return uring.state > 0;
+}
+
+// Hand everything queued so far to the kernel (one syscall per batch).
+static void uring_flush(void) {
+  if (!uring.to_submit) return;
+  __atomic_store_n(uring.sq_tail, uring.sq_local_tail, __ATOMIC_RELEASE);
+  while (syscall(__NR_io_uring_enter, uring.fd, uring.to_submit, 0, 0, NULL, 0) < 0 && errno == EINTR) {}
+  uring.to_submit = 0;
+}
+
+// Move finished requests to their UringOp and wake coroutines waiting on them.
+static void uring_reap(void) {
+  unsigned head = *uring.cq_head;
+  unsigned tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    struct io_uring_cqe *cqe = &uring.cqes[head & *uring.cq_mask];
+    UringOp *op = (UringOp *)(uintptr_t)cqe->user_data;
+    op->res = cqe->res; op->done = 1; uring.inflight--;
+    if (op->waiter) coro_enqueue(op->waiter);
+  }
+  __atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+static struct io_uring_sqe *uring_sqe(UringOp *op) {
+  if (uring.sq_local_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE) >= uring.sq_entries)
+    uring_flush();
+  unsigned idx = uring.sq_local_tail & *uring.sq_mask;
+  struct io_uring_sqe *sqe = &uring.sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = (uint64_t)(uintptr_t)op;
+  uring.sq_array[idx] = idx;
+  uring.sq_local_tail++; uring.to_submit++; uring.inflight++;
+  op->res = 0; op->done = 0; op->waiter = NULL;
+  return sqe;
+}
+
+// Block until `last` (the tail of a request chain) completes.  A coroutine
+// parks and leaves submission to the scheduler's next poll; the thread's own
+// stack submits and waits right away.
+static int uring_wait(UringOp *last) {
+  if (coro_sched.current) {
+    last->waiter = coro_sched.current;
+    while (!last->done) { coro_sched.current->state = CORO_WAITING; coro_suspend(); }
+    return last->res;
+  }
+  while (!last->done) {
+    __atomic_store_n(uring.sq_tail, uring.sq_local_tail, __ATOMIC_RELEASE);
+    long r = syscall(__NR_io_uring_enter, uring.fd, uring.to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (r >= 0) uring.to_submit = 0;
+    else if (errno != EINTR) return -errno;
+    uring_reap();
+  }
+  return last->res;
+}
+
+// Make the scheduler's epoll wake up when the completion queue has entries.
+static void uring_watch(void) {
+  if (uring.watched) return;
+  if (coro_sched.epfd < 0) coro_sched.epfd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev; ev.events = EPOLLIN; ev.data.fd = uring.fd;
+  if (epoll_ctl(coro_sched.epfd, EPOLL_CTL_ADD, uring.fd, &ev) == 0) uring.watched = 1;
+}
+
+static ssize_t uring_recv(int fd, void *buf, size_t n) {
+  UringOp op;
+  struct io_uring_sqe *sqe = uring_sqe(&op);
+  int idx = uring.buf_free ? __builtin_ctz(uring.buf_free) : -1;
+  sqe->fd = fd;
+  if (idx >= 0) {
+    uring.buf_free &= ~(1u << idx);
+    sqe->opcode = IORING_OP_READ_FIXED;
+    sqe->addr = (uint64_t)(uintptr_t)(uring.bufs + idx * URING_BUF_SIZE);
+    sqe->len = (unsigned)(n < URING_BUF_SIZE ? n : URING_BUF_SIZE);
+    sqe->buf_index = (uint16_t)idx;
+  } else {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (unsigned)n;
+  }
+  int r = uring_wait(&op);
+  if (idx >= 0) {
+    if (r > 0) memcpy(buf, uring.bufs + idx * URING_BUF_SIZE, (size_t)r);
+    uring.buf_free |= 1u << idx;
+  }
+  if (r < 0) { errno = -r; return -1; }
+  return r;
+}
+
+static ssize_t uring_send(int fd, const void *buf, size_t n) {
+  UringOp op;
+  struct io_uring_sqe *sqe = uring_sqe(&op);
+  sqe->opcode = IORING_OP_SEND; sqe->fd = fd;
+  sqe->addr = (uint64_t)(uintptr_t)buf; sqe->len = (unsigned)n;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  int r = uring_wait(&op);
+  if (r < 0) { errno = -r; return -1; }
+  return r;
+}
+
+// Queue fd's close behind the request just queued, as one linked chain.
+static void uring_link_close(struct io_uring_sqe *prev, UringOp *op, int fd) {
+  prev->flags |= IOSQE_IO_LINK;
+  struct io_uring_sqe *sqe = uring_sqe(op);
+  sqe->opcode = IORING_OP_CLOSE; sqe->fd = fd;
+}
+#endif
+
+#ifdef STOLA_HAVE_URING
+/* one read/write moves at most ~2 GiB (MAX_RW_COUNT) and sqe->len is 32-bit */
+#define URING_RW_MAX (1u << 30)
+
+// Move len bytes between buf and fd at off ((uint64_t)-1: the file
+// position, for O_APPEND), then close fd.  The CLOSE is linked behind the
+// request that should finish the transfer; a short result breaks the chain
+// and the loop carries on from where it stopped.  Returns the bytes moved,
+// or -1 on error (fd is closed either way).
+static ssize_t uring_rw_close(int opcode, int fd, char *buf, size_t len, uint64_t off) {
+  size_t done = 0;
+  int closed = 0, failed = 0;
+  while (!closed) {
+    size_t n = len - done < URING_RW_MAX ? len - done : URING_RW_MAX;
+    UringOp rw, cl;
+    struct io_uring_sqe *sqe = uring_sqe(&rw);
+    sqe->opcode = (uint8_t)opcode; sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)(buf + done); sqe->len = (unsigned)n;
+    sqe->off = off == (uint64_t)-1 ? off : off + done;
+    if (done + n == len) {
+      uring_link_close(sqe, &cl, fd);
+      uring_wait(&cl);
+      closed = cl.res != -ECANCELED;
+    } else uring_wait(&rw);
+    if (rw.res == -EINTR || rw.res == -EAGAIN) continue;
+    if (rw.res < 0) { failed = 1; break; }
+    if (rw.res == 0) break; /* EOF: the file shrank under us */
+    done += (size_t)rw.res;
+  }
+  if (!closed) close(fd);
+  return failed ? -1 : (ssize_t)done;
+}
+#endif
+
+// Whole-file helpers used by read_file / write_file / append_file in
+// runtime.c.  -1 means "no engine, use stdio"; otherwise 1 ok / 0 failed.
+int stola_io_read_file(const char *path, char **out) {
+#ifdef STOLA_HAVE_URING
+  if (!uring_ready()) return -1;
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { *out = NULL; return 0; }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) { close(fd); return -1; } /* procfs etc. */
+  char *buf = (char *)malloc((size_t)st.st_size + 1);
+  if (!buf) { close(fd); *out = NULL; return 0; }
+  ssize_t got = uring_rw_close(IORING_OP_READ, fd, buf, (size_t)st.st_size, 0);
+  if (got < 0) { free(buf); *out = NULL; return 0; }
+  buf[got] = '\0';
+  *out = buf;
+  return 1;
+#else
+  (void)path; (void)out;
+  return -1;
+#endif
+}
+
+int stola_io_write_file(const char *path, const char *data, size_t len, int append) {
+#ifdef STOLA_HAVE_URING
+  if (!uring_ready()) return -1;
+  int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0666);
+  if (fd < 0) return 0;
+  ssize_t done = uring_rw_close(IORING_OP_WRITE, fd, (char *)data, len, append ? (uint64_t)-1 : 0);
+  return done == (ssize_t)len;
+#else
+  (void)path; (void)data; (void)len; (void)append;
+  return -1;
+#endif
+}
+
+StolaValue *stola_io_engine(void) {
+#ifdef STOLA_HAVE_URING
+  if (uring_ready()) return stola_new_string("io_uring");
+#endif
+  return stola_new_string("epoll");
+}
+
+// Take c off fd's waiter list (the other half of a timed wait fired).
+static void coro_unpark(StolaCoro *c, int fd) {
+  for (StolaCoro **pp = &coro_sched.fd_waiters[fd]; *pp; pp = &(*pp)->fd_next)
+    if (*pp == c) { *pp = c->fd_next; coro_sched.parked--; return; }
+}
+
+// Add c to the timer list, which is kept sorted by wake_at.
+static void coro_sleep_insert(StolaCoro *c) {
+  StolaCoro **pp = &coro_sched.sleepers;
+  while (*pp && (*pp)->wake_at <= c->wake_at) pp = &(*pp)->next;
+  c->next = *pp; *pp = c;
+}
+
+static void coro_unsleep(StolaCoro *c) {
+  for (StolaCoro **pp = &coro_sched.sleepers; *pp; pp = &(*pp)->next)
+    if (*pp == c) { *pp = c->next; return; }
+}
+
+// Wait for parked fds / due sleepers and move them to the run queue.
+static void coro_poll(int block) {
+  int timeout = block ? -1 : 0;
+  if (coro_sched.sleepers) {
+    int64_t d = coro_sched.sleepers->wake_at - coro_now_ms();
+    if (d < 0) d = 0;
+    if (timeout < 0 || d < timeout) timeout = (int)d;
+  }
+#ifdef STOLA_HAVE_URING
+  int uring_busy = uring.state > 0 && uring.inflight > 0;
+  if (uring_busy) { uring_flush(); uring_watch(); }
+#else
+  int uring_busy = 0;
+#endif
+  if (coro_sched.parked > 0 || uring_busy) {
+    struct epoll_event evs[64];
+    int n = epoll_wait(coro_sched.epfd, evs, 64, timeout);
+    for (int i = 0; i < n; i++) {
+#ifdef STOLA_HAVE_URING
+      if (evs[i].data.fd == uring.fd) { uring_reap(); continue; }
+#endif
+      /* wake every waiter; the losers of a race simply park again */
+      StolaCoro *c = coro_sched.fd_waiters[evs[i].data.fd];
+      coro_sched.fd_waiters[evs[i].data.fd] = NULL;
+      while (c) {
+        StolaCoro *nx = c->fd_next;
+        coro_sched.parked--;
+        if (c->timed_fd >= 0) { coro_unsleep(c); c->timed_fd = -1; }
+        coro_enqueue(c); c = nx;
+      }
+    }
+  } else if (timeout > 0) {
+    struct timespec ts = {timeout / 1000, (long)(timeout % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+  }
+  int64_t now = coro_now_ms();
+  while (coro_sched.sleepers && coro_sched.sleepers->wake_at <= now) {
+    StolaCoro *c = coro_sched.sleepers; coro_sched.sleepers = c->next;
+    if (c->timed_fd >= 0) { coro_unpark(c, c->timed_fd); c->timed_fd = -1; }
+    coro_enqueue(c);
+  }
+}
+
+// One scheduling round on the thread's own stack: run every coroutine that
+// is ready now.  Returns 0 when nothing could ever become ready again.
+static int coro_run_once(int block) {
+  if (!coro_sched.head) {
+    int idle = !coro_sched.parked && !coro_sched.sleepers;
+#ifdef STOLA_HAVE_URING
+    idle = idle && !(uring.state > 0 && uring.inflight > 0);
+#endif
+    if (idle) return 0;
+    coro_poll(block);
+  }
+  StolaCoro *last = coro_sched.tail;
+  while (coro_sched.head) {
+    StolaCoro *c = coro_sched.head;
+    coro_sched.head = c->next;
+    if (!coro_sched.head) coro_sched.tail = NULL;
+    coro_resume(c);
+    if (c == last) break;
+  }
+  return 1;
 }
 
-StolaValue *stola_ws_receive(StolaValue *handle) {
-  if (!handle||handle->type!=STOLA_INT) return stola_new_null();
-  char *payload=ws_recv_frame((SOCKET)handle->as.int_val);
-  if (!payload) return stola_new_null();
-  return stola_new_string_owned(payload);
+// Register c as waiting for `events` on fd; 0 if epoll cannot watch fd.
+static int coro_park_fd(StolaCoro *c, int fd, uint32_t events) {
+  if (coro_sched.epfd < 0) coro_sched.epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (fd >= coro_sched.fd_cap) {
+    int cap = coro_sched.fd_cap ? coro_sched.fd_cap : 64;
+    while (cap <= fd) cap *= 2;
+    coro_sched.fd_waiters = (StolaCoro **)realloc(coro_sched.fd_waiters, sizeof(StolaCoro *) * cap);
+    memset(coro_sched.fd_waiters + coro_sched.fd_cap, 0, sizeof(StolaCoro *) * (cap - coro_sched.fd_cap));
+    coro_sched.fd_cap = cap;
+  }
+  c->events = events;
+  for (StolaCoro *w = coro_sched.fd_waiters[fd]; w; w = w->fd_next) events |= w->events;
+  struct epoll_event ev; ev.events = events | EPOLLONESHOT; ev.data.fd = fd;
+  if (epoll_ctl(coro_sched.epfd, EPOLL_CTL_MOD, fd, &ev) < 0 &&
+      (errno != ENOENT || epoll_ctl(coro_sched.epfd, EPOLL_CTL_ADD, fd, &ev) < 0))
+    return 0;
+  c->fd_next = coro_sched.fd_waiters[fd]; coro_sched.fd_waiters[fd] = c;
+  c->state = CORO_WAITING; coro_sched.parked++;
+  return 1;
 }
 
-StolaValue *stola_ws_close(StolaValue *handle) {
-  if (!handle||handle->type!=STOLA_INT) return stola_new_null();
-  unsigned char cf[2]={0x88,0x00};
-  send((SOCKET)handle->as.int_val,(const char*)cf,2,0);
-  closesocket((SOCKET)handle->as.int_val);
-  return stola_new_null();
+// Park the running coroutine until fd reports `events`.  Outside a
+// coroutine (or for fds epoll cannot watch) this is a no-op and the caller
+// simply performs blocking I/O.
+static void coro_wait_fd(int fd, uint32_t events) {
+  StolaCoro *c = coro_sched.current;
+  if (!c || fd < 0) return;
+  if (coro_park_fd(c, fd, events)) coro_suspend();
 }
 
-StolaValue *stola_ws_server_create(StolaValue *port_val) {
-  if (!port_val||port_val->type!=STOLA_INT) return stola_new_int(-1);
-  ensure_wsa();
-  SOCKET server=socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
-  if (server==INVALID_SOCKET) return stola_new_int(-1);
-  int opt=1;
-  setsockopt(server,SOL_SOCKET,SO_REUSEADDR,(const char*)&opt,sizeof(opt));
-  struct sockaddr_in addr; memset(&addr,0,sizeof(addr));
-  addr.sin_family=AF_INET; addr.sin_addr.s_addr=INADDR_ANY;
-  addr.sin_port=htons((unsigned short)port_val->as.int_val);
-  if (bind(server,(struct sockaddr*)&addr,sizeof(addr))==SOCKET_ERROR){closesocket(server);return stola_new_int(-1);}
-  if (listen(server,SOMAXCONN)==SOCKET_ERROR){closesocket(server);return stola_new_int(-1);}
-  return stola_new_int((int64_t)server);
+// coro_wait_fd that also gives up at `deadline` (coro_now_ms() time): the
+// coroutine sits on fd and on the timer list at once, and whichever fires
+// first takes it off the other.  Returns 0 once the deadline has passed.
+static int coro_wait_fd_until(int fd, uint32_t events, int64_t deadline) {
+  StolaCoro *c = coro_sched.current;
+  if (coro_now_ms() >= deadline) return 0;
+  if (!c || fd < 0 || !coro_park_fd(c, fd, events)) return 1;
+  c->timed_fd = fd; c->wake_at = deadline;
+  coro_sleep_insert(c);
+  coro_suspend();
+  return coro_now_ms() < deadline;
 }
 
-StolaValue *stola_ws_server_accept(StolaValue *server_val) {
-  if (!server_val||server_val->type!=STOLA_INT) return stola_new_int(-1);
-  SOCKET client=accept((SOCKET)server_val->as.int_val,NULL,NULL);
-  if (client==INVALID_SOCKET) return stola_new_int(-1);
-  char buf[4096]={0}; recv(client,buf,sizeof(buf)-1,0);
-  char *kh=strstr(buf,"Sec-WebSocket-Key:");
-  if (!kh){closesocket(client);return stola_new_int(-1);}
-  kh+=18; while(*kh==' ')kh++;
-  char key[64]={0}; int ki=0;
-  while(*kh&&*kh!='\r'&&*kh!='\n'&&ki<63) key[ki++]=*kh++;
-  char combined[256];
-  snprintf(combined,sizeof(combined),"%s%s",key,"258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-  unsigned char sha1_out[20];
-  ws_sha1((unsigned char*)combined,strlen(combined),sha1_out);
-  char *accept_key=ws_base64_encode(sha1_out,20);
-  char response[512];
-  snprintf(response,sizeof(response),
-    "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
-    "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n",accept_key);
-  free(accept_key);
-  send(client,response,(int)strlen(response),0);
-  return stola_new_int((int64_t)client);
+// recv() that parks the calling coroutine instead of blocking the thread.
+static ssize_t coro_recv(int fd, void *buf, size_t n) {
+  // Outside a coroutine the plain syscall is used even with io_uring up:
+  // ring requests ignore SO_RCVTIMEO, so a blocking caller could hang.
+  if (!coro_sched.current) return recv(fd, buf, n, 0);
+#ifdef STOLA_HAVE_URING
+  if (uring_ready()) return uring_recv(fd, buf, n);
+#endif
+  for (;;) {
+    ssize_t r = recv(fd, buf, n, MSG_DONTWAIT);
+    if (r >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) return r;
+    if (errno != EINTR) coro_wait_fd(fd, EPOLLIN | EPOLLRDHUP);
+  }
 }
 
-StolaValue *stola_ws_server_close(StolaValue *server_val) {
-  if (!server_val||server_val->type!=STOLA_INT) return stola_new_null();
-  closesocket((SOCKET)server_val->as.int_val);
+// accept() counterpart: all coroutines parked on a listener wake together,
+// so only the ones that still see a pending connection may call accept().
+static int coro_accept(int fd) {
+  if (!coro_sched.current) return accept(fd, NULL, NULL);
+  for (;;) {
+    struct pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, 0) > 0) return accept(fd, NULL, NULL);
+    coro_wait_fd(fd, EPOLLIN);
+  }
+}
+
+// send() through the I/O engine.  Sends everything, waiting for the socket
+// to drain when it is non-blocking (server connections are) and the kernel
+// buffer fills up.  Like coro_recv, only coroutines use the ring.
+static ssize_t io_send(int fd, const void *buf, size_t n) {
+  size_t sent = 0;
+  while (sent < n) {
+    ssize_t r;
+#ifdef STOLA_HAVE_URING
+    if (coro_sched.current && uring_ready())
+      r = uring_send(fd, (const char *)buf + sent, n - sent);
+    else
+#endif
+    r = send(fd, (const char *)buf + sent, n - sent, MSG_NOSIGNAL);
+    if (r > 0) { sent += (size_t)r; continue; }
+    if (r < 0 && errno == EINTR) continue;
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (coro_sched.current) coro_wait_fd(fd, EPOLLOUT);
+      else { struct pollfd p = {fd, POLLOUT, 0}; poll(&p, 1, -1); }
+      continue;
+    }
+    return sent ? (ssize_t)sent : -1;
+  }
+  return (ssize_t)sent;
+}
+
+static StolaCoro *coro_create(void *func_ptr, StolaValue *arg) {
+  StolaCoro *c = (StolaCoro *)calloc(1, sizeof(StolaCoro));
+  c->stack = coro_stack_alloc();
+  if (!c->stack) { free(c); stola_throw(stola_new_string("spawn: cannot map coroutine stack")); return NULL; }
+  c->func = (CoroFunc)func_ptr; c->arg = arg; c->timed_fd = -1;
+  /* r15 r14 r13 r12 rbx rbp ret — 72 bytes below a 16-aligned top, so the
+     call in stola_coro_boot happens with RSP % 16 == 0 */
+  int64_t *sp = (int64_t *)(c->stack + CORO_STACK_SIZE) - 9;
+  sp[3] = (int64_t)(uintptr_t)c;
+  sp[6] = (int64_t)(uintptr_t)stola_coro_boot;
+  c->sp = (int64_t)(uintptr_t)sp;
+  coro_enqueue(c);
+  return c;
+}
+
+StolaValue *stola_coro_spawn(void *func_ptr, StolaValue *arg) {
+  StolaCoro *c = coro_create(func_ptr, arg);
+  return c ? stola_new_int((int64_t)(uintptr_t)c) : stola_new_null();
+}
+
+// spawn() whose handle is discarded: nobody can await it, so the record is
+// freed by the scheduler as soon as the coroutine finishes.
+StolaValue *stola_coro_go(void *func_ptr, StolaValue *arg) {
+  StolaCoro *c = coro_create(func_ptr, arg);
+  if (c) c->detached = 1;
   return stola_new_null();
 }
 
-// ── I/O Multiplexing ─────────────────────────────────────────────────────────
-// stola_ws_select(handles: array<int>, timeout_ms: int) -> array<int>
-// Returns the subset of socket handles that have data ready to read.
-// timeout_ms < 0 → block; timeout_ms == 0 → non-blocking poll.
-StolaValue *stola_ws_select(StolaValue *handles, StolaValue *timeout_ms_val) {
-  StolaValue *result = stola_new_array();
-  if (!handles || handles->type != STOLA_ARRAY) return result;
-  int64_t timeout_ms = (timeout_ms_val && timeout_ms_val->type == STOLA_INT)
-                       ? timeout_ms_val->as.int_val : -1;
-  fd_set rfds;
-  FD_ZERO(&rfds);
-  int count = (int)handles->as.array_val.count;
-  for (int i = 0; i < count; i++) {
-    StolaValue *h = handles->as.array_val.items[i];
-    if (h && h->type == STOLA_INT)
-      FD_SET((SOCKET)h->as.int_val, &rfds);
-  }
-  struct timeval tv, *tvp = NULL;
-  if (timeout_ms >= 0) {
-    tv.tv_sec  = (long)(timeout_ms / 1000);
-    tv.tv_usec = (long)((timeout_ms % 1000) * 1000);
-    tvp = &tv;
-  }
-  // On Windows, the first argument to select() is ignored.
-  int r = select(0, &rfds, NULL, NULL, tvp);
-  if (r <= 0) return result;
-  for (int i = 0; i < count; i++) {
-    StolaValue *h = handles->as.array_val.items[i];
-    if (h && h->type == STOLA_INT &&
-        FD_ISSET((SOCKET)h->as.int_val, &rfds))
-      stola_push(result, stola_new_int(h->as.int_val));
+StolaValue *stola_coro_yield(void) {
+  if (coro_sched.current) { coro_enqueue(coro_sched.current); coro_suspend(); }
+  else coro_run_once(0);
+  return stola_new_null();
+}
+
+// A handle can be awaited once (like thread_join); the result is handed
+// over and the coroutine record freed.
+StolaValue *stola_coro_await(StolaValue *h) {
+  if (!h || h->type != STOLA_INT || !h->as.int_val) return stola_new_null();
+  StolaCoro *c = (StolaCoro *)(uintptr_t)h->as.int_val;
+  if (c->state != CORO_DONE) {
+    if (coro_sched.current) {
+      if (c->waiter || c == coro_sched.current) return stola_new_null();
+      c->waiter = coro_sched.current; coro_sched.current->state = CORO_WAITING;
+      coro_suspend();
+    } else {
+      while (c->state != CORO_DONE && coro_run_once(1)) {}
+      if (c->state != CORO_DONE) return stola_new_null(); /* deadlocked */
+    }
   }
-  return result;
+  StolaValue *r = c->result ? c->result : stola_new_null();
+  free(c);
+  return r;
 }
 
-#else
-// ============================================================
-// POSIX / Linux implementation
-// ============================================================
-#include <sys/socket.h>
-#include <netdb.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
-#include <pthread.h>
-#include <time.h>
+int stola_coro_sleep(int64_t ms) {
+  StolaCoro *c = coro_sched.current;
+  if (!c) return 0;
+  c->wake_at = coro_now_ms() + ms; c->state = CORO_WAITING;
+  coro_sleep_insert(c);
+  coro_suspend();
+  return 1;
+}
 
 // ---- Sockets ----
 StolaValue *stola_socket_connect(StolaValue *host, StolaValue *port) {
+  host = stola_as_string(host);
   if (!host || host->type != STOLA_STRING || !port) return stola_new_int(-1);
-  const char *hostname = host->as.str_val;
-  int port_num = (int)port->as.int_val;
-  char port_str[16]; snprintf(port_str, sizeof(port_str), "%d", port_num);
-  struct addrinfo hints, *result = NULL;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
-  if (getaddrinfo(hostname, port_str, &hints, &result) != 0) return stola_new_int(-1);
-  int sock = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
-  if (sock < 0) { freeaddrinfo(result); return stola_new_int(-1); }
-  if (connect(sock, result->ai_addr, result->ai_addrlen) < 0) {
-    close(sock); freeaddrinfo(result); return stola_new_int(-1);
-  }
-  freeaddrinfo(result);
+  struct sockaddr_in addr;
+  if (dns_lookup(host->as.str_val, (int)port->as.int_val, &addr) != 0) return stola_new_int(-1);
+  int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (sock < 0) return stola_new_int(-1);
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(sock); return stola_new_int(-1); }
   return stola_new_int((int64_t)sock);
 }
 
 StolaValue *stola_socket_send(StolaValue *fd, StolaValue *data) {
-  if (!fd || !data || data->type != STOLA_STRING) return stola_new_int(-1);
+  const char *buf; size_t n;
+  if (!fd || !stola_str_span(data, &buf, &n)) return stola_new_int(-1);
   int sock = (int)fd->as.int_val;
-  const char *buf = data->as.str_val;
-  return stola_new_int((int64_t)send(sock, buf, strlen(buf), 0));
+  return stola_new_int((int64_t)io_send(sock, buf, n));
 }
 
 StolaValue *stola_socket_receive(StolaValue *fd) {
   if (!fd) return stola_new_string("");
   int sock = (int)fd->as.int_val;
-  size_t total = 0, cap = 4096;
-  char *buf = (char *)malloc(cap);
+  size_t cap;
+  char *buf;
+  size_t total = sockbuf_drain(fd->as.int_val, &buf, &cap);
   while (1) {
     if (total + 4096 > cap) { cap *= 2; buf = (char *)realloc(buf, cap); }
-    int r = (int)recv(sock, buf + total, 4096, 0);
+    int r = (int)coro_recv(sock, buf + total, 4096);
     if (r <= 0) break;
     total += r;
   }
@@ -599,57 +2910,386 @@ StolaValue *stola_socket_receive(StolaValue *fd) {
 
 void stola_socket_close(StolaValue *fd) {
   if (!fd) return;
+  sockbuf_drop(fd->as.int_val);
   close((int)fd->as.int_val);
 }
 
+static long sock_recv_some(int64_t fd, char *buf, size_t n, int nonblock) {
+  /* io_uring would wait for data even on an O_NONBLOCK socket */
+  ssize_t r = nonblock ? recv((int)fd, buf, n, MSG_DONTWAIT) : coro_recv((int)fd, buf, n);
+  if (r >= 0) return (long)r;
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? -2 : -1;
+}
+
+StolaValue *stola_socket_set_nonblocking(StolaValue *fd, StolaValue *on) {
+  if (!fd || fd->type != STOLA_INT) return stola_new_bool(0);
+  int sock = (int)fd->as.int_val;
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0) return stola_new_bool(0);
+  int nb = on && stola_is_truthy(on);
+  if (fcntl(sock, F_SETFL, nb ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) < 0) return stola_new_bool(0);
+  sockbuf_get(fd->as.int_val, 1)->nonblock = nb;
+  return stola_new_bool(1);
+}
+
 // ---- HTTP fetch (raw POSIX, HTTP/1.1) ----
-StolaValue *stola_http_fetch(StolaValue *url_val) {
-  if (!url_val || url_val->type != STOLA_STRING) return stola_new_null();
-  const char *url = url_val->as.str_val;
-  char host[256] = {0}; char path[2048] = "/"; int port = 80;
+// ---- HTTP/1.1 client ----
+// http_request(method, url, body, headers) -> {status, body, headers}
+// Connections are kept alive in a process-wide pool (at most
+// HTTP_POOL_PER_HOST idle sockets per host:port, dropped after
+// HTTP_POOL_IDLE_MS) and reused by later requests to the same host.  A
+// pooled socket the server closed in the meantime is detected before use,
+// and a request that gets no response at all on a reused socket is retried
+// once on a fresh one.  Bodies may be Content-Length, chunked or
+// close-delimited.  http_pipeline(requests) writes several requests to one
+// connection before reading the responses back in order.
+// http_set_timeout(ms) bounds connect and each wait for response bytes
+// (0 = wait forever); coroutines are not interrupted by it.
+// Plain http:// only: TLS needs the WinHTTP build.
+#include <netinet/tcp.h>
+#include <strings.h>
+
+#define HTTP_POOL_PER_HOST 8
+#define HTTP_POOL_IDLE_MS  30000
+
+typedef struct HttpConn {
+  char key[300];                  /* "host:port" */
+  int fd;
+  int64_t idle_since;
+  struct HttpConn *next;
+} HttpConn;
+
+typedef struct { char host[256]; char path[2048]; int port, tls; } HttpUrl;
+
+static HttpConn *http_pool = NULL;
+static pthread_mutex_t http_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static int http_timeout_ms = 0;
+
+static int http_parse_url(const char *url, HttpUrl *u) {
+  memset(u, 0, sizeof(*u));
+  strcpy(u->path, "/"); u->port = 80;
   const char *p = url;
   if (strncmp(p, "http://", 7) == 0) p += 7;
-  else if (strncmp(p, "https://", 8) == 0) { p += 8; port = 443; }
+  else if (strncmp(p, "https://", 8) == 0) { p += 8; u->port = 443; u->tls = 1; }
   const char *slash = strchr(p, '/'), *colon = strchr(p, ':');
   if (colon && (!slash || colon < slash)) {
-    size_t hl = colon - p; strncpy(host, p, hl < 255 ? hl : 255);
-    port = atoi(colon + 1);
-  } else if (slash) strncpy(host, p, (slash-p) < 255 ? (slash-p) : 255);
-  else strncpy(host, p, 255);
-  if (slash) strncpy(path, slash, 2047);
-  char port_str[16]; snprintf(port_str, sizeof(port_str), "%d", port);
-  struct addrinfo hints, *res = NULL; memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET; hints.ai_socktype = SOCK_STREAM;
-  if (getaddrinfo(host, port_str, &hints, &res) != 0) {
-    stola_throw(stola_new_string("http_fetch: host not found")); return stola_new_null();
-  }
-  int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-  if (sock < 0) { freeaddrinfo(res); stola_throw(stola_new_string("http_fetch: socket failed")); return stola_new_null(); }
-  if (connect(sock, res->ai_addr, res->ai_addrlen) < 0) {
-    close(sock); freeaddrinfo(res); stola_throw(stola_new_string("http_fetch: connect failed")); return stola_new_null();
-  }
-  freeaddrinfo(res);
-  char req[3096];
-  snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n", path, host);
-  send(sock, req, strlen(req), 0);
-  size_t total = 0, cap = 8192;
-  char *buf = (char *)malloc(cap);
-  while (1) {
-    if (total + 4096 > cap) { cap *= 2; buf = (char *)realloc(buf, cap); }
-    int r = (int)recv(sock, buf + total, 4096, 0);
-    if (r <= 0) break; total += r;
+    size_t hl = (size_t)(colon - p); strncpy(u->host, p, hl < 255 ? hl : 255);
+    u->port = atoi(colon + 1);
+  } else if (slash) strncpy(u->host, p, (size_t)(slash - p) < 255 ? (size_t)(slash - p) : 255);
+  else strncpy(u->host, p, 255);
+  if (slash) strncpy(u->path, slash, 2047);
+  return u->host[0] != '\0';
+}
+
+static int http_connect(const char *host, int port) {
+  struct sockaddr_in addr;
+  if (dns_lookup(host, port, &addr) != 0) return -1;
+  int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+  if (sock < 0) return -1;
+  int ok;
+  if (http_timeout_ms > 0 && !coro_sched.current) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    ok = connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    if (!ok && errno == EINPROGRESS) {
+      struct pollfd p = {sock, POLLOUT, 0};
+      int err = 0; socklen_t el = sizeof(err);
+      ok = poll(&p, 1, http_timeout_ms) > 0 && getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &el) == 0 && err == 0;
+    }
+    fcntl(sock, F_SETFL, flags);
+  } else ok = connect(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+  if (!ok) { close(sock); return -1; }
+  int one = 1; setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return sock;
+}
+
+static void http_conn_close(int fd) { sockbuf_drop(fd); close(fd); }
+
+// Idle pooled socket for key, or a new connection.  *reused tells which.
+static int http_pool_get(const char *key, const HttpUrl *u, int *reused) {
+  int64_t now = coro_now_ms();
+  pthread_mutex_lock(&http_pool_lock);
+  HttpConn **pp = &http_pool;
+  while (*pp) {
+    HttpConn *c = *pp;
+    if (strcmp(c->key, key) != 0) { pp = &c->next; continue; }
+    *pp = c->next;
+    int fd = c->fd;
+    int64_t idle = now - c->idle_since;
+    free(c);
+    /* readable while idle means the server closed it (or sent junk) */
+    struct pollfd p = {fd, POLLIN, 0};
+    if (idle > HTTP_POOL_IDLE_MS || poll(&p, 1, 0) != 0) { http_conn_close(fd); continue; }
+    pthread_mutex_unlock(&http_pool_lock);
+    *reused = 1;
+    return fd;
   }
-  close(sock);
-  buf[total] = '\0';
-  int status = 0;
-  if (strncmp(buf, "HTTP/", 5) == 0) { const char *sp = strchr(buf, ' '); if (sp) status = atoi(sp+1); }
-  char *body_start = strstr(buf, "\r\n\r\n");
-  char *body_copy = body_start ? strdup(body_start + 4) : strdup("");
-  free(buf);
-  StolaValue *result = stola_new_dict();
-  stola_dict_set(result, stola_new_string("status"), stola_new_int((int64_t)status));
-  stola_dict_set(result, stola_new_string("body"), stola_new_string_owned(body_copy));
-  return result;
+  pthread_mutex_unlock(&http_pool_lock);
+  *reused = 0;
+  return http_connect(u->host, u->port);
+}
+
+static void http_pool_put(const char *key, int fd) {
+  SockBuf *b = sockbuf_get(fd, 0);
+  if (b && b->len) { http_conn_close(fd); return; } /* unexpected extra bytes */
+  int same = 0;
+  pthread_mutex_lock(&http_pool_lock);
+  for (HttpConn *c = http_pool; c; c = c->next) same += strcmp(c->key, key) == 0;
+  if (same < HTTP_POOL_PER_HOST) {
+    HttpConn *c = (HttpConn *)malloc(sizeof(HttpConn));
+    snprintf(c->key, sizeof(c->key), "%s", key);
+    c->fd = fd; c->idle_since = coro_now_ms();
+    c->next = http_pool; http_pool = c;
+    fd = -1;
+  }
+  pthread_mutex_unlock(&http_pool_lock);
+  if (fd >= 0) http_conn_close(fd);
+}
+
+// sockbuf_fill honouring http_set_timeout; -1 also on timeout.
+static long http_fill(SockBuf *b, size_t want) {
+  if (http_timeout_ms > 0 && !coro_sched.current) {
+    struct pollfd p = {(int)b->fd, POLLIN, 0};
+    if (poll(&p, 1, http_timeout_ms) <= 0) return -1;
+  }
+  return sockbuf_fill(b, want);
+}
+
+// Length of the next line in b (CRLF not included, *skip = its length),
+// or -1 if the stream ended first.
+static long http_line(SockBuf *b, size_t *skip) {
+  size_t scanned = 0;
+  for (;;) {
+    char *nl = b->len > scanned ? (char *)memchr(b->data + b->start + scanned, '\n', b->len - scanned) : NULL;
+    if (nl) {
+      size_t n = (size_t)(nl - (b->data + b->start));
+      *skip = 1;
+      if (n && b->data[b->start + n - 1] == '\r') { n--; *skip = 2; }
+      return (long)n;
+    }
+    if (b->len >= SOCKBUF_MAX) return -1;
+    scanned = b->len;
+    if (http_fill(b, 0) <= 0) return -1;
+  }
+}
+
+static void http_consume(SockBuf *b, size_t n) {
+  b->start += n; b->len -= n;
+  if (!b->len) b->start = 0;
+}
+
+static void http_body_append(char **body, size_t *len, size_t *cap, const char *src, size_t n) {
+  if (*len + n + 1 > *cap) { while (*len + n + 1 > *cap) *cap *= 2; *body = (char *)realloc(*body, *cap); }
+  memcpy(*body + *len, src, n);
+  *len += n;
+}
+
+// Read one response from fd.  NULL if the connection failed; *got_any says
+// whether any byte of the response had arrived.  *keep is set when the
+// connection may carry another request.
+static StolaValue *http_read_response(int fd, int head_only, int *keep, int *got_any) {
+  SockBuf *b = sockbuf_get(fd, 1);
+  size_t skip;
+  *keep = 0; *got_any = 0;
+  long n;
+  int status;
+  do { /* skip 1xx interim responses */
+    n = http_line(b, &skip);
+    if (n < 0) { *got_any = b->len > 0; return NULL; }
+    *got_any = 1;
+    if (n < 12 || strncmp(b->data + b->start, "HTTP/1.", 7) != 0) return NULL;
+    *keep = b->data[b->start + 7] == '1';
+    status = atoi(b->data + b->start + 9);
+    http_consume(b, (size_t)n + skip);
+    StolaValue *headers = stola_new_dict();
+    long content_length = -1;
+    int chunked = 0;
+    while ((n = http_line(b, &skip)) > 0) {
+      const char *line = b->data + b->start;
+      http_add_header(headers, line, (size_t)n);
+      if (n > 15 && strncasecmp(line, "content-length:", 15) == 0) content_length = atol(line + 15);
+      else if (n > 18 && strncasecmp(line, "transfer-encoding:", 18) == 0 && memmem(line, (size_t)n, "chunked", 7)) chunked = 1;
+      else if (n > 11 && strncasecmp(line, "connection:", 11) == 0) {
+        if (memmem(line, (size_t)n, "close", 5)) *keep = 0;
+        else if (memmem(line, (size_t)n, "keep-alive", 10)) *keep = 1;
+      }
+      http_consume(b, (size_t)n + skip);
+    }
+    if (n < 0) return NULL;
+    http_consume(b, skip);
+    if (status >= 100 && status < 200) continue;
+    size_t blen = 0, bcap = 4096;
+    char *body = (char *)malloc(bcap);
+    if (head_only || status == 204 || status == 304) {
+      /* no body */
+    } else if (chunked) {
+      for (;;) {
+        if ((n = http_line(b, &skip)) < 0) { free(body); return NULL; }
+        size_t size = (size_t)strtoul(b->data + b->start, NULL, 16);
+        http_consume(b, (size_t)n + skip);
+        if (size == 0) { /* trailers end with an empty line */
+          while ((n = http_line(b, &skip)) > 0) http_consume(b, (size_t)n + skip);
+          if (n < 0) { free(body); return NULL; }
+          http_consume(b, skip);
+          break;
+        }
+        while (b->len < size + 2) if (http_fill(b, size + 2) <= 0) { free(body); return NULL; }
+        http_body_append(&body, &blen, &bcap, b->data + b->start, size);
+        http_consume(b, size + 2);
+      }
+    } else if (content_length >= 0) {
+      while (b->len < (size_t)content_length)
+        if (http_fill(b, (size_t)content_length) <= 0) { free(body); return NULL; }
+      http_body_append(&body, &blen, &bcap, b->data + b->start, (size_t)content_length);
+      http_consume(b, (size_t)content_length);
+    } else { /* delimited by close */
+      *keep = 0;
+      for (;;) {
+        http_body_append(&body, &blen, &bcap, b->data + b->start, b->len);
+        http_consume(b, b->len);
+        if (http_fill(b, 0) <= 0) break;
+      }
+    }
+    body[blen] = '\0';
+    return http_result(status, body, headers);
+  } while (1);
+}
+
+static char *http_build_request(const char *method, const HttpUrl *u, StolaValue *body,
+                                StolaValue *headers, size_t *out_len) {
+  const char *b = (body && body->type == STOLA_STRING) ? body->as.str_val : NULL;
+  if (body && body->type != STOLA_STRING && body->type != STOLA_NULL) b = stola_to_string(body)->as.str_val;
+  size_t bl = b ? strlen(b) : 0;
+  char *extra = http_header_lines(headers);
+  size_t cap = strlen(method) + strlen(u->path) + strlen(u->host) + strlen(extra) + bl + 128;
+  char *req = (char *)malloc(cap);
+  int n = snprintf(req, cap, "%s %s HTTP/1.1\r\nHost: %s", method, u->path, u->host);
+  if (u->port != 80) n += snprintf(req + n, cap - (size_t)n, ":%d", u->port);
+  n += snprintf(req + n, cap - (size_t)n, "\r\nUser-Agent: StolasScript/1.0\r\n%s", extra);
+  if (b || strcmp(method, "POST") == 0 || strcmp(method, "PUT") == 0 || strcmp(method, "PATCH") == 0)
+    n += snprintf(req + n, cap - (size_t)n, "Content-Length: %zu\r\n", bl);
+  n += snprintf(req + n, cap - (size_t)n, "\r\n");
+  if (bl) { memcpy(req + n, b, bl); n += (int)bl; }
+  free(extra);
+  *out_len = (size_t)n;
+  return req;
+}
+
+// One request/response on a pooled connection; NULL with *err set on failure.
+static StolaValue *http_do(const char *method, const char *url, StolaValue *body,
+                           StolaValue *headers, const char **err) {
+  HttpUrl u;
+  if (!http_parse_url(url, &u)) { *err = "http: invalid URL"; return NULL; }
+  if (u.tls) { *err = "http: https is only supported by the WinHTTP (Windows) build"; return NULL; }
+  char key[300]; snprintf(key, sizeof(key), "%s:%d", u.host, u.port);
+  size_t len;
+  char *req = http_build_request(method, &u, body, headers, &len);
+  int head_only = strcmp(method, "HEAD") == 0;
+  StolaValue *resp = NULL;
+  *err = NULL;
+  for (int attempt = 0; attempt < 2 && !resp; attempt++) {
+    int reused, keep, got_any;
+    int fd = http_pool_get(key, &u, &reused);
+    if (fd < 0) { *err = "http: connect failed"; break; }
+    if (io_send(fd, req, len) < 0) {
+      http_conn_close(fd);
+      if (reused) continue;
+      *err = "http: send failed"; break;
+    }
+    resp = http_read_response(fd, head_only, &keep, &got_any);
+    if (resp && keep) http_pool_put(key, fd);
+    else http_conn_close(fd);
+    if (!resp && (!reused || got_any)) { *err = "http: no response (timeout or connection closed)"; break; }
+  }
+  free(req);
+  return resp;
+}
+
+StolaValue *stola_http_request(StolaValue *method, StolaValue *url, StolaValue *body, StolaValue *headers) {
+  method = stola_as_string(method); url = stola_as_string(url);
+  if (!method || method->type != STOLA_STRING || !url || url->type != STOLA_STRING) return stola_new_null();
+  const char *err;
+  StolaValue *resp = http_do(method->as.str_val, url->as.str_val, body, headers, &err);
+  if (!resp) { stola_throw(stola_new_string(err)); return stola_new_null(); }
+  return resp;
+}
+
+StolaValue *stola_http_fetch(StolaValue *url_val) {
+  url_val = stola_as_string(url_val);
+  if (!url_val || url_val->type != STOLA_STRING) return stola_new_null();
+  return stola_http_request(stola_new_string("GET"), url_val, NULL, NULL);
+}
+
+// requests: array of {method, url, body?, headers?}.  Consecutive requests
+// to the same host:port share one connection: all of them are written
+// first, then the responses are read in order.  Anything left unanswered
+// when the server closes the connection is retried one by one.
+StolaValue *stola_http_pipeline(StolaValue *requests) {
+  StolaValue *out = stola_new_array();
+  if (!requests || requests->type != STOLA_ARRAY) return out;
+  int count = requests->as.array_val.count;
+  StolaValue *k_method = stola_new_string("method"), *k_url = stola_new_string("url");
+  StolaValue *k_body = stola_new_string("body"), *k_headers = stola_new_string("headers");
+  int i = 0;
+  while (i < count) {
+    StolaValue *r = requests->as.array_val.items[i];
+    StolaValue *uv = stola_dict_get(r, k_url);
+    HttpUrl u;
+    if (!uv || uv->type != STOLA_STRING || !http_parse_url(uv->as.str_val, &u) || u.tls) {
+      stola_push(out, stola_new_null()); i++; continue;
+    }
+    char key[300]; snprintf(key, sizeof(key), "%s:%d", u.host, u.port);
+    /* batch: [i, j) all go to key */
+    int j = i;
+    size_t tlen = 0, tcap = 4096;
+    char *batch = (char *)malloc(tcap);
+    int heads[64];
+    while (j < count && j - i < 64) {
+      StolaValue *rj = requests->as.array_val.items[j];
+      StolaValue *mj = stola_dict_get(rj, k_method), *uj = stola_dict_get(rj, k_url);
+      HttpUrl uu;
+      if (!uj || uj->type != STOLA_STRING || !http_parse_url(uj->as.str_val, &uu) || uu.tls ||
+          strcmp(uu.host, u.host) != 0 || uu.port != u.port) break;
+      const char *mm = (mj && mj->type == STOLA_STRING) ? mj->as.str_val : "GET";
+      size_t len;
+      char *req = http_build_request(mm, &uu, stola_dict_get(rj, k_body), stola_dict_get(rj, k_headers), &len);
+      if (tlen + len > tcap) { while (tlen + len > tcap) tcap *= 2; batch = (char *)realloc(batch, tcap); }
+      memcpy(batch + tlen, req, len); tlen += len;
+      free(req);
+      heads[j - i] = strcmp(mm, "HEAD") == 0;
+      j++;
+    }
+    int reused, done = i;
+    int fd = http_pool_get(key, &u, &reused);
+    if (fd >= 0 && io_send(fd, batch, tlen) >= 0) {
+      int keep = 1, got_any;
+      while (done < j && keep) {
+        StolaValue *resp = http_read_response(fd, heads[done - i], &keep, &got_any);
+        if (!resp) break;
+        stola_push(out, resp);
+        done++;
+      }
+      if (done == j && keep) http_pool_put(key, fd);
+      else http_conn_close(fd);
+    } else if (fd >= 0) http_conn_close(fd);
+    free(batch);
+    for (; done < j; done++) { /* leftovers: plain requests */
+      StolaValue *rj = requests->as.array_val.items[done];
+      StolaValue *mj = stola_dict_get(rj, k_method);
+      const char *err;
+      StolaValue *resp = http_do((mj && mj->type == STOLA_STRING) ? mj->as.str_val : "GET",
+                                 stola_dict_get(rj, k_url)->as.str_val,
+                                 stola_dict_get(rj, k_body), stola_dict_get(rj, k_headers), &err);
+      stola_push(out, resp ? resp : stola_new_null());
+    }
+    i = j;
+  }
+  return out;
+}
+
+StolaValue *stola_http_set_timeout(StolaValue *ms) {
+  http_timeout_ms = (ms && ms->type == STOLA_INT && ms->as.int_val > 0) ? (int)ms->as.int_val : 0;
+  return stola_new_null();
 }
 
 // ---- Threads (pthreads) ----
@@ -709,43 +3349,116 @@ StolaValue *stola_mutex_unlock(StolaValue *v) {
 }
 
 // ---- WebSocket (POSIX, RFC 6455) ----
-static int ws_send_frame_posix(int sock, const char *payload, size_t plen) {
-  struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
-  srand((unsigned int)(ts.tv_nsec));
-  unsigned char mask[4]; for (int i=0;i<4;i++) mask[i]=rand()&0xFF;
-  unsigned char hdr[14]; int hlen=0;
-  hdr[hlen++]=0x81;
-  if (plen<=125) hdr[hlen++]=0x80|(unsigned char)plen;
-  else if(plen<=65535){hdr[hlen++]=0x80|126;hdr[hlen++]=(plen>>8)&0xFF;hdr[hlen++]=plen&0xFF;}
-  else{hdr[hlen++]=0x80|127;for(int i=7;i>=0;i--)hdr[hlen++]=(plen>>(i*8))&0xFF;}
-  memcpy(hdr+hlen,mask,4); hlen+=4;
-  unsigned char *frame=(unsigned char*)malloc(hlen+plen);
-  memcpy(frame,hdr,hlen);
-  for (size_t i=0;i<plen;i++) frame[hlen+i]=((unsigned char)payload[i])^mask[i%4];
-  int sent=(int)send(sock,(const char*)frame,hlen+plen,0);
-  free(frame); return sent;
-}
-
-static char *ws_recv_frame_posix(int sock) {
-  unsigned char hdr[2];
-  if (recv(sock,(char*)hdr,2,MSG_WAITALL)!=2) return NULL;
-  int opcode=hdr[0]&0x0F, masked=(hdr[1]>>7)&1;
-  uint64_t plen=hdr[1]&0x7F;
-  if (plen==126){unsigned char e[2];if(recv(sock,(char*)e,2,MSG_WAITALL)!=2)return NULL;plen=((uint64_t)e[0]<<8)|e[1];}
-  else if(plen==127){unsigned char e[8];if(recv(sock,(char*)e,8,MSG_WAITALL)!=8)return NULL;plen=0;for(int i=0;i<8;i++)plen=(plen<<8)|e[i];}
-  unsigned char mask[4]={0};
-  if (masked && recv(sock,(char*)mask,4,MSG_WAITALL)!=4) return NULL;
-  if (opcode==0x8) return NULL;
-  char *payload=(char*)malloc(plen+1);
-  size_t got=0;
-  while (got<plen){int r=(int)recv(sock,payload+got,(int)(plen-got),0);if(r<=0){free(payload);return NULL;}got+=r;}
-  payload[plen]='\0';
-  if (masked) for(size_t i=0;i<plen;i++) payload[i]^=mask[i%4];
-  if (opcode==0x9){unsigned char pong[2]={0x8A,0x00};send(sock,(const char*)pong,2,0);free(payload);return ws_recv_frame_posix(sock);}
-  return payload;
+static int sock_sendv(int64_t fd, const void *a, size_t alen, const void *b, size_t blen) {
+  struct iovec iov[2] = {{(void *)a, alen}, {(void *)b, blen}};
+  struct msghdr mh; memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = iov; mh.msg_iovlen = 2;
+  while (iov[0].iov_len + iov[1].iov_len) {
+    ssize_t r = sendmsg((int)fd, &mh, MSG_NOSIGNAL);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) return -1;
+      if (coro_sched.current) coro_wait_fd((int)fd, EPOLLOUT);
+      else { struct pollfd p = {(int)fd, POLLOUT, 0}; poll(&p, 1, -1); }
+      continue;
+    }
+    for (int i = 0; i < 2; i++) {
+      size_t k = (size_t)r < iov[i].iov_len ? (size_t)r : iov[i].iov_len;
+      iov[i].iov_base = (char *)iov[i].iov_base + k; iov[i].iov_len -= k; r -= (ssize_t)k;
+    }
+  }
+  return 0;
+}
+
+#define WS_BCAST_TIMEOUT_MS 5000
+
+// The unsent tail of item it as an iovec pair.
+static struct msghdr *ws_bcast_msg(WsBcast *it, struct msghdr *mh, struct iovec *iov) {
+  size_t d = it->done;
+  if (d < it->hlen) {
+    iov[0].iov_base = (void *)(it->hdr + d); iov[0].iov_len = it->hlen - d;
+    iov[1].iov_base = (void *)it->payload; iov[1].iov_len = it->plen;
+  } else {
+    iov[0].iov_base = (void *)(it->payload + (d - it->hlen)); iov[0].iov_len = it->plen - (d - it->hlen);
+    iov[1].iov_base = NULL; iov[1].iov_len = 0;
+  }
+  memset(mh, 0, sizeof(*mh));
+  mh->msg_iov = iov; mh->msg_iovlen = 2;
+  return mh;
+}
+
+// Push as much of it as the socket takes right now: 1 done, 0 would block.
+static int ws_bcast_try(WsBcast *it) {
+  while (it->done < it->hlen + it->plen) {
+    struct msghdr mh; struct iovec iov[2];
+    ssize_t r = sendmsg((int)it->fd, ws_bcast_msg(it, &mh, iov), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (r > 0) { it->done += (size_t)r; continue; }
+    if (r < 0 && errno == EINTR) continue;
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    it->failed = 1;
+    return 1;
+  }
+  return 1;
+}
+
+// io_uring: one non-blocking SENDMSG per socket, all submitted with a
+// single io_uring_enter.  Otherwise non-blocking sendmsg to everyone first.
+// Either way the sockets whose buffers were full are then finished by
+// waiting for POLLOUT (parking the coroutine, if any) until one deadline
+// for the whole call.  A socket left holding part of a frame is shut down:
+// whatever is sent on it next would land in the middle of that frame.
+static void sock_broadcast(WsBcast *items, int n) {
+#ifdef STOLA_HAVE_URING
+  if (n > 1 && uring_ready()) {
+    UringOp *ops = (UringOp *)calloc((size_t)n, sizeof(UringOp));
+    struct msghdr *mh = (struct msghdr *)calloc((size_t)n, sizeof(struct msghdr));
+    struct iovec *iov = (struct iovec *)calloc((size_t)n * 2, sizeof(struct iovec));
+    for (int i = 0; i < n; i++) {
+      struct io_uring_sqe *sqe = uring_sqe(&ops[i]);
+      sqe->opcode = IORING_OP_SENDMSG; sqe->fd = (int)items[i].fd;
+      sqe->addr = (uint64_t)(uintptr_t)ws_bcast_msg(&items[i], &mh[i], &iov[i * 2]);
+      /* MSG_DONTWAIT: a full socket must not park the batch in the kernel */
+      sqe->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+    }
+    for (int i = 0; i < n; i++) {
+      int r = uring_wait(&ops[i]);
+      if (r > 0) items[i].done += (size_t)r;
+      else if (r < 0 && r != -EAGAIN && r != -EINTR) items[i].failed = 1;
+    }
+    free(ops); free(mh); free(iov);
+  }
+#endif
+  struct pollfd *pf = (struct pollfd *)malloc(sizeof(struct pollfd) * (size_t)(n ? n : 1));
+  int *idx = (int *)malloc(sizeof(int) * (size_t)(n ? n : 1));
+  int64_t deadline = coro_now_ms() + WS_BCAST_TIMEOUT_MS;
+  for (;;) {
+    int np = 0;
+    for (int i = 0; i < n; i++)
+      if (!items[i].failed && !ws_bcast_try(&items[i])) {
+        pf[np].fd = (int)items[i].fd; pf[np].events = POLLOUT; pf[np].revents = 0;
+        idx[np++] = i;
+      }
+    if (!np) break;
+    int64_t left = deadline - coro_now_ms();
+    if (left <= 0) { for (int k = 0; k < np; k++) items[idx[k]].failed = 1; break; }
+    if (coro_sched.current) {
+      /* any one of them: the next round retries every pending socket */
+      coro_wait_fd_until(pf[0].fd, EPOLLOUT, deadline);
+      continue;
+    }
+    int r = poll(pf, (nfds_t)np, (int)left);
+    if (r < 0 && errno != EINTR) { for (int k = 0; k < np; k++) items[idx[k]].failed = 1; break; }
+    for (int k = 0; r > 0 && k < np; k++)
+      if (pf[k].revents & (POLLERR | POLLHUP | POLLNVAL)) items[idx[k]].failed = 1;
+  }
+  for (int i = 0; i < n; i++)
+    if (items[i].failed && items[i].done > 0 && items[i].done < items[i].hlen + items[i].plen)
+      shutdown((int)items[i].fd, SHUT_RDWR);
+  free(pf); free(idx);
 }
 
 StolaValue *stola_ws_connect(StolaValue *url_val) {
+  url_val=stola_as_string(url_val);
   if (!url_val||url_val->type!=STOLA_STRING) return stola_new_int(-1);
   const char *url=url_val->as.str_val;
   char host[256]={0}; int port=80; char path[1024]="/";
@@ -757,46 +3470,42 @@ StolaValue *stola_ws_connect(StolaValue *url_val) {
   else if(slash) strncpy(host,p,(slash-p)<255?(slash-p):255);
   else strncpy(host,p,255);
   if (slash) strncpy(path,slash,1023);
-  char port_str[16]; snprintf(port_str,sizeof(port_str),"%d",port);
-  struct addrinfo hints,*res=NULL; memset(&hints,0,sizeof(hints));
-  hints.ai_family=AF_INET; hints.ai_socktype=SOCK_STREAM;
-  if (getaddrinfo(host,port_str,&hints,&res)!=0) return stola_new_int(-1);
-  int sock=socket(res->ai_family,res->ai_socktype,res->ai_protocol);
-  if (sock<0){freeaddrinfo(res);return stola_new_int(-1);}
-  if (connect(sock,res->ai_addr,res->ai_addrlen)<0){close(sock);freeaddrinfo(res);return stola_new_int(-1);}
-  freeaddrinfo(res);
+  struct sockaddr_in addr;
+  if (dns_lookup(host,port,&addr)!=0) return stola_new_int(-1);
+  int sock=socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+  if (sock<0) return stola_new_int(-1);
+  if (connect(sock,(struct sockaddr*)&addr,sizeof(addr))<0){close(sock);return stola_new_int(-1);}
   struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); srand((unsigned int)(ts.tv_nsec));
   unsigned char key_bytes[16]; for(int i=0;i<16;i++) key_bytes[i]=rand()&0xFF;
   char *key=ws_base64_encode(key_bytes,16);
   char req[1024];
   snprintf(req,sizeof(req),"GET %s HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\n"
-    "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n",
+    "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n" WS_CLIENT_EXT "\r\n",
     path,host,port,key);
   free(key);
   send(sock,req,strlen(req),0);
-  char resp[2048]={0}; recv(sock,resp,sizeof(resp)-1,0);
-  if (!strstr(resp,"101")){close(sock);return stola_new_int(-1);}
+  if (!ws_client_handshake(sock)){sockbuf_drop(sock);close(sock);return stola_new_int(-1);}
   return stola_new_int((int64_t)sock);
 }
 
 StolaValue *stola_ws_send(StolaValue *handle, StolaValue *msg) {
   if (!handle||handle->type!=STOLA_INT) return stola_new_int(-1);
-  if (!msg||msg->type!=STOLA_STRING) return stola_new_int(-1);
-  return stola_new_int(ws_send_frame_posix((int)handle->as.int_val,
-    msg->as.str_val, strlen(msg->as.str_val)));
+  const char *p; size_t n;
+  if (!stola_str_span(msg,&p,&n)) return stola_new_int(-1);
+  return stola_new_int(ws_send_message(handle->as.int_val, 0x1, p, n));
 }
 
 StolaValue *stola_ws_receive(StolaValue *handle) {
   if (!handle||handle->type!=STOLA_INT) return stola_new_null();
-  char *payload=ws_recv_frame_posix((int)handle->as.int_val);
+  char *payload=ws_recv_frame(handle->as.int_val);
   if (!payload) return stola_new_null();
   return stola_new_string_owned(payload);
 }
 
 StolaValue *stola_ws_close(StolaValue *handle) {
   if (!handle||handle->type!=STOLA_INT) return stola_new_null();
-  unsigned char cf[2]={0x88,0x00};
-  send((int)handle->as.int_val,(const char*)cf,2,0);
+  ws_send_close(handle->as.int_val,1000);
+  sockbuf_drop(handle->as.int_val);
   close((int)handle->as.int_val);
   return stola_new_null();
 }
@@ -816,24 +3525,20 @@ StolaValue *stola_ws_server_create(StolaValue *port_val) {
 
 StolaValue *stola_ws_server_accept(StolaValue *server_val) {
   if (!server_val||server_val->type!=STOLA_INT) return stola_new_int(-1);
-  int client=accept((int)server_val->as.int_val,NULL,NULL);
+  int client=coro_accept((int)server_val->as.int_val);
   if (client<0) return stola_new_int(-1);
-  char buf[4096]={0}; recv(client,buf,sizeof(buf)-1,0);
-  char *kh=strstr(buf,"Sec-WebSocket-Key:");
-  if (!kh){close(client);return stola_new_int(-1);}
-  kh+=18; while(*kh==' ')kh++;
-  char key[64]={0}; int ki=0;
-  while(*kh&&*kh!='\r'&&*kh!='\n'&&ki<63) key[ki++]=*kh++;
-  char combined[256];
-  snprintf(combined,sizeof(combined),"%s%s",key,"258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-  unsigned char sha1_out[20];
-  ws_sha1((unsigned char*)combined,strlen(combined),sha1_out);
-  char *accept_key=ws_base64_encode(sha1_out,20);
-  char response[512];
-  snprintf(response,sizeof(response),"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
-    "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n",accept_key);
-  free(accept_key);
-  send(client,response,strlen(response),0);
+  /* read until the blank line ends the request headers */
+  char buf[4096]={0}; size_t got=0;
+  while (got<sizeof(buf)-1 && !strstr(buf,"\r\n\r\n")) {
+    ssize_t r=coro_recv(client,buf+got,sizeof(buf)-1-got);
+    if (r<=0) break;
+    got+=(size_t)r; buf[got]='\0';
+  }
+  char response[512]; int deflate;
+  int rlen=ws_handshake_reply(buf,response,sizeof(response),&deflate);
+  if (rlen<0){close(client);return stola_new_int(-1);}
+  io_send(client,response,(size_t)rlen);
+  ws_set_server((int64_t)client,deflate);
   return stola_new_int((int64_t)client);
 }
 
@@ -843,45 +3548,445 @@ StolaValue *stola_ws_server_close(StolaValue *server_val) {
   return stola_new_null();
 }
 
+// ── Multi-core server ────────────────────────────────────────────────────────
+// ws_server_run(port, handler, workers) blocks and serves the port from
+// `workers` threads (<= 0: one per online core).  Each worker owns a
+// SO_REUSEPORT listener, so the kernel spreads new connections across them,
+// plus an epoll set of non-blocking connections.  Handshakes and frames are
+// parsed from per-connection buffers as bytes arrive, so a slow client never
+// stalls the others.  handler(client, msg, event) is called on the worker
+// that owns the connection with event "open" / "message" / "binary" /
+// "close" (msg is null for open and close); client is a normal handle for
+// ws_send/ws_close.
+// ws_server_stop(port) makes a running ws_server_run return.
+//
+// The worker loop is protocol-agnostic: each server supplies a `process`
+// callback that consumes whatever complete messages sit in a connection's
+// buffer.  http_server_create (below) runs on the same machinery.
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+
+#define WS_RUN_MAX_HANDSHAKE 16384
+
+typedef struct {
+  int fd, open;                   /* open: handshake done */
+  unsigned char *buf; size_t len, cap;
+  StolaValue *handle;
+} NetConn;
+
+typedef struct NetWorker NetWorker;
+
+typedef struct NetServer {
+  int port, stop_fd, nworkers, shared_fd;
+  int background;                 /* started by http_server_create */
+  CoroFunc handler;
+  int (*process)(struct NetServer *, NetConn *); /* 0: drop the connection */
+  NetWorker *workers;
+  struct NetServer *next;
+} NetServer;
+
+struct NetWorker { NetServer *srv; int listen_fd; pthread_t tid; };
+
+static NetServer *net_servers = NULL;
+static pthread_mutex_t net_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int net_listen(int port, int reuseport) {
+  int fd=socket(AF_INET,SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC,IPPROTO_TCP);
+  if (fd<0) return -1;
+  int opt=1; setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&opt,sizeof(opt));
+#ifdef SO_REUSEPORT
+  if (reuseport && setsockopt(fd,SOL_SOCKET,SO_REUSEPORT,&opt,sizeof(opt))<0){close(fd);return -1;}
+#else
+  if (reuseport){close(fd);return -1;}
+#endif
+  struct sockaddr_in addr; memset(&addr,0,sizeof(addr));
+  addr.sin_family=AF_INET; addr.sin_addr.s_addr=INADDR_ANY; addr.sin_port=htons((unsigned short)port);
+  if (bind(fd,(struct sockaddr*)&addr,sizeof(addr))<0||listen(fd,SOMAXCONN)<0){close(fd);return -1;}
+  return fd;
+}
+
+static void ws_run_event(NetServer *srv, NetConn *c, StolaValue *msg, const char *event) {
+  srv->handler(c->handle, msg ? msg : stola_new_null(), stola_new_string(event), stola_new_null());
+}
+
+static void net_drop(NetServer *srv, int epfd, NetConn **conns, NetConn *c, int notify) {
+  if (notify && c->open) ws_run_event(srv, c, NULL, "close");
+  /* the handler may already have closed it with ws_close() */
+  if (fcntl(c->fd, F_GETFD) >= 0) { epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL); sockbuf_drop(c->fd); close(c->fd); }
+  conns[c->fd] = NULL;
+  free(c->buf); free(c);
+}
+
+// Consume complete handshakes/frames from c->buf.  Returns 0 when the
+// connection must be dropped.
+static int ws_run_process(NetServer *srv, NetConn *c) {
+  size_t off = 0;
+  if (!c->open) {
+    c->buf[c->len] = '\0';
+    char *end = strstr((char *)c->buf, "\r\n\r\n");
+    if (!end) return c->len < WS_RUN_MAX_HANDSHAKE;
+    char response[512]; int deflate;
+    int rlen = ws_handshake_reply((char *)c->buf, response, sizeof(response), &deflate);
+    if (rlen < 0 || io_send(c->fd, response, (size_t)rlen) < 0) return 0;
+    c->open = 1;
+    ws_set_server(c->fd, deflate);
+    off = (size_t)(end + 4 - (char *)c->buf);
+    ws_run_event(srv, c, NULL, "open");
+  }
+  SockBuf *b = sockbuf_get(c->fd, 1);
+  if (!b->ws_msg) b->ws_msg = (WsMsg *)calloc(1, sizeof(WsMsg));
+  for (;;) {
+    WsFrame f;
+    size_t total = ws_parse_frame(c->buf + off, c->len - off, &f);
+    if (!total) {
+      if (f.plen > WS_MAX_MESSAGE) { ws_send_close(c->fd, 1009); return 0; }
+      break;
+    }
+    unsigned char *payload = c->buf + off + f.hlen;
+    off += total;
+    if (f.opcode >= 0x8) {
+      if (!f.fin || f.plen > 125) { ws_send_close(c->fd, 1002); return 0; }
+      if (f.masked) ws_mask(payload, payload, (size_t)f.plen, payload - 4, 0);
+      if (!ws_control(c->fd, &f, payload)) return 0;
+      continue;
+    }
+    int rc = f.opcode <= 0x2 ? ws_msg_feed(b->ws_msg, &f, payload, b->ws_deflate) : 1002;
+    if (rc > 1) { ws_send_close(c->fd, rc); return 0; }
+    if (!rc) continue;
+    size_t len; int binary;
+    char *msg = ws_msg_take(b->ws_msg, &len, &binary);
+    if (!msg) { ws_send_close(c->fd, 1007); return 0; }
+    ws_run_event(srv, c, stola_new_string_owned(msg), binary ? "binary" : "message");
+    if (fcntl(c->fd, F_GETFD) < 0) return 0; /* closed by the handler */
+  }
+  if (off) { memmove(c->buf, c->buf + off, c->len - off); c->len -= off; }
+  return 1;
+}
+
+static void *net_worker(void *p) {
+  NetWorker *w = (NetWorker *)p;
+  NetServer *srv = w->srv;
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event ev;
+  ev.events = EPOLLIN; ev.data.fd = srv->stop_fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, srv->stop_fd, &ev);
+#ifdef EPOLLEXCLUSIVE
+  ev.events = EPOLLIN | (w->listen_fd == srv->shared_fd ? EPOLLEXCLUSIVE : 0);
+#else
+  ev.events = EPOLLIN;
+#endif
+  ev.data.fd = w->listen_fd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, w->listen_fd, &ev);
+  int cap = 1024;
+  NetConn **conns = (NetConn **)calloc((size_t)cap, sizeof(NetConn *));
+  struct epoll_event evs[256];
+  for (;;) {
+    int n = epoll_wait(epfd, evs, 256, -1);
+    if (n < 0 && errno != EINTR) break;
+    int stop = 0;
+    for (int i = 0; i < n; i++) {
+      int fd = evs[i].data.fd;
+      if (fd == srv->stop_fd) { stop = 1; break; }
+      if (fd == w->listen_fd) {
+        int cfd;
+        while ((cfd = accept4(w->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          if (cfd >= cap) {
+            int ncap = cap; while (ncap <= cfd) ncap *= 2;
+            conns = (NetConn **)realloc(conns, sizeof(NetConn *) * (size_t)ncap);
+            memset(conns + cap, 0, sizeof(NetConn *) * (size_t)(ncap - cap));
+            cap = ncap;
+          }
+          NetConn *c = (NetConn *)calloc(1, sizeof(NetConn));
+          c->fd = cfd; c->cap = 4096; c->buf = (unsigned char *)malloc(c->cap + 1);
+          c->handle = stola_new_int((int64_t)cfd);
+          conns[cfd] = c;
+          struct epoll_event cev; cev.events = EPOLLIN | EPOLLRDHUP; cev.data.fd = cfd;
+          epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev);
+        }
+        continue;
+      }
+      NetConn *c = fd < cap ? conns[fd] : NULL;
+      if (!c) continue;
+      int alive = 1;
+      for (;;) {
+        if (c->len == c->cap) { c->cap *= 2; c->buf = (unsigned char *)realloc(c->buf, c->cap + 1); }
+        ssize_t r = recv(fd, c->buf + c->len, c->cap - c->len, 0);
+        if (r > 0) { c->len += (size_t)r; continue; }
+        if (r < 0 && errno == EINTR) continue;
+        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) alive = 0;
+        break;
+      }
+      if (!srv->process(srv, c) || !alive) net_drop(srv, epfd, conns, c, 1);
+    }
+    if (stop) break;
+  }
+  for (int fd = 0; fd < cap; fd++)
+    if (conns[fd]) net_drop(srv, epfd, conns, conns[fd], 1);
+  free(conns);
+  close(epfd);
+  if (w->listen_fd != srv->shared_fd) close(w->listen_fd);
+  return NULL;
+}
+
+// Open listeners for nw workers (<= 0: one per core), register srv and
+// start workers[first..] on their own threads.  Returns the worker count,
+// 0 when the port cannot be bound.
+static int net_server_start(NetServer *srv, int nw, int first) {
+  if (nw <= 0) nw = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (nw <= 0) nw = 1;
+  srv->shared_fd = -1;
+  srv->workers = (NetWorker *)calloc((size_t)nw, sizeof(NetWorker));
+  for (int i = 0; i < nw; i++) {
+    srv->workers[i].srv = srv;
+    srv->workers[i].listen_fd = srv->shared_fd >= 0 ? srv->shared_fd : net_listen(srv->port, 1);
+    if (srv->workers[i].listen_fd < 0 && i == 0) {
+      /* no SO_REUSEPORT: every worker shares one listener */
+      srv->shared_fd = srv->workers[i].listen_fd = net_listen(srv->port, 0);
+    }
+    if (srv->workers[i].listen_fd < 0) { nw = i; break; }
+  }
+  if (nw == 0) { free(srv->workers); srv->workers = NULL; return 0; }
+  srv->nworkers = nw;
+  srv->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  pthread_mutex_lock(&net_lock);
+  srv->next = net_servers; net_servers = srv;
+  pthread_mutex_unlock(&net_lock);
+  for (int i = first; i < nw; i++) pthread_create(&srv->workers[i].tid, NULL, net_worker, &srv->workers[i]);
+  return nw;
+}
+
+// Join workers[first..] (after stop_fd fired), unregister and release srv's
+// descriptors.
+static void net_server_finish(NetServer *srv, int first) {
+  for (int i = first; i < srv->nworkers; i++) pthread_join(srv->workers[i].tid, NULL);
+  pthread_mutex_lock(&net_lock);
+  for (NetServer **pp = &net_servers; *pp; pp = &(*pp)->next)
+    if (*pp == srv) { *pp = srv->next; break; }
+  pthread_mutex_unlock(&net_lock);
+  if (srv->shared_fd >= 0) close(srv->shared_fd);
+  close(srv->stop_fd);
+  free(srv->workers);
+}
+
+static int net_server_signal(int port, int background) {
+  int found = 0;
+  pthread_mutex_lock(&net_lock);
+  for (NetServer *srv = net_servers; srv; srv = srv->next)
+    if (srv->port == port && srv->background == background) {
+      uint64_t one = 1;
+      if (write(srv->stop_fd, &one, sizeof(one)) == sizeof(one)) found = 1;
+    }
+  pthread_mutex_unlock(&net_lock);
+  return found;
+}
+
+StolaValue *stola_ws_server_run(StolaValue *port_val, void *handler, StolaValue *workers_val) {
+  if (!port_val||port_val->type!=STOLA_INT||!handler) return stola_new_bool(0);
+  int nw = (workers_val && workers_val->type == STOLA_INT) ? (int)workers_val->as.int_val : 0;
+  NetServer srv; memset(&srv, 0, sizeof(srv));
+  srv.port = (int)port_val->as.int_val; srv.handler = (CoroFunc)handler;
+  srv.process = ws_run_process;
+  if (!net_server_start(&srv, nw, 1)) return stola_new_bool(0);
+  net_worker(&srv.workers[0]);
+  net_server_finish(&srv, 1);
+  return stola_new_bool(1);
+}
+
+StolaValue *stola_ws_server_stop(StolaValue *port_val) {
+  if (!port_val||port_val->type!=STOLA_INT) return stola_new_bool(0);
+  return stola_new_bool(net_server_signal((int)port_val->as.int_val, 0));
+}
+
+// ── HTTP server ──────────────────────────────────────────────────────────────
+// http_server_create(port, handler) -> port, or -1 when it cannot listen.
+// Starts one worker per core in the background (same epoll/SO_REUSEPORT
+// machinery as ws_server_run) and returns immediately; handler(req) runs on
+// the worker that owns the connection.  Keep-alive and pipelined requests
+// are served from the connection buffer, and {file: path} responses go out
+// with sendfile(2).  http_server_stop(port) shuts it down.
+
+static int httpd_open_file(const char *path, int64_t *size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) { close(fd); return -1; }
+  *size = (int64_t)st.st_size;
+  return fd;
+}
+
+static int httpd_sendfile(int sock, int fd, int64_t size) {
+  off_t pos = 0;
+  while ((int64_t)pos < size) {
+    ssize_t r = sendfile(sock, fd, &pos, (size_t)(size - (int64_t)pos));
+    if (r > 0) continue;
+    if (r == 0) return -1; /* file shrank under us */
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      if (coro_sched.current) coro_wait_fd(sock, EPOLLOUT);
+      else { struct pollfd pf = {sock, POLLOUT, 0}; poll(&pf, 1, -1); }
+      continue;
+    }
+    if (errno != EINVAL && errno != ENOSYS) return -1;
+    char chunk[65536]; /* fd type without sendfile support */
+    ssize_t n;
+    while ((n = pread(fd, chunk, sizeof(chunk), pos)) > 0) {
+      if (io_send(sock, chunk, (size_t)n) < 0) return -1;
+      pos += n;
+    }
+    return (int64_t)pos == size ? 0 : -1;
+  }
+  return 0;
+}
+
+static int http_run_process(NetServer *srv, NetConn *c) {
+  size_t off = 0;
+  for (;;) {
+    size_t used = 0; int ffd = -1, keep = 1; int64_t fsize = 0;
+    int rc = httpd_serve(srv->handler, (char *)c->buf + off, c->len - off, &used, &ffd, &fsize, &keep);
+    off += used;
+    if (httpd_out.len) {
+      if (io_send(c->fd, httpd_out.data, httpd_out.len) < 0) keep = rc = 0;
+      httpd_out.len = 0;
+    }
+    if (ffd >= 0) {
+      if (rc && fsize > 0 && httpd_sendfile(c->fd, ffd, fsize) < 0) keep = rc = 0;
+      close(ffd);
+    }
+    if (!rc || !keep) return 0;
+    if (rc != 2) break;
+  }
+  if (off) { memmove(c->buf, c->buf + off, c->len - off); c->len -= off; }
+  return 1;
+}
+
+StolaValue *stola_http_server_create(StolaValue *port_val, void *handler) {
+  if (!port_val||port_val->type!=STOLA_INT||!handler) return stola_new_int(-1);
+  NetServer *srv = (NetServer *)calloc(1, sizeof(NetServer));
+  srv->port = (int)port_val->as.int_val; srv->handler = (CoroFunc)handler;
+  srv->process = http_run_process; srv->background = 1;
+  if (!net_server_start(srv, 0, 0)) { free(srv); return stola_new_int(-1); }
+  return stola_new_int((int64_t)srv->port);
+}
+
+StolaValue *stola_http_server_stop(StolaValue *port_val) {
+  if (!port_val||port_val->type!=STOLA_INT) return stola_new_bool(0);
+  int port = (int)port_val->as.int_val;
+  NetServer *srv = NULL;
+  pthread_mutex_lock(&net_lock);
+  for (NetServer **pp = &net_servers; *pp; pp = &(*pp)->next)
+    if ((*pp)->port == port && (*pp)->background) { srv = *pp; *pp = srv->next; break; }
+  pthread_mutex_unlock(&net_lock);
+  if (!srv) return stola_new_bool(0);
+  uint64_t one = 1;
+  if (write(srv->stop_fd, &one, sizeof(one)) != sizeof(one)) return stola_new_bool(0);
+  net_server_finish(srv, 0);
+  free(srv);
+  return stola_new_bool(1);
+}
+
 // ── I/O Multiplexing ─────────────────────────────────────────────────────────
 // stola_ws_select(handles: array<int>, timeout_ms: int) -> array<int>
 // Returns the subset of socket handles that have data ready to read.
 // timeout_ms < 0 → block; timeout_ms == 0 → non-blocking poll.
-#include <sys/select.h>
+// Built on poll(), so fds above FD_SETSIZE (1024) are fine.  Long-lived
+// sets should use the poller below instead of rebuilding this every call.
 StolaValue *stola_ws_select(StolaValue *handles, StolaValue *timeout_ms_val) {
   StolaValue *result = stola_new_array();
   if (!handles || handles->type != STOLA_ARRAY) return result;
-  int64_t timeout_ms = (timeout_ms_val && timeout_ms_val->type == STOLA_INT)
-                       ? timeout_ms_val->as.int_val : -1;
-  fd_set rfds;
-  FD_ZERO(&rfds);
-  int nfds = 0;
-  int count = (int)handles->as.array_val.count;
+  int timeout_ms = (timeout_ms_val && timeout_ms_val->type == STOLA_INT)
+                   ? (int)timeout_ms_val->as.int_val : -1;
+  int count = (int)handles->as.array_val.count, n = 0;
+  struct pollfd stack_pfds[64];
+  struct pollfd *pfds = count <= 64 ? stack_pfds : (struct pollfd *)malloc(sizeof(struct pollfd) * count);
   for (int i = 0; i < count; i++) {
     StolaValue *h = handles->as.array_val.items[i];
     if (h && h->type == STOLA_INT) {
-      int fd = (int)h->as.int_val;
-      FD_SET(fd, &rfds);
-      if (fd + 1 > nfds) nfds = fd + 1;
+      pfds[n].fd = (int)h->as.int_val; pfds[n].events = POLLIN; pfds[n].revents = 0; n++;
     }
   }
-  struct timeval tv, *tvp = NULL;
-  if (timeout_ms >= 0) {
-    tv.tv_sec  = (long)(timeout_ms / 1000);
-    tv.tv_usec = (long)((timeout_ms % 1000) * 1000);
-    tvp = &tv;
+  if (poll(pfds, (nfds_t)n, timeout_ms) > 0) {
+    for (int i = 0; i < n; i++)
+      if (pfds[i].revents & (POLLIN | POLLHUP | POLLERR))
+        stola_push(result, stola_new_int((int64_t)pfds[i].fd));
   }
-  int r = select(nfds, &rfds, NULL, NULL, tvp);
-  if (r <= 0) return result;
-  for (int i = 0; i < count; i++) {
-    StolaValue *h = handles->as.array_val.items[i];
-    if (h && h->type == STOLA_INT) {
-      int fd = (int)h->as.int_val;
-      if (FD_ISSET(fd, &rfds))
-        stola_push(result, stola_new_int((int64_t)fd));
-    }
+  if (pfds != stack_pfds) free(pfds);
+  return result;
+}
+
+// ── Persistent poller (epoll) ────────────────────────────────────────────────
+// poller_create() / poller_add(p, fd, events) / poller_remove(p, fd) /
+// poller_wait(p, timeout_ms) -> array<int> / poller_close(p)
+// events: 1 = readable, 2 = writable, 4 = edge-triggered (EPOLLET; the
+// caller must then drain the fd until it would block).  The interest set
+// lives in the kernel, so a wait costs O(ready fds), not O(registered fds).
+// Closing an fd drops it from the set without poller_remove, so the poller
+// keeps no count of its own: the event buffer grows when a wait fills it.
+#define POLLER_READ  1
+#define POLLER_WRITE 2
+#define POLLER_EDGE  4
+
+#define POLLER_BATCH_MIN 64
+#define POLLER_BATCH_MAX 4096
+
+typedef struct { int epfd; struct epoll_event *evs; int cap; } StolaPoller;
+
+static uint32_t poller_events(StolaValue *events) {
+  int ev = (events && events->type == STOLA_INT) ? (int)events->as.int_val : POLLER_READ;
+  return ((ev & POLLER_READ) ? (EPOLLIN | EPOLLRDHUP) : 0) | ((ev & POLLER_WRITE) ? EPOLLOUT : 0)
+       | ((ev & POLLER_EDGE) ? EPOLLET : 0);
+}
+
+StolaValue *stola_poller_create(void) {
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0) return stola_new_int(-1);
+  StolaPoller *p = (StolaPoller *)calloc(1, sizeof(StolaPoller));
+  p->epfd = epfd;
+  return stola_new_int((int64_t)(uintptr_t)p);
+}
+
+StolaValue *stola_poller_add(StolaValue *pv, StolaValue *fd, StolaValue *events) {
+  if (!pv || pv->type != STOLA_INT || pv->as.int_val <= 0 || !fd || fd->type != STOLA_INT) return stola_new_bool(0);
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  struct epoll_event ev; ev.events = poller_events(events); ev.data.fd = (int)fd->as.int_val;
+  if (epoll_ctl(p->epfd, EPOLL_CTL_ADD, ev.data.fd, &ev) == 0) return stola_new_bool(1);
+  if (errno == EEXIST && epoll_ctl(p->epfd, EPOLL_CTL_MOD, ev.data.fd, &ev) == 0) return stola_new_bool(1);
+  return stola_new_bool(0);
+}
+
+StolaValue *stola_poller_remove(StolaValue *pv, StolaValue *fd) {
+  if (!pv || pv->type != STOLA_INT || pv->as.int_val <= 0 || !fd || fd->type != STOLA_INT) return stola_new_bool(0);
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  return stola_new_bool(epoll_ctl(p->epfd, EPOLL_CTL_DEL, (int)fd->as.int_val, NULL) == 0);
+}
+
+StolaValue *stola_poller_wait(StolaValue *pv, StolaValue *timeout_ms_val) {
+  StolaValue *result = stola_new_array();
+  if (!pv || pv->type != STOLA_INT || pv->as.int_val <= 0) return result;
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  int timeout_ms = (timeout_ms_val && timeout_ms_val->type == STOLA_INT)
+                   ? (int)timeout_ms_val->as.int_val : -1;
+  if (!p->evs) {
+    p->cap = POLLER_BATCH_MIN;
+    p->evs = (struct epoll_event *)malloc(sizeof(struct epoll_event) * p->cap);
+  }
+  /* Inside a coroutine an infinite wait parks on the epoll fd itself */
+  if (timeout_ms < 0 && coro_sched.current) { coro_wait_fd(p->epfd, EPOLLIN); timeout_ms = 0; }
+  int n = epoll_wait(p->epfd, p->evs, p->cap, timeout_ms);
+  for (int i = 0; i < n; i++) stola_push(result, stola_new_int((int64_t)p->evs[i].data.fd));
+  /* A full batch means more fds may be ready: take more next time */
+  if (n == p->cap && p->cap < POLLER_BATCH_MAX) {
+    p->cap *= 2;
+    p->evs = (struct epoll_event *)realloc(p->evs, sizeof(struct epoll_event) * p->cap);
   }
   return result;
 }
 
+StolaValue *stola_poller_close(StolaValue *pv) {
+  if (!pv || pv->type != STOLA_INT || pv->as.int_val <= 0) return stola_new_null();
+  StolaPoller *p = (StolaPoller *)(uintptr_t)pv->as.int_val;
+  close(p->epfd); free(p->evs); free(p);
+  return stola_new_null();
+}
+
 #endif
@@ -1,8 +1,24 @@
 #define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L /* sysconf */
+#endif
 #include "codegen.h"
+#include "peephole.h"
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#include <process.h>
+#include <stdint.h>
+/* <windows.h> clashes with token.h (TokenType); declare what we use */
+extern unsigned long __stdcall WaitForSingleObject(void *, unsigned long);
+extern int __stdcall CloseHandle(void *);
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 // ============================================================
 // Code Generator for StolasScript — x64 Assembly, Intel syntax
@@ -26,21 +42,266 @@
   #define stola_strdup strdup
 #endif
 
-static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
-                          int is_freestanding);
+// ============================================================
+// Code generation units
+// main and every function / method body is one unit. Units are
+// generated independently (possibly on worker threads) into their
+// own buffer, then concatenated in program order. Labels and string
+// literals are named per unit (.L<unit>_<n>, .str<unit>_<n>) so the
+// output does not depend on scheduling. Module output (see
+// codegen_generate_module) adds a per-module prefix, so its text can be
+// appended to any program.
+// ============================================================
 
-static int label_counter = 0;
-static int string_counter = 0;
+#if defined(_MSC_VER)
+  #define CG_THREAD_LOCAL __declspec(thread)
+#else
+  #define CG_THREAD_LOCAL _Thread_local
+#endif
 
 typedef struct {
-  char *value;
+  const char *value;
   int label_id;
 } StringEntry;
-static StringEntry string_table[512];
-static int string_table_count = 0;
+
+typedef struct {
+  ASTNode *decl;        /* function/method declaration, NULL for main */
+  char *text;           /* generated assembly */
+  size_t length;
+  StringEntry *strings; /* literal pool, emitted into .data */
+  int string_count;
+  int string_capacity;
+} CodegenUnit;
+
+static const char *label_prefix = ""; /* set before the workers start */
+static CG_THREAD_LOCAL CodegenUnit *current_unit;
+static CG_THREAD_LOCAL char unit_tag[80]; /* <prefix><unit>_ */
+static CG_THREAD_LOCAL int label_counter;
 
 static int get_label(void) { return label_counter++; }
 
+// Static stack alignment. stack_align is RSP % 16 at the point being
+// generated, or -1 where it is not known (interrupt handlers, freestanding
+// code) and emit_call realigns at run time. Pushes and pops go through
+// emit_push/emit_pop to keep it in step. Jumps and labels only occur between
+// statements, where RSP is back at frame_align; a unit that breaks that, or
+// that contains an asm block, is generated again with run-time alignment.
+static CG_THREAD_LOCAL int stack_align = -1;
+static CG_THREAD_LOCAL int frame_align = -1;
+static CG_THREAD_LOCAL int align_failed;   /* regenerate this unit */
+static CG_THREAD_LOCAL int align_disabled; /* second attempt: always -1 */
+
+/* RSP moved down by `bytes` */
+static void stack_moved(int bytes) {
+  if (stack_align >= 0)
+    stack_align = (stack_align - bytes) & 15;
+}
+
+/* A jump or label: control arrives from elsewhere at frame_align */
+static void stack_join(void) {
+  if (stack_align != frame_align)
+    align_failed = 1;
+}
+
+/* RSP % 16 right after the prologue of a frame entered by a call */
+static void frame_enter(int is_known) {
+  stack_align = is_known && !align_disabled ? 8 : -1;
+}
+
+// ============================================================
+// Emitter
+// Assembly text is appended to a growable buffer. Fixed instructions
+// are copied with their length known at compile time (emit_lit), and
+// the operand shapes codegen uses most have helpers that format
+// without printf. Each unit is generated into its own buffer, and the
+// whole program goes to the output file with a single fwrite.
+// ============================================================
+
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+} Emitter;
+
+static void emit_reserve(Emitter *e, size_t extra) {
+  if (e->size + extra <= e->capacity)
+    return;
+  size_t cap = e->capacity ? e->capacity : 4096;
+  while (cap < e->size + extra)
+    cap *= 2;
+  e->data = realloc(e->data, cap);
+  e->capacity = cap;
+}
+
+static void emit_raw(Emitter *e, const char *s, size_t n) {
+  emit_reserve(e, n);
+  memcpy(e->data + e->size, s, n);
+  e->size += n;
+}
+
+static void emit_str(Emitter *e, const char *s) { emit_raw(e, s, strlen(s)); }
+
+/* Fixed text; `s` must be a string literal */
+#define emit_lit(e, s) emit_raw((e), s, sizeof(s) - 1)
+
+static void emit_int(Emitter *e, long long v) {
+  char buf[24];
+  int n = 0;
+  unsigned long long u = v < 0 ? 0ull - (unsigned long long)v : (unsigned long long)v;
+  do {
+    buf[sizeof(buf) - 1 - n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+  if (v < 0)
+    buf[sizeof(buf) - 1 - n++] = '-';
+  emit_raw(e, buf + sizeof(buf) - n, n);
+}
+
+/* Anything else (headers, rare instruction shapes) */
+static void emit_fmt(Emitter *e, const char *fmt, ...) {
+  va_list ap;
+  emit_reserve(e, 256);
+  va_start(ap, fmt);
+  int n = vsnprintf(e->data + e->size, e->capacity - e->size, fmt, ap);
+  va_end(ap);
+  if (n < 0)
+    return;
+  if ((size_t)n >= e->capacity - e->size) {
+    emit_reserve(e, (size_t)n + 1);
+    va_start(ap, fmt);
+    vsnprintf(e->data + e->size, e->capacity - e->size, fmt, ap);
+    va_end(ap);
+  }
+  e->size += (size_t)n;
+}
+
+/* "    op a\n" */
+static void emit_op(Emitter *e, const char *op, const char *a) {
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " ");
+  emit_str(e, a);
+  emit_lit(e, "\n");
+}
+
+/* "    op imm\n" */
+static void emit_op_imm(Emitter *e, const char *op, long long imm) {
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " ");
+  emit_int(e, imm);
+  emit_lit(e, "\n");
+}
+
+/* "    push <s>\n" / "    pop <s>\n"; `s` must be a string literal */
+#define emit_push(e, s) (emit_lit((e), "    push " s "\n"), stack_moved(8))
+#define emit_pop(e, s) (emit_lit((e), "    pop " s "\n"), stack_moved(-8))
+
+static void emit_push_str(Emitter *e, const char *operand) {
+  emit_op(e, "push", operand);
+  stack_moved(8);
+}
+
+static void emit_pop_str(Emitter *e, const char *operand) {
+  emit_op(e, "pop", operand);
+  stack_moved(-8);
+}
+
+/* "    op dst, src\n" */
+static void emit_op_reg_reg(Emitter *e, const char *op, const char *dst,
+                            const char *src) {
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " ");
+  emit_str(e, dst);
+  emit_lit(e, ", ");
+  emit_str(e, src);
+  emit_lit(e, "\n");
+}
+
+/* "    op reg, imm\n" */
+static void emit_op_reg_imm(Emitter *e, const char *op, const char *reg,
+                            long long imm) {
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " ");
+  emit_str(e, reg);
+  emit_lit(e, ", ");
+  emit_int(e, imm);
+  emit_lit(e, "\n");
+}
+
+/* "[base + disp]" / "[base - disp]" / "[base]" */
+static void emit_mem(Emitter *e, const char *base, int disp) {
+  emit_lit(e, "[");
+  emit_str(e, base);
+  if (disp > 0) {
+    emit_lit(e, " + ");
+    emit_int(e, disp);
+  } else if (disp < 0) {
+    emit_lit(e, " - ");
+    emit_int(e, -(long long)disp);
+  }
+  emit_lit(e, "]");
+}
+
+/* "    op reg, [base +/- disp]\n" */
+static void emit_op_reg_mem(Emitter *e, const char *op, const char *reg,
+                            const char *base, int disp) {
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " ");
+  emit_str(e, reg);
+  emit_lit(e, ", ");
+  emit_mem(e, base, disp);
+  emit_lit(e, "\n");
+}
+
+/* "    op [base +/- disp], reg\n" */
+static void emit_op_mem_reg(Emitter *e, const char *op, const char *base,
+                            int disp, const char *reg) {
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " ");
+  emit_mem(e, base, disp);
+  emit_lit(e, ", ");
+  emit_str(e, reg);
+  emit_lit(e, "\n");
+}
+
+/* ".L<unit>_<n>:\n" */
+static void emit_label(Emitter *e, int label) {
+  stack_join();
+  emit_lit(e, ".L");
+  emit_str(e, unit_tag);
+  emit_int(e, label);
+  emit_lit(e, ":\n");
+}
+
+/* "    jmp .L<unit>_<n>\n" (or any jcc) */
+static void emit_jump(Emitter *e, const char *op, int label) {
+  stack_join();
+  emit_lit(e, "    ");
+  emit_str(e, op);
+  emit_lit(e, " .L");
+  emit_str(e, unit_tag);
+  emit_int(e, label);
+  emit_lit(e, "\n");
+}
+
+/* "    lea reg, [rip + .str<unit>_<id>]\n" */
+static void emit_lea_str(Emitter *e, const char *reg, int id) {
+  emit_lit(e, "    lea ");
+  emit_str(e, reg);
+  emit_lit(e, ", [rip + .str");
+  emit_str(e, unit_tag);
+  emit_int(e, id);
+  emit_lit(e, "]\n");
+}
+
+static void generate_node(ASTNode *node, Emitter *out, SemanticAnalyzer *analyzer,
+                          int is_freestanding);
+
 /* Forward declaration — defined further below */
 static int get_var_offset(const char *name);
 
@@ -70,13 +331,18 @@ typedef struct {
   int    regs_used;  /* number of callee-saved regs currently live */
 } RegAlloc;
 
-static RegAlloc func_regalloc;
-static int      current_epilogue_label = -1; /* label id for function exit */
+static CG_THREAD_LOCAL RegAlloc func_regalloc;
+static CG_THREAD_LOCAL int      current_epilogue_label = -1; /* label id for function exit */
 
 /* --- Internal: record one variable in the allocator --- */
 static void ra_add(const char *name);
 static void ra_collect(ASTNode *node);
 
+/* Hidden local holding a for-in loop's iterator (unique per loop node) */
+static void for_iter_name(ASTNode *node, char *buf, size_t size) {
+  snprintf(buf, size, "__for_%d", node->as.for_stmt.id);
+}
+
 static void ra_add(const char *name) {
   if (!name || func_regalloc.count >= REGALLOC_MAX_VARS) return;
   for (int i = 0; i < func_regalloc.count; i++)
@@ -111,6 +377,15 @@ static void ra_collect(ASTNode *node) {
     if (node->as.loop_stmt.step_expr) ra_collect(node->as.loop_stmt.step_expr);
     ra_collect(node->as.loop_stmt.body);
     break;
+  case AST_FOR_STMT: {
+    char hidden[64];
+    for_iter_name(node, hidden, sizeof(hidden));
+    ra_add(node->as.for_stmt.iterator_name);
+    ra_add(hidden);
+    ra_collect(node->as.for_stmt.iterable);
+    ra_collect(node->as.for_stmt.body);
+    break;
+  }
   case AST_BLOCK:
     for (int i = 0; i < node->as.block.statement_count; i++)
       ra_collect(node->as.block.statements[i]);
@@ -175,46 +450,52 @@ static int ra_get_offset(const char *name) {
 }
 
 /* Emit: push the value of a named variable onto the stack */
-static void ra_push_var(FILE *out, const char *name) {
+static void ra_push_var(Emitter *out, const char *name) {
   const char *reg = ra_get_reg(name);
   if (reg) {
-    fprintf(out, "    push %s\n", reg);
+    emit_push_str(out, reg);
   } else {
-    fprintf(out, "    mov rax, [rbp - %d]\n", ra_get_offset(name));
-    fprintf(out, "    push rax\n");
+    emit_op_reg_mem(out, "mov", "rax", "rbp", -ra_get_offset(name));
+    emit_push(out, "rax");
   }
 }
 
 /* Emit: store rax into a named variable */
-static void ra_store_var(FILE *out, const char *name) {
+static void ra_store_var(Emitter *out, const char *name) {
   const char *reg = ra_get_reg(name);
   if (reg) {
-    fprintf(out, "    mov %s, rax\n", reg);
+    emit_op_reg_reg(out, "mov", reg, "rax");
   } else {
-    fprintf(out, "    mov [rbp - %d], rax\n", ra_get_offset(name));
+    emit_op_mem_reg(out, "mov", "rbp", -ra_get_offset(name), "rax");
   }
 }
 
 /* Emit push/pop of callee-saved regs used by the current function */
-static void ra_save_regs(FILE *out) {
+static void ra_save_regs(Emitter *out) {
   for (int i = 0; i < func_regalloc.regs_used; i++)
-    fprintf(out, "    push %s\n", callee_saved_regs[i]);
+    emit_push_str(out, callee_saved_regs[i]);
 }
 
-static void ra_restore_regs(FILE *out) {
+static void ra_restore_regs(Emitter *out) {
   for (int i = func_regalloc.regs_used - 1; i >= 0; i--)
-    fprintf(out, "    pop %s\n", callee_saved_regs[i]);
+    emit_op(out, "pop", callee_saved_regs[i]);
 }
 
+// Literals live in the AST (compile arena) until codegen is done, so the
+// pool only keeps pointers.
 static int add_string_literal(const char *value) {
-  for (int i = 0; i < string_table_count; i++) {
-    if (strcmp(string_table[i].value, value) == 0)
-      return string_table[i].label_id;
+  CodegenUnit *u = current_unit;
+  for (int i = 0; i < u->string_count; i++) {
+    if (strcmp(u->strings[i].value, value) == 0)
+      return u->strings[i].label_id;
+  }
+  if (u->string_count == u->string_capacity) {
+    u->string_capacity = u->string_capacity ? u->string_capacity * 2 : 16;
+    u->strings = realloc(u->strings, u->string_capacity * sizeof(StringEntry));
   }
-  int id = string_counter++;
-  string_table[string_table_count].value = stola_strdup(value);
-  string_table[string_table_count].label_id = id;
-  string_table_count++;
+  int id = u->string_count++;
+  u->strings[id].value = value;
+  u->strings[id].label_id = id;
   return id;
 }
 
@@ -228,7 +509,11 @@ static int get_var_offset(const char *name) {
   return (hash + 1) * 8;
 }
 
-// Emit a platform-aware ABI call: align stack, call, restore.
+// Emit a platform-aware ABI call. Where stack_align is known the call only
+// needs RSP padded down to the boundary (plus the shadow space on Windows):
+//   call func                      ; RSP % 16 == 0 already
+//   sub rsp, 8 / call func / add rsp, 8
+// Otherwise the stack is aligned at run time as below.
 //
 // SysV AMD64 ABI requirement: RSP must be 16-byte aligned BEFORE the call
 // instruction (so that at function entry RSP % 16 == 8, after call pushes
@@ -252,25 +537,51 @@ static int get_var_offset(const char *name) {
 //
 // After 'ret', rsp is restored by the callee's ret, so [rsp+8] is still the
 // slot we wrote above.
-static void emit_call(FILE *out, const char *func_name) {
-  fprintf(out, "    mov r10, rsp\n");
-  fprintf(out, "    and rsp, -16\n");
+//
+// The fixed parts of the sequence are copied as two literals around the
+// callee's name. peephole.c matches this exact sequence, and the padding
+// above, to share one alignment between back-to-back calls; keep them in
+// step.
+static void emit_call(Emitter *out, const char *func_name) {
+  if (stack_align >= 0) {
+#ifdef _WIN32
+    int pad = 32 + stack_align;
+#else
+    int pad = stack_align;
+#endif
+    if (pad)
+      emit_op_reg_imm(out, "sub", "rsp", pad);
+    emit_lit(out, "    call ");
+    emit_str(out, func_name);
+    emit_lit(out, "\n");
+    if (pad)
+      emit_op_reg_imm(out, "add", "rsp", pad);
+    return;
+  }
 #ifdef _WIN32
   // Windows x64: 32-byte shadow space required + 8-byte RSP slot + 8 padding
   // to maintain 16-byte alignment = 48 bytes total.
-  fprintf(out, "    sub rsp, 48\n");
-  fprintf(out, "    mov [rsp + 40], r10\n");
-  fprintf(out, "    call %s\n", func_name);
-  fprintf(out, "    mov rsp, [rsp + 40]\n");
+  emit_lit(out, "    mov r10, rsp\n"
+                "    and rsp, -16\n"
+                "    sub rsp, 48\n"
+                "    mov [rsp + 40], r10\n"
+                "    call ");
+  emit_str(out, func_name);
+  emit_lit(out, "\n"
+                "    mov rsp, [rsp + 40]\n");
 #else
   // System V AMD64: no shadow space.
   // sub rsp,16 keeps alignment (16 % 16 == 0), opens a 16-byte slot.
   // Write saved-RSP at [rsp+8]; lowest 8 bytes ([rsp]) are padding.
   // At 'call', RSP % 16 == 0, so entry RSP % 16 == 8 ✓.
-  fprintf(out, "    sub rsp, 16\n");
-  fprintf(out, "    mov [rsp + 8], r10\n");
-  fprintf(out, "    call %s\n", func_name);
-  fprintf(out, "    mov rsp, [rsp + 8]\n");
+  emit_lit(out, "    mov r10, rsp\n"
+                "    and rsp, -16\n"
+                "    sub rsp, 16\n"
+                "    mov [rsp + 8], r10\n"
+                "    call ");
+  emit_str(out, func_name);
+  emit_lit(out, "\n"
+                "    mov rsp, [rsp + 8]\n");
 #endif
 }
 
@@ -340,37 +651,96 @@ static BuiltinEntry builtins[] = {
     {"socket_send", "stola_socket_send", 2},
     {"socket_receive", "stola_socket_receive", 1},
     {"socket_close", "stola_socket_close", 1},
+    {"socket_receive_some", "stola_socket_receive_some", 2},
+    {"socket_receive_exact", "stola_socket_receive_exact", 2},
+    {"socket_read_line", "stola_socket_read_line", 1},
+    {"socket_set_nonblocking", "stola_socket_set_nonblocking", 2},
+    {"dns_cache_flush", "stola_dns_cache_flush", 0},
+    {"dns_prewarm", "stola_dns_prewarm", 1},
+    {"dns_cache_stats", "stola_dns_cache_stats", 0},
+    {"dns_set_ttl", "stola_dns_set_ttl", 2},
     {"ws_connect", "stola_ws_connect", 1},
     {"ws_send", "stola_ws_send", 2},
     {"ws_receive", "stola_ws_receive", 1},
+    {"ws_send_binary", "stola_ws_send_binary", 2},
+    {"ws_broadcast", "stola_ws_broadcast", 2},
+    {"ws_receive_message", "stola_ws_receive_message", 1},
     {"ws_close", "stola_ws_close", 1},
     {"ws_server_create", "stola_ws_server_create", 1},
     {"ws_server_accept", "stola_ws_server_accept", 1},
     {"ws_server_close", "stola_ws_server_close", 1},
+    {"ws_server_run", "stola_ws_server_run", 3},
+    {"ws_server_stop", "stola_ws_server_stop", 1},
     {"ws_select", "stola_ws_select", 2},
+    {"poller_create", "stola_poller_create", 0},
+    {"poller_add", "stola_poller_add", 3},
+    {"poller_remove", "stola_poller_remove", 2},
+    {"poller_wait", "stola_poller_wait", 2},
+    {"poller_close", "stola_poller_close", 1},
     {"json_encode", "stola_json_encode", 1},
     {"json_decode", "stola_json_decode", 1},
+    {"json_parse_stream", "stola_json_parse_stream", 3},
+    {"json_lazy", "stola_json_lazy", 1},
     {"current_time", "stola_current_time", 0},
+    {"time_ms", "stola_time_ms", 0},
     {"sleep", "stola_sleep", 1},
     {"random", "stola_random", 0},
     {"floor", "stola_floor", 1},
     {"ceil", "stola_ceil", 1},
     {"round", "stola_round", 1},
     {"read_file", "stola_read_file", 1},
+    {"mmap_file", "stola_mmap_file", 1},
     {"write_file", "stola_write_file", 2},
     {"append_file", "stola_append_file", 2},
+    {"io_engine", "stola_io_engine", 0},
     {"file_exists", "stola_file_exists", 1},
+    {"delete_file", "stola_delete_file", 1},
+    {"file_open", "stola_file_open", 2},
+    {"file_read_line", "stola_file_read_line", 1},
+    {"file_read_chunk", "stola_file_read_chunk", 2},
+    {"file_write", "stola_file_write", 2},
+    {"file_flush", "stola_file_flush", 1},
+    {"file_close", "stola_file_close", 1},
+    {"lines", "stola_lines", 1},
     {"http_fetch", "stola_http_fetch", 1},
+    {"http_request", "stola_http_request", 4},
+    {"http_pipeline", "stola_http_pipeline", 1},
+    {"http_set_timeout", "stola_http_set_timeout", 1},
+    {"http_server_create", "stola_http_server_create", 2},
+    {"http_server_stop", "stola_http_server_stop", 1},
+    {"http_header", "stola_http_header", 2},
+    {"http_headers", "stola_http_headers", 1},
+    {"thread_spawn", "stola_thread_spawn", 2},
     {"thread_join", "stola_thread_join", 1},
     {"mutex_create", "stola_mutex_create", 0},
     {"mutex_lock", "stola_mutex_lock", 1},
     {"mutex_unlock", "stola_mutex_unlock", 1},
+    /* Coroutines (green threads) */
+    {"spawn", "stola_coro_spawn", 2},
+    {"yield", "stola_coro_yield", 0},
+    {"await", "stola_coro_await", 1},
     /* Raw memory access — non-freestanding hosted wrappers */
     {"memory_read",       "stola_memory_read",       1},
     {"memory_write",      "stola_memory_write",      2},
     {"memory_write_byte", "stola_memory_write_byte", 2},
     {NULL, NULL, 0}};
 
+// Builtins whose first argument names a user function: its code address is
+// passed (lea) instead of an evaluated StolaValue*.
+static const struct {
+  const char *name;
+  int arg; /* which argument is a StolasScript function */
+} fn_arg_builtins[] = {
+    {"thread_spawn", 0}, {"spawn", 0}, {"ws_server_run", 1},
+    {"http_server_create", 1}, {"json_parse_stream", 1}, {NULL, 0}};
+
+static int takes_fn_arg(const char *name, int arg) {
+  for (int i = 0; fn_arg_builtins[i].name; i++)
+    if (strcmp(fn_arg_builtins[i].name, name) == 0)
+      return fn_arg_builtins[i].arg == arg;
+  return 0;
+}
+
 static BuiltinEntry *find_builtin(const char *name) {
   for (int i = 0; builtins[i].stola_name; i++) {
     if (strcmp(builtins[i].stola_name, name) == 0)
@@ -379,87 +749,20 @@ static BuiltinEntry *find_builtin(const char *name) {
   return NULL;
 }
 
-void codegen_generate(ASTNode *program, SemanticAnalyzer *analyzer,
-                      const char *output_file, int is_freestanding) {
-  FILE *out = fopen(output_file, "w");
-  if (!out) {
-    printf("Error: Could not open output file %s\n", output_file);
-    return;
-  }
-
-  label_counter = 0;
-  string_counter = 0;
-  string_table_count = 0;
-  memset(&func_regalloc, 0, sizeof(func_regalloc));
-  current_epilogue_label = -1;
-
-  fprintf(out, ".intel_syntax noprefix\n");
-  fprintf(out, ".global main\n\n");
-
-  // Declare all external runtime functions (skip in freestanding)
-  if (!is_freestanding) {
-    for (int i = 0; builtins[i].stola_name; i++) {
-      fprintf(out, ".extern %s\n", builtins[i].c_name);
-    }
-    fprintf(out, ".extern stola_thread_spawn\n");
-    fprintf(out, ".extern stola_register_method\n");
-    fprintf(out, ".extern stola_invoke_method\n");
-    fprintf(out, ".extern stola_load_dll\n");
-    fprintf(out, ".extern stola_bind_c_function\n");
-    fprintf(out, ".extern stola_invoke_c_function\n");
-    fprintf(out, ".extern stola_new_int\n");
-    fprintf(out, ".extern stola_new_bool\n");
-    fprintf(out, ".extern stola_new_string\n");
-    fprintf(out, ".extern stola_new_null\n");
-    fprintf(out, ".extern stola_new_array\n");
-    fprintf(out, ".extern stola_new_dict\n");
-    fprintf(out, ".extern stola_new_struct\n");
-    fprintf(out, ".extern stola_is_truthy\n");
-    fprintf(out, ".extern stola_add\n");
-    fprintf(out, ".extern stola_sub\n");
-    fprintf(out, ".extern stola_mul\n");
-    fprintf(out, ".extern stola_div\n");
-    fprintf(out, ".extern stola_mod\n");
-    fprintf(out, ".extern stola_neg\n");
-    fprintf(out, ".extern stola_eq\n");
-    fprintf(out, ".extern stola_neq\n");
-    fprintf(out, ".extern stola_lt\n");
-    fprintf(out, ".extern stola_gt\n");
-    fprintf(out, ".extern stola_le\n");
-    fprintf(out, ".extern stola_ge\n");
-    fprintf(out, ".extern stola_and\n");
-    fprintf(out, ".extern stola_or\n");
-    fprintf(out, ".extern stola_not\n");
-    fprintf(out, ".extern stola_struct_get\n");
-    fprintf(out, ".extern stola_struct_set\n");
-    fprintf(out, ".extern stola_getitem\n");
-    fprintf(out, ".extern stola_setitem\n");
-    fprintf(out, ".extern stola_array_get\n");
-    fprintf(out, ".extern stola_array_set\n");
-    fprintf(out, ".extern stola_dict_get\n");
-    fprintf(out, ".extern stola_dict_set\n");
-    fprintf(out, ".extern stola_push\n");
-    fprintf(out, ".extern stola_push_try\n");
-    fprintf(out, ".extern stola_pop_try\n");
-    fprintf(out, ".extern stola_throw\n");
-    fprintf(out, ".extern stola_get_error\n");
-    fprintf(out, ".extern stola_register_longjmp\n");
-    fprintf(out, ".extern stola_setup_runtime\n");
-    fprintf(out, ".extern stola_memory_read\n");
-    fprintf(out, ".extern stola_memory_write\n");
-    fprintf(out, ".extern stola_memory_write_byte\n");
-  }
-
-  fprintf(out, "\n.text\n");
-
-  fprintf(out, "main:\n");
-  fprintf(out, "    push rbp\n");
-  fprintf(out, "    mov rbp, rsp\n");
-  fprintf(out, "    sub rsp, 512\n");
+// Emit main: runtime setup, method/DLL/C-function registration and the
+// top-level statements
+static void generate_main(ASTNode *program, Emitter *out,
+                          SemanticAnalyzer *analyzer, int is_freestanding) {
+  emit_lit(out, "main:\n");
+  frame_enter(!is_freestanding);
+  emit_push(out, "rbp");
+  emit_lit(out, "    mov rbp, rsp\n");
+  emit_lit(out, "    sub rsp, 512\n");
+  frame_align = stack_align;
 
   if (!is_freestanding) {
     // Register the longjmp asm routine with the C runtime
-    fprintf(out, "    lea " ARG0 ", [rip + stola_longjmp]\n");
+    emit_lit(out, "    lea " ARG0 ", [rip + stola_longjmp]\n");
     emit_call(out, "stola_register_longjmp");
     // Install signal handlers (SIGINT, SIGSEGV) on Linux; no-op on Windows
     emit_call(out, "stola_setup_runtime");
@@ -475,19 +778,19 @@ void codegen_generate(ASTNode *program, SemanticAnalyzer *analyzer,
             ASTNode *m = stmt->as.class_decl.methods[j];
             int cid = add_string_literal(stmt->as.class_decl.name);
             int mid = add_string_literal(m->as.function_decl.name);
-            fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", cid);
-            fprintf(out, "    lea " ARG1 ", [rip + .str%d]\n", mid);
-            fprintf(out, "    lea " ARG2 ", [rip + %s_%s]\n",
+            emit_lea_str(out, ARG0, cid);
+            emit_lea_str(out, ARG1, mid);
+            emit_fmt(out, "    lea " ARG2 ", [rip + %s_%s]\n",
                     stmt->as.class_decl.name, m->as.function_decl.name);
             emit_call(out, "stola_register_method");
           }
         } else if (stmt->type == AST_IMPORT_NATIVE) {
           int sid = add_string_literal(stmt->as.import_native.dll_name);
-          fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", sid);
+          emit_lea_str(out, ARG0, sid);
           emit_call(out, "stola_load_dll");
         } else if (stmt->type == AST_C_FUNCTION_DECL) {
           int sid = add_string_literal(stmt->as.c_function_decl.name);
-          fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", sid);
+          emit_lea_str(out, ARG0, sid);
           emit_call(out, "stola_bind_c_function");
         }
       }
@@ -503,104 +806,380 @@ void codegen_generate(ASTNode *program, SemanticAnalyzer *analyzer,
     }
   }
 
-  fprintf(out, "    xor eax, eax\n");
-  fprintf(out, "    add rsp, 512\n");
-  fprintf(out, "    pop rbp\n");
-  fprintf(out, "    ret\n");
+  emit_lit(out, "    xor eax, eax\n");
+  emit_lit(out, "    add rsp, 512\n");
+  emit_lit(out, "    pop rbp\n");
+  emit_lit(out, "    ret\n");
+}
+
+// Methods are emitted as <Class>_<method> with an implicit leading "this".
+// Works on a copy so the declaration main registers stays untouched.
+static ASTNode *mangle_method(ASTNode *cls, ASTNode *m) {
+  ASTNode *copy = arena_alloc(&compile_arena, sizeof(ASTNode));
+  *copy = *m;
+
+  size_t len = strlen(cls->as.class_decl.name) +
+               strlen(m->as.function_decl.name) + 2;
+  char *name = arena_alloc(&compile_arena, len);
+  snprintf(name, len, "%s_%s", cls->as.class_decl.name,
+           m->as.function_decl.name);
+
+  int count = m->as.function_decl.param_count;
+  char **params = arena_alloc(&compile_arena, (count + 1) * sizeof(char *));
+  params[0] = "this";
+  if (count > 0)
+    memcpy(params + 1, m->as.function_decl.parameters, count * sizeof(char *));
+
+  copy->as.function_decl.name = name;
+  copy->as.function_decl.parameters = params;
+  copy->as.function_decl.param_count = count + 1;
+  return copy;
+}
+
+typedef struct {
+  CodegenUnit *units;
+  int unit_count;
+  atomic_int next; /* next unit to claim */
+  ASTNode *program;
+  SemanticAnalyzer *analyzer;
+  int is_freestanding;
+} CodegenJob;
+
+// Generate one unit into its own buffer, starting from fresh per-unit state.
+static void generate_unit(CodegenJob *job, int index) {
+  CodegenUnit *u = &job->units[index];
+  current_unit = u;
+  snprintf(unit_tag, sizeof(unit_tag), "%s%d_", label_prefix, index);
+
+  Emitter out = {0};
+  align_disabled = 0;
+  for (;;) {
+    label_counter = 0;
+    memset(&func_regalloc, 0, sizeof(func_regalloc));
+    current_epilogue_label = -1;
+    stack_align = frame_align = -1;
+    align_failed = 0;
+    if (u->decl)
+      generate_node(u->decl, &out, job->analyzer, job->is_freestanding);
+    else
+      generate_main(job->program, &out, job->analyzer, job->is_freestanding);
+    if (!align_failed || align_disabled)
+      break;
+    // Stack depth could not be followed: again, aligning at run time
+    align_disabled = 1;
+    out.size = 0;
+  }
+  u->text = peephole_optimize(out.data, out.size, &u->length);
+  free(out.data);
+}
+
+#ifdef _WIN32
+static unsigned __stdcall codegen_worker(void *arg) {
+#else
+static void *codegen_worker(void *arg) {
+#endif
+  CodegenJob *job = arg;
+  int i;
+  while ((i = atomic_fetch_add(&job->next, 1)) < job->unit_count)
+    generate_unit(job, i);
+#ifdef _WIN32
+  return 0;
+#else
+  return NULL;
+#endif
+}
 
-  // User-defined functions & Classes
-  if (program && program->type == AST_PROGRAM && !is_freestanding) {
-    for (int i = 0; i < program->as.program.statement_count; i++) {
-      ASTNode *stmt = program->as.program.statements[i];
-      if (stmt->type == AST_FUNCTION_DECL) {
-        generate_node(stmt, out, analyzer, is_freestanding);
-      } else if (stmt->type == AST_CLASS_DECL) {
-        for (int j = 0; j < stmt->as.class_decl.method_count; j++) {
-          ASTNode *m = stmt->as.class_decl.methods[j];
-          char mangled[256];
-          snprintf(mangled, sizeof(mangled), "%s_%s", stmt->as.class_decl.name,
-                   m->as.function_decl.name);
-          char *old_name = m->as.function_decl.name;
-          m->as.function_decl.name = stola_strdup(mangled);
-
-          int old_count = m->as.function_decl.param_count;
-          m->as.function_decl.param_count = old_count + 1;
-          m->as.function_decl.parameters = realloc(
-              m->as.function_decl.parameters, sizeof(char *) * (old_count + 1));
-          for (int k = old_count; k > 0; k--) {
-            m->as.function_decl.parameters[k] =
-                m->as.function_decl.parameters[k - 1];
-          }
-          m->as.function_decl.parameters[0] = stola_strdup("this");
+static int default_jobs(void) {
+#ifdef _WIN32
+  const char *n = getenv("NUMBER_OF_PROCESSORS");
+  int jobs = n ? atoi(n) : 1;
+#else
+  int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return jobs > 0 ? jobs : 1;
+}
 
-          generate_node(m, out, analyzer, is_freestanding);
+// Run every unit on up to `jobs` threads; the calling thread is one of them
+// and drains whatever the others leave (also when a thread cannot start).
+static void run_units(CodegenJob *job, int jobs) {
+  if (jobs > job->unit_count)
+    jobs = job->unit_count;
+  if (jobs < 1)
+    jobs = 1;
+  int started = 0;
+#ifdef _WIN32
+  uintptr_t *threads = malloc(jobs * sizeof(uintptr_t));
+  for (int i = 1; i < jobs; i++) {
+    uintptr_t t = _beginthreadex(NULL, 0, codegen_worker, job, 0, NULL);
+    if (t)
+      threads[started++] = t;
+  }
+  codegen_worker(job);
+  for (int i = 0; i < started; i++) {
+    WaitForSingleObject((void *)threads[i], 0xFFFFFFFFu);
+    CloseHandle((void *)threads[i]);
+  }
+#else
+  pthread_t *threads = malloc(jobs * sizeof(pthread_t));
+  for (int i = 1; i < jobs; i++) {
+    if (pthread_create(&threads[started], NULL, codegen_worker, job) == 0)
+      started++;
+  }
+  codegen_worker(job);
+  for (int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+#endif
+  free(threads);
+}
 
-          free(m->as.function_decl.name);
-          m->as.function_decl.name = old_name;
-        }
-      }
+static void free_units(CodegenUnit *units, int unit_count) {
+  for (int i = 0; i < unit_count; i++) {
+    free(units[i].text);
+    free(units[i].strings);
+  }
+  free(units);
+}
+
+// Generate `units` (decl == NULL is main) on up to `jobs` threads.
+static void generate_units(CodegenUnit *units, int unit_count, ASTNode *program,
+                          SemanticAnalyzer *analyzer, int is_freestanding,
+                          int jobs) {
+  CodegenJob job;
+  job.units = units;
+  job.unit_count = unit_count;
+  atomic_init(&job.next, 0);
+  job.program = program;
+  job.analyzer = analyzer;
+  job.is_freestanding = is_freestanding;
+  run_units(&job, jobs > 0 ? jobs : default_jobs());
+}
+
+// Concatenate unit text in order, then every unit's literal pool into .data.
+// Frees the units.
+static void write_units(Emitter *out, CodegenUnit *units, int unit_count) {
+  for (int i = 0; i < unit_count; i++)
+    emit_raw(out, units[i].text, units[i].length);
+
+  // Emit string literal data
+  int data_started = 0;
+  for (int i = 0; i < unit_count; i++) {
+    if (units[i].string_count > 0 && !data_started) {
+      emit_lit(out, "\n.data\n");
+      data_started = 1;
+    }
+    for (int j = 0; j < units[i].string_count; j++) {
+      emit_lit(out, ".str");
+      emit_str(out, label_prefix);
+      emit_int(out, i);
+      emit_lit(out, "_");
+      emit_int(out, units[i].strings[j].label_id);
+      emit_lit(out, ": .asciz \"");
+      emit_str(out, units[i].strings[j].value);
+      emit_lit(out, "\"\n");
+    }
+  }
+  free_units(units, unit_count);
+}
+
+int codegen_generate(ASTNode *program, SemanticAnalyzer *analyzer,
+                     FILE *file, int is_freestanding, int jobs) {
+  // Unit 0 is main, then user functions and class methods in program order
+  // (freestanding mode only supports functions, no classes). Declarations
+  // without a body come from the module cache and are not emitted here.
+  int unit_count = 1;
+  int is_program = program && program->type == AST_PROGRAM;
+  if (is_program) {
+    for (int i = 0; i < program->as.program.statement_count; i++) {
+      ASTNode *stmt = program->as.program.statements[i];
+      if (stmt->type == AST_FUNCTION_DECL && stmt->as.function_decl.body)
+        unit_count++;
+      else if (stmt->type == AST_CLASS_DECL && !is_freestanding)
+        unit_count += stmt->as.class_decl.method_count;
     }
-  } else if (program && program->type == AST_PROGRAM && is_freestanding) {
-    // In freestanding, we only support functions, no classes.
+  }
+
+  CodegenUnit *units = calloc(unit_count, sizeof(CodegenUnit));
+  int n = 1;
+  if (is_program) {
     for (int i = 0; i < program->as.program.statement_count; i++) {
       ASTNode *stmt = program->as.program.statements[i];
-      if (stmt->type == AST_FUNCTION_DECL) {
-        generate_node(stmt, out, analyzer, is_freestanding);
+      if (stmt->type == AST_FUNCTION_DECL && stmt->as.function_decl.body) {
+        units[n++].decl = stmt;
+      } else if (stmt->type == AST_CLASS_DECL && !is_freestanding) {
+        for (int j = 0; j < stmt->as.class_decl.method_count; j++)
+          units[n++].decl = mangle_method(stmt, stmt->as.class_decl.methods[j]);
       }
     }
   }
 
-  // Emit string literal data
-  if (string_table_count > 0) {
-    fprintf(out, "\n.data\n");
-    for (int i = 0; i < string_table_count; i++) {
-      fprintf(out, ".str%d: .asciz \"%s\"\n", string_table[i].label_id,
-              string_table[i].value);
-      free(string_table[i].value);
+  label_prefix = "";
+  generate_units(units, unit_count, program, analyzer, is_freestanding, jobs);
+
+  Emitter text = {0};
+  Emitter *out = &text;
+  emit_lit(out, ".intel_syntax noprefix\n");
+  emit_lit(out, ".global main\n\n");
+
+  // Declare all external runtime functions (skip in freestanding)
+  if (!is_freestanding) {
+    for (int i = 0; builtins[i].stola_name; i++) {
+      emit_lit(out, ".extern ");
+      emit_str(out, builtins[i].c_name);
+      emit_lit(out, "\n");
     }
+    emit_lit(out, ".extern stola_coro_go\n");
+    emit_lit(out, ".extern stola_register_method\n");
+    emit_lit(out, ".extern stola_invoke_method\n");
+    emit_lit(out, ".extern stola_load_dll\n");
+    emit_lit(out, ".extern stola_bind_c_function\n");
+    emit_lit(out, ".extern stola_invoke_c_function\n");
+    emit_lit(out, ".extern stola_new_int\n");
+    emit_lit(out, ".extern stola_new_bool\n");
+    emit_lit(out, ".extern stola_new_string\n");
+    emit_lit(out, ".extern stola_new_null\n");
+    emit_lit(out, ".extern stola_new_array\n");
+    emit_lit(out, ".extern stola_new_dict\n");
+    emit_lit(out, ".extern stola_new_struct\n");
+    emit_lit(out, ".extern stola_is_truthy\n");
+    emit_lit(out, ".extern stola_add\n");
+    emit_lit(out, ".extern stola_sub\n");
+    emit_lit(out, ".extern stola_mul\n");
+    emit_lit(out, ".extern stola_div\n");
+    emit_lit(out, ".extern stola_mod\n");
+    emit_lit(out, ".extern stola_neg\n");
+    emit_lit(out, ".extern stola_eq\n");
+    emit_lit(out, ".extern stola_neq\n");
+    emit_lit(out, ".extern stola_lt\n");
+    emit_lit(out, ".extern stola_gt\n");
+    emit_lit(out, ".extern stola_le\n");
+    emit_lit(out, ".extern stola_ge\n");
+    emit_lit(out, ".extern stola_and\n");
+    emit_lit(out, ".extern stola_or\n");
+    emit_lit(out, ".extern stola_not\n");
+    emit_lit(out, ".extern stola_struct_get\n");
+    emit_lit(out, ".extern stola_struct_set\n");
+    emit_lit(out, ".extern stola_getitem\n");
+    emit_lit(out, ".extern stola_setitem\n");
+    emit_lit(out, ".extern stola_array_get\n");
+    emit_lit(out, ".extern stola_array_set\n");
+    emit_lit(out, ".extern stola_dict_get\n");
+    emit_lit(out, ".extern stola_dict_set\n");
+    emit_lit(out, ".extern stola_push\n");
+    emit_lit(out, ".extern stola_iter_begin\n");
+    emit_lit(out, ".extern stola_iter_next\n");
+    emit_lit(out, ".extern stola_push_try\n");
+    emit_lit(out, ".extern stola_pop_try\n");
+    emit_lit(out, ".extern stola_throw\n");
+    emit_lit(out, ".extern stola_get_error\n");
+    emit_lit(out, ".extern stola_register_longjmp\n");
+    emit_lit(out, ".extern stola_setup_runtime\n");
+    emit_lit(out, ".extern stola_memory_read\n");
+    emit_lit(out, ".extern stola_memory_write\n");
+    emit_lit(out, ".extern stola_memory_write_byte\n");
   }
+  emit_lit(out, "\n.text\n");
+  write_units(out, units, unit_count);
 
-  fprintf(out, "\n");
+  emit_lit(out, "\n");
   if (!is_freestanding) {
-    fprintf(out, "    .text\n");
-    fprintf(out, "// Custom setjmp / longjmp for exception handling\n");
-    fprintf(out, ".global stola_setjmp\n");
-    fprintf(out, "stola_setjmp:\n");
-    fprintf(out, "    mov [" ARG0 "], rbx\n");
-    fprintf(out, "    mov [" ARG0 "+8], rbp\n");
-    fprintf(out, "    mov [" ARG0 "+16], r12\n");
-    fprintf(out, "    mov [" ARG0 "+24], r13\n");
-    fprintf(out, "    mov [" ARG0 "+32], r14\n");
-    fprintf(out, "    mov [" ARG0 "+40], r15\n");
-    fprintf(out, "    mov [" ARG0 "+48], rsi\n");
-    fprintf(out, "    mov [" ARG0 "+56], rdi\n");
-    fprintf(out, "    lea " ARG1 ", [rsp+8]\n");
-    fprintf(out, "    mov [" ARG0 "+64], " ARG1 "\n");
-    fprintf(out, "    mov " ARG1 ", [rsp]\n");
-    fprintf(out, "    mov [" ARG0 "+72], " ARG1 "\n");
-    fprintf(out, "    xor rax, rax\n");
-    fprintf(out, "    ret\n\n");
-
-    fprintf(out, ".global stola_longjmp\n");
-    fprintf(out, "stola_longjmp:\n");
-    fprintf(out, "    mov rbx, [" ARG0 "]\n");
-    fprintf(out, "    mov rbp, [" ARG0 "+8]\n");
-    fprintf(out, "    mov r12, [" ARG0 "+16]\n");
-    fprintf(out, "    mov r13, [" ARG0 "+24]\n");
-    fprintf(out, "    mov r14, [" ARG0 "+32]\n");
-    fprintf(out, "    mov r15, [" ARG0 "+40]\n");
-    fprintf(out, "    mov rsi, [" ARG0 "+48]\n");
-    fprintf(out, "    mov rdi, [" ARG0 "+56]\n");
-    fprintf(out, "    mov rsp, [" ARG0 "+64]\n");
-    fprintf(out, "    mov " ARG1 ", [" ARG0 "+72]\n");
-    fprintf(out, "    mov rax, 1\n");
-    fprintf(out, "    jmp " ARG1 "\n");
+    emit_lit(out, "    .text\n");
+    emit_lit(out, "// Custom setjmp / longjmp for exception handling\n");
+    emit_lit(out, ".global stola_setjmp\n");
+    emit_lit(out, "stola_setjmp:\n");
+    emit_lit(out, "    mov [" ARG0 "], rbx\n");
+    emit_lit(out, "    mov [" ARG0 "+8], rbp\n");
+    emit_lit(out, "    mov [" ARG0 "+16], r12\n");
+    emit_lit(out, "    mov [" ARG0 "+24], r13\n");
+    emit_lit(out, "    mov [" ARG0 "+32], r14\n");
+    emit_lit(out, "    mov [" ARG0 "+40], r15\n");
+    emit_lit(out, "    mov [" ARG0 "+48], rsi\n");
+    emit_lit(out, "    mov [" ARG0 "+56], rdi\n");
+    emit_lit(out, "    lea " ARG1 ", [rsp+8]\n");
+    emit_lit(out, "    mov [" ARG0 "+64], " ARG1 "\n");
+    emit_lit(out, "    mov " ARG1 ", [rsp]\n");
+    emit_lit(out, "    mov [" ARG0 "+72], " ARG1 "\n");
+    emit_lit(out, "    xor rax, rax\n");
+    emit_lit(out, "    ret\n\n");
+
+    emit_lit(out, ".global stola_longjmp\n");
+    emit_lit(out, "stola_longjmp:\n");
+    emit_lit(out, "    mov rbx, [" ARG0 "]\n");
+    emit_lit(out, "    mov rbp, [" ARG0 "+8]\n");
+    emit_lit(out, "    mov r12, [" ARG0 "+16]\n");
+    emit_lit(out, "    mov r13, [" ARG0 "+24]\n");
+    emit_lit(out, "    mov r14, [" ARG0 "+32]\n");
+    emit_lit(out, "    mov r15, [" ARG0 "+40]\n");
+    emit_lit(out, "    mov rsi, [" ARG0 "+48]\n");
+    emit_lit(out, "    mov rdi, [" ARG0 "+56]\n");
+    emit_lit(out, "    mov rsp, [" ARG0 "+64]\n");
+    emit_lit(out, "    mov " ARG1 ", [" ARG0 "+72]\n");
+    emit_lit(out, "    mov rax, 1\n");
+    emit_lit(out, "    jmp " ARG1 "\n");
+  }
+
+  int ok = fwrite(text.data, 1, text.size, file) == text.size;
+  free(text.data);
+  return ok;
+}
+
+int codegen_generate_module(ASTNode **decls, int count, const char *prefix,
+                            SemanticAnalyzer *analyzer, FILE *file, int jobs) {
+  if (count == 0)
+    return 1;
+  CodegenUnit *units = calloc(count, sizeof(CodegenUnit));
+  for (int i = 0; i < count; i++)
+    units[i].decl = decls[i];
+
+  label_prefix = prefix;
+  generate_units(units, count, NULL, analyzer, 0, jobs);
+  Emitter text = {0};
+  emit_lit(&text, "\n.text\n");
+  write_units(&text, units, count);
+  emit_lit(&text, "\n.text\n");
+  label_prefix = "";
+  int ok = fwrite(text.data, 1, text.size, file) == text.size;
+  free(text.data);
+  return ok;
+}
+
+// Anything that changes the emitted code must change this string; the
+// build stamp covers local edits to the compiler.
+const char *codegen_version(void) {
+  return "stolascript-codegen-5 " __DATE__ " " __TIME__;
+}
+
+// Built-in call: evaluate args, put them in ABI registers, call c_name
+static void generate_builtin_call(ASTNode *node, const char *c_name, Emitter *out,
+                                  SemanticAnalyzer *analyzer, int is_freestanding) {
+  const char *name = node->as.call_expr.function->as.identifier.value;
+  const char *regs[] = {ARG0, ARG1, ARG2, ARG3};
+  for (int i = 0; i < node->as.call_expr.arg_count && i < 4; i++) {
+    ASTNode *arg = node->as.call_expr.args[i];
+    if (arg->type == AST_IDENTIFIER && takes_fn_arg(name, i)) {
+      // Function argument (thread_spawn, spawn, ...): pass its address
+      emit_fmt(out, "    lea rax, [rip + %s]\n", arg->as.identifier.value);
+      emit_push(out, "rax");
+    } else {
+      generate_node(arg, out, analyzer, is_freestanding);
+    }
   }
+  for (int i = node->as.call_expr.arg_count - 1; i >= 0 && i < 4; i--)
+    emit_pop_str(out, regs[i]);
+  emit_call(out, c_name);
+  emit_push(out, "rax");
+}
 
-  fclose(out);
+// spawn(...) used as a statement: its handle can never be awaited
+static int is_dropped_spawn(ASTNode *expr) {
+  if (expr->type != AST_CALL_EXPR ||
+      expr->as.call_expr.function->type != AST_IDENTIFIER)
+    return 0;
+  Symbol *sym = expr->as.call_expr.function->as.identifier.symbol;
+  return (!sym || sym->type != SYMBOL_C_FUNCTION) &&
+         strcmp(expr->as.call_expr.function->as.identifier.value, "spawn") == 0;
 }
 
-static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
+static void generate_node(ASTNode *node, Emitter *out, SemanticAnalyzer *analyzer,
                           int is_freestanding) {
   if (!node)
     return;
@@ -609,11 +1188,11 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   // --- Literals ---
   case AST_NUMBER_LITERAL: {
     if (is_freestanding) {
-      fprintf(out, "    push %s\n", node->as.number_literal.value);
+      emit_push_str(out, node->as.number_literal.value);
     } else {
-      fprintf(out, "    mov " ARG0 ", %s\n", node->as.number_literal.value);
+      emit_op_reg_reg(out, "mov", ARG0, node->as.number_literal.value);
       emit_call(out, "stola_new_int");
-      fprintf(out, "    push rax\n");
+      emit_push(out, "rax");
     }
     break;
   }
@@ -621,31 +1200,33 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     if (is_freestanding) {
       // For now, we don't support strings in freestanding as they require
       // StolaValue*
-      fprintf(out, "    push 0 ; Strings not supported in freestanding\n");
+      emit_lit(out, "    push 0 ; Strings not supported in freestanding\n");
+      stack_moved(8);
     } else {
       int sid = add_string_literal(node->as.string_literal.value);
-      fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", sid);
+      emit_lea_str(out, ARG0, sid);
       emit_call(out, "stola_new_string");
-      fprintf(out, "    push rax\n");
+      emit_push(out, "rax");
     }
     break;
   }
   case AST_BOOLEAN_LITERAL: {
     if (is_freestanding) {
-      fprintf(out, "    push %d\n", node->as.boolean_literal.value);
+      emit_op_imm(out, "push", node->as.boolean_literal.value);
+      stack_moved(8);
     } else {
-      fprintf(out, "    mov " ARG0 ", %d\n", node->as.boolean_literal.value);
+      emit_op_reg_imm(out, "mov", ARG0, node->as.boolean_literal.value);
       emit_call(out, "stola_new_bool");
-      fprintf(out, "    push rax\n");
+      emit_push(out, "rax");
     }
     break;
   }
   case AST_NULL_LITERAL: {
     if (is_freestanding) {
-      fprintf(out, "    push 0\n");
+      emit_push(out, "0");
     } else {
       emit_call(out, "stola_new_null");
-      fprintf(out, "    push rax\n");
+      emit_push(out, "rax");
     }
     break;
   }
@@ -653,23 +1234,23 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   case AST_NEW_EXPR: {
     const char *cname = node->as.new_expr.class_name->as.identifier.value;
     int cid = add_string_literal(cname);
-    fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", cid);
+    emit_lea_str(out, ARG0, cid);
     emit_call(out, "stola_new_struct"); // Create instance!
-    fprintf(out, "    push rax\n");     // save instance
+    emit_push(out, "rax"); // save instance
 
     // Evaluate constructor arguments (max 2 for now, mapping to ARG2 and ARG3)
     for (int i = 0; i < node->as.new_expr.arg_count && i < 2; i++) {
       generate_node(node->as.new_expr.args[i], out, analyzer, is_freestanding);
     }
     if (node->as.new_expr.arg_count > 1)
-      fprintf(out, "    pop " ARG3 "\n");
+      emit_pop(out, ARG3);
     if (node->as.new_expr.arg_count > 0)
-      fprintf(out, "    pop " ARG2 "\n");
+      emit_pop(out, ARG2);
 
     // Prepare Call to init
-    fprintf(out, "    mov " ARG0 ", [rsp]\n"); // fetch instance (this) into ARG0
+    emit_lit(out, "    mov " ARG0 ", [rsp]\n"); // fetch instance (this) into ARG0
     int init_id = add_string_literal("init");
-    fprintf(out, "    lea " ARG1 ", [rip + .str%d]\n", init_id);
+    emit_lea_str(out, ARG1, init_id);
     emit_call(out, "stola_invoke_method");
 
     // Result of AST_NEW_EXPR is the pushed instance, we ignore init()'s return.
@@ -690,33 +1271,33 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   // --- Assignment: eval value, store StolaValue* in stack slot ---
   case AST_ASSIGNMENT: {
     generate_node(node->as.assignment.value, out, analyzer, is_freestanding);
-    fprintf(out, "    pop rax\n");
+    emit_pop(out, "rax");
 
     if (node->as.assignment.target->type == AST_IDENTIFIER) {
       ra_store_var(out, node->as.assignment.target->as.identifier.value);
     } else if (node->as.assignment.target->type == AST_MEMBER_ACCESS) {
       // obj.field = value  OR  arr at i = value  OR  dict[key] = value
       // rax = value (StolaValue*)
-      fprintf(out, "    push rax\n"); // save value
+      emit_push(out, "rax"); // save value
       generate_node(node->as.assignment.target->as.member_access.object, out,
                     analyzer, is_freestanding);
       if (node->as.assignment.target->as.member_access.is_computed) {
         // Dynamic set: arr at i = v  /  dict[expr] = v
         generate_node(node->as.assignment.target->as.member_access.property,
                       out, analyzer, is_freestanding);
-        fprintf(out, "    pop " ARG1 "\n"); // key
-        fprintf(out, "    pop " ARG0 "\n"); // object
-        fprintf(out, "    pop " ARG2 "\n"); // value (saved earlier)
+        emit_pop(out, ARG1); // key
+        emit_pop(out, ARG0); // object
+        emit_pop(out, ARG2); // value (saved earlier)
         emit_call(out, "stola_setitem");
       } else {
         // Static dot set: obj.field = v
-        fprintf(out, "    pop " ARG0 "\n"); // obj
+        emit_pop(out, ARG0); // obj
         const char *field =
             node->as.assignment.target->as.member_access.property
                 ->as.identifier.value;
         int fid = add_string_literal(field);
-        fprintf(out, "    lea " ARG1 ", [rip + .str%d]\n", fid);
-        fprintf(out, "    pop " ARG2 "\n"); // value
+        emit_lea_str(out, ARG1, fid);
+        emit_pop(out, ARG2); // value
         emit_call(out, "stola_struct_set");
       }
     }
@@ -727,56 +1308,56 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   case AST_BINARY_OP: {
     generate_node(node->as.binary_op.left, out, analyzer, is_freestanding);
     generate_node(node->as.binary_op.right, out, analyzer, is_freestanding);
-    fprintf(out, "    pop " ARG1 "\n"); // right
-    fprintf(out, "    pop " ARG0 "\n"); // left
+    emit_pop(out, ARG1); // right
+    emit_pop(out, ARG0); // left
 
     if (is_freestanding) {
       switch (node->as.binary_op.op.type) {
       case TOKEN_PLUS:
-        fprintf(out, "    add " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    push " ARG0 "\n");
+        emit_lit(out, "    add " ARG0 ", " ARG1 "\n");
+        emit_push(out, ARG0);
         break;
       case TOKEN_MINUS:
-        fprintf(out, "    sub " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    push " ARG0 "\n");
+        emit_lit(out, "    sub " ARG0 ", " ARG1 "\n");
+        emit_push(out, ARG0);
         break;
       case TOKEN_TIMES:
-        fprintf(out, "    imul " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    push " ARG0 "\n");
+        emit_lit(out, "    imul " ARG0 ", " ARG1 "\n");
+        emit_push(out, ARG0);
         break;
       case TOKEN_DIVIDED_BY:
-        fprintf(out, "    mov rax, " ARG0 "\n");
-        fprintf(out, "    cqo\n");
-        fprintf(out, "    idiv " ARG1 "\n");
-        fprintf(out, "    push rax\n");
+        emit_lit(out, "    mov rax, " ARG0 "\n");
+        emit_lit(out, "    cqo\n");
+        emit_lit(out, "    idiv " ARG1 "\n");
+        emit_push(out, "rax");
         break;
       case TOKEN_LESS_THAN:
-        fprintf(out, "    cmp " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    setl al\n");
-        fprintf(out, "    movzx rax, al\n");
-        fprintf(out, "    push rax\n");
+        emit_lit(out, "    cmp " ARG0 ", " ARG1 "\n");
+        emit_lit(out, "    setl al\n");
+        emit_lit(out, "    movzx rax, al\n");
+        emit_push(out, "rax");
         break;
       case TOKEN_GREATER_THAN:
-        fprintf(out, "    cmp " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    setg al\n");
-        fprintf(out, "    movzx rax, al\n");
-        fprintf(out, "    push rax\n");
+        emit_lit(out, "    cmp " ARG0 ", " ARG1 "\n");
+        emit_lit(out, "    setg al\n");
+        emit_lit(out, "    movzx rax, al\n");
+        emit_push(out, "rax");
         break;
       case TOKEN_EQUALS:
-        fprintf(out, "    cmp " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    sete al\n");
-        fprintf(out, "    movzx rax, al\n");
-        fprintf(out, "    push rax\n");
+        emit_lit(out, "    cmp " ARG0 ", " ARG1 "\n");
+        emit_lit(out, "    sete al\n");
+        emit_lit(out, "    movzx rax, al\n");
+        emit_push(out, "rax");
         break;
       default:
-        fprintf(out, "    add " ARG0 ", " ARG1 "\n");
-        fprintf(out, "    push " ARG0 "\n");
+        emit_lit(out, "    add " ARG0 ", " ARG1 "\n");
+        emit_push(out, ARG0);
         break;
       }
     } else {
       const char *func = binop_runtime_func(node->as.binary_op.op.type);
       emit_call(out, func);
-      fprintf(out, "    push rax\n"); // result = StolaValue*
+      emit_push(out, "rax"); // result = StolaValue*
     }
     break;
   }
@@ -784,21 +1365,26 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   // --- Unary Op ---
   case AST_UNARY_OP: {
     generate_node(node->as.unary_op.right, out, analyzer, is_freestanding);
-    fprintf(out, "    pop " ARG0 "\n");
+    emit_pop(out, ARG0);
     if (node->as.unary_op.op.type == TOKEN_MINUS) {
       emit_call(out, "stola_neg");
     } else if (node->as.unary_op.op.type == TOKEN_NOT) {
       emit_call(out, "stola_not");
     }
-    fprintf(out, "    push rax\n");
+    emit_push(out, "rax");
     break;
   }
 
   // --- Expression Statement ---
   case AST_EXPRESSION_STMT: {
-    generate_node(node->as.expression_stmt.expression, out, analyzer,
-                  is_freestanding);
-    fprintf(out, "    pop rax\n"); // discard
+    ASTNode *expr = node->as.expression_stmt.expression;
+    if (!is_freestanding && is_dropped_spawn(expr))
+      // Detached: the scheduler frees it as soon as it finishes
+      generate_builtin_call(expr, "stola_coro_go", out, analyzer,
+                            is_freestanding);
+    else
+      generate_node(expr, out, analyzer, is_freestanding);
+    emit_pop(out, "rax"); // discard
     break;
   }
 
@@ -816,33 +1402,33 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     int next_label = get_label();
 
     generate_node(node->as.if_stmt.condition, out, analyzer, is_freestanding);
-    fprintf(out, "    pop " ARG0 "\n");
+    emit_pop(out, ARG0);
     emit_call(out, "stola_is_truthy");
-    fprintf(out, "    cmp rax, 0\n");
-    fprintf(out, "    je .L%d\n", next_label);
+    emit_lit(out, "    cmp rax, 0\n");
+    emit_jump(out, "je", next_label);
 
     generate_node(node->as.if_stmt.consequence, out, analyzer, is_freestanding);
-    fprintf(out, "    jmp .L%d\n", end_label);
+    emit_jump(out, "jmp", end_label);
 
     for (int i = 0; i < node->as.if_stmt.elif_count; i++) {
-      fprintf(out, ".L%d:\n", next_label);
+      emit_label(out, next_label);
       next_label = get_label();
       generate_node(node->as.if_stmt.elif_conditions[i], out, analyzer,
                     is_freestanding);
-      fprintf(out, "    pop " ARG0 "\n");
+      emit_pop(out, ARG0);
       emit_call(out, "stola_is_truthy");
-      fprintf(out, "    cmp rax, 0\n");
-      fprintf(out, "    je .L%d\n", next_label);
+      emit_lit(out, "    cmp rax, 0\n");
+      emit_jump(out, "je", next_label);
       generate_node(node->as.if_stmt.elif_consequences[i], out, analyzer,
                     is_freestanding);
-      fprintf(out, "    jmp .L%d\n", end_label);
+      emit_jump(out, "jmp", end_label);
     }
 
-    fprintf(out, ".L%d:\n", next_label);
+    emit_label(out, next_label);
     if (node->as.if_stmt.alternative)
       generate_node(node->as.if_stmt.alternative, out, analyzer,
                     is_freestanding);
-    fprintf(out, ".L%d:\n", end_label);
+    emit_label(out, end_label);
     break;
   }
 
@@ -851,17 +1437,43 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     int loop_start = get_label();
     int loop_end = get_label();
 
-    fprintf(out, ".L%d:\n", loop_start);
+    emit_label(out, loop_start);
     generate_node(node->as.while_stmt.condition, out, analyzer,
                   is_freestanding);
-    fprintf(out, "    pop " ARG0 "\n");
+    emit_pop(out, ARG0);
     emit_call(out, "stola_is_truthy");
-    fprintf(out, "    cmp rax, 0\n");
-    fprintf(out, "    je .L%d\n", loop_end);
+    emit_lit(out, "    cmp rax, 0\n");
+    emit_jump(out, "je", loop_end);
 
     generate_node(node->as.while_stmt.body, out, analyzer, is_freestanding);
-    fprintf(out, "    jmp .L%d\n", loop_start);
-    fprintf(out, ".L%d:\n", loop_end);
+    emit_jump(out, "jmp", loop_start);
+    emit_label(out, loop_end);
+    break;
+  }
+
+  // --- For-in: iterator = stola_iter_begin(iterable); stop on NULL ---
+  case AST_FOR_STMT: {
+    int loop_start = get_label();
+    int loop_end = get_label();
+    char hidden[64];
+    for_iter_name(node, hidden, sizeof(hidden));
+
+    generate_node(node->as.for_stmt.iterable, out, analyzer, is_freestanding);
+    emit_pop(out, ARG0);
+    emit_call(out, "stola_iter_begin");
+    ra_store_var(out, hidden);
+
+    emit_label(out, loop_start);
+    ra_push_var(out, hidden);
+    emit_pop(out, ARG0);
+    emit_call(out, "stola_iter_next");
+    emit_lit(out, "    test rax, rax\n");
+    emit_jump(out, "jz", loop_end);
+    ra_store_var(out, node->as.for_stmt.iterator_name);
+
+    generate_node(node->as.for_stmt.body, out, analyzer, is_freestanding);
+    emit_jump(out, "jmp", loop_start);
+    emit_label(out, loop_end);
     break;
   }
 
@@ -874,20 +1486,20 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     // Initialize iterator with start value
     generate_node(node->as.loop_stmt.start_expr, out, analyzer,
                   is_freestanding);
-    fprintf(out, "    pop rax\n");
+    emit_pop(out, "rax");
     ra_store_var(out, iname);
 
-    fprintf(out, ".L%d:\n", loop_start);
+    emit_label(out, loop_start);
     // Condition: iterator < end  (use stola_lt)
     ra_push_var(out, iname);
     generate_node(node->as.loop_stmt.end_expr, out, analyzer, is_freestanding);
-    fprintf(out, "    pop " ARG1 "\n"); // end
-    fprintf(out, "    pop " ARG0 "\n"); // iterator
+    emit_pop(out, ARG1); // end
+    emit_pop(out, ARG0); // iterator
     emit_call(out, "stola_lt");
-    fprintf(out, "    mov " ARG0 ", rax\n");
+    emit_lit(out, "    mov " ARG0 ", rax\n");
     emit_call(out, "stola_is_truthy");
-    fprintf(out, "    cmp rax, 0\n");
-    fprintf(out, "    je .L%d\n", loop_end);
+    emit_lit(out, "    cmp rax, 0\n");
+    emit_jump(out, "je", loop_end);
 
     generate_node(node->as.loop_stmt.body, out, analyzer, is_freestanding);
 
@@ -897,16 +1509,16 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
       generate_node(node->as.loop_stmt.step_expr, out, analyzer,
                     is_freestanding);
     } else {
-      fprintf(out, "    mov " ARG0 ", 1\n");
+      emit_lit(out, "    mov " ARG0 ", 1\n");
       emit_call(out, "stola_new_int");
-      fprintf(out, "    push rax\n");
+      emit_push(out, "rax");
     }
-    fprintf(out, "    pop " ARG1 "\n"); // step
-    fprintf(out, "    pop " ARG0 "\n"); // current
+    emit_pop(out, ARG1); // step
+    emit_pop(out, ARG0); // current
     emit_call(out, "stola_add");
     ra_store_var(out, iname);
-    fprintf(out, "    jmp .L%d\n", loop_start);
-    fprintf(out, ".L%d:\n", loop_end);
+    emit_jump(out, "jmp", loop_start);
+    emit_label(out, loop_end);
     break;
   }
 
@@ -915,32 +1527,32 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     int end_label = get_label();
     generate_node(node->as.match_stmt.condition, out, analyzer,
                   is_freestanding);
-    fprintf(out, "    pop r11\n"); // match value
+    emit_pop(out, "r11"); // match value
 
     for (int i = 0; i < node->as.match_stmt.case_count; i++) {
       int next_case = get_label();
-      fprintf(out, "    push r11\n"); // preserve match value
-      fprintf(out, "    mov " ARG0 ", r11\n");
-      fprintf(out, "    push " ARG0 "\n");
+      emit_push(out, "r11"); // preserve match value
+      emit_lit(out, "    mov " ARG0 ", r11\n");
+      emit_push(out, ARG0);
       generate_node(node->as.match_stmt.cases[i], out, analyzer,
                     is_freestanding);
-      fprintf(out, "    pop " ARG1 "\n"); // case value
-      fprintf(out, "    pop " ARG0 "\n"); // match value
+      emit_pop(out, ARG1); // case value
+      emit_pop(out, ARG0); // match value
       emit_call(out, "stola_eq");
-      fprintf(out, "    mov " ARG0 ", rax\n");
+      emit_lit(out, "    mov " ARG0 ", rax\n");
       emit_call(out, "stola_is_truthy");
-      fprintf(out, "    pop r11\n"); // restore match value
-      fprintf(out, "    cmp rax, 0\n");
-      fprintf(out, "    je .L%d\n", next_case);
+      emit_pop(out, "r11"); // restore match value
+      emit_lit(out, "    cmp rax, 0\n");
+      emit_jump(out, "je", next_case);
       generate_node(node->as.match_stmt.consequences[i], out, analyzer,
                     is_freestanding);
-      fprintf(out, "    jmp .L%d\n", end_label);
-      fprintf(out, ".L%d:\n", next_case);
+      emit_jump(out, "jmp", end_label);
+      emit_label(out, next_case);
     }
     if (node->as.match_stmt.default_consequence)
       generate_node(node->as.match_stmt.default_consequence, out, analyzer,
                     is_freestanding);
-    fprintf(out, ".L%d:\n", end_label);
+    emit_label(out, end_label);
     break;
   }
 
@@ -949,7 +1561,10 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     const char *p = node->as.asm_block.code;
     if (!p)
       break;
-    fprintf(out, "    /* asm block */\n");
+    // May move RSP in ways codegen cannot follow
+    if (stack_align >= 0)
+      align_failed = 1;
+    emit_lit(out, "    /* asm block */\n");
     // Emit each non-empty line with 4-space indentation
     while (*p) {
       while (*p == ' ' || *p == '\t')
@@ -960,13 +1575,17 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
       }
       if (*p == '\0')
         break;
-      fprintf(out, "    ");
+      const char *line = p;
       while (*p && *p != '\n')
-        fputc(*p++, out);
-      fprintf(out, "\n");
+        p++;
+      emit_lit(out, "    ");
+      emit_raw(out, line, p - line);
+      emit_lit(out, "\n");
       if (*p == '\n')
         p++;
     }
+    // The peephole pass copies everything up to here as written
+    emit_lit(out, "    /* end asm block */\n");
     break;
   }
 
@@ -974,40 +1593,42 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   case AST_FUNCTION_DECL: {
     if (node->as.function_decl.is_interrupt) {
       // ISR: exported global symbol, save/restore caller-saved regs, ends with iretq
-      fprintf(out, "\n.global %s\n", node->as.function_decl.name);
-      fprintf(out, "%s:\n", node->as.function_decl.name);
+      // RSP depends on the interrupt frame: calls realign at run time
+      stack_align = frame_align = -1;
+      emit_fmt(out, "\n.global %s\n", node->as.function_decl.name);
+      emit_fmt(out, "%s:\n", node->as.function_decl.name);
       // Save caller-saved registers (hardware pushed RIP/CS/RFLAGS/RSP/SS on entry)
       // rax/rcx/rdx/r8-r11: volatile on both Windows x64 and SysV AMD64
       // rsi/rdi: volatile on SysV AMD64 (callee-saved on Windows, but saving is safe)
-      fprintf(out, "    push rax\n");
-      fprintf(out, "    push rcx\n");
-      fprintf(out, "    push rdx\n");
-      fprintf(out, "    push r8\n");
-      fprintf(out, "    push r9\n");
-      fprintf(out, "    push r10\n");
-      fprintf(out, "    push r11\n");
-      fprintf(out, "    push rsi\n");
-      fprintf(out, "    push rdi\n");
+      emit_lit(out, "    push rax\n");
+      emit_lit(out, "    push rcx\n");
+      emit_lit(out, "    push rdx\n");
+      emit_lit(out, "    push r8\n");
+      emit_lit(out, "    push r9\n");
+      emit_lit(out, "    push r10\n");
+      emit_lit(out, "    push r11\n");
+      emit_lit(out, "    push rsi\n");
+      emit_lit(out, "    push rdi\n");
       // Stack frame so asm {} variable offsets work
-      fprintf(out, "    push rbp\n");
-      fprintf(out, "    mov rbp, rsp\n");
-      fprintf(out, "    sub rsp, 256\n");
+      emit_lit(out, "    push rbp\n");
+      emit_lit(out, "    mov rbp, rsp\n");
+      emit_lit(out, "    sub rsp, 256\n");
 
       generate_node(node->as.function_decl.body, out, analyzer, is_freestanding);
 
-      fprintf(out, "    add rsp, 256\n");
-      fprintf(out, "    pop rbp\n");
+      emit_lit(out, "    add rsp, 256\n");
+      emit_lit(out, "    pop rbp\n");
       // Restore caller-saved registers in reverse order
-      fprintf(out, "    pop rdi\n");
-      fprintf(out, "    pop rsi\n");
-      fprintf(out, "    pop r11\n");
-      fprintf(out, "    pop r10\n");
-      fprintf(out, "    pop r9\n");
-      fprintf(out, "    pop r8\n");
-      fprintf(out, "    pop rdx\n");
-      fprintf(out, "    pop rcx\n");
-      fprintf(out, "    pop rax\n");
-      fprintf(out, "    iretq\n");
+      emit_lit(out, "    pop rdi\n");
+      emit_lit(out, "    pop rsi\n");
+      emit_lit(out, "    pop r11\n");
+      emit_lit(out, "    pop r10\n");
+      emit_lit(out, "    pop r9\n");
+      emit_lit(out, "    pop r8\n");
+      emit_lit(out, "    pop rdx\n");
+      emit_lit(out, "    pop rcx\n");
+      emit_lit(out, "    pop rax\n");
+      emit_lit(out, "    iretq\n");
       break;
     }
 
@@ -1018,12 +1639,17 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     int epi_label = get_label();
     current_epilogue_label = epi_label;
 
-    fprintf(out, "\n%s:\n", node->as.function_decl.name);
-    fprintf(out, "    push rbp\n");
-    fprintf(out, "    mov rbp, rsp\n");
+    emit_fmt(out, "\n%s:\n", node->as.function_decl.name);
+    frame_enter(!is_freestanding);
+    emit_push(out, "rbp");
+    emit_lit(out, "    mov rbp, rsp\n");
     // Save callee-saved regs we're about to use for local variables
     ra_save_regs(out);
-    fprintf(out, "    sub rsp, 512\n");
+    // An odd number of them is padded so statements start aligned
+    int frame_size = stack_align == 8 ? 520 : 512;
+    emit_op_reg_imm(out, "sub", "rsp", frame_size);
+    stack_align = stack_align >= 0 ? 0 : -1;
+    frame_align = stack_align;
 
     // Store incoming parameters into their allocated locations (reg or stack)
     const char *abi_regs[] = {ARG0, ARG1, ARG2, ARG3};
@@ -1031,10 +1657,9 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
       const char *pname = node->as.function_decl.parameters[i];
       const char *preg  = ra_get_reg(pname);
       if (preg) {
-        fprintf(out, "    mov %s, %s\n", preg, abi_regs[i]);
+        emit_op_reg_reg(out, "mov", preg, abi_regs[i]);
       } else {
-        fprintf(out, "    mov [rbp - %d], %s\n",
-                ra_get_offset(pname), abi_regs[i]);
+        emit_op_mem_reg(out, "mov", "rbp", -ra_get_offset(pname), abi_regs[i]);
       }
     }
 
@@ -1043,12 +1668,13 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     // Default null return falls through to shared epilogue
     if (!is_freestanding)
       emit_call(out, "stola_new_null");
-    fprintf(out, ".L%d:  /* function epilogue: %s */\n",
+    stack_join();
+    emit_fmt(out, ".L%s%d:  /* function epilogue: %s */\n", unit_tag,
             epi_label, node->as.function_decl.name);
-    fprintf(out, "    add rsp, 512\n");
+    emit_op_reg_imm(out, "add", "rsp", frame_size);
     ra_restore_regs(out);
-    fprintf(out, "    pop rbp\n");
-    fprintf(out, "    ret\n");
+    emit_lit(out, "    pop rbp\n");
+    emit_lit(out, "    ret\n");
     current_epilogue_label = -1;
     break;
   }
@@ -1058,21 +1684,21 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     if (node->as.return_stmt.return_value) {
       generate_node(node->as.return_stmt.return_value, out, analyzer,
                     is_freestanding);
-      fprintf(out, "    pop rax\n");
+      emit_pop(out, "rax");
     } else {
       if (!is_freestanding)
         emit_call(out, "stola_new_null");
       else
-        fprintf(out, "    xor rax, rax\n");
+        emit_lit(out, "    xor rax, rax\n");
     }
     if (current_epilogue_label >= 0) {
       /* Jump to the shared epilogue so callee-saved regs are properly restored */
-      fprintf(out, "    jmp .L%d\n", current_epilogue_label);
+      emit_jump(out, "jmp", current_epilogue_label);
     } else {
       /* Fallback: main body or code outside a function declaration */
-      fprintf(out, "    add rsp, 512\n");
-      fprintf(out, "    pop rbp\n");
-      fprintf(out, "    ret\n");
+      emit_lit(out, "    add rsp, 512\n");
+      emit_lit(out, "    pop rbp\n");
+      emit_lit(out, "    ret\n");
     }
     break;
   }
@@ -1092,90 +1718,92 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
                       is_freestanding);
       }
       if (node->as.call_expr.arg_count > 1)
-        fprintf(out, "    pop " ARG3 "\n");
+        emit_pop(out, ARG3);
       if (node->as.call_expr.arg_count > 0)
-        fprintf(out, "    pop " ARG2 "\n");
+        emit_pop(out, ARG2);
 
-      fprintf(out, "    pop " ARG0 "\n"); // pop obj (this)
+      emit_pop(out, ARG0); // pop obj (this)
 
       int mid = add_string_literal(mname);
-      fprintf(out, "    lea " ARG1 ", [rip + .str%d]\n", mid);
+      emit_lea_str(out, ARG1, mid);
       emit_call(out, "stola_invoke_method");
-      fprintf(out, "    push rax\n"); // method return value
+      emit_push(out, "rax"); // method return value
     } else if (node->as.call_expr.function->type == AST_IDENTIFIER) {
       const char *name = node->as.call_expr.function->as.identifier.value;
       BuiltinEntry *bi = find_builtin(name);
-      Symbol *sym = resolve_symbol(analyzer, name);
+      // Resolved once by the semantic pass
+      Symbol *sym = node->as.call_expr.function->as.identifier.symbol;
 
       if (sym && sym->type == SYMBOL_C_FUNCTION) {
-        for (int i = 0; i < node->as.call_expr.arg_count && i < 4; i++) {
+        // stola_invoke_c_function(name, a1, a2, a3, a4): missing arguments
+        // are passed as NULL. The fourth travels in r8 on System V; on
+        // Windows it would need a stack slot, so only three are supported.
+#ifdef _WIN32
+        int cargs = node->as.call_expr.arg_count < 3
+                        ? node->as.call_expr.arg_count : 3;
+#else
+        int cargs = node->as.call_expr.arg_count < 4
+                        ? node->as.call_expr.arg_count : 4;
+#endif
+        for (int i = 0; i < cargs; i++) {
           generate_node(node->as.call_expr.args[i], out, analyzer,
                         is_freestanding);
         }
 
-        if (node->as.call_expr.arg_count > 2)
-          fprintf(out, "    pop " ARG3 "\n");
-        if (node->as.call_expr.arg_count > 1)
-          fprintf(out, "    pop " ARG2 "\n");
-        if (node->as.call_expr.arg_count > 0)
-          fprintf(out, "    pop " ARG1 "\n");
+#ifndef _WIN32
+        if (cargs > 3)
+          emit_pop(out, "r8");
+        else
+          emit_lit(out, "    xor r8d, r8d\n");
+#endif
+        if (cargs > 2)
+          emit_pop(out, ARG3);
+        else
+          emit_op_reg_reg(out, "xor", ARG3, ARG3);
+        if (cargs > 1)
+          emit_pop(out, ARG2);
+        else
+          emit_op_reg_reg(out, "xor", ARG2, ARG2);
+        if (cargs > 0)
+          emit_pop(out, ARG1);
+        else
+          emit_op_reg_reg(out, "xor", ARG1, ARG1);
 
         int sid = add_string_literal(name);
-        fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", sid);
+        emit_lea_str(out, ARG0, sid);
         emit_call(out, "stola_invoke_c_function");
-        fprintf(out, "    push rax\n");
-
-      } else if (strcmp(name, "thread_spawn") == 0 &&
-                 node->as.call_expr.arg_count == 2) {
-        // Arg 1 is function identifier!
-        const char *fn_name = node->as.call_expr.args[0]->as.identifier.value;
-        fprintf(out, "    lea " ARG0 ", [rip + %s]\n", fn_name);
-        // Arg 2 is the actual argument to pass
-        generate_node(node->as.call_expr.args[1], out, analyzer,
-                      is_freestanding);
-        fprintf(out, "    pop " ARG1 "\n");
-
-        emit_call(out, "stola_thread_spawn");
-        fprintf(out, "    push rax\n");
+        emit_push(out, "rax");
 
       } else if (is_freestanding && strcmp(name, "memory_read") == 0 &&
                  node->as.call_expr.arg_count == 1) {
         /* memory_read(addr) — read 8-byte qword at address */
         generate_node(node->as.call_expr.args[0], out, analyzer, is_freestanding);
-        fprintf(out, "    pop rax\n");           /* address */
-        fprintf(out, "    mov rax, [rax]\n");    /* dereference */
-        fprintf(out, "    push rax\n");
+        emit_pop(out, "rax"); /* address */
+        emit_lit(out, "    mov rax, [rax]\n"); /* dereference */
+        emit_push(out, "rax");
 
       } else if (is_freestanding && strcmp(name, "memory_write") == 0 &&
                  node->as.call_expr.arg_count == 2) {
         /* memory_write(addr, val) — write 8-byte qword */
         generate_node(node->as.call_expr.args[0], out, analyzer, is_freestanding);
         generate_node(node->as.call_expr.args[1], out, analyzer, is_freestanding);
-        fprintf(out, "    pop rcx\n");           /* value */
-        fprintf(out, "    pop rax\n");           /* address */
-        fprintf(out, "    mov [rax], rcx\n");
-        fprintf(out, "    push 0\n");
+        emit_pop(out, "rcx"); /* value */
+        emit_pop(out, "rax"); /* address */
+        emit_lit(out, "    mov [rax], rcx\n");
+        emit_push(out, "0");
 
       } else if (is_freestanding && strcmp(name, "memory_write_byte") == 0 &&
                  node->as.call_expr.arg_count == 2) {
         /* memory_write_byte(addr, byte_val) — write 1 byte */
         generate_node(node->as.call_expr.args[0], out, analyzer, is_freestanding);
         generate_node(node->as.call_expr.args[1], out, analyzer, is_freestanding);
-        fprintf(out, "    pop rcx\n");           /* byte value */
-        fprintf(out, "    pop rax\n");           /* address */
-        fprintf(out, "    mov byte ptr [rax], cl\n");
-        fprintf(out, "    push 0\n");
+        emit_pop(out, "rcx"); /* byte value */
+        emit_pop(out, "rax"); /* address */
+        emit_lit(out, "    mov byte ptr [rax], cl\n");
+        emit_push(out, "0");
 
       } else if (bi) {
-        // Built-in: evaluate args, put in ABI registers, call C function
-        const char *regs[] = {ARG0, ARG1, ARG2, ARG3};
-        for (int i = 0; i < node->as.call_expr.arg_count && i < 4; i++)
-          generate_node(node->as.call_expr.args[i], out, analyzer,
-                        is_freestanding);
-        for (int i = node->as.call_expr.arg_count - 1; i >= 0 && i < 4; i--)
-          fprintf(out, "    pop %s\n", regs[i]);
-        emit_call(out, bi->c_name);
-        fprintf(out, "    push rax\n");
+        generate_builtin_call(node, bi->c_name, out, analyzer, is_freestanding);
       } else {
         // User-defined function call
         const char *regs[] = {ARG0, ARG1, ARG2, ARG3};
@@ -1183,9 +1811,9 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
           generate_node(node->as.call_expr.args[i], out, analyzer,
                         is_freestanding);
         for (int i = node->as.call_expr.arg_count - 1; i >= 0 && i < 4; i--)
-          fprintf(out, "    pop %s\n", regs[i]);
+          emit_pop_str(out, regs[i]);
         emit_call(out, name);
-        fprintf(out, "    push rax\n");
+        emit_push(out, "rax");
       }
     }
     break;
@@ -1199,37 +1827,37 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
       // Dynamic: arr at i  /  dict[expr]  — evaluate key as StolaValue*
       generate_node(node->as.member_access.property, out, analyzer,
                     is_freestanding);
-      fprintf(out, "    pop " ARG1 "\n"); // key
-      fprintf(out, "    pop " ARG0 "\n"); // object
+      emit_pop(out, ARG1); // key
+      emit_pop(out, ARG0); // object
       emit_call(out, "stola_getitem");
     } else {
       // Static dot: obj.field  — use string literal as key
-      fprintf(out, "    pop " ARG0 "\n"); // obj
+      emit_pop(out, ARG0); // obj
       const char *field = node->as.member_access.property->as.identifier.value;
       int fid = add_string_literal(field);
-      fprintf(out, "    lea " ARG1 ", [rip + .str%d]\n", fid);
+      emit_lea_str(out, ARG1, fid);
       emit_call(out, "stola_struct_get");
     }
-    fprintf(out, "    push rax\n");
+    emit_push(out, "rax");
     break;
   }
 
   // --- Array Literal ---
   case AST_ARRAY_LITERAL: {
     emit_call(out, "stola_new_array");
-    fprintf(out, "    push rax\n"); // array on stack
+    emit_push(out, "rax"); // array on stack
 
     for (int i = 0; i < node->as.array_literal.element_count; i++) {
       generate_node(node->as.array_literal.elements[i], out, analyzer,
                     is_freestanding);
       // Stack: [..., array, element]
-      fprintf(out, "    pop " ARG1 "\n");  // element
-      fprintf(out, "    pop " ARG0 "\n");  // array
-      fprintf(out, "    push " ARG0 "\n"); // keep array
-      fprintf(out, "    push " ARG1 "\n"); // save element
-      fprintf(out, "    pop " ARG1 "\n");  // element in ARG1
+      emit_pop(out, ARG1); // element
+      emit_pop(out, ARG0); // array
+      emit_push(out, ARG0); // keep array
+      emit_push(out, ARG1); // save element
+      emit_pop(out, ARG1); // element in ARG1
       // ARG0 was popped and repushed, need it in ARG0
-      fprintf(out, "    mov " ARG0 ", [rsp]\n"); // peek array from stack top
+      emit_lit(out, "    mov " ARG0 ", [rsp]\n"); // peek array from stack top
       emit_call(out, "stola_push");
     }
     // Array pointer is still on stack top
@@ -1239,22 +1867,22 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   // --- Dict Literal ---
   case AST_DICT_LITERAL: {
     emit_call(out, "stola_new_dict");
-    fprintf(out, "    push rax\n"); // dict on stack
+    emit_push(out, "rax"); // dict on stack
 
     for (int i = 0; i < node->as.dict_literal.pair_count; i++) {
       const char *key_str = node->as.dict_literal.keys[i]->as.identifier.value;
       int kid = add_string_literal(key_str);
-      fprintf(out, "    lea " ARG0 ", [rip + .str%d]\n", kid);
+      emit_lea_str(out, ARG0, kid);
       emit_call(out, "stola_new_string");
-      fprintf(out, "    push rax\n"); // key
+      emit_push(out, "rax"); // key
 
       // Generate value
       generate_node(node->as.dict_literal.values[i], out, analyzer,
                     is_freestanding);
       // Stack: [..., dict, key, value]
-      fprintf(out, "    pop " ARG2 "\n");         // value
-      fprintf(out, "    pop " ARG1 "\n");        // key
-      fprintf(out, "    mov " ARG0 ", [rsp]\n"); // peek dict
+      emit_pop(out, ARG2); // value
+      emit_pop(out, ARG1); // key
+      emit_lit(out, "    mov " ARG0 ", [rsp]\n"); // peek dict
       emit_call(out, "stola_dict_set");
     }
     break;
@@ -1266,15 +1894,15 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     int end_label = get_label();
 
     emit_call(out, "stola_push_try"); // returns int64_t* in rax
-    fprintf(out, "    mov " ARG0 ", rax\n");
+    emit_lit(out, "    mov " ARG0 ", rax\n");
 
     // CRITICAL: Call our custom assembly setjmp DIRECTLY without emit_call
     // because emit_call creates an ephemeral stack frame that gets overwritten
     // by the try block, corrupting the restored stack pointer on longjmp!
-    fprintf(out, "    call stola_setjmp\n");
+    emit_lit(out, "    call stola_setjmp\n");
 
-    fprintf(out, "    cmp rax, 0\n");
-    fprintf(out, "    jne .L%d\n", catch_label); // longjmp sets rax=1
+    emit_lit(out, "    cmp rax, 0\n");
+    emit_jump(out, "jne", catch_label); // longjmp sets rax=1
 
     // Try block
     generate_node(node->as.try_catch_stmt.try_block, out, analyzer,
@@ -1282,10 +1910,10 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
 
     // Normal exit: pop handler
     emit_call(out, "stola_pop_try");
-    fprintf(out, "    jmp .L%d\n", end_label);
+    emit_jump(out, "jmp", end_label);
 
     // Catch block
-    fprintf(out, ".L%d:\n", catch_label);
+    emit_label(out, catch_label);
     emit_call(out, "stola_pop_try");   // pop the handler we just jumped from
     emit_call(out, "stola_get_error"); // rax = StolaValue* Error Data
     ra_store_var(out, node->as.try_catch_stmt.catch_var);
@@ -1293,7 +1921,7 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
     generate_node(node->as.try_catch_stmt.catch_block, out, analyzer,
                   is_freestanding);
 
-    fprintf(out, ".L%d:\n", end_label);
+    emit_label(out, end_label);
     break;
   }
 
@@ -1301,7 +1929,7 @@ static void generate_node(ASTNode *node, FILE *out, SemanticAnalyzer *analyzer,
   case AST_THROW: {
     generate_node(node->as.throw_stmt.exception_value, out, analyzer,
                   is_freestanding);
-    fprintf(out, "    pop " ARG0 "\n"); // exception value
+    emit_pop(out, ARG0); // exception value
     emit_call(out, "stola_throw"); // does not return
     break;
   }
@@ -3,8 +3,21 @@
 
 #include "ast.h"
 #include "semantic.h"
+#include <stdio.h>
 
-void codegen_generate(ASTNode *program, SemanticAnalyzer *analyzer,
-                      const char *output_file, int is_freestanding);
+// Function bodies are generated on up to `jobs` threads (<= 0: one per
+// core); the output is the same for any job count. Function declarations
+// without a body (cached modules) are skipped. Returns 0 on failure.
+int codegen_generate(ASTNode *program, SemanticAnalyzer *analyzer, FILE *out,
+                     int is_freestanding, int jobs);
+
+// Emit only the given functions (an imported module) to `out`, naming their
+// labels and literals with `prefix` so the text can be appended to another
+// program's output. Returns 0 on failure.
+int codegen_generate_module(ASTNode **decls, int count, const char *prefix,
+                            SemanticAnalyzer *analyzer, FILE *out, int jobs);
+
+// Identifies the code generator; part of the module cache key.
+const char *codegen_version(void);
 
 #endif // CODEGEN_H
@@ -0,0 +1,82 @@
+#include "intern.h"
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *str; // NULL = empty slot
+  uint32_t hash;
+  uint32_t len;
+} InternSlot;
+
+static InternSlot *intern_slots;
+static size_t intern_capacity; // power of two
+static size_t intern_count;
+
+// FNV-1a; identifiers are short, so this beats anything fancier.
+static uint32_t intern_hash(const char *s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static InternSlot *intern_probe(const char *s, size_t len, uint32_t hash) {
+  size_t mask = intern_capacity - 1;
+  size_t i = hash & mask;
+  for (;;) {
+    InternSlot *slot = &intern_slots[i];
+    if (!slot->str || (slot->hash == hash && slot->len == len &&
+                       memcmp(slot->str, s, len) == 0))
+      return slot;
+    i = (i + 1) & mask;
+  }
+}
+
+static void intern_grow(void) {
+  InternSlot *old = intern_slots;
+  size_t old_capacity = intern_capacity;
+  intern_capacity = old_capacity ? old_capacity * 2 : 1024;
+  intern_slots = calloc(intern_capacity, sizeof(InternSlot));
+  if (!intern_slots)
+    abort();
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].str)
+      *intern_probe(old[i].str, old[i].len, old[i].hash) = old[i];
+  }
+  free(old);
+}
+
+char *intern_string(const char *s, size_t len) {
+  // Keep the load factor under 1/2
+  if ((intern_count + 1) * 2 > intern_capacity)
+    intern_grow();
+  uint32_t hash = intern_hash(s, len);
+  InternSlot *slot = intern_probe(s, len, hash);
+  if (!slot->str) {
+    slot->str = arena_strndup(&compile_arena, s, len);
+    slot->hash = hash;
+    slot->len = (uint32_t)len;
+    intern_count++;
+  }
+  return (char *)slot->str;
+}
+
+char *intern_cstr(const char *s) { return intern_string(s, strlen(s)); }
+
+const char *intern_find(const char *s) {
+  if (!intern_capacity)
+    return NULL;
+  size_t len = strlen(s);
+  return intern_probe(s, len, intern_hash(s, len))->str;
+}
+
+void intern_release(void) {
+  free(intern_slots);
+  intern_slots = NULL;
+  intern_capacity = 0;
+  intern_count = 0;
+}
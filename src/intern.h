@@ -0,0 +1,23 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// Identifier interning: every distinct spelling is stored once in
+// compile_arena, so two interned names are equal iff their pointers are.
+// Symbol tables key on the pointer instead of comparing strings.
+//
+// The returned text must not be modified. It is typed `char *` only because
+// the AST name fields are.
+
+char *intern_string(const char *s, size_t len);
+char *intern_cstr(const char *s);
+
+// Lookup without inserting: NULL when `s` was never interned, which also
+// means no symbol can be named `s`.
+const char *intern_find(const char *s);
+
+// Drops the table; call before arena_release(&compile_arena).
+void intern_release(void);
+
+#endif // INTERN_H
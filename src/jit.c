@@ -0,0 +1,155 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+#endif
+#include "jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+int jit_run(const X64Object *obj, const char *runtime_path, int argc,
+            char **argv, int *status) {
+  (void)obj;
+  (void)runtime_path;
+  (void)argc;
+  (void)argv;
+  (void)status;
+  printf("Error: run mode is not available on Windows\n");
+  return 0;
+}
+
+#else
+
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// "jmp [rip + 0]" followed by the absolute target: reaches any address, so
+// rel32 calls into the runtime work wherever dlopen placed it.
+#define STUB_SIZE 16
+
+static size_t round_up(size_t n, size_t to) { return (n + to - 1) / to * to; }
+
+static void write_stub(uint8_t *p, uint64_t target) {
+  static const uint8_t jmp[6] = {0xFF, 0x25, 0, 0, 0, 0};
+  memcpy(p, jmp, sizeof(jmp));
+  memcpy(p + 6, &target, 8);
+  p[14] = p[15] = 0xCC;
+}
+
+int jit_run(const X64Object *obj, const char *runtime_path, int argc,
+            char **argv, int *status) {
+  int main_index = x64_find_symbol(obj, "main");
+  if (main_index < 0 || obj->symbols[main_index].section != X64_TEXT) {
+    printf("Error: program has no main\n");
+    return 0;
+  }
+
+  // RTLD_GLOBAL so FFI lookups from the runtime see it too
+  void *runtime = dlopen(runtime_path, RTLD_NOW | RTLD_GLOBAL);
+  if (!runtime) {
+    printf("Error: could not load the runtime: %s\n", dlerror());
+    printf("Build it with 'make runtime' or set STOLA_RUNTIME.\n");
+    return 0;
+  }
+  void *process = dlopen(NULL, RTLD_NOW);
+
+  // One stub per external function; data symbols are not referenced by
+  // generated code
+  const X64Buffer *text = &obj->sections[X64_TEXT];
+  const X64Buffer *data = &obj->sections[X64_DATA];
+  int *stub = malloc((obj->symbol_count + 1) * sizeof(int));
+  int stub_count = 0;
+  for (int i = 0; i < obj->symbol_count; i++)
+    stub[i] = (obj->symbols[i].section == X64_UNDEF &&
+               obj->symbols[i].is_referenced)
+                  ? stub_count++
+                  : -1;
+
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t stubs_offset = round_up(text->size, STUB_SIZE);
+  size_t text_size = round_up(stubs_offset + stub_count * STUB_SIZE, page);
+  size_t data_size = round_up(data->size, page);
+  uint8_t *mem = mmap(NULL, text_size + data_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    printf("Error: could not map memory for the program\n");
+    free(stub);
+    return 0;
+  }
+  uint8_t *base[X64_SECTION_COUNT] = {NULL, mem, mem + text_size};
+  if (text->size)
+    memcpy(base[X64_TEXT], text->data, text->size);
+  if (data->size)
+    memcpy(base[X64_DATA], data->data, data->size);
+
+  int ok = 1;
+  uint64_t *address = calloc(obj->symbol_count + 1, sizeof(uint64_t));
+  for (int i = 0; i < obj->symbol_count && ok; i++) {
+    if (stub[i] < 0)
+      continue;
+    const char *name = obj->symbols[i].name;
+    void *sym = dlsym(runtime, name);
+    if (!sym && process)
+      sym = dlsym(process, name);
+    if (!sym) {
+      printf("Error: undefined symbol '%s'\n", name);
+      ok = 0;
+      break;
+    }
+    address[i] = (uint64_t)(uintptr_t)sym;
+    write_stub(base[X64_TEXT] + stubs_offset + stub[i] * STUB_SIZE,
+               address[i]);
+  }
+
+  for (int i = 0; i < obj->reloc_count && ok; i++) {
+    const X64Reloc *r = &obj->relocs[i];
+    uint8_t *field = base[r->section] + r->offset;
+    uint64_t target;
+    if (r->target_section != X64_UNDEF)
+      target = (uint64_t)(uintptr_t)base[r->target_section] + r->addend;
+    else if (r->type == X64_RELOC_ABS64)
+      target = address[r->symbol] + r->addend;
+    else
+      target = (uint64_t)(uintptr_t)(base[X64_TEXT] + stubs_offset +
+                                     stub[r->symbol] * STUB_SIZE) +
+               r->addend;
+
+    if (r->type == X64_RELOC_ABS64) {
+      memcpy(field, &target, 8);
+    } else {
+      int64_t rel = (int64_t)(target - (uint64_t)(uintptr_t)field);
+      if (rel < INT32_MIN || rel > INT32_MAX) {
+        printf("Error: relocation out of range\n");
+        ok = 0;
+        break;
+      }
+      int32_t rel32 = (int32_t)rel;
+      memcpy(field, &rel32, 4);
+    }
+  }
+  free(address);
+  free(stub);
+
+  if (ok && mprotect(mem, text_size, PROT_READ | PROT_EXEC) != 0) {
+    printf("Error: could not make the program executable\n");
+    ok = 0;
+  }
+  if (!ok) {
+    munmap(mem, text_size + data_size);
+    return 0;
+  }
+
+  // The mapping stays for the rest of the process: runtime threads may
+  // still be running program code when main returns.
+  int (*entry)(int, char **);
+  void *main_address = base[X64_TEXT] + obj->symbols[main_index].offset;
+  memcpy(&entry, &main_address, sizeof(entry));
+  *status = entry(argc, argv);
+  return 1;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "x64asm.h"
+
+// In-process execution of an assembled program (`stolascript run`). The
+// runtime is loaded as a shared library (libstola.so, built by
+// `make runtime`); calls to undefined symbols go through stubs that jump to
+// the runtime or to any library already loaded in the process.
+//
+// Runs `main` from `obj` with argc/argv and stores its return value in
+// *status. Returns 0 (after printing the reason) when the program cannot be
+// loaded. POSIX only.
+int jit_run(const X64Object *obj, const char *runtime_path, int argc,
+            char **argv, int *status);
+
+#endif // JIT_H
@@ -1,9 +1,116 @@
 #include "lexer.h"
-#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// Character classes for the hot scanning loops. Indexed by unsigned char so
+// non-ASCII bytes are simply "other" (isalpha() on a negative char is UB).
+#define CC_ALPHA 1 // a-z A-Z _
+#define CC_DIGIT 2 // 0-9
+#define CC_SPACE 4 // ' ' '\t' '\r' (newlines are tokens)
+
+static const unsigned char char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 0, 0, 0, 0,
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#define CHAR_IS(c, cls) (char_class[(unsigned char)(c)] & (cls))
+#define IS_IDENT_START(c) CHAR_IS(c, CC_ALPHA)
+#define IS_DIGIT(c) CHAR_IS(c, CC_DIGIT)
+
+// Keywords and word operators, looked up with a perfect hash over the
+// first two bytes, the last byte and the length. The multipliers were found
+// by exhaustive search so that every entry below lands in its own slot; a
+// new keyword must be checked for collisions (and the constants re-searched
+// if needed). `phrase` marks words that may start a multi-word operator
+// ("less than", "greater or equals", "divided by", "not equals"); those
+// that are not keywords on their own map to TOKEN_IDENTIFIER.
+typedef struct {
+  const char *word;
+  unsigned char len;
+  TokenType type;
+  unsigned char phrase;
+} Keyword;
+
+#define KEYWORD_MIN_LEN 2
+#define KEYWORD_MAX_LEN 13
+#define KEYWORD_HASH(s, n)                                                     \
+  (((unsigned char)(s)[0] * 2 + (unsigned char)(s)[1] * 10 +                   \
+    (unsigned char)(s)[(n) - 1] + (unsigned)(n) * 12) &                        \
+   127)
+
+static const Keyword keyword_table[128] = {
+    [2] = {"default", 7, TOKEN_DEFAULT, 0},
+    [8] = {"greater", 7, TOKEN_IDENTIFIER, 1},
+    [10] = {"null", 4, TOKEN_NULL, 0},
+    [12] = {"return", 6, TOKEN_RETURN, 0},
+    [14] = {"step", 4, TOKEN_STEP, 0},
+    [21] = {"import_native", 13, TOKEN_IMPORT_NATIVE, 0},
+    [22] = {"and", 3, TOKEN_AND, 0},
+    [23] = {"else", 4, TOKEN_ELSE, 0},
+    [24] = {"elif", 4, TOKEN_ELIF, 0},
+    [26] = {"divided", 7, TOKEN_IDENTIFIER, 1},
+    [27] = {"this", 4, TOKEN_THIS, 0},
+    [30] = {"end", 3, TOKEN_END, 0},
+    [31] = {"while", 5, TOKEN_WHILE, 0},
+    [35] = {"minus", 5, TOKEN_MINUS, 0},
+    [36] = {"in", 2, TOKEN_IN, 0},
+    [37] = {"case", 4, TOKEN_CASE, 0},
+    [42] = {"struct", 6, TOKEN_STRUCT, 0},
+    [43] = {"throw", 5, TOKEN_THROW, 0},
+    [44] = {"function", 8, TOKEN_FUNCTION, 0},
+    [45] = {"class", 5, TOKEN_CLASS, 0},
+    [49] = {"times", 5, TOKEN_TIMES, 0},
+    [52] = {"catch", 5, TOKEN_CATCH, 0},
+    [55] = {"false", 5, TOKEN_FALSE, 0},
+    [56] = {"for", 3, TOKEN_FOR, 0},
+    [59] = {"plus", 4, TOKEN_PLUS, 0},
+    [69] = {"to", 2, TOKEN_TO, 0},
+    [72] = {"match", 5, TOKEN_MATCH, 0},
+    [74] = {"not", 3, TOKEN_NOT, 1},
+    [76] = {"if", 2, TOKEN_IF, 0},
+    [78] = {"loop", 4, TOKEN_LOOP, 0},
+    [80] = {"import", 6, TOKEN_IMPORT, 0},
+    [81] = {"asm", 3, TOKEN_ASM, 0},
+    [86] = {"at", 2, TOKEN_AT, 0},
+    [92] = {"or", 2, TOKEN_OR, 0},
+    [93] = {"from", 4, TOKEN_FROM, 0},
+    [95] = {"break", 5, TOKEN_BREAK, 0},
+    [97] = {"continue", 8, TOKEN_CONTINUE, 0},
+    [98] = {"c_function", 10, TOKEN_C_FUNCTION, 0},
+    [100] = {"power", 5, TOKEN_POWER, 0},
+    [103] = {"modulo", 6, TOKEN_MODULO, 0},
+    [105] = {"new", 3, TOKEN_NEW, 0},
+    [109] = {"less", 4, TOKEN_IDENTIFIER, 1},
+    [111] = {"equals", 6, TOKEN_EQUALS, 0},
+    [113] = {"true", 4, TOKEN_TRUE, 0},
+    [121] = {"try", 3, TOKEN_TRY, 0},
+    [126] = {"interrupt", 9, TOKEN_INTERRUPT, 0},
+};
+
+static const Keyword *keyword_lookup(const char *s, int len) {
+  if (len < KEYWORD_MIN_LEN || len > KEYWORD_MAX_LEN)
+    return NULL;
+  const Keyword *kw = &keyword_table[KEYWORD_HASH(s, len)];
+  if (kw->len == len && memcmp(kw->word, s, len) == 0)
+    return kw;
+  return NULL;
+}
+
 void lexer_init(Lexer *lexer, const char *source) {
   lexer->source = source;
   lexer->position = 0;
@@ -40,146 +147,64 @@ static char lexer_peek_char(Lexer *lexer) {
   }
 }
 
-static void lexer_skip_whitespace(Lexer *lexer) {
-  while (lexer->ch == ' ' || lexer->ch == '\t' || lexer->ch == '\r') {
-    lexer_read_char(lexer);
-  }
+// Advances over a run of characters of class `cls` with a plain pointer scan
+// instead of one lexer_read_char() per byte. None of the classes include '\n',
+// so only the column moves.
+static void lexer_skip_class(Lexer *lexer, unsigned char cls) {
+  const char *start = lexer->source + lexer->position;
+  const char *p = start;
+  while (CHAR_IS(*p, cls))
+    p++;
+  int n = (int)(p - start);
+  if (n == 0)
+    return;
+  lexer->position += n;
+  lexer->read_position = lexer->position + 1;
+  lexer->ch = *p;
+  lexer->column += n;
 }
 
-static Token *create_token(TokenType type, const char *literal, int len,
-                           int line, int column) {
-  Token *token = malloc(sizeof(Token));
-  token->type = type;
-  token->line = line;
-  token->column = column;
-
-  if (literal) {
-    token->literal = malloc(len + 1);
-    strncpy(token->literal, literal, len);
-    token->literal[len] = '\0';
-  } else {
-    token->literal = NULL;
-  }
+static void lexer_skip_whitespace(Lexer *lexer) {
+  lexer_skip_class(lexer, CC_SPACE);
+}
 
+// Tokens are returned by value and point into the source buffer (or at a
+// string constant for synthesized text), so lexing allocates nothing.
+static Token create_token(TokenType type, const char *literal, int len,
+                          int line, int column) {
+  Token token;
+  token.type = type;
+  token.literal = literal;
+  token.length = len;
+  token.line = line;
+  token.column = column;
   return token;
 }
 
-static Token *create_char_token(TokenType type, Lexer *lexer) {
-  char str[2] = {lexer->ch, '\0'};
-  Token *tok = create_token(type, str, 1, lexer->line, lexer->column);
+static Token create_char_token(TokenType type, Lexer *lexer) {
+  Token tok = create_token(type, lexer->source + lexer->position, 1,
+                           lexer->line, lexer->column);
   lexer_read_char(lexer);
   return tok;
 }
 
-static Token *read_identifier(Lexer *lexer) {
+static Token read_identifier(Lexer *lexer) {
   int start_pos = lexer->position;
   int col = lexer->column;
 
-  while (isalpha(lexer->ch) || lexer->ch == '_' || isdigit(lexer->ch)) {
-    lexer_read_char(lexer);
-  }
+  lexer_skip_class(lexer, CC_ALPHA | CC_DIGIT);
 
   int len = lexer->position - start_pos;
-  char *literal = malloc(len + 1);
-  strncpy(literal, lexer->source + start_pos, len);
-  literal[len] = '\0';
-
-  TokenType type = TOKEN_IDENTIFIER;
-
-  // Check keywords
-  if (strcmp(literal, "if") == 0)
-    type = TOKEN_IF;
-  else if (strcmp(literal, "else") == 0)
-    type = TOKEN_ELSE;
-  else if (strcmp(literal, "elif") == 0)
-    type = TOKEN_ELIF;
-  else if (strcmp(literal, "while") == 0)
-    type = TOKEN_WHILE;
-  else if (strcmp(literal, "for") == 0)
-    type = TOKEN_FOR;
-  else if (strcmp(literal, "loop") == 0)
-    type = TOKEN_LOOP;
-  else if (strcmp(literal, "function") == 0)
-    type = TOKEN_FUNCTION;
-  else if (strcmp(literal, "match") == 0)
-    type = TOKEN_MATCH;
-  else if (strcmp(literal, "case") == 0)
-    type = TOKEN_CASE;
-  else if (strcmp(literal, "default") == 0)
-    type = TOKEN_DEFAULT;
-  else if (strcmp(literal, "struct") == 0)
-    type = TOKEN_STRUCT;
-  else if (strcmp(literal, "class") == 0)
-    type = TOKEN_CLASS;
-  else if (strcmp(literal, "this") == 0)
-    type = TOKEN_THIS;
-  else if (strcmp(literal, "new") == 0)
-    type = TOKEN_NEW;
-  else if (strcmp(literal, "try") == 0)
-    type = TOKEN_TRY;
-  else if (strcmp(literal, "catch") == 0)
-    type = TOKEN_CATCH;
-  else if (strcmp(literal, "throw") == 0)
-    type = TOKEN_THROW;
-  else if (strcmp(literal, "import_native") == 0)
-    type = TOKEN_IMPORT_NATIVE;
-  else if (strcmp(literal, "c_function") == 0)
-    type = TOKEN_C_FUNCTION;
-  else if (strcmp(literal, "end") == 0)
-    type = TOKEN_END;
-  else if (strcmp(literal, "return") == 0)
-    type = TOKEN_RETURN;
-  else if (strcmp(literal, "in") == 0)
-    type = TOKEN_IN;
-  else if (strcmp(literal, "and") == 0)
-    type = TOKEN_AND;
-  else if (strcmp(literal, "or") == 0)
-    type = TOKEN_OR;
-  else if (strcmp(literal, "not") == 0)
-    type = TOKEN_NOT;
-  else if (strcmp(literal, "true") == 0)
-    type = TOKEN_TRUE;
-  else if (strcmp(literal, "false") == 0)
-    type = TOKEN_FALSE;
-  else if (strcmp(literal, "null") == 0)
-    type = TOKEN_NULL;
-  else if (strcmp(literal, "break") == 0)
-    type = TOKEN_BREAK;
-  else if (strcmp(literal, "continue") == 0)
-    type = TOKEN_CONTINUE;
-  else if (strcmp(literal, "from") == 0)
-    type = TOKEN_FROM;
-  else if (strcmp(literal, "to") == 0)
-    type = TOKEN_TO;
-  else if (strcmp(literal, "step") == 0)
-    type = TOKEN_STEP;
-  else if (strcmp(literal, "import") == 0)
-    type = TOKEN_IMPORT;
-  else if (strcmp(literal, "at") == 0)
-    type = TOKEN_AT;
-  else if (strcmp(literal, "interrupt") == 0)
-    type = TOKEN_INTERRUPT;
-  else if (strcmp(literal, "asm") == 0)
-    type = TOKEN_ASM;
-
-  // Single-word operators
-  else if (strcmp(literal, "plus") == 0)
-    type = TOKEN_PLUS;
-  else if (strcmp(literal, "minus") == 0)
-    type = TOKEN_MINUS;
-  else if (strcmp(literal, "times") == 0)
-    type = TOKEN_TIMES;
-  else if (strcmp(literal, "modulo") == 0)
-    type = TOKEN_MODULO;
-  else if (strcmp(literal, "power") == 0)
-    type = TOKEN_POWER;
-  else if (strcmp(literal, "equals") == 0)
-    type = TOKEN_EQUALS;
+  const char *literal = lexer->source + start_pos;
+
+#define IS_WORD(w) (len == (int)sizeof(w) - 1 && memcmp(literal, w, len) == 0)
+
+  const Keyword *kw = keyword_lookup(literal, len);
+  TokenType type = kw ? kw->type : TOKEN_IDENTIFIER;
 
   // Handle multi-word operators via lookahead
   // e.g. "less than", "greater than", "divided by", "not equals"
-  if (strcmp(literal, "less") == 0 || strcmp(literal, "greater") == 0 ||
-      strcmp(literal, "divided") == 0 || strcmp(literal, "not") == 0) {
+  if (kw && kw->phrase) {
     // Save current position in case lookahead fails
     int saved_pos = lexer->position;
     int saved_read = lexer->read_position;
@@ -193,7 +218,7 @@ static Token *read_identifier(Lexer *lexer) {
 
     // Read next word
     int word2_start = lexer->position;
-    while (isalpha(lexer->ch) || lexer->ch == '_') {
+    while (IS_IDENT_START(lexer->ch)) {
       lexer_read_char(lexer);
     }
     int word2_len = lexer->position - word2_start;
@@ -204,28 +229,23 @@ static Token *read_identifier(Lexer *lexer) {
       strncpy(word2, lexer->source + word2_start, copy_len);
       word2[copy_len] = '\0';
 
-      if (strcmp(literal, "less") == 0 && strcmp(word2, "than") == 0) {
-        free(literal);
-        Token *t =
+      if (IS_WORD("less") && strcmp(word2, "than") == 0) {
+        Token t =
             create_token(TOKEN_LESS_THAN, "less than", 9, lexer->line, col);
         return t;
-      } else if (strcmp(literal, "greater") == 0 &&
-                 strcmp(word2, "than") == 0) {
-        free(literal);
-        Token *t = create_token(TOKEN_GREATER_THAN, "greater than", 12,
-                                lexer->line, col);
+      } else if (IS_WORD("greater") && strcmp(word2, "than") == 0) {
+        Token t = create_token(TOKEN_GREATER_THAN, "greater than", 12,
+                               lexer->line, col);
         return t;
-      } else if (strcmp(literal, "divided") == 0 && strcmp(word2, "by") == 0) {
-        free(literal);
-        Token *t =
+      } else if (IS_WORD("divided") && strcmp(word2, "by") == 0) {
+        Token t =
             create_token(TOKEN_DIVIDED_BY, "divided by", 10, lexer->line, col);
         return t;
-      } else if (strcmp(literal, "not") == 0 && strcmp(word2, "equals") == 0) {
-        free(literal);
-        Token *t =
+      } else if (IS_WORD("not") && strcmp(word2, "equals") == 0) {
+        Token t =
             create_token(TOKEN_NOT_EQUALS, "not equals", 10, lexer->line, col);
         return t;
-      } else if (strcmp(literal, "greater") == 0 && strcmp(word2, "or") == 0) {
+      } else if (IS_WORD("greater") && strcmp(word2, "or") == 0) {
         // Check for "greater or equals" (3 words)
         int saved2_pos = lexer->position;
         int saved2_read = lexer->read_position;
@@ -234,7 +254,7 @@ static Token *read_identifier(Lexer *lexer) {
         while (lexer->ch == ' ' || lexer->ch == '\t')
           lexer_read_char(lexer);
         int w3_start = lexer->position;
-        while (isalpha(lexer->ch) || lexer->ch == '_')
+        while (IS_IDENT_START(lexer->ch))
           lexer_read_char(lexer);
         int w3_len = lexer->position - w3_start;
         if (w3_len > 0) {
@@ -243,7 +263,6 @@ static Token *read_identifier(Lexer *lexer) {
           strncpy(w3, lexer->source + w3_start, c3);
           w3[c3] = '\0';
           if (strcmp(w3, "equals") == 0) {
-            free(literal);
             return create_token(TOKEN_GREATER_OR_EQUALS, "greater or equals",
                                 17, lexer->line, col);
           }
@@ -253,7 +272,7 @@ static Token *read_identifier(Lexer *lexer) {
         lexer->read_position = saved2_read;
         lexer->ch = saved2_ch;
         lexer->column = saved2_col;
-      } else if (strcmp(literal, "less") == 0 && strcmp(word2, "or") == 0) {
+      } else if (IS_WORD("less") && strcmp(word2, "or") == 0) {
         int saved2_pos = lexer->position;
         int saved2_read = lexer->read_position;
         char saved2_ch = lexer->ch;
@@ -261,7 +280,7 @@ static Token *read_identifier(Lexer *lexer) {
         while (lexer->ch == ' ' || lexer->ch == '\t')
           lexer_read_char(lexer);
         int w3_start = lexer->position;
-        while (isalpha(lexer->ch) || lexer->ch == '_')
+        while (IS_IDENT_START(lexer->ch))
           lexer_read_char(lexer);
         int w3_len = lexer->position - w3_start;
         if (w3_len > 0) {
@@ -270,7 +289,6 @@ static Token *read_identifier(Lexer *lexer) {
           strncpy(w3, lexer->source + w3_start, c3);
           w3[c3] = '\0';
           if (strcmp(w3, "equals") == 0) {
-            free(literal);
             return create_token(TOKEN_LESS_OR_EQUALS, "less or equals", 14,
                                 lexer->line, col);
           }
@@ -303,9 +321,8 @@ static Token *read_identifier(Lexer *lexer) {
       lexer_read_char(lexer);
     }
     if (lexer->ch != '{') {
-      Token *t = create_token(TOKEN_ERROR, "Expected '{' after 'asm'", 23,
-                              lexer->line, col);
-      free(literal);
+      Token t = create_token(TOKEN_ERROR, "Expected '{' after 'asm'", 23,
+                             lexer->line, col);
       return t;
     }
     lexer_read_char(lexer); // consume '{'
@@ -330,34 +347,33 @@ static Token *read_identifier(Lexer *lexer) {
     int asm_end = lexer->position;
     int asm_len = asm_end - asm_start;
 
-    Token *t = create_token(TOKEN_ASM, lexer->source + asm_start, asm_len,
-                            lexer->line, col);
-    free(literal);
+    Token t = create_token(TOKEN_ASM, lexer->source + asm_start, asm_len,
+                           lexer->line, col);
     if (lexer->ch == '}')
       lexer_read_char(lexer); // consume closing '}'
     return t;
   }
 
-  Token *tok = create_token(type, literal, len, lexer->line, col);
-  free(literal);
-  return tok;
+#undef IS_WORD
+
+  return create_token(type, literal, len, lexer->line, col);
 }
 
-static Token *read_number(Lexer *lexer) {
+static Token read_number(Lexer *lexer) {
   int start_pos = lexer->position;
   int col = lexer->column;
 
-  while (isdigit(lexer->ch) || lexer->ch == '.') {
+  while (IS_DIGIT(lexer->ch) || lexer->ch == '.') {
     lexer_read_char(lexer);
   }
 
   int len = lexer->position - start_pos;
-  Token *tok = create_token(TOKEN_NUMBER, lexer->source + start_pos, len,
-                            lexer->line, col);
+  Token tok = create_token(TOKEN_NUMBER, lexer->source + start_pos, len,
+                           lexer->line, col);
   return tok;
 }
 
-static Token *read_string(Lexer *lexer, char quote_char) {
+static Token read_string(Lexer *lexer, char quote_char) {
   int start_pos = lexer->position + 1; // skip quote
   int col = lexer->column;
   lexer_read_char(lexer);
@@ -368,8 +384,8 @@ static Token *read_string(Lexer *lexer, char quote_char) {
   }
 
   int len = lexer->position - start_pos;
-  Token *tok = create_token(TOKEN_STRING, lexer->source + start_pos, len,
-                            lexer->line, col);
+  Token tok = create_token(TOKEN_STRING, lexer->source + start_pos, len,
+                           lexer->line, col);
 
   if (lexer->ch == quote_char) {
     lexer_read_char(lexer); // consume closing quote
@@ -403,8 +419,8 @@ static void skip_comment(Lexer *lexer) {
   }
 }
 
-Token *lexer_next_token(Lexer *lexer) {
-  Token *tok = NULL;
+Token lexer_next_token(Lexer *lexer) {
+  Token tok;
 
   lexer_skip_whitespace(lexer);
 
@@ -530,9 +546,9 @@ Token *lexer_next_token(Lexer *lexer) {
     tok = create_token(TOKEN_EOF, "", 0, lexer->line, col);
     break;
   default:
-    if (isalpha(lexer->ch) || lexer->ch == '_') {
+    if (IS_IDENT_START(lexer->ch)) {
       tok = read_identifier(lexer);
-    } else if (isdigit(lexer->ch)) {
+    } else if (IS_DIGIT(lexer->ch)) {
       tok = read_number(lexer);
     } else {
       tok = create_char_token(TOKEN_ERROR, lexer);
@@ -543,15 +559,6 @@ Token *lexer_next_token(Lexer *lexer) {
   return tok;
 }
 
-void token_free(Token *token) {
-  if (token) {
-    if (token->literal) {
-      free(token->literal);
-    }
-    free(token);
-  }
-}
-
 const char *token_type_to_string(TokenType type) {
   switch (type) {
   case TOKEN_IF:
@@ -13,8 +13,7 @@ typedef struct {
 } Lexer;
 
 void lexer_init(Lexer *lexer, const char *source);
-Token *lexer_next_token(Lexer *lexer);
-void token_free(Token *token);
+Token lexer_next_token(Lexer *lexer);
 const char *token_type_to_string(TokenType type);
 
 #endif // LEXER_H
@@ -1,7 +1,11 @@
 #include "codegen.h"
+#include "intern.h"
+#include "jit.h"
 #include "lexer.h"
+#include "modcache.h"
 #include "parser.h"
 #include "semantic.h"
+#include "x64asm.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,6 +16,12 @@
 #define PATH_SEP '/'
 #endif
 
+// Progress messages go to stdout, so `run` turns them off to leave the
+// script's own output alone
+static int show_progress = 1;
+
+// Source buffers live in compile_arena: tokens and AST nodes point into them,
+// so they must stay valid until the arena is released.
 char *read_source_file(const char *path) {
   FILE *file = fopen(path, "rb");
   if (!file) {
@@ -23,12 +33,7 @@ char *read_source_file(const char *path) {
   size_t file_size = ftell(file);
   rewind(file);
 
-  char *buffer = (char *)malloc(file_size + 1);
-  if (!buffer) {
-    fprintf(stderr, "Not enough memory to read \"%s\".\n", path);
-    fclose(file);
-    return NULL;
-  }
+  char *buffer = arena_alloc(&compile_arena, file_size + 1);
 
   size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
   buffer[bytes_read] = '\0';
@@ -64,7 +69,58 @@ static char *build_stdlib_path(const char *module_name) {
   return path;
 }
 
-// Resolve imports: parse imported .stola files and prepend their functions
+// Runtime library for run mode: $STOLA_RUNTIME, else <exe_dir>/libstola.so
+static char *build_runtime_path(void) {
+  const char *env = getenv("STOLA_RUNTIME");
+  if (env && *env) {
+    char *path = (char *)malloc(strlen(env) + 1);
+    strcpy(path, env);
+    return path;
+  }
+  char exe_dir[512];
+  get_exe_dir(exe_dir, sizeof(exe_dir));
+  size_t len = strlen(exe_dir) + strlen("libstola.so") + 1;
+  char *path = (char *)malloc(len);
+  snprintf(path, len, "%slibstola.so", exe_dir);
+  return path;
+}
+
+// Parse an imported module and collect its function declarations (arena
+// array). Returns -1 on parse errors.
+static int parse_module(const char *module, char *source, ASTNode ***funcs) {
+  Lexer lib_lexer;
+  lexer_init(&lib_lexer, source);
+
+  Parser lib_parser;
+  parser_init(&lib_parser, &lib_lexer);
+
+  ASTNode *lib_program = parser_parse_program(&lib_parser);
+
+  if (lib_parser.error_count > 0) {
+    fprintf(stderr, "Parse errors in imported module '%s':\n", module);
+    parser_print_errors(&lib_parser);
+    return -1;
+  }
+
+  // Extract all function declarations from the imported module
+  ASTNode **decls = NULL;
+  int count = 0;
+  if (lib_program && lib_program->type == AST_PROGRAM) {
+    for (int i = 0; i < lib_program->as.program.statement_count; i++) {
+      ASTNode *stmt = lib_program->as.program.statements[i];
+      if (stmt && stmt->type == AST_FUNCTION_DECL) {
+        decls = arena_grow(&compile_arena, decls, count, sizeof(ASTNode *));
+        decls[count++] = stmt;
+      }
+    }
+  }
+  *funcs = decls;
+  return count;
+}
+
+// Resolve imports: prepend the functions of imported .stola files. A module
+// found in the module cache is declared from its entry; otherwise it is
+// parsed and, when it compiles on its own, stored in the cache.
 static void resolve_imports(ASTNode *program) {
   if (!program || program->type != AST_PROGRAM)
     return;
@@ -85,7 +141,7 @@ static void resolve_imports(ASTNode *program) {
   if (module_count == 0)
     return;
 
-  // Parse each imported module and collect function declarations
+  // Load or parse each imported module and collect function declarations
   ASTNode **imported_funcs = NULL;
   int imported_count = 0;
 
@@ -100,42 +156,28 @@ static void resolve_imports(ASTNode *program) {
       continue;
     }
 
-    printf("Importing %s...\n", modules[m]);
-
-    Lexer lib_lexer;
-    lexer_init(&lib_lexer, source);
-
-    Parser lib_parser;
-    parser_init(&lib_parser, &lib_lexer);
-
-    ASTNode *lib_program = parser_parse_program(&lib_parser);
-
-    if (lib_parser.error_count > 0) {
-      fprintf(stderr, "Parse errors in imported module '%s':\n", modules[m]);
-      parser_print_errors(&lib_parser);
-      parser_free(&lib_parser);
-      free(source);
-      free(path);
-      continue;
+    ASTNode **funcs = NULL;
+    int func_count = modcache_load(modules[m], source, &funcs);
+    if (func_count >= 0) {
+      if (show_progress)
+        printf("Importing %s (cached)...\n", modules[m]);
+    } else {
+      if (show_progress)
+        printf("Importing %s...\n", modules[m]);
+      func_count = parse_module(modules[m], source, &funcs);
+      ASTNode **stubs;
+      if (func_count >= 0 &&
+          modcache_store(modules[m], source, funcs, func_count, &stubs) >= 0)
+        funcs = stubs; // code comes from the cache entry
     }
 
-    // Extract all function declarations from the imported module
-    if (lib_program && lib_program->type == AST_PROGRAM) {
-      for (int i = 0; i < lib_program->as.program.statement_count; i++) {
-        ASTNode *stmt = lib_program->as.program.statements[i];
-        if (stmt && stmt->type == AST_FUNCTION_DECL) {
-          imported_count++;
-          imported_funcs = (ASTNode **)realloc(
-              imported_funcs, sizeof(ASTNode *) * imported_count);
-          imported_funcs[imported_count - 1] = stmt;
-          // Remove from lib_program so it doesn't get freed
-          lib_program->as.program.statements[i] = NULL;
-        }
-      }
+    for (int i = 0; i < func_count; i++) {
+      imported_count++;
+      imported_funcs = (ASTNode **)realloc(imported_funcs,
+                                           sizeof(ASTNode *) * imported_count);
+      imported_funcs[imported_count - 1] = funcs[i];
     }
 
-    parser_free(&lib_parser);
-    free(source);
     free(path);
   }
 
@@ -146,7 +188,8 @@ static void resolve_imports(ASTNode *program) {
   // statements (minus import statements)
   int orig_count = program->as.program.statement_count;
   int new_capacity = imported_count + orig_count;
-  ASTNode **new_stmts = (ASTNode **)malloc(sizeof(ASTNode *) * new_capacity);
+  ASTNode **new_stmts =
+      arena_alloc(&compile_arena, sizeof(ASTNode *) * new_capacity);
 
   // Prepend imported functions
   int idx = 0;
@@ -162,29 +205,96 @@ static void resolve_imports(ASTNode *program) {
     }
   }
 
-  free(program->as.program.statements);
   program->as.program.statements = new_stmts;
   program->as.program.statement_count = idx;
 
   free(imported_funcs);
 }
 
+// Assemble the generated text in `asm_file` into `obj`, without running an
+// external assembler.
+static int assemble_output(FILE *asm_file, X64Object *obj) {
+  long size = fseek(asm_file, 0L, SEEK_END) == 0 ? ftell(asm_file) : -1;
+  if (size < 0) {
+    printf("Error: Could not measure the generated assembly\n");
+    return 0;
+  }
+  rewind(asm_file);
+  char *text = malloc((size_t)size + 1);
+  if (!text) {
+    printf("Error: Out of memory reading the generated assembly\n");
+    return 0;
+  }
+  size_t n = fread(text, 1, (size_t)size, asm_file);
+
+  int ok = x64_assemble(obj, text, n);
+  if (!ok)
+    printf("Error: assembler: %s\n", obj->error);
+  free(text);
+  return ok;
+}
+
+static int write_object(const X64Object *obj, const char *path) {
+#ifdef _WIN32
+  (void)obj;
+  (void)path;
+  printf("Error: -c writes ELF objects and is not available on Windows\n");
+  return 0;
+#else
+  if (!x64_write_elf(obj, path)) {
+    printf("Error: Could not write object file %s\n", path);
+    return 0;
+  }
+  return 1;
+#endif
+}
+
 int main(int argc, char **argv) {
   if (argc < 3) {
     printf("Usage: stolascript [options] <input.stola> <output.s>\n");
+    printf("       stolascript run [options] <input.stola> [args...]\n");
     printf("Options:\n");
+    printf("  -c                Write an ELF object file instead of "
+           "assembly\n");
+    printf("  -o <file>         Output file (instead of the second path)\n");
     printf("  --freestanding    Compile for bare-metal without runtime.c "
            "dependencies\n");
+    printf("  -j <n>            Code generation threads (default: one per "
+           "core)\n");
+    printf("  --no-cache        Compile imported modules without the module "
+           "cache\n");
     return 1;
   }
 
   int is_freestanding = 0;
+  int jobs = 0;
+  int use_cache = 1;
+  int emit_object = 0;
+  int run_mode = strcmp(argv[1], "run") == 0;
+  int script_argc = 0;
+  char **script_argv = NULL;
   const char *input_path = NULL;
   const char *output_path = NULL;
 
-  for (int i = 1; i < argc; i++) {
+  for (int i = run_mode ? 2 : 1; i < argc; i++) {
     if (strcmp(argv[i], "--freestanding") == 0) {
       is_freestanding = 1;
+    } else if (strcmp(argv[i], "--no-cache") == 0) {
+      use_cache = 0;
+    } else if (strcmp(argv[i], "-c") == 0) {
+      emit_object = 1;
+    } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output_path = argv[++i];
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+    } else if (strncmp(argv[i], "-j", 2) == 0 && argv[i][2]) {
+      jobs = atoi(argv[i] + 2);
+    } else if (run_mode) {
+      // The script sees its own path as argv[0], then the rest
+      input_path = argv[i];
+      script_argc = argc - i;
+      script_argv = argv + i;
+      break;
     } else if (!input_path) {
       input_path = argv[i];
     } else if (!output_path) {
@@ -192,17 +302,23 @@ int main(int argc, char **argv) {
     }
   }
 
-  if (!input_path || !output_path) {
+  if (run_mode && (emit_object || is_freestanding)) {
+    printf("Error: run cannot be combined with -c or --freestanding.\n");
+    return 1;
+  }
+  if (!input_path || (!output_path && !run_mode)) {
     printf("Error: Missing input or output file paths.\n");
     return 1;
   }
+  show_progress = !run_mode;
 
   char *source = read_source_file(input_path);
   if (!source)
     return 1;
 
-  printf("Compiling %s %s...\n", input_path,
-         is_freestanding ? "(Freestanding Mode)" : "");
+  if (show_progress)
+    printf("Compiling %s %s...\n", input_path,
+           is_freestanding ? "(Freestanding Mode)" : "");
 
   Lexer lexer;
   lexer_init(&lexer, source);
@@ -215,13 +331,20 @@ int main(int argc, char **argv) {
   if (parser.error_count > 0) {
     printf("Parser failed.\n");
     parser_print_errors(&parser);
-    free(source);
+    intern_release();
+    arena_release(&compile_arena);
     return 1;
   }
 
   // Resolve imports before semantic analysis (skip in freestanding since stdlib
   // uses runtime)
   if (!is_freestanding) {
+    // Entries go to $STOLA_CACHE_DIR, default .stola_cache in the working
+    // directory
+    const char *cache_dir = getenv("STOLA_CACHE_DIR");
+    if (!cache_dir || !*cache_dir)
+      cache_dir = ".stola_cache";
+    modcache_init(use_cache ? cache_dir : NULL, jobs);
     resolve_imports(program);
   }
 
@@ -232,18 +355,55 @@ int main(int argc, char **argv) {
     printf("Semantic Analyzer failed.\n");
     semantic_print_errors(&analyzer);
     semantic_free(&analyzer);
-    free(source);
+    intern_release();
+    arena_release(&compile_arena);
     return 1;
   }
 
-  printf("Generating assembly to %s...\n", output_path);
-  codegen_generate(program, &analyzer, output_path, is_freestanding);
+  // Objects and run mode assemble the text in memory (a temporary file);
+  // run shares all of code generation with the other modes
+  int in_memory = emit_object || run_mode;
+  if (show_progress)
+    printf("Generating %s to %s...\n", emit_object ? "object" : "assembly",
+           output_path);
+  FILE *out = in_memory ? tmpfile() : fopen(output_path, "w");
+  X64Object obj;
+  memset(&obj, 0, sizeof(obj));
+  int ok = 0;
+  if (!out) {
+    printf("Error: Could not open output file %s\n",
+           output_path ? output_path : "(temporary)");
+  } else {
+    ok = codegen_generate(program, &analyzer, out, is_freestanding, jobs) &&
+         modcache_append(out);
+    if (ok && in_memory)
+      ok = assemble_output(out, &obj);
+    if (ok && emit_object)
+      ok = write_object(&obj, output_path);
+    ok = fclose(out) == 0 && ok;
+  }
 
   semantic_free(&analyzer);
-  ast_free(program);
-  parser_free(&parser);
-  free(source);
+  // Tokens, AST, symbols and source buffers all go at once
+  intern_release();
+  arena_release(&compile_arena);
+
+  if (!ok) {
+    x64_free(&obj);
+    printf("Code generation failed.\n");
+    return 1;
+  }
+
+  if (run_mode) {
+    char *runtime_path = build_runtime_path();
+    int status = 1;
+    ok = jit_run(&obj, runtime_path, script_argc, script_argv, &status);
+    free(runtime_path);
+    x64_free(&obj);
+    return ok ? status : 1;
+  }
 
+  x64_free(&obj);
   printf("Compilation successful!\n");
   return 0;
 }
@@ -0,0 +1,224 @@
+#define _CRT_SECURE_NO_WARNINGS
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L /* mkdir, getpid */
+#endif
+#include "modcache.h"
+#include "codegen.h"
+#include "intern.h"
+#include "semantic.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define PATH_SEP '\\'
+#define make_dir(path) _mkdir(path)
+#define process_id() _getpid()
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#define PATH_SEP '/'
+#define make_dir(path) mkdir(path, 0755)
+#define process_id() getpid()
+#endif
+
+#define MODCACHE_MAX_ENTRIES 32 // resolve_imports handles up to 32 modules
+
+static const char *cache_dir; // NULL = disabled
+static int cache_jobs;
+static const char *used_entries[MODCACHE_MAX_ENTRIES];
+static int used_count;
+
+void modcache_init(const char *dir, int jobs) {
+  cache_dir = dir;
+  cache_jobs = jobs;
+  used_count = 0;
+}
+
+// FNV-1a 64
+static uint64_t hash_bytes(uint64_t h, const char *s, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+// Everything the emitted code depends on besides the source itself
+static uint64_t entry_key(const char *source) {
+  uint64_t h = 14695981039346656037ull;
+  const char *version = codegen_version();
+  h = hash_bytes(h, version, strlen(version) + 1);
+#ifdef _WIN32
+  h = hash_bytes(h, "win64", 6);
+#else
+  h = hash_bytes(h, "sysv", 5);
+#endif
+  return hash_bytes(h, source, strlen(source));
+}
+
+static char *entry_path(const char *module, const char *source) {
+  size_t len = strlen(cache_dir) + strlen(module) + 24;
+  char *path = arena_alloc(&compile_arena, len);
+  snprintf(path, len, "%s%c%s-%016llx.s", cache_dir, PATH_SEP, module,
+           (unsigned long long)entry_key(source));
+  return path;
+}
+
+// "// fn <name> <return_type> <param>[:<type>]..."
+static ASTNode *parse_signature(char *line) {
+  const char *delims = " \r\n";
+  char *name = strtok(line + strlen("// fn "), delims);
+  char *return_type = strtok(NULL, delims);
+  if (!name || !return_type)
+    return NULL;
+
+  ASTNode *fn = ast_create_function_decl(intern_cstr(name), NULL);
+  fn->as.function_decl.return_type = intern_cstr(return_type);
+  char *param;
+  while ((param = strtok(NULL, delims))) {
+    char *type = strchr(param, ':');
+    if (type)
+      *type++ = '\0';
+    ast_function_add_param(fn, intern_cstr(param));
+    if (type)
+      ast_function_add_param_type(fn, intern_cstr(type));
+  }
+  return fn;
+}
+
+static void write_signature(FILE *out, ASTNode *fn) {
+  FunctionDeclNode *decl = &fn->as.function_decl;
+  fprintf(out, "// fn %s %s", decl->name,
+          decl->return_type ? decl->return_type : "any");
+  for (int i = 0; i < decl->param_count; i++) {
+    if (decl->param_types[i])
+      fprintf(out, " %s:%s", decl->parameters[i], decl->param_types[i]);
+    else
+      fprintf(out, " %s", decl->parameters[i]);
+  }
+  fprintf(out, "\n");
+}
+
+static void use_entry(const char *path) {
+  if (used_count < MODCACHE_MAX_ENTRIES)
+    used_entries[used_count++] = path;
+}
+
+int modcache_load(const char *module, const char *source, ASTNode ***decls) {
+  if (!cache_dir)
+    return -1;
+  char *path = entry_path(module, source);
+  FILE *in = fopen(path, "r");
+  if (!in)
+    return -1;
+
+  // The signature block ends at the first line that is not "// fn"
+  ASTNode **fns = NULL;
+  int count = 0;
+  char line[4096];
+  int ok = fgets(line, sizeof(line), in) &&
+           strncmp(line, "// stola module ", 16) == 0;
+  while (ok && fgets(line, sizeof(line), in) &&
+         strncmp(line, "// fn ", 6) == 0) {
+    ASTNode *fn = strchr(line, '\n') ? parse_signature(line) : NULL;
+    if (!fn) {
+      ok = 0; // truncated or malformed entry: rebuild it
+      break;
+    }
+    fns = arena_grow(&compile_arena, fns, count, sizeof(ASTNode *));
+    fns[count++] = fn;
+  }
+  fclose(in);
+  if (!ok)
+    return -1;
+
+  use_entry(path);
+  *decls = fns;
+  return count;
+}
+
+int modcache_store(const char *module, const char *source, ASTNode **decls,
+                   int count, ASTNode ***stubs) {
+  if (!cache_dir)
+    return -1;
+
+  // The module must stand on its own: analyze it without the program
+  ASTNode *lib = ast_create_program();
+  for (int i = 0; i < count; i++)
+    ast_program_add_statement(lib, decls[i]);
+  SemanticAnalyzer analyzer;
+  semantic_init(&analyzer, 0);
+  if (!semantic_analyze(&analyzer, lib)) {
+    semantic_free(&analyzer);
+    return -1;
+  }
+
+  char *path = entry_path(module, source);
+  size_t tmp_len = strlen(path) + 24;
+  char *tmp = arena_alloc(&compile_arena, tmp_len);
+  snprintf(tmp, tmp_len, "%s.%d.tmp", path, (int)process_id());
+
+  make_dir(cache_dir); // fails harmlessly when it exists
+  FILE *out = fopen(tmp, "w");
+  if (!out) {
+    semantic_free(&analyzer);
+    return -1;
+  }
+
+  // Labels get a per-module prefix so the text can join any program
+  size_t prefix_len = strlen(module) + 4;
+  char *prefix = arena_alloc(&compile_arena, prefix_len);
+  snprintf(prefix, prefix_len, "m_%s_", module);
+
+  fprintf(out, "// stola module %s\n", module);
+  for (int i = 0; i < count; i++)
+    write_signature(out, decls[i]);
+  int ok = codegen_generate_module(decls, count, prefix, &analyzer, out,
+                                   cache_jobs);
+  ok = fclose(out) == 0 && ok;
+  semantic_free(&analyzer);
+
+#ifdef _WIN32
+  if (ok)
+    remove(path); // rename does not replace on Windows
+#endif
+  if (!ok || rename(tmp, path) != 0) {
+    remove(tmp);
+    return -1;
+  }
+
+  ASTNode **fns = arena_alloc(&compile_arena, sizeof(ASTNode *) * count);
+  for (int i = 0; i < count; i++) {
+    fns[i] = arena_alloc(&compile_arena, sizeof(ASTNode));
+    *fns[i] = *decls[i];
+    fns[i]->as.function_decl.body = NULL;
+  }
+  use_entry(path);
+  *stubs = fns;
+  return count;
+}
+
+int modcache_append(FILE *out) {
+  int ok = 1;
+  char buf[65536];
+  for (int i = 0; i < used_count && ok; i++) {
+    FILE *in = fopen(used_entries[i], "rb");
+    if (!in) {
+      fprintf(stderr, "Error: module cache entry %s disappeared\n",
+              used_entries[i]);
+      ok = 0;
+      break;
+    }
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+      fwrite(buf, 1, n, out);
+    fclose(in);
+  }
+  used_count = 0;
+  return ok && !ferror(out);
+}
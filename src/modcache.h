@@ -0,0 +1,34 @@
+#ifndef MODCACHE_H
+#define MODCACHE_H
+
+#include "ast.h"
+#include <stdio.h>
+
+// Cache of compiled imported modules. A module is analyzed and compiled on
+// its own, and its assembly is stored in the cache directory as
+// <module>-<key>.s, where the key hashes the module source, the compiler
+// version and the target ABI. The entry opens with the signatures of the
+// module's functions ("// fn" lines), so a later build declares them without
+// lexing or parsing the module and appends the cached code to its output.
+
+// Use `dir` (created on demand) for entries; NULL disables the cache.
+// `jobs` is passed on to codegen when a module is compiled.
+void modcache_init(const char *dir, int jobs);
+
+// Declarations for the functions of `module` as of `source`, loaded from
+// its entry. Cached declarations have no body: codegen skips them and
+// modcache_append supplies their code. Returns the count, -1 on a miss.
+int modcache_load(const char *module, const char *source, ASTNode ***decls);
+
+// Compile freshly parsed `decls` of `module` and store them as the entry for
+// `source`; on success `*stubs` receives the body-less declarations to use
+// instead. Returns -1 when the module cannot be compiled on its own (it
+// calls into the importing program, say) or the entry cannot be written;
+// the caller then compiles `decls` as part of the program.
+int modcache_store(const char *module, const char *source, ASTNode **decls,
+                   int count, ASTNode ***stubs);
+
+// Append the code of every entry used by this build to `out`.
+int modcache_append(FILE *out);
+
+#endif // MODCACHE_H
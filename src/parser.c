@@ -1,4 +1,5 @@
 #include "parser.h"
+#include "intern.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -70,19 +71,32 @@ static ASTNode *parse_expression(Parser *parser, Precedence precedence);
 static ASTNode *parse_statement(Parser *parser);
 static ASTNode *parse_block_statement(Parser *parser);
 
+// current_token and peek_token point into parser->tokens; advancing swaps
+// the two slots and lexes into the one that was just consumed.
 static void parser_next_token(Parser *parser) {
-  if (parser->current_token) {
-    token_free(parser->current_token);
-  }
+  Token *spent = parser->current_token;
   parser->current_token = parser->peek_token;
-  parser->peek_token = lexer_next_token(parser->lexer);
+  *spent = lexer_next_token(parser->lexer);
+  parser->peek_token = spent;
+}
+
+// Token text is a slice of the source; AST nodes get a terminated copy in
+// compile_arena. Names (identifiers, types, fields) are interned instead so
+// the semantic pass can key its symbol tables on the pointer.
+static char *current_text(Parser *parser) {
+  return arena_strndup(&compile_arena, parser->current_token->literal,
+                       parser->current_token->length);
+}
+
+static char *current_name(Parser *parser) {
+  return intern_string(parser->current_token->literal,
+                       parser->current_token->length);
 }
 
 static void parser_add_error(Parser *parser, const char *msg) {
-  parser->error_count++;
-  parser->errors =
-      realloc(parser->errors, sizeof(char *) * parser->error_count);
-  parser->errors[parser->error_count - 1] = strdup(msg);
+  parser->errors = arena_grow(&compile_arena, parser->errors,
+                              parser->error_count, sizeof(char *));
+  parser->errors[parser->error_count++] = arena_strdup(&compile_arena, msg);
 }
 
 static int current_token_is(Parser *parser, TokenType type) {
@@ -110,15 +124,15 @@ static int expect_peek(Parser *parser, TokenType type) {
 // ------ EXPRESSION PARSERS ------
 
 static ASTNode *parse_identifier(Parser *parser) {
-  return ast_create_identifier(parser->current_token->literal);
+  return ast_create_identifier(current_name(parser));
 }
 
 static ASTNode *parse_number_literal(Parser *parser) {
-  return ast_create_number_literal(parser->current_token->literal);
+  return ast_create_number_literal(current_text(parser));
 }
 
 static ASTNode *parse_string_literal(Parser *parser) {
-  return ast_create_string_literal(parser->current_token->literal);
+  return ast_create_string_literal(current_text(parser));
 }
 
 static ASTNode *parse_boolean_literal(Parser *parser) {
@@ -138,10 +152,9 @@ static ASTNode *parse_new_expr(Parser *parser) {
     parser_add_error(parser, "Expected class name after 'new'");
     return NULL;
   }
-  ASTNode *class_name = ast_create_identifier(parser->current_token->literal);
+  ASTNode *class_name = ast_create_identifier(current_name(parser));
 
   if (!expect_peek(parser, TOKEN_LPAREN)) {
-    ast_free(class_name);
     return NULL;
   }
 
@@ -166,7 +179,6 @@ static ASTNode *parse_new_expr(Parser *parser) {
   }
 
   if (!expect_peek(parser, TOKEN_RPAREN)) {
-    ast_free(new_node);
     return NULL;
   }
 
@@ -192,7 +204,6 @@ static ASTNode *parse_grouped_expression(Parser *parser) {
   parser_next_token(parser); // consume '('
   ASTNode *exp = parse_expression(parser, PREC_LOWEST);
   if (!expect_peek(parser, TOKEN_RPAREN)) {
-    ast_free(exp);
     return NULL;
   }
   return exp;
@@ -214,7 +225,6 @@ static ASTNode *parse_call_arguments(Parser *parser, ASTNode *call) {
   }
 
   if (!expect_peek(parser, TOKEN_RPAREN)) {
-    ast_free(call);
     return NULL;
   }
 
@@ -244,7 +254,6 @@ static ASTNode *parse_array_literal(Parser *parser) {
   }
 
   if (!expect_peek(parser, TOKEN_RBRACKET)) {
-    ast_free(array);
     return NULL;
   }
 
@@ -272,9 +281,9 @@ static ASTNode *parse_dict_literal(Parser *parser) {
     // Key must be an identifier or string
     ASTNode *key = NULL;
     if (current_token_is(parser, TOKEN_IDENTIFIER)) {
-      key = ast_create_identifier(parser->current_token->literal);
+      key = ast_create_identifier(current_name(parser));
     } else if (current_token_is(parser, TOKEN_STRING)) {
-      key = ast_create_string_literal(parser->current_token->literal);
+      key = ast_create_string_literal(current_text(parser));
     } else {
       char err[128];
       snprintf(err, sizeof(err),
@@ -282,14 +291,11 @@ static ASTNode *parse_dict_literal(Parser *parser) {
                parser->current_token->line,
                token_type_to_string(parser->current_token->type));
       parser_add_error(parser, err);
-      ast_free(dict);
       return NULL;
     }
 
     // Expect colon
     if (!expect_peek(parser, TOKEN_COLON)) {
-      ast_free(key);
-      ast_free(dict);
       return NULL;
     }
     parser_next_token(parser); // move past ':' to value
@@ -312,7 +318,6 @@ static ASTNode *parse_dict_literal(Parser *parser) {
                parser->current_token->line,
                token_type_to_string(parser->peek_token->type));
       parser_add_error(parser, err);
-      ast_free(dict);
       return NULL;
     }
   }
@@ -325,8 +330,6 @@ static ASTNode *parse_index_access(Parser *parser, ASTNode *left) {
   ASTNode *index = parse_expression(parser, PREC_LOWEST);
 
   if (!expect_peek(parser, TOKEN_RBRACKET)) {
-    ast_free(left);
-    ast_free(index);
     return NULL;
   }
 
@@ -355,7 +358,7 @@ static ASTNode *parse_member_access(Parser *parser, ASTNode *left) {
     parser_add_error(parser, err);
     return left; // return what we have so far, don't crash
   }
-  ASTNode *property = ast_create_identifier(parser->current_token->literal);
+  ASTNode *property = ast_create_identifier(current_name(parser));
   return ast_create_member_access(left, property, 0);
 }
 
@@ -483,7 +486,7 @@ static ASTNode *parse_assignment_statement(Parser *parser) {
     parser_next_token(parser); // consume ':'
     if (peek_token_is(parser, TOKEN_IDENTIFIER)) {
       parser_next_token(parser); // consume type name
-      type_annotation = strdup(parser->current_token->literal);
+      type_annotation = current_name(parser);
     } else {
       parser_add_error(parser, "Expected type name after ':'");
     }
@@ -501,15 +504,12 @@ static ASTNode *parse_assignment_statement(Parser *parser) {
 
     ASTNode *assign = ast_create_assignment(target, value);
     if (type_annotation) {
-      free(assign->as.assignment.type_annotation);
       assign->as.assignment.type_annotation = type_annotation;
     }
     return assign;
   }
 
   if (type_annotation) {
-    free(type_annotation); // Just in case it's not an assignment but it had a
-                           // colon? (invalid syntax)
     parser_add_error(parser, "Expected '=' after type annotation");
   }
 
@@ -528,7 +528,6 @@ static ASTNode *parse_assignment_statement(Parser *parser) {
            parser->current_token->line,
            token_type_to_string(parser->peek_token->type));
   parser_add_error(parser, err);
-  ast_free(target);
   return NULL;
 }
 
@@ -626,13 +625,13 @@ static void parse_function_parameters(Parser *parser, ASTNode *func) {
   }
 
   parser_next_token(parser);
-  ast_function_add_param(func, parser->current_token->literal);
+  ast_function_add_param(func, current_name(parser));
 
   if (peek_token_is(parser, TOKEN_COLON)) {
     parser_next_token(parser); // move to ':'
     if (peek_token_is(parser, TOKEN_IDENTIFIER)) {
       parser_next_token(parser); // move to type
-      ast_function_add_param_type(func, parser->current_token->literal);
+      ast_function_add_param_type(func, current_name(parser));
     } else {
       parser_add_error(parser, "Expected type after ':' in parameter list");
     }
@@ -647,13 +646,13 @@ static void parse_function_parameters(Parser *parser, ASTNode *func) {
       break;
     }
     parser_next_token(parser);
-    ast_function_add_param(func, parser->current_token->literal);
+    ast_function_add_param(func, current_name(parser));
 
     if (peek_token_is(parser, TOKEN_COLON)) {
       parser_next_token(parser);
       if (peek_token_is(parser, TOKEN_IDENTIFIER)) {
         parser_next_token(parser);
-        ast_function_add_param_type(func, parser->current_token->literal);
+        ast_function_add_param_type(func, current_name(parser));
       } else {
         parser_add_error(parser, "Expected type after ':' in parameter list");
       }
@@ -675,15 +674,13 @@ static ASTNode *parse_function_decl(Parser *parser) {
     return NULL;
   }
 
-  char *name = strdup(parser->current_token->literal);
+  char *name = current_name(parser);
 
   if (!expect_peek(parser, TOKEN_LPAREN)) {
-    free(name);
     return NULL;
   }
 
   ASTNode *func = ast_create_function_decl(name, NULL);
-  free(name);
 
   parse_function_parameters(parser, func);
 
@@ -692,16 +689,13 @@ static ASTNode *parse_function_decl(Parser *parser) {
     parser_next_token(parser); // consume '->'
     if (peek_token_is(parser, TOKEN_IDENTIFIER)) {
       parser_next_token(parser); // consume type name
-      free(func->as.function_decl.return_type);
-      func->as.function_decl.return_type =
-          strdup(parser->current_token->literal);
+      func->as.function_decl.return_type = current_name(parser);
     } else {
       parser_add_error(parser, "Expected return type after '->'");
     }
   }
 
   if (!expect_peek(parser, TOKEN_NEWLINE)) {
-    ast_free(func);
     return NULL;
   }
   parser_next_token(parser); // move to start of block
@@ -731,7 +725,7 @@ static ASTNode *parse_import_native_stmt(Parser *parser) {
     return NULL;
   }
 
-  ASTNode *node = ast_create_import_native(parser->current_token->literal);
+  ASTNode *node = ast_create_import_native(current_text(parser));
   parser_next_token(parser); // consume string
 
   if (current_token_is(parser, TOKEN_NEWLINE)) {
@@ -748,21 +742,20 @@ static ASTNode *parse_c_function_decl(Parser *parser) {
     parser_add_error(parser, "Expected C function name");
     return NULL;
   }
-  char *name = strdup(parser->current_token->literal);
+  char *name = current_name(parser);
   parser_next_token(parser);
 
   if (!current_token_is(parser, TOKEN_LPAREN)) {
     parser_add_error(parser, "Expected '(' after C function name");
-    free(name);
     return NULL;
   }
 
   char *return_type = "any";
   ASTNode *cfunc = ast_create_c_function_decl(name, return_type);
-  free(name);
 
   // Parse params (param: type)
   if (peek_token_is(parser, TOKEN_RPAREN)) {
+    parser_next_token(parser); // move to ')'
     parser_next_token(parser); // consume ')'
   } else {
     parser_next_token(parser); // move to first param name
@@ -777,7 +770,7 @@ static ASTNode *parse_c_function_decl(Parser *parser) {
       if (current_token_is(parser, TOKEN_COLON)) {
         parser_next_token(parser); // consume ':'
         if (current_token_is(parser, TOKEN_IDENTIFIER)) {
-          ast_c_function_add_param_type(cfunc, parser->current_token->literal);
+          ast_c_function_add_param_type(cfunc, current_name(parser));
           parser_next_token(parser); // consume type
         } else {
           parser_add_error(parser, "Expected type after ':'");
@@ -800,10 +793,7 @@ static ASTNode *parse_c_function_decl(Parser *parser) {
   if (current_token_is(parser, TOKEN_ARROW)) {
     parser_next_token(parser); // consume '->'
     if (current_token_is(parser, TOKEN_IDENTIFIER)) {
-      if (cfunc->as.c_function_decl.return_type)
-        free(cfunc->as.c_function_decl.return_type);
-      cfunc->as.c_function_decl.return_type =
-          strdup(parser->current_token->literal);
+      cfunc->as.c_function_decl.return_type = current_name(parser);
       parser_next_token(parser);
     } else {
       parser_add_error(parser, "Expected return type after '->'");
@@ -825,18 +815,16 @@ static ASTNode *parse_class_decl(Parser *parser) {
     return NULL;
   }
 
-  char *name = strdup(parser->current_token->literal);
+  char *name = current_name(parser);
   parser_next_token(parser);
 
   if (!current_token_is(parser, TOKEN_NEWLINE)) {
     parser_add_error(parser, "Expected newline after class name");
-    free(name);
     return NULL;
   }
   parser_next_token(parser); // move to class body
 
   ASTNode *class_node = ast_create_class_decl(name);
-  free(name);
 
   // Parse methods until 'end'
   while (!current_token_is(parser, TOKEN_END) &&
@@ -917,12 +905,11 @@ static ASTNode *parse_loop_statement(Parser *parser) {
     return NULL;
   }
 
-  char *iterator_name = strdup(parser->current_token->literal);
+  char *iterator_name = current_name(parser);
   parser_next_token(parser);
 
   if (!current_token_is(parser, TOKEN_FROM)) {
     parser_add_error(parser, "Expected 'from' in loop statement");
-    free(iterator_name);
     return NULL;
   }
   parser_next_token(parser);
@@ -930,8 +917,6 @@ static ASTNode *parse_loop_statement(Parser *parser) {
   ASTNode *start_expr = parse_expression(parser, PREC_LOWEST);
 
   if (!expect_peek(parser, TOKEN_TO)) {
-    free(iterator_name);
-    ast_free(start_expr);
     return NULL;
   }
   parser_next_token(parser);
@@ -946,11 +931,6 @@ static ASTNode *parse_loop_statement(Parser *parser) {
   }
 
   if (!expect_peek(parser, TOKEN_NEWLINE)) {
-    free(iterator_name);
-    ast_free(start_expr);
-    ast_free(end_expr);
-    if (step_expr)
-      ast_free(step_expr);
     return NULL;
   }
   parser_next_token(parser);
@@ -969,7 +949,6 @@ static ASTNode *parse_loop_statement(Parser *parser) {
 
   ASTNode *loop_stmt = ast_create_loop_stmt(iterator_name, start_expr, end_expr,
                                             step_expr, body);
-  free(iterator_name);
 
   return loop_stmt;
 }
@@ -982,12 +961,11 @@ static ASTNode *parse_for_statement(Parser *parser) {
     return NULL;
   }
 
-  char *iterator_name = strdup(parser->current_token->literal);
+  char *iterator_name = current_name(parser);
   parser_next_token(parser);
 
   if (!current_token_is(parser, TOKEN_IN)) {
     parser_add_error(parser, "Expected 'in' in for statement");
-    free(iterator_name);
     return NULL;
   }
   parser_next_token(parser);
@@ -995,8 +973,6 @@ static ASTNode *parse_for_statement(Parser *parser) {
   ASTNode *iterable = parse_expression(parser, PREC_LOWEST);
 
   if (!expect_peek(parser, TOKEN_NEWLINE)) {
-    free(iterator_name);
-    ast_free(iterable);
     return NULL;
   }
   parser_next_token(parser);
@@ -1014,7 +990,6 @@ static ASTNode *parse_for_statement(Parser *parser) {
   }
 
   ASTNode *for_stmt = ast_create_for_stmt(iterator_name, iterable, body);
-  free(iterator_name);
 
   return for_stmt;
 }
@@ -1027,7 +1002,7 @@ static ASTNode *parse_struct_decl(Parser *parser) {
     return NULL;
   }
 
-  ASTNode *struct_node = ast_create_struct_decl(parser->current_token->literal);
+  ASTNode *struct_node = ast_create_struct_decl(current_name(parser));
 
   if (!expect_peek(parser, TOKEN_NEWLINE))
     return struct_node;
@@ -1041,7 +1016,7 @@ static ASTNode *parse_struct_decl(Parser *parser) {
     }
 
     if (current_token_is(parser, TOKEN_IDENTIFIER)) {
-      ast_struct_add_field(struct_node, parser->current_token->literal);
+      ast_struct_add_field(struct_node, current_name(parser));
       parser_next_token(parser);
     } else {
       parser_add_error(parser, "Expected identifier for struct field");
@@ -1121,17 +1096,15 @@ static ASTNode *parse_try_catch_statement(Parser *parser) {
 
   if (!current_token_is(parser, TOKEN_CATCH)) {
     parser_add_error(parser, "Expected 'catch' after try block");
-    ast_free(try_block);
     return NULL;
   }
   parser_next_token(parser); // consume 'catch'
 
   if (!current_token_is(parser, TOKEN_IDENTIFIER)) {
     parser_add_error(parser, "Expected identifier for catch error variable");
-    ast_free(try_block);
     return NULL;
   }
-  char *catch_var = strdup(parser->current_token->literal);
+  char *catch_var = current_name(parser);
   parser_next_token(parser); // consume identifier
 
   ASTNode *catch_block = parse_block_statement(parser);
@@ -1148,7 +1121,6 @@ static ASTNode *parse_try_catch_statement(Parser *parser) {
 
   ASTNode *try_catch_stmt =
       ast_create_try_catch(try_block, catch_var, catch_block);
-  free(catch_var);
   return try_catch_stmt;
 }
 
@@ -1166,7 +1138,7 @@ static ASTNode *parse_throw_statement(Parser *parser) {
 
 static ASTNode *parse_asm_block(Parser *parser) {
   // current_token is TOKEN_ASM; its literal is the raw assembly text
-  ASTNode *node = ast_create_asm_block(parser->current_token->literal);
+  ASTNode *node = ast_create_asm_block(current_text(parser));
   parser_next_token(parser); // consume TOKEN_ASM
   if (current_token_is(parser, TOKEN_NEWLINE)) {
     parser_next_token(parser);
@@ -1226,10 +1198,8 @@ static ASTNode *parse_statement(Parser *parser) {
       parser_add_error(parser, "Expected module name after 'import'");
       return NULL;
     }
-    ASTNode *import_node = malloc(sizeof(ASTNode));
-    import_node->type = AST_IMPORT_STMT;
-    import_node->as.import_stmt.module_name =
-        strdup(parser->current_token->literal);
+    ASTNode *import_node = ast_create_node(AST_IMPORT_STMT);
+    import_node->as.import_stmt.module_name = current_name(parser);
     parser_next_token(parser); // consume module name
     if (current_token_is(parser, TOKEN_NEWLINE))
       parser_next_token(parser);
@@ -1253,12 +1223,12 @@ void parser_init(Parser *parser, Lexer *lexer) {
   parser->lexer = lexer;
   parser->errors = NULL;
   parser->error_count = 0;
-  parser->current_token = NULL;
-  parser->peek_token = NULL;
+  parser->current_token = &parser->tokens[0];
+  parser->peek_token = &parser->tokens[1];
 
   // Read two tokens, so current and peek are both set
-  parser->peek_token = lexer_next_token(parser->lexer);
-  parser_next_token(parser);
+  parser->tokens[0] = lexer_next_token(parser->lexer);
+  parser->tokens[1] = lexer_next_token(parser->lexer);
 }
 
 ASTNode *parser_parse_program(Parser *parser) {
@@ -1288,19 +1258,6 @@ ASTNode *parser_parse_program(Parser *parser) {
   return program;
 }
 
-void parser_free(Parser *parser) {
-  if (parser->current_token)
-    token_free(parser->current_token);
-  if (parser->peek_token)
-    token_free(parser->peek_token);
-
-  for (int i = 0; i < parser->error_count; i++) {
-    free(parser->errors[i]);
-  }
-  if (parser->errors)
-    free(parser->errors);
-}
-
 void parser_print_errors(Parser *parser) {
   if (parser->error_count == 0)
     return;
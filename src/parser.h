@@ -7,17 +7,17 @@
 
 typedef struct {
   Lexer *lexer;
+  Token tokens[2]; // storage for the two-token window below
   Token *current_token;
   Token *peek_token;
 
-  // Error tracking
+  // Error tracking (messages live in compile_arena)
   char **errors;
   int error_count;
 } Parser;
 
 void parser_init(Parser *parser, Lexer *lexer);
 ASTNode *parser_parse_program(Parser *parser);
-void parser_free(Parser *parser);
 void parser_print_errors(Parser *parser);
 
 #endif // PARSER_H
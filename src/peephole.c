@@ -0,0 +1,809 @@
+#include "peephole.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *s;
+  int len;
+} Slice;
+
+#define SLICE(lit) ((Slice){lit, sizeof(lit) - 1})
+
+typedef enum { LINE_OTHER, LINE_LABEL, LINE_INSN } LineKind;
+
+// Mnemonics the rules care about; everything else is OP_UNKNOWN
+typedef enum {
+  OP_UNKNOWN,
+  OP_MOV,
+  OP_LEA,
+  OP_MOVX, // movzx, movsx, movsxd
+  OP_ADD,
+  OP_SUB,
+  OP_AND,
+  OP_OR,
+  OP_XOR,
+  OP_CMP,
+  OP_TEST,
+  OP_UNARY, // inc, dec, neg, not
+  OP_SHIFT, // shl, shr, sar
+  OP_IMUL,
+  OP_SETCC,
+  OP_CMOVCC,
+  OP_PUSH,
+  OP_POP,
+  OP_CALL,
+  OP_JUMP // jmp and jcc
+} Opcode;
+
+typedef struct {
+  Slice text;   // without the newline
+  Slice op;     // LINE_INSN: mnemonic; LINE_LABEL: label name
+  Slice arg[2]; // operands, trimmed
+  // Per operand: registers named in it (one bit per number), and the
+  // register number and width (see reg_lookup) when it is just a register,
+  // else -1
+  uint16_t regs[2];
+  int8_t reg[2];
+  uint8_t width[2];
+  long long imm; // value of the operand flagged in is_imm
+  uint8_t is_imm[2];
+  uint8_t kind; // LineKind
+  uint8_t code; // Opcode
+  uint8_t argc;
+  uint8_t is_explicit; // see classify()
+  uint8_t deleted;
+  uint8_t rewritten; // print op/arg instead of text
+} Line;
+
+// ── Parsing ─────────────────────────────────────────────────────────────────
+
+static int is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static int is_word(char c) {
+  return (unsigned)((c | 0x20) - 'a') < 26 || (unsigned)(c - '0') < 10 ||
+         c == '_';
+}
+
+static Slice trim(const char *s, const char *end) {
+  while (s < end && is_space(*s))
+    s++;
+  while (end > s && is_space(end[-1]))
+    end--;
+  return (Slice){s, (int)(end - s)};
+}
+
+static int slice_eq(Slice a, Slice b) {
+  return a.len == b.len && memcmp(a.s, b.s, a.len) == 0;
+}
+
+static int slice_is(Slice a, const char *s) {
+  return (int)strlen(s) == a.len && memcmp(a.s, s, a.len) == 0;
+}
+
+static Opcode opcode(Slice op) {
+  static const struct {
+    const char *name;
+    Opcode code;
+  } table[] = {{"mov", OP_MOV},     {"lea", OP_LEA},     {"movzx", OP_MOVX},
+               {"movsx", OP_MOVX},  {"movsxd", OP_MOVX}, {"add", OP_ADD},
+               {"sub", OP_SUB},     {"and", OP_AND},     {"or", OP_OR},
+               {"xor", OP_XOR},     {"cmp", OP_CMP},     {"test", OP_TEST},
+               {"inc", OP_UNARY},   {"dec", OP_UNARY},   {"neg", OP_UNARY},
+               {"not", OP_UNARY},   {"shl", OP_SHIFT},   {"shr", OP_SHIFT},
+               {"sar", OP_SHIFT},   {"imul", OP_IMUL},   {"push", OP_PUSH},
+               {"pop", OP_POP},     {"call", OP_CALL}};
+  if (op.s[0] == 'j')
+    return OP_JUMP;
+  for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+    if (table[i].name[0] == op.s[0] && slice_is(op, table[i].name))
+      return table[i].code;
+  if (op.len > 3 && memcmp(op.s, "set", 3) == 0)
+    return OP_SETCC;
+  if (op.len > 4 && memcmp(op.s, "cmov", 4) == 0)
+    return OP_CMOVCC;
+  return OP_UNKNOWN;
+}
+
+static void describe_operands(Line *l);
+
+static void parse_line(Line *l) {
+  const char *p = l->text.s, *end = p + l->text.len;
+  l->kind = LINE_OTHER;
+  if (p == end)
+    return;
+
+  // Labels start the line: "name:" alone or followed by a comment
+  if (!is_space(*p)) {
+    const char *q = p;
+    while (q < end && (is_word(*q) || *q == '.' || *q == '$'))
+      q++;
+    if (q > p && q < end && *q == ':') {
+      Slice rest = trim(q + 1, end);
+      if (rest.len == 0 || rest.s[0] == '/' || rest.s[0] == '#') {
+        l->kind = LINE_LABEL;
+        l->op = (Slice){p, (int)(q - p)};
+      }
+    }
+    return;
+  }
+
+  // Instructions are indented: mnemonic, then operands split at commas.
+  // Directives and lines with a comment, a string, a label or a segment
+  // prefix are left alone.
+  while (p < end && is_space(*p))
+    p++;
+  if (p == end || !is_word(*p))
+    return;
+  const char *q = p;
+  while (q < end && is_word(*q))
+    q++;
+  if (q < end && !is_space(*q))
+    return;
+  Slice arg[2];
+  int argc = 0;
+  const char *start = q;
+  for (const char *c = q;; c++) {
+    if (c == end || *c == ',') {
+      Slice a = trim(start, c);
+      if (a.len == 0 && (c != end || argc > 0))
+        return;
+      if (a.len > 0) {
+        if (argc == 2)
+          return;
+        arg[argc++] = a;
+      }
+      if (c == end)
+        break;
+      start = c + 1;
+    } else if (*c == '#' || *c == '/' || *c == ';' || *c == '"' ||
+               *c == ':') {
+      return;
+    }
+  }
+  l->kind = LINE_INSN;
+  l->op = (Slice){p, (int)(q - p)};
+  l->code = opcode(l->op);
+  l->argc = argc;
+  for (int i = 0; i < argc; i++)
+    l->arg[i] = arg[i];
+  describe_operands(l);
+}
+
+// ── Registers and operands ──────────────────────────────────────────────────
+
+enum { REG_RSP = 4, REG_RBP = 5, REG_R10 = 10 };
+
+// ax, cx, dx, bx, sp, bp, si, di -> 0..7 (the 16-bit names, which the
+// 64- and 32-bit ones extend with an r/e prefix)
+static int legacy_reg(char a, char b) {
+  switch (a) {
+  case 'a':
+    return b == 'x' ? 0 : -1;
+  case 'c':
+    return b == 'x' ? 1 : -1;
+  case 'd':
+    return b == 'x' ? 2 : b == 'i' ? 7 : -1;
+  case 'b':
+    return b == 'x' ? 3 : b == 'p' ? 5 : -1;
+  case 's':
+    return b == 'p' ? 4 : b == 'i' ? 6 : -1;
+  default:
+    return -1;
+  }
+}
+
+// Register number of any spelling, in any case (rax/eax/ax/al/ah are all 0);
+// -1 if `s` is not a register. *width is 0 for 64-bit, 1 for 32-bit, 2 for
+// 16-bit and 3 for 8-bit names.
+static int reg_lookup(Slice s, int *width) {
+  char c[5];
+  if (s.len < 2 || s.len > 4)
+    return -1;
+  for (int i = 0; i < s.len; i++)
+    c[i] = s.s[i] | 0x20;
+  c[s.len] = '\0';
+
+  if (c[0] == 'r' && c[1] >= '0' && c[1] <= '9') { // r8 .. r15b
+    int num = c[1] - '0', k = 2;
+    if (num == 1 && c[2] >= '0' && c[2] <= '5')
+      num = 10 + c[k++] - '0';
+    if (num < 8)
+      return -1;
+    static const char suffix[] = "\0dwb";
+    const char *w = c[k] ? memchr(suffix + 1, c[k], 3) : suffix;
+    if (!w || (c[k] && c[k + 1]))
+      return -1;
+    *width = (int)(w - suffix);
+    return num;
+  }
+  int r;
+  if (s.len == 2) {
+    if ((r = legacy_reg(c[0], c[1])) >= 0) {
+      *width = 2;
+      return r;
+    }
+    if ((c[1] == 'l' || c[1] == 'h') && (r = legacy_reg(c[0], 'x')) >= 0) {
+      *width = 3; // al, cl, dl, bl, ah, ch, dh, bh
+      return r;
+    }
+    return -1;
+  }
+  if (s.len != 3)
+    return -1;
+  if ((c[0] == 'r' || c[0] == 'e') && (r = legacy_reg(c[1], c[2])) >= 0) {
+    *width = c[0] == 'r' ? 0 : 1;
+    return r;
+  }
+  if (c[2] == 'l' && (r = legacy_reg(c[0], c[1])) >= 4) {
+    *width = 3; // spl, bpl, sil, dil
+    return r;
+  }
+  return -1;
+}
+
+// Decimal or 0x-prefixed integer of at most 15 digits; anything else
+// (octal, suffixes, expressions) is not treated as an immediate
+static int parse_imm(Slice s, long long *value) {
+  const char *p = s.s, *end = s.s + s.len;
+  int negative = p < end && *p == '-';
+  p += negative;
+  int base = 10;
+  if (end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x') {
+    base = 16;
+    p += 2;
+  } else if (end - p > 1 && p[0] == '0') {
+    return 0;
+  }
+  if (p == end || end - p > 15)
+    return 0;
+  long long v = 0;
+  for (; p < end; p++) {
+    int digit;
+    if (*p >= '0' && *p <= '9')
+      digit = *p - '0';
+    else if (base == 16 && (unsigned)((*p | 0x20) - 'a') < 6)
+      digit = (*p | 0x20) - 'a' + 10;
+    else
+      return 0;
+    v = v * base + digit;
+  }
+  *value = negative ? -v : v;
+  return 1;
+}
+
+static int fits_imm32(long long v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+// Fills in what Line records about operand `i` in one scan of its words
+static void describe_operand(Line *l, int i) {
+  Slice s = l->arg[i];
+  const char *p = s.s, *end = s.s + s.len;
+  unsigned regs = 0;
+  l->reg[i] = -1;
+  l->width[i] = 0;
+  while (p < end) {
+    if (!is_word(*p)) {
+      p++;
+      continue;
+    }
+    const char *start = p;
+    while (p < end && is_word(*p))
+      p++;
+    int width;
+    int reg = reg_lookup((Slice){start, (int)(p - start)}, &width);
+    if (reg < 0)
+      continue;
+    regs |= 1u << reg;
+    if (start == s.s && p == end) {
+      l->reg[i] = (int8_t)reg;
+      l->width[i] = (uint8_t)width;
+    }
+  }
+  l->regs[i] = (uint16_t)regs;
+  l->is_imm[i] = !regs && parse_imm(s, &l->imm);
+}
+
+static void describe_operands(Line *l) {
+  for (int i = 0; i < 2; i++) {
+    if (i < l->argc) {
+      describe_operand(l, i);
+    } else {
+      l->regs[i] = 0;
+      l->reg[i] = -1;
+      l->is_imm[i] = 0;
+    }
+  }
+}
+
+// Register number when operand `i` is exactly a 64-bit register, else -1
+static int reg64(const Line *l, int i) {
+  return l->width[i] == 0 ? l->reg[i] : -1;
+}
+
+static int mentions(const Line *l, int reg) {
+  return ((l->regs[0] | l->regs[1]) >> reg) & 1;
+}
+
+// "[rsp + N]" -> N
+static int parse_rsp_slot(Slice s, int *slot) {
+  static const char prefix[] = "[rsp + ";
+  int n = sizeof(prefix) - 1;
+  if (s.len <= n + 1 || memcmp(s.s, prefix, n) != 0 || s.s[s.len - 1] != ']')
+    return 0;
+  long long v;
+  if (!parse_imm((Slice){s.s + n, s.len - n - 1}, &v))
+    return 0;
+  *slot = (int)v;
+  return 1;
+}
+
+// ── Instruction classes ─────────────────────────────────────────────────────
+
+static int is_op(const Line *l, Opcode code, int argc) {
+  return l->kind == LINE_INSN && l->code == code && l->argc == argc;
+}
+
+// Instructions whose only register operands are the written ones (plus
+// flags), so mentions() sees every register they touch
+static int classify(const Line *l) {
+  if (l->kind != LINE_INSN || l->argc == 0)
+    return 0;
+  switch (l->code) {
+  case OP_IMUL:
+    return l->argc == 2; // one-operand imul uses rax/rdx
+  case OP_MOV:
+  case OP_LEA:
+  case OP_MOVX:
+  case OP_ADD:
+  case OP_SUB:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+  case OP_CMP:
+  case OP_TEST:
+  case OP_UNARY:
+  case OP_SHIFT:
+  case OP_SETCC:
+  case OP_CMOVCC:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Can be moved past or run with a different RSP: no stack access at all
+static int is_stack_free(const Line *l) {
+  return l->is_explicit && !mentions(l, REG_RSP);
+}
+
+// Overwrites all of `reg` without reading it
+static int kills(const Line *l, int reg) {
+  if (is_op(l, OP_POP, 1))
+    return reg64(l, 0) == reg;
+  if (!(is_op(l, OP_MOV, 2) || is_op(l, OP_LEA, 2) || is_op(l, OP_MOVX, 2)))
+    return 0;
+  return l->reg[0] == reg && l->width[0] <= 1 && !((l->regs[1] >> reg) & 1);
+}
+
+static int next_line(const Line *lines, int n, int i) {
+  for (i++; i < n && lines[i].deleted; i++)
+    ;
+  return i;
+}
+
+// `reg` is not read after line `i` before being overwritten. Gives up (live)
+// at labels, branches, calls and anything it does not model.
+static int dead_after(const Line *lines, int n, int i, int reg) {
+  for (int k = next_line(lines, n, i), steps = 0; k < n && steps < 32;
+       k = next_line(lines, n, k), steps++) {
+    const Line *l = &lines[k];
+    if (kills(l, reg))
+      return 1;
+    if (!(l->is_explicit || is_op(l, OP_PUSH, 1) || is_op(l, OP_POP, 1)) ||
+        mentions(l, reg))
+      return 0;
+  }
+  return 0;
+}
+
+// Operands changed: refresh what the rules look at
+static void update(Line *l) {
+  describe_operands(l);
+  l->is_explicit = classify(l);
+}
+
+static void rewrite_mov(Line *l, Slice dst, Slice src) {
+  l->op = SLICE("mov");
+  l->code = OP_MOV;
+  l->arg[0] = dst;
+  l->arg[1] = src;
+  l->argc = 2;
+  l->rewritten = 1;
+  update(l);
+}
+
+// ── Rules ───────────────────────────────────────────────────────────────────
+
+// push X ... pop Y with only stack-free instructions that leave Y alone in
+// between: Y = X can happen at the push. Scanned backwards so inner pairs go
+// first and the outer ones then see a plain mov in the gap.
+static int fold_push_pop(Line *lines, int n) {
+  int changed = 0;
+  for (int i = n - 1; i >= 0; i--) {
+    Line *push = &lines[i];
+    if (push->deleted || !is_op(push, OP_PUSH, 1))
+      continue;
+    int src = reg64(push, 0);
+    if (src == REG_RSP || (src < 0 && !push->is_imm[0]))
+      continue;
+    int j = next_line(lines, n, i);
+    while (j < n && is_stack_free(&lines[j]))
+      j = next_line(lines, n, j);
+    if (j == n || !is_op(&lines[j], OP_POP, 1))
+      continue;
+    int dst = reg64(&lines[j], 0);
+    if (dst < 0 || dst == REG_RSP)
+      continue;
+    int clash = 0;
+    for (int k = next_line(lines, n, i); k < j && !clash;
+         k = next_line(lines, n, k))
+      clash = mentions(&lines[k], dst);
+    if (clash)
+      continue;
+    if (src == dst)
+      push->deleted = 1;
+    else
+      rewrite_mov(push, lines[j].arg[0], push->arg[0]);
+    lines[j].deleted = 1;
+    changed = 1;
+  }
+  return changed;
+}
+
+// pop X / push X leaves the stack as it was: X = [rsp]. Also drops reloads
+// of what was just pushed, moves that repeat the previous one and copies of
+// a register onto itself.
+static int fold_reloads(Line *lines, int n) {
+  int changed = 0;
+  for (int i = 0; i < n; i = next_line(lines, n, i)) {
+    Line *l = &lines[i];
+    if (l->deleted || l->kind != LINE_INSN)
+      continue;
+    int j = next_line(lines, n, i);
+    Line *next = j < n ? &lines[j] : NULL;
+    if (is_op(l, OP_POP, 1) && next && is_op(next, OP_PUSH, 1)) {
+      int reg = reg64(l, 0);
+      if (reg >= 0 && reg != REG_RSP && reg64(next, 0) == reg) {
+        rewrite_mov(l, l->arg[0], SLICE("[rsp]"));
+        next->deleted = 1;
+        changed = 1;
+      }
+      continue;
+    }
+    if (is_op(l, OP_PUSH, 1) && next && is_op(next, OP_MOV, 2) &&
+        slice_eq(next->arg[0], l->arg[0]) &&
+        slice_is(next->arg[1], "[rsp]") && reg64(l, 0) >= 0) {
+      next->deleted = 1;
+      changed = 1;
+      continue;
+    }
+    if (!is_op(l, OP_MOV, 2))
+      continue;
+    int dst = reg64(l, 0);
+    if (dst >= 0 && reg64(l, 1) == dst) {
+      l->deleted = 1;
+      changed = 1;
+      continue;
+    }
+    if (dst < 0 || !next || !is_op(next, OP_MOV, 2) ||
+        !slice_eq(next->arg[0], l->arg[0]) || !slice_eq(next->arg[1], l->arg[1]))
+      continue;
+    // Only reloads from the stack frame: other memory may be a device
+    // register in freestanding code
+    Slice src = l->arg[1];
+    int plain = reg64(l, 1) >= 0 || l->is_imm[1];
+    int frame = src.len > 4 && (memcmp(src.s, "[rsp", 4) == 0 ||
+                                memcmp(src.s, "[rbp", 4) == 0);
+    if ((plain || frame) && !((l->regs[1] >> dst) & 1)) {
+      next->deleted = 1;
+      changed = 1;
+    }
+  }
+  return changed;
+}
+
+// The four live lines from `i` are the alignment half of emit_call's
+// sequence (codegen.c), saving RSP at [rsp + *slot]:
+//   mov r10, rsp / and rsp, -16 / sub rsp, slot + 8 / mov [rsp + slot], r10
+static int match_realign(const Line *lines, int n, int i, int *slot,
+                         int seq[4]) {
+  for (int k = 0; k < 4; k++, i = next_line(lines, n, i)) {
+    if (i >= n)
+      return 0;
+    seq[k] = i;
+  }
+  const Line *save = &lines[seq[0]], *align = &lines[seq[1]],
+             *open = &lines[seq[2]], *store = &lines[seq[3]];
+  int store_slot;
+  if (!is_op(save, OP_MOV, 2) || !slice_is(save->arg[0], "r10") ||
+      !slice_is(save->arg[1], "rsp") || !is_op(align, OP_AND, 2) ||
+      !slice_is(align->arg[0], "rsp") || !slice_is(align->arg[1], "-16") ||
+      !is_op(open, OP_SUB, 2) || !slice_is(open->arg[0], "rsp") ||
+      !open->is_imm[1] || !is_op(store, OP_MOV, 2) ||
+      !parse_rsp_slot(store->arg[0], &store_slot) ||
+      !slice_is(store->arg[1], "r10") || open->imm != store_slot + 8)
+    return 0;
+  *slot = store_slot;
+  return 1;
+}
+
+static int skips_between_calls(const Line *l) {
+  return is_stack_free(l) && !mentions(l, REG_R10);
+}
+
+// Follows the alignment in effect from one emit_call sequence through the
+// calls that share it. At `call f / mov rsp, [rsp + slot]`, when the next
+// call follows with only stack-free work that leaves r10 alone, restoring
+// RSP and aligning it again would give the same RSP and the same saved
+// slot: both halves go and the next call runs on the same alignment.
+static int merge_realignments(Line *lines, int n) {
+  int changed = 0;
+  int aligned = -1; // saved-RSP slot of the alignment in effect
+  for (int i = 0; i < n; i = next_line(lines, n, i)) {
+    Line *l = &lines[i];
+    int slot, seq[4];
+    if (l->deleted || l->kind != LINE_INSN) {
+      aligned = l->deleted ? aligned : -1;
+      continue;
+    }
+    if (is_op(l, OP_MOV, 2) && slice_is(l->arg[0], "r10") &&
+        match_realign(lines, n, i, &slot, seq)) {
+      aligned = slot;
+      i = seq[3];
+      continue;
+    }
+    if (aligned < 0 || is_op(l, OP_CALL, 1) || skips_between_calls(l))
+      continue;
+    if (!is_op(l, OP_MOV, 2) || !slice_is(l->arg[0], "rsp") ||
+        !parse_rsp_slot(l->arg[1], &slot) || slot != aligned) {
+      aligned = -1;
+      continue;
+    }
+    int j = next_line(lines, n, i);
+    while (j < n && skips_between_calls(&lines[j]))
+      j = next_line(lines, n, j);
+    int call;
+    if (!match_realign(lines, n, j, &slot, seq) || slot != aligned ||
+        (call = next_line(lines, n, seq[3])) == n ||
+        !is_op(&lines[call], OP_CALL, 1)) {
+      aligned = -1;
+      continue;
+    }
+    l->deleted = 1;
+    for (int k = 0; k < 4; k++)
+      lines[seq[k]].deleted = 1;
+    changed = 1;
+  }
+  return changed;
+}
+
+static int is_rsp_imm(const Line *l, Opcode code) {
+  return is_op(l, code, 2) && reg64(l, 0) == REG_RSP && l->is_imm[1];
+}
+
+// `add rsp, N` then, after stack-free work that does not read the flags,
+// `sub rsp, N` and a call: the padding emit_call puts around calls where
+// RSP is known (codegen.c). The call clobbers the flags, so both go.
+static int merge_paddings(Line *lines, int n) {
+  int changed = 0;
+  for (int i = 0; i < n; i = next_line(lines, n, i)) {
+    Line *l = &lines[i];
+    if (l->deleted || !is_rsp_imm(l, OP_ADD))
+      continue;
+    int j = next_line(lines, n, i);
+    while (j < n && is_stack_free(&lines[j]) && lines[j].code != OP_SETCC &&
+           lines[j].code != OP_CMOVCC)
+      j = next_line(lines, n, j);
+    int call;
+    if (j == n || !is_rsp_imm(&lines[j], OP_SUB) || lines[j].imm != l->imm ||
+        (call = next_line(lines, n, j)) == n ||
+        !is_op(&lines[call], OP_CALL, 1))
+      continue;
+    l->deleted = 1;
+    lines[j].deleted = 1;
+    changed = 1;
+  }
+  return changed;
+}
+
+static int drop_jumps_to_next(Line *lines, int n) {
+  int changed = 0;
+  for (int i = 0; i < n; i = next_line(lines, n, i)) {
+    Line *l = &lines[i];
+    if (l->deleted || !is_op(l, OP_JUMP, 1))
+      continue;
+    for (int k = next_line(lines, n, i); k < n && lines[k].kind == LINE_LABEL;
+         k = next_line(lines, n, k)) {
+      if (slice_eq(lines[k].op, l->arg[0])) {
+        l->deleted = 1;
+        changed = 1;
+        break;
+      }
+    }
+  }
+  return changed;
+}
+
+// mov R, imm followed by `push R` or `op A, R`: use the immediate directly
+// when nothing reads R afterwards.
+static int fold_immediates(Line *lines, int n) {
+  int changed = 0;
+  for (int i = 0; i < n; i = next_line(lines, n, i)) {
+    Line *l = &lines[i];
+    if (l->deleted || !is_op(l, OP_MOV, 2) || !l->is_imm[1])
+      continue;
+    int reg = reg64(l, 0);
+    int j = next_line(lines, n, i);
+    if (reg < 0 || reg == REG_RSP || reg == REG_RBP || j == n)
+      continue;
+    Line *use = &lines[j];
+    int slot;
+    if (is_op(use, OP_PUSH, 1))
+      slot = 0;
+    else if (use->kind == LINE_INSN && use->argc == 2 &&
+             use->code >= OP_MOV && use->code <= OP_TEST &&
+             use->code != OP_LEA && use->code != OP_MOVX)
+      slot = 1;
+    else
+      continue;
+    if (reg64(use, slot) != reg)
+      continue;
+    if (slot == 1) {
+      int dst = reg64(use, 0);
+      if (dst < 0 || dst == reg)
+        continue;
+    }
+    if ((use->code != OP_MOV && !fits_imm32(l->imm)) ||
+        !dead_after(lines, n, j, reg))
+      continue;
+    use->arg[slot] = l->arg[1];
+    use->rewritten = 1;
+    update(use);
+    l->deleted = 1;
+    changed = 1;
+  }
+  return changed;
+}
+
+// ── Driver ──────────────────────────────────────────────────────────────────
+
+// Markers codegen puts around the body of an asm { } block
+#define ASM_BEGIN SLICE("/* asm block */")
+#define ASM_END SLICE("/* end asm block */")
+
+// Length of the asm block body starting at p, up to and including the line
+// with its end marker
+static size_t asm_block_len(const char *p, const char *end) {
+  const char *q = p;
+  while (q < end) {
+    const char *nl = memchr(q, '\n', end - q);
+    Slice line = trim(q, nl ? nl : end);
+    q = nl ? nl + 1 : end;
+    if (slice_eq(line, ASM_END))
+      break;
+  }
+  return (size_t)(q - p);
+}
+
+static void optimize_block(Line *lines, int n) {
+  // Every rule deletes at least one line, so this ends
+  int changed;
+  do {
+    changed = fold_push_pop(lines, n);
+    changed |= fold_reloads(lines, n);
+    changed |= merge_realignments(lines, n);
+    changed |= merge_paddings(lines, n);
+    changed |= drop_jumps_to_next(lines, n);
+    changed |= fold_immediates(lines, n);
+  } while (changed);
+}
+
+static char *append(char *p, Slice s) {
+  memcpy(p, s.s, s.len);
+  return p + s.len;
+}
+
+static size_t line_size(const Line *l) {
+  if (l->deleted)
+    return 0;
+  if (!l->rewritten)
+    return l->text.len + 1;
+  return 4 + l->op.len + 1 + l->arg[0].len +
+         (l->argc == 2 ? 2 + l->arg[1].len : 0) + 1;
+}
+
+static char *print_line(char *q, const Line *l) {
+  if (l->deleted)
+    return q;
+  if (!l->rewritten) {
+    q = append(q, l->text);
+  } else {
+    q = append(q, SLICE("    "));
+    q = append(q, l->op);
+    *q++ = ' ';
+    q = append(q, l->arg[0]);
+    if (l->argc == 2) {
+      q = append(q, SLICE(", "));
+      q = append(q, l->arg[1]);
+    }
+  }
+  *q++ = '\n';
+  return q;
+}
+
+char *peephole_optimize(const char *text, size_t len, size_t *out_len) {
+  size_t cap = len + 64, size = 0;
+  char *result = malloc(cap);
+  int line_cap = 256;
+  Line *lines = malloc(line_cap * sizeof(Line));
+  int last_deleted = 0;
+
+  // No rule looks past a directive or a blank line, so the text is parsed,
+  // optimized and printed one stretch between them (usually a function) at
+  // a time, while its lines are still in cache
+  const char *p = text, *end = text + len;
+  while (p < end) {
+    int n = 0;
+    do {
+      if (n == line_cap) {
+        line_cap *= 2;
+        lines = realloc(lines, line_cap * sizeof(Line));
+      }
+      const char *nl = memchr(p, '\n', end - p);
+      const char *stop = nl ? nl : end;
+      Line *l = &lines[n++];
+      memset(l, 0, sizeof(*l));
+      l->text = (Slice){p, (int)(stop - p)};
+      parse_line(l);
+      l->is_explicit = classify(l);
+      p = nl ? nl + 1 : end;
+    } while (p < end && lines[n - 1].kind != LINE_OTHER);
+
+    optimize_block(lines, n);
+
+    size_t need = size + 1;
+    for (int i = 0; i < n; i++)
+      need += line_size(&lines[i]);
+    if (need > cap) {
+      cap = need > cap * 2 ? need : cap * 2;
+      result = realloc(result, cap);
+    }
+    char *q = result + size;
+    for (int i = 0; i < n; i++)
+      q = print_line(q, &lines[i]);
+    size = (size_t)(q - result);
+    last_deleted = lines[n - 1].deleted;
+
+    // asm { } bodies are copied as written
+    Slice last = trim(lines[n - 1].text.s, lines[n - 1].text.s + lines[n - 1].text.len);
+    size_t body = slice_eq(last, ASM_BEGIN) ? asm_block_len(p, end) : 0;
+    if (body) {
+      if (size + body + 1 > cap) {
+        cap = size + body + 1 > cap * 2 ? size + body + 1 : cap * 2;
+        result = realloc(result, cap);
+      }
+      memcpy(result + size, p, body);
+      size += body;
+      p += body;
+      last_deleted = 1; // copied with its own final newline, if any
+    }
+  }
+  free(lines);
+
+  // Keep a missing final newline missing
+  if (len > 0 && text[len - 1] != '\n' && !last_deleted)
+    size--;
+  result[size] = '\0';
+  *out_len = size;
+  return result;
+}
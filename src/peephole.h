@@ -0,0 +1,27 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stddef.h>
+
+// Peephole pass over one unit of generated assembly (Intel syntax, one
+// instruction per line). It cleans up what the stack-machine code generator
+// leaves behind:
+//
+//   push X / pop Y         -> mov Y, X (nothing when X == Y), also across
+//                             instructions that leave the stack, X and Y alone
+//   pop X / push X         -> mov X, [rsp]
+//   mov R, imm / op A, R   -> op A, imm, when R is dead afterwards
+//   restoring RSP after a call and realigning it for the next one with only
+//   register work in between -> the first alignment is kept
+//   add rsp, N ... sub rsp, N / call (padding around consecutive calls)
+//                          -> both removed
+//   jmp/jcc to the label right after it -> removed
+//
+// Labels, directives, comments and instructions it does not model end a
+// sequence. The body of an `asm { }` block (between the markers codegen
+// emits around it) is copied unchanged.
+//
+// Returns the optimized text (malloc'd) and stores its length in *out_len.
+char *peephole_optimize(const char *text, size_t len, size_t *out_len);
+
+#endif // PEEPHOLE_H
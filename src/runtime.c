@@ -7,11 +7,29 @@
 #include <string.h>
 #include <time.h>
 #ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
 #include <windows.h>
 #define stola_strdup _strdup
 #else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #define stola_strdup strdup
 #endif
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_SSE2 1
+#endif
+
+// Lazy JSON nodes (defined with the JSON decoder)
+static int json_lazy_is_object(StolaValue *node);
+static int64_t json_lazy_length(StolaValue *node);
+static StolaValue *json_lazy_get(StolaValue *node, StolaValue *key);
+static StolaValue *json_lazy_field(StolaValue *node, const char *field);
+static size_t json_lazy_span(StolaValue *node);
 
 // ============================================================
 // Value Constructors
@@ -45,6 +63,14 @@ StolaValue *stola_new_string_owned(char *str) {
   return v;
 }
 
+StolaValue *stola_new_view(const char *ptr, size_t len) {
+  StolaValue *v = (StolaValue *)malloc(sizeof(StolaValue));
+  v->type = STOLA_VIEW;
+  v->as.view_val.ptr = ptr;
+  v->as.view_val.len = len;
+  return v;
+}
+
 StolaValue *stola_new_null(void) {
   StolaValue *v = (StolaValue *)malloc(sizeof(StolaValue));
   v->type = STOLA_NULL;
@@ -104,6 +130,12 @@ int stola_is_truthy(StolaValue *val) {
     return 1;
   case STOLA_FUNCTION:
     return 1;
+  case STOLA_JSON:
+    return json_lazy_length(val) > 0;
+  case STOLA_VIEW:
+    return val->as.view_val.len > 0;
+  case STOLA_ITER:
+    return 1;
   default:
     return 0;
   }
@@ -118,6 +150,7 @@ const char *stola_type_name(StolaValue *val) {
   case STOLA_BOOL:
     return "bool";
   case STOLA_STRING:
+  case STOLA_VIEW:
     return "string";
   case STOLA_ARRAY:
     return "array";
@@ -129,6 +162,10 @@ const char *stola_type_name(StolaValue *val) {
     return "function";
   case STOLA_NULL:
     return "null";
+  case STOLA_JSON:
+    return json_lazy_is_object(val) ? "dict" : "array";
+  case STOLA_ITER:
+    return "iterator";
   default:
     return "unknown";
   }
@@ -192,6 +229,20 @@ static void print_value_internal(StolaValue *val, int nested) {
   case STOLA_FUNCTION:
     printf("<function>");
     break;
+  case STOLA_JSON:
+    stola_json_force(val);
+    print_value_internal(val, nested);
+    break;
+  case STOLA_VIEW:
+    if (nested)
+      printf("\"");
+    fwrite(val->as.view_val.ptr, 1, val->as.view_val.len, stdout);
+    if (nested)
+      printf("\"");
+    break;
+  case STOLA_ITER:
+    printf("<iterator>");
+    break;
   }
 }
 
@@ -218,8 +269,9 @@ static int64_t val_to_int(StolaValue *v) {
 StolaValue *stola_add(StolaValue *a, StolaValue *b) {
   if (!a || !b)
     return stola_new_null();
-  // String + anything = string concatenation
-  if (a->type == STOLA_STRING || b->type == STOLA_STRING) {
+  // String (or view) + anything = string concatenation
+  if (a->type == STOLA_STRING || b->type == STOLA_STRING ||
+      a->type == STOLA_VIEW || b->type == STOLA_VIEW) {
     return stola_string_concat(a, b);
   }
   return stola_new_int(val_to_int(a) + val_to_int(b));
@@ -257,9 +309,20 @@ StolaValue *stola_neg(StolaValue *a) { return stola_new_int(-val_to_int(a)); }
 // Dynamic Comparisons
 // ============================================================
 
+// Byte-wise ordering of two string-like values (strings or views).
+static int span_cmp(const char *a, size_t an, const char *b, size_t bn) {
+  int c = memcmp(a, b, an < bn ? an : bn);
+  return c ? c : (an > bn) - (an < bn);
+}
+
 StolaValue *stola_eq(StolaValue *a, StolaValue *b) {
   if (!a || !b)
     return stola_new_bool(a == b);
+  const char *ap, *bp;
+  size_t an, bn;
+  if ((a->type == STOLA_VIEW || b->type == STOLA_VIEW) &&
+      stola_str_span(a, &ap, &an) && stola_str_span(b, &bp, &bn))
+    return stola_new_bool(an == bn && memcmp(ap, bp, an) == 0);
   if (a->type != b->type)
     return stola_new_bool(0);
   switch (a->type) {
@@ -283,14 +346,18 @@ StolaValue *stola_neq(StolaValue *a, StolaValue *b) {
 }
 
 StolaValue *stola_lt(StolaValue *a, StolaValue *b) {
-  if (a && b && a->type == STOLA_STRING && b->type == STOLA_STRING)
-    return stola_new_bool(strcmp(a->as.str_val, b->as.str_val) < 0);
+  const char *ap, *bp;
+  size_t an, bn;
+  if (stola_str_span(a, &ap, &an) && stola_str_span(b, &bp, &bn))
+    return stola_new_bool(span_cmp(ap, an, bp, bn) < 0);
   return stola_new_bool(val_to_int(a) < val_to_int(b));
 }
 
 StolaValue *stola_gt(StolaValue *a, StolaValue *b) {
-  if (a && b && a->type == STOLA_STRING && b->type == STOLA_STRING)
-    return stola_new_bool(strcmp(a->as.str_val, b->as.str_val) > 0);
+  const char *ap, *bp;
+  size_t an, bn;
+  if (stola_str_span(a, &ap, &an) && stola_str_span(b, &bp, &bn))
+    return stola_new_bool(span_cmp(ap, an, bp, bn) > 0);
   return stola_new_bool(val_to_int(a) > val_to_int(b));
 }
 
@@ -318,6 +385,43 @@ StolaValue *stola_not(StolaValue *a) {
 // String Operations
 // ============================================================
 
+int stola_str_span(StolaValue *val, const char **ptr, size_t *len) {
+  if (val && val->type == STOLA_STRING) {
+    *ptr = val->as.str_val ? val->as.str_val : "";
+    *len = strlen(*ptr);
+    return 1;
+  }
+  if (val && val->type == STOLA_VIEW) {
+    *ptr = val->as.view_val.ptr;
+    *len = val->as.view_val.len;
+    return 1;
+  }
+  return 0;
+}
+
+StolaValue *stola_as_string(StolaValue *val) {
+  if (val && val->type == STOLA_VIEW)
+    return stola_to_string(val);
+  return val;
+}
+
+// First occurrence of needle in haystack (memmem is not portable).
+static const char *span_find(const char *h, size_t hn, const char *n,
+                             size_t nn) {
+  if (nn == 0)
+    return h;
+  while (hn >= nn) {
+    const char *p = (const char *)memchr(h, n[0], hn - nn + 1);
+    if (!p)
+      return NULL;
+    if (memcmp(p, n, nn) == 0)
+      return p;
+    hn -= (size_t)(p - h) + 1;
+    h = p + 1;
+  }
+  return NULL;
+}
+
 // Helper: convert any value to a C string (caller must free)
 static char *value_to_cstr(StolaValue *val) {
   if (!val)
@@ -325,6 +429,12 @@ static char *value_to_cstr(StolaValue *val) {
   switch (val->type) {
   case STOLA_STRING:
     return stola_strdup(val->as.str_val ? val->as.str_val : "");
+  case STOLA_VIEW: {
+    char *s = (char *)malloc(val->as.view_val.len + 1);
+    memcpy(s, val->as.view_val.ptr, val->as.view_val.len);
+    s[val->as.view_val.len] = '\0';
+    return s;
+  }
   case STOLA_INT: {
     char buf[64];
     snprintf(buf, sizeof(buf), "%lld", (long long)val->as.int_val);
@@ -340,12 +450,22 @@ static char *value_to_cstr(StolaValue *val) {
 }
 
 StolaValue *stola_string_concat(StolaValue *a, StolaValue *b) {
-  char *sa = value_to_cstr(a);
-  char *sb = value_to_cstr(b);
-  size_t la = strlen(sa), lb = strlen(sb);
+  // Strings and views are copied straight from their bytes; anything else
+  // is formatted first.
+  const char *pa, *pb;
+  size_t la, lb;
+  char *sa = NULL, *sb = NULL;
+  if (!stola_str_span(a, &pa, &la)) {
+    pa = sa = value_to_cstr(a);
+    la = strlen(sa);
+  }
+  if (!stola_str_span(b, &pb, &lb)) {
+    pb = sb = value_to_cstr(b);
+    lb = strlen(sb);
+  }
   char *result = (char *)malloc(la + lb + 1);
-  memcpy(result, sa, la);
-  memcpy(result + la, sb, lb);
+  memcpy(result, pa, la);
+  memcpy(result + la, pb, lb);
   result[la + lb] = '\0';
   free(sa);
   free(sb);
@@ -353,13 +473,32 @@ StolaValue *stola_string_concat(StolaValue *a, StolaValue *b) {
 }
 
 StolaValue *stola_string_split(StolaValue *str, StolaValue *delim) {
+  const char *s, *d;
+  size_t slen, dlen;
+  if (str && str->type == STOLA_VIEW && stola_str_span(str, &s, &slen) &&
+      stola_str_span(delim, &d, &dlen)) {
+    // Views split into views of the same buffer: no bytes are copied.
+    StolaValue *arr = stola_new_array();
+    const char *end = s + slen, *found;
+    if (dlen == 0) {
+      stola_push(arr, stola_new_view(s, slen));
+      return arr;
+    }
+    while ((found = span_find(s, end - s, d, dlen)) != NULL) {
+      stola_push(arr, stola_new_view(s, found - s));
+      s = found + dlen;
+    }
+    stola_push(arr, stola_new_view(s, end - s));
+    return arr;
+  }
+  delim = stola_as_string(delim);
   if (!str || str->type != STOLA_STRING || !delim ||
       delim->type != STOLA_STRING)
     return stola_new_array();
   StolaValue *arr = stola_new_array();
-  const char *s = str->as.str_val;
-  const char *d = delim->as.str_val;
-  size_t dlen = strlen(d);
+  s = str->as.str_val;
+  d = delim->as.str_val;
+  dlen = strlen(d);
   if (dlen == 0) {
     stola_push(arr, stola_new_string(s));
     return arr;
@@ -379,37 +518,38 @@ StolaValue *stola_string_split(StolaValue *str, StolaValue *delim) {
 }
 
 StolaValue *stola_string_starts_with(StolaValue *str, StolaValue *prefix) {
-  if (!str || !prefix || str->type != STOLA_STRING ||
-      prefix->type != STOLA_STRING)
+  const char *s, *x;
+  size_t sl, xl;
+  if (!stola_str_span(str, &s, &sl) || !stola_str_span(prefix, &x, &xl))
     return stola_new_bool(0);
-  return stola_new_bool(strncmp(str->as.str_val, prefix->as.str_val,
-                                strlen(prefix->as.str_val)) == 0);
+  return stola_new_bool(xl <= sl && memcmp(s, x, xl) == 0);
 }
 
 StolaValue *stola_string_ends_with(StolaValue *str, StolaValue *suffix) {
-  if (!str || !suffix || str->type != STOLA_STRING ||
-      suffix->type != STOLA_STRING)
-    return stola_new_bool(0);
-  size_t sl = strlen(str->as.str_val), xl = strlen(suffix->as.str_val);
-  if (xl > sl)
+  const char *s, *x;
+  size_t sl, xl;
+  if (!stola_str_span(str, &s, &sl) || !stola_str_span(suffix, &x, &xl))
     return stola_new_bool(0);
-  return stola_new_bool(strcmp(str->as.str_val + sl - xl, suffix->as.str_val) ==
-                        0);
+  return stola_new_bool(xl <= sl && memcmp(s + sl - xl, x, xl) == 0);
 }
 
 StolaValue *stola_string_contains(StolaValue *str, StolaValue *sub) {
-  if (!str || !sub || str->type != STOLA_STRING || sub->type != STOLA_STRING)
+  const char *s, *x;
+  size_t sl, xl;
+  if (!stola_str_span(str, &s, &sl) || !stola_str_span(sub, &x, &xl))
     return stola_new_bool(0);
-  return stola_new_bool(strstr(str->as.str_val, sub->as.str_val) != NULL);
+  return stola_new_bool(span_find(s, sl, x, xl) != NULL);
 }
 
 StolaValue *stola_string_substring(StolaValue *str, StolaValue *start,
                                    StolaValue *end) {
-  if (!str || str->type != STOLA_STRING)
+  const char *p;
+  size_t plen;
+  if (!stola_str_span(str, &p, &plen))
     return stola_new_string("");
   int64_t s = start ? val_to_int(start) : 0;
-  int64_t e = end ? val_to_int(end) : (int64_t)strlen(str->as.str_val);
-  int64_t len = (int64_t)strlen(str->as.str_val);
+  int64_t e = end ? val_to_int(end) : (int64_t)plen;
+  int64_t len = (int64_t)plen;
   if (s < 0)
     s = 0;
   if (s > len)
@@ -419,47 +559,48 @@ StolaValue *stola_string_substring(StolaValue *str, StolaValue *start,
   if (e > len)
     e = len;
   int64_t rlen = e - s;
+  if (str->type == STOLA_VIEW)
+    return stola_new_view(p + s, (size_t)rlen);
   char *result = (char *)malloc(rlen + 1);
-  memcpy(result, str->as.str_val + s, rlen);
+  memcpy(result, p + s, rlen);
   result[rlen] = '\0';
   return stola_new_string_owned(result);
 }
 
 StolaValue *stola_string_index_of(StolaValue *str, StolaValue *sub) {
-  if (!str || !sub || str->type != STOLA_STRING || sub->type != STOLA_STRING)
+  const char *s, *x;
+  size_t sl, xl;
+  if (!stola_str_span(str, &s, &sl) || !stola_str_span(sub, &x, &xl))
     return stola_new_int(-1);
-  const char *found = strstr(str->as.str_val, sub->as.str_val);
+  const char *found = span_find(s, sl, x, xl);
   if (!found)
     return stola_new_int(-1);
-  return stola_new_int((int64_t)(found - str->as.str_val));
+  return stola_new_int((int64_t)(found - s));
 }
 
 StolaValue *stola_string_replace(StolaValue *str, StolaValue *from,
                                  StolaValue *to) {
-  if (!str || !from || !to || str->type != STOLA_STRING ||
-      from->type != STOLA_STRING || to->type != STOLA_STRING)
-    return str ? stola_new_string(str->as.str_val) : stola_new_string("");
-  const char *s = str->as.str_val;
-  const char *f = from->as.str_val;
-  const char *t = to->as.str_val;
-  size_t fl = strlen(f), tl = strlen(t);
-  if (fl == 0)
-    return stola_new_string(s);
+  const char *s, *f, *t;
+  size_t sl, fl, tl;
+  if (!stola_str_span(str, &s, &sl))
+    return stola_new_string("");
+  if (!stola_str_span(from, &f, &fl) || !stola_str_span(to, &t, &tl) ||
+      fl == 0)
+    return stola_new_string_owned(value_to_cstr(str));
 
   // Count occurrences
-  int count = 0;
-  const char *p = s;
-  while ((p = strstr(p, f)) != NULL) {
+  size_t count = 0;
+  const char *p = s, *end = s + sl, *found;
+  while ((found = span_find(p, (size_t)(end - p), f, fl)) != NULL) {
     count++;
-    p += fl;
+    p = found + fl;
   }
 
-  size_t new_len = strlen(s) + count * ((int64_t)tl - (int64_t)fl);
+  size_t new_len = sl - count * fl + count * tl;
   char *result = (char *)malloc(new_len + 1);
   char *dst = result;
   p = s;
-  const char *found;
-  while ((found = strstr(p, f)) != NULL) {
+  while ((found = span_find(p, (size_t)(end - p), f, fl)) != NULL) {
     size_t chunk = found - p;
     memcpy(dst, p, chunk);
     dst += chunk;
@@ -467,11 +608,20 @@ StolaValue *stola_string_replace(StolaValue *str, StolaValue *from,
     dst += tl;
     p = found + fl;
   }
-  strcpy(dst, p);
+  memcpy(dst, p, (size_t)(end - p));
+  dst[end - p] = '\0';
   return stola_new_string_owned(result);
 }
 
 StolaValue *stola_string_trim(StolaValue *str) {
+  if (str && str->type == STOLA_VIEW) {
+    const char *s = str->as.view_val.ptr, *e = s + str->as.view_val.len;
+    while (s < e && isspace((unsigned char)*s))
+      s++;
+    while (e > s && isspace((unsigned char)e[-1]))
+      e--;
+    return stola_new_view(s, e - s);
+  }
   if (!str || str->type != STOLA_STRING)
     return stola_new_string("");
   const char *s = str->as.str_val;
@@ -490,18 +640,18 @@ StolaValue *stola_string_trim(StolaValue *str) {
 }
 
 StolaValue *stola_uppercase(StolaValue *str) {
-  if (!str || str->type != STOLA_STRING)
+  if (!str || (str->type != STOLA_STRING && str->type != STOLA_VIEW))
     return stola_new_string("");
-  char *result = stola_strdup(str->as.str_val);
+  char *result = value_to_cstr(str);
   for (int i = 0; result[i]; i++)
     result[i] = (char)toupper((unsigned char)result[i]);
   return stola_new_string_owned(result);
 }
 
 StolaValue *stola_lowercase(StolaValue *str) {
-  if (!str || str->type != STOLA_STRING)
+  if (!str || (str->type != STOLA_STRING && str->type != STOLA_VIEW))
     return stola_new_string("");
-  char *result = stola_strdup(str->as.str_val);
+  char *result = value_to_cstr(str);
   for (int i = 0; result[i]; i++)
     result[i] = (char)tolower((unsigned char)result[i]);
   return stola_new_string_owned(result);
@@ -521,6 +671,14 @@ StolaValue *stola_to_number(StolaValue *val) {
     return stola_new_int(val->as.bool_val);
   if (val->type == STOLA_STRING)
     return stola_new_int(atoll(val->as.str_val));
+  if (val->type == STOLA_VIEW) {
+    char num[32];
+    size_t n = val->as.view_val.len < sizeof(num) - 1 ? val->as.view_val.len
+                                                      : sizeof(num) - 1;
+    memcpy(num, val->as.view_val.ptr, n);
+    num[n] = '\0';
+    return stola_new_int(atoll(num));
+  }
   return stola_new_int(0);
 }
 
@@ -537,10 +695,15 @@ StolaValue *stola_length(StolaValue *val) {
     return stola_new_int((int64_t)strlen(val->as.str_val));
   if (val->type == STOLA_DICT)
     return stola_new_int(val->as.dict_val.count);
+  if (val->type == STOLA_JSON)
+    return stola_new_int(json_lazy_length(val));
+  if (val->type == STOLA_VIEW)
+    return stola_new_int((int64_t)val->as.view_val.len);
   return stola_new_int(0);
 }
 
 void stola_push(StolaValue *arr, StolaValue *val) {
+  stola_json_force(arr);
   if (!arr || arr->type != STOLA_ARRAY)
     return;
   if (arr->as.array_val.count >= arr->as.array_val.capacity) {
@@ -554,12 +717,14 @@ void stola_push(StolaValue *arr, StolaValue *val) {
 }
 
 StolaValue *stola_pop(StolaValue *arr) {
+  stola_json_force(arr);
   if (!arr || arr->type != STOLA_ARRAY || arr->as.array_val.count == 0)
     return stola_new_null();
   return arr->as.array_val.items[--arr->as.array_val.count];
 }
 
 StolaValue *stola_shift(StolaValue *arr) {
+  stola_json_force(arr);
   if (!arr || arr->type != STOLA_ARRAY || arr->as.array_val.count == 0)
     return stola_new_null();
   StolaValue *first = arr->as.array_val.items[0];
@@ -570,6 +735,7 @@ StolaValue *stola_shift(StolaValue *arr) {
 }
 
 void stola_unshift(StolaValue *arr, StolaValue *val) {
+  stola_json_force(arr);
   if (!arr || arr->type != STOLA_ARRAY)
     return;
   stola_push(arr, NULL); // grow
@@ -579,6 +745,8 @@ void stola_unshift(StolaValue *arr, StolaValue *val) {
 }
 
 StolaValue *stola_array_get(StolaValue *arr, StolaValue *index) {
+  if (arr && arr->type == STOLA_JSON)
+    return json_lazy_get(arr, index);
   if (!arr || arr->type != STOLA_ARRAY)
     return stola_new_null();
   int64_t i = val_to_int(index);
@@ -588,6 +756,7 @@ StolaValue *stola_array_get(StolaValue *arr, StolaValue *index) {
 }
 
 void stola_array_set(StolaValue *arr, StolaValue *index, StolaValue *val) {
+  stola_json_force(arr);
   if (!arr || arr->type != STOLA_ARRAY)
     return;
   int64_t i = val_to_int(index);
@@ -614,6 +783,8 @@ static void dict_ensure_capacity(StolaDict *d) {
 StolaValue *stola_dict_get(StolaValue *dict, StolaValue *key) {
   if (!dict || !key)
     return stola_new_null();
+  if (dict->type == STOLA_JSON)
+    return json_lazy_get(dict, key);
   StolaDict *d = NULL;
   if (dict->type == STOLA_DICT)
     d = &dict->as.dict_val;
@@ -636,6 +807,7 @@ StolaValue *stola_dict_get(StolaValue *dict, StolaValue *key) {
 void stola_dict_set(StolaValue *dict, StolaValue *key, StolaValue *val) {
   if (!dict || !key)
     return;
+  stola_json_force(dict);
   StolaDict *d = NULL;
   if (dict->type == STOLA_DICT)
     d = &dict->as.dict_val;
@@ -667,6 +839,8 @@ void stola_dict_set(StolaValue *dict, StolaValue *key, StolaValue *val) {
 StolaValue *stola_struct_get(StolaValue *s, const char *field) {
   if (!s)
     return stola_new_null();
+  if (s->type == STOLA_JSON)
+    return json_lazy_field(s, field);
   StolaDict *d = NULL;
   if (s->type == STOLA_STRUCT)
     d = &s->as.struct_val.fields;
@@ -686,6 +860,7 @@ StolaValue *stola_struct_get(StolaValue *s, const char *field) {
 // Universal computed-index get: dispatches array[int] vs dict/struct[key]
 StolaValue *stola_getitem(StolaValue *obj, StolaValue *key) {
   if (!obj) return stola_new_null();
+  if (obj->type == STOLA_JSON) return json_lazy_get(obj, key);
   if (obj->type == STOLA_ARRAY) return stola_array_get(obj, key);
   if (obj->type == STOLA_DICT || obj->type == STOLA_STRUCT)
     return stola_dict_get(obj, key);
@@ -695,6 +870,7 @@ StolaValue *stola_getitem(StolaValue *obj, StolaValue *key) {
 // Universal computed-index set: dispatches array[int] vs dict/struct[key]
 void stola_setitem(StolaValue *obj, StolaValue *key, StolaValue *val) {
   if (!obj) return;
+  stola_json_force(obj);
   if (obj->type == STOLA_ARRAY) { stola_array_set(obj, key, val); return; }
   if (obj->type == STOLA_DICT || obj->type == STOLA_STRUCT)
     stola_dict_set(obj, key, val);
@@ -703,6 +879,7 @@ void stola_setitem(StolaValue *obj, StolaValue *key, StolaValue *val) {
 void stola_struct_set(StolaValue *s, const char *field, StolaValue *val) {
   if (!s)
     return;
+  stola_json_force(s);
   StolaDict *d = NULL;
   if (s->type == STOLA_STRUCT)
     d = &s->as.struct_val.fields;
@@ -949,234 +1126,1063 @@ StolaValue *stola_invoke_c_function(const char *name, StolaValue *a1,
   int64_t v1 = val_to_int_or_ptr(a1);
   int64_t v2 = val_to_int_or_ptr(a2);
   int64_t v3 = val_to_int_or_ptr(a3);
+#ifdef _WIN32
+  // The generated call only fills the register arguments; a4 would be on
+  // the stack and is never written.
+  (void)a4;
+  int64_t v4 = 0;
+#else
   int64_t v4 = val_to_int_or_ptr(a4);
+#endif
 
   int64_t ret = func(v1, v2, v3, v4);
   return stola_new_int(ret); // Box result dynamically
 }
 
 // ============================================================
-// JSON (simple recursive implementation)
+// JSON
 // ============================================================
+// The encoder sizes its output with a cheap pre-pass and bulk-copies runs of
+// bytes that need no escaping; the decoder finds string ends and whitespace
+// runs 16 bytes at a time. Both fall back to scalar loops off x86-64.
+
+typedef struct {
+  char *data;
+  size_t len, cap;
+} JsonBuf;
+
+static void jb_reserve(JsonBuf *b, size_t extra) {
+  if (b->len + extra < b->cap)
+    return;
+  size_t cap = b->cap ? b->cap : 256;
+  while (b->len + extra >= cap)
+    cap *= 2;
+  b->data = (char *)realloc(b->data, cap);
+  b->cap = cap;
+}
+
+static inline void jb_put(JsonBuf *b, const char *s, size_t n) {
+  jb_reserve(b, n);
+  memcpy(b->data + b->len, s, n);
+  b->len += n;
+}
+
+static inline void jb_putc(JsonBuf *b, char c) {
+  jb_reserve(b, 1);
+  b->data[b->len++] = c;
+}
+
+// Offset of the first byte in s[0..n) that must be escaped on output (quote,
+// backslash or control character), or n if there is none.
+static size_t json_escape_scan(const unsigned char *s, size_t n) {
+  size_t i = 0;
+#ifdef JSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"'), bslash = _mm_set1_epi8('\\');
+  const __m128i ctl = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    __m128i m = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+        _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v));
+    int bits = _mm_movemask_epi8(m);
+    if (bits)
+      return i + __builtin_ctz(bits);
+  }
+#endif
+  for (; i < n; i++)
+    if (s[i] == '"' || s[i] == '\\' || s[i] < 0x20)
+      return i;
+  return n;
+}
+
+// Offset of the first quote or backslash in s[0..n), or n.
+static size_t json_string_scan(const unsigned char *s, size_t n) {
+  size_t i = 0;
+#ifdef JSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"'), bslash = _mm_set1_epi8('\\');
+  for (; i + 16 <= n; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    int bits = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)));
+    if (bits)
+      return i + __builtin_ctz(bits);
+  }
+#endif
+  for (; i < n; i++)
+    if (s[i] == '"' || s[i] == '\\')
+      return i;
+  return n;
+}
+
+static void json_put_string(JsonBuf *b, const char *str, size_t n) {
+  const unsigned char *s = (const unsigned char *)str;
+  jb_reserve(b, n + 2);
+  b->data[b->len++] = '"';
+  while (n) {
+    size_t run = json_escape_scan(s, n);
+    jb_put(b, (const char *)s, run);
+    if (run == n)
+      break;
+    char esc[8] = {'\\', 0};
+    size_t elen = 2;
+    switch (s[run]) {
+    case '"': esc[1] = '"'; break;
+    case '\\': esc[1] = '\\'; break;
+    case '\n': esc[1] = 'n'; break;
+    case '\r': esc[1] = 'r'; break;
+    case '\t': esc[1] = 't'; break;
+    case '\b': esc[1] = 'b'; break;
+    case '\f': esc[1] = 'f'; break;
+    default:
+      snprintf(esc, sizeof(esc), "\\u%04x", s[run]);
+      elen = 6;
+    }
+    jb_put(b, esc, elen);
+    s += run + 1;
+    n -= run + 1;
+  }
+  jb_putc(b, '"');
+}
 
-static void json_encode_internal(StolaValue *val, char **buf, size_t *len,
-                                 size_t *cap) {
-#define JAPPEND(s)                                                             \
-  do {                                                                         \
-    size_t sl = strlen(s);                                                     \
-    while (*len + sl >= *cap) {                                                \
-      *cap *= 2;                                                               \
-      *buf = (char *)realloc(*buf, *cap);                                      \
-    }                                                                          \
-    memcpy(*buf + *len, s, sl);                                                \
-    *len += sl;                                                                \
-  } while (0)
+static void json_put_int(JsonBuf *b, int64_t v) {
+  char tmp[24];
+  int i = sizeof(tmp);
+  uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+  do {
+    tmp[--i] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+  if (v < 0)
+    tmp[--i] = '-';
+  jb_put(b, tmp + i, sizeof(tmp) - i);
+}
 
+// Encoded size assuming nothing needs escaping; good enough that typical
+// values encode into a single allocation.
+static size_t json_estimate(StolaValue *val) {
+  if (!val)
+    return 4;
+  switch (val->type) {
+  case STOLA_BOOL:
+    return 5;
+  case STOLA_INT:
+    return 20;
+  case STOLA_STRING:
+    return strlen(val->as.str_val) + 2;
+  case STOLA_VIEW:
+    return val->as.view_val.len + 2;
+  case STOLA_ARRAY: {
+    size_t n = 2;
+    for (int i = 0; i < val->as.array_val.count; i++)
+      n += json_estimate(val->as.array_val.items[i]) + 1;
+    return n;
+  }
+  case STOLA_DICT:
+  case STOLA_STRUCT: {
+    StolaDict *d = (val->type == STOLA_DICT) ? &val->as.dict_val
+                                             : &val->as.struct_val.fields;
+    size_t n = 2;
+    for (int i = 0; i < d->count; i++)
+      n += strlen(d->entries[i].key) + 4 + json_estimate(d->entries[i].value);
+    return n;
+  }
+  case STOLA_JSON:
+    return json_lazy_span(val);
+  default:
+    return 4;
+  }
+}
+
+static void json_lazy_encode(StolaValue *node, JsonBuf *b);
+
+static void json_encode_internal(StolaValue *val, JsonBuf *b) {
   if (!val) {
-    JAPPEND("null");
+    jb_put(b, "null", 4);
     return;
   }
   switch (val->type) {
-  case STOLA_NULL:
-    JAPPEND("null");
-    break;
   case STOLA_BOOL:
-    JAPPEND(val->as.bool_val ? "true" : "false");
+    if (val->as.bool_val)
+      jb_put(b, "true", 4);
+    else
+      jb_put(b, "false", 5);
     break;
-  case STOLA_INT: {
-    char num[64];
-    snprintf(num, sizeof(num), "%lld", (long long)val->as.int_val);
-    JAPPEND(num);
+  case STOLA_INT:
+    json_put_int(b, val->as.int_val);
     break;
-  }
-  case STOLA_STRING: {
-    JAPPEND("\"");
-    // Escape special chars
-    const char *s = val->as.str_val;
-    for (; *s; s++) {
-      char esc[3] = {0};
-      if (*s == '"') {
-        JAPPEND("\\\"");
-      } else if (*s == '\\') {
-        JAPPEND("\\\\");
-      } else if (*s == '\n') {
-        JAPPEND("\\n");
-      } else if (*s == '\r') {
-        JAPPEND("\\r");
-      } else if (*s == '\t') {
-        JAPPEND("\\t");
-      } else {
-        esc[0] = *s;
-        JAPPEND(esc);
-      }
-    }
-    JAPPEND("\"");
+  case STOLA_STRING:
+    json_put_string(b, val->as.str_val, strlen(val->as.str_val));
+    break;
+  case STOLA_VIEW:
+    json_put_string(b, val->as.view_val.ptr, val->as.view_val.len);
     break;
-  }
   case STOLA_ARRAY: {
-    JAPPEND("[");
+    jb_putc(b, '[');
     for (int i = 0; i < val->as.array_val.count; i++) {
       if (i > 0)
-        JAPPEND(",");
-      json_encode_internal(val->as.array_val.items[i], buf, len, cap);
+        jb_putc(b, ',');
+      json_encode_internal(val->as.array_val.items[i], b);
     }
-    JAPPEND("]");
+    jb_putc(b, ']');
     break;
   }
   case STOLA_DICT:
   case STOLA_STRUCT: {
     StolaDict *d = (val->type == STOLA_DICT) ? &val->as.dict_val
                                              : &val->as.struct_val.fields;
-    JAPPEND("{");
+    jb_putc(b, '{');
     for (int i = 0; i < d->count; i++) {
       if (i > 0)
-        JAPPEND(",");
-      JAPPEND("\"");
-      JAPPEND(d->entries[i].key);
-      JAPPEND("\":");
-      json_encode_internal(d->entries[i].value, buf, len, cap);
+        jb_putc(b, ',');
+      json_put_string(b, d->entries[i].key, strlen(d->entries[i].key));
+      jb_putc(b, ':');
+      json_encode_internal(d->entries[i].value, b);
     }
-    JAPPEND("}");
+    jb_putc(b, '}');
     break;
   }
+  case STOLA_JSON:
+    json_lazy_encode(val, b);
+    break;
   default:
-    JAPPEND("null");
+    jb_put(b, "null", 4);
     break;
   }
-#undef JAPPEND
 }
 
 StolaValue *stola_json_encode(StolaValue *val) {
-  size_t cap = 256, len = 0;
-  char *buf = (char *)malloc(cap);
-  json_encode_internal(val, &buf, &len, &cap);
-  buf[len] = '\0';
-  return stola_new_string_owned(buf);
+  JsonBuf b = {NULL, 0, 0};
+  jb_reserve(&b, json_estimate(val));
+  json_encode_internal(val, &b);
+  b.data[b.len] = '\0';
+  return stola_new_string_owned(b.data);
 }
 
-// Simple JSON decoder (handles objects, arrays, strings, numbers, bools,
-// null)
-static StolaValue *json_parse_value(const char **p);
+// Decoder over an explicit [p, end) span, so it works on slices of a larger
+// buffer (streams) as well as on whole strings. Malformed input never reads
+// past `end`; whatever could not be parsed comes back as null.
+#define JSON_MAX_DEPTH 1024
 
-static void json_skip_ws(const char **p) {
-  while (**p && isspace((unsigned char)**p))
-    (*p)++;
+typedef struct {
+  const char *p, *end;
+  int depth;
+} JsonIn;
+
+static StolaValue *json_parse_value(JsonIn *in);
+
+static inline int json_is_ws(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
 }
 
-static StolaValue *json_parse_string(const char **p) {
-  (*p)++; // skip "
-  const char *start = *p;
-  // For simplicity, no escape handling in decode
-  while (**p && **p != '"')
-    (*p)++;
-  size_t len = *p - start;
-  char *s = (char *)malloc(len + 1);
-  memcpy(s, start, len);
-  s[len] = '\0';
-  if (**p == '"')
-    (*p)++;
-  return stola_new_string_owned(s);
+static void json_skip_ws(JsonIn *in) {
+  const char *p = in->p;
+  if (p < in->end && !json_is_ws(*p))
+    return;
+#ifdef JSON_SSE2
+  // Indentation in pretty-printed documents comes in long runs.
+  const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+  while (p + 16 <= in->end) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+    int bits = ~_mm_movemask_epi8(ws) & 0xFFFF;
+    if (bits) {
+      in->p = p + __builtin_ctz(bits);
+      return;
+    }
+    p += 16;
+  }
+#endif
+  while (p < in->end && json_is_ws(*p))
+    p++;
+  in->p = p;
+}
+
+static int json_hex4(const char *p, const char *end) {
+  if (end - p < 4)
+    return -1;
+  int v = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = p[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9')
+      v |= c - '0';
+    else if (c >= 'a' && c <= 'f')
+      v |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      v |= c - 'A' + 10;
+    else
+      return -1;
+  }
+  return v;
 }
 
-static StolaValue *json_parse_number(const char **p) {
-  int64_t val = 0;
+static size_t json_utf8(char *out, unsigned cp) {
+  if (cp < 0x80) {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = (char)(0xC0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3F));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = (char)(0xE0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = (char)(0x80 | (cp & 0x3F));
+    return 3;
+  }
+  out[0] = (char)(0xF0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = (char)(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+// Decodes the string starting at the opening quote into a fresh buffer.
+// Escape-free strings (the common case) are a single scan and memcpy.
+static char *json_parse_chars(JsonIn *in) {
+  const char *s = in->p + 1, *end = in->end;
+  size_t run = json_string_scan((const unsigned char *)s, end - s);
+  if (s + run < end && s[run] == '"') {
+    char *out = (char *)malloc(run + 1);
+    memcpy(out, s, run);
+    out[run] = '\0';
+    in->p = s + run + 1;
+    return out;
+  }
+  JsonBuf b = {NULL, 0, 0};
+  jb_reserve(&b, run + 16);
+  for (;;) {
+    jb_put(&b, s, run);
+    s += run;
+    if (s >= end)
+      break;
+    if (*s == '"') {
+      s++;
+      break;
+    }
+    if (++s >= end)
+      break;
+    char c = *s++;
+    switch (c) {
+    case 'n': jb_putc(&b, '\n'); break;
+    case 'r': jb_putc(&b, '\r'); break;
+    case 't': jb_putc(&b, '\t'); break;
+    case 'b': jb_putc(&b, '\b'); break;
+    case 'f': jb_putc(&b, '\f'); break;
+    case 'u': {
+      int cp = json_hex4(s, end);
+      if (cp < 0) {
+        cp = 0xFFFD;
+      } else {
+        s += 4;
+        if (cp >= 0xD800 && cp <= 0xDBFF && end - s >= 6 && s[0] == '\\' &&
+            s[1] == 'u') {
+          int lo = json_hex4(s + 2, end);
+          if (lo >= 0xDC00 && lo <= 0xDFFF) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            s += 6;
+          }
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF)
+          cp = 0xFFFD;
+      }
+      char u[4];
+      jb_put(&b, u, json_utf8(u, (unsigned)cp));
+      break;
+    }
+    default: // \" \\ \/ and anything unknown map to the character itself
+      jb_putc(&b, c);
+    }
+    run = json_string_scan((const unsigned char *)s, end - s);
+  }
+  b.data[b.len] = '\0';
+  in->p = s;
+  return b.data;
+}
+
+static StolaValue *json_parse_number(JsonIn *in) {
+  const char *p = in->p, *end = in->end;
   int neg = 0;
-  if (**p == '-') {
+  if (p < end && *p == '-') {
     neg = 1;
-    (*p)++;
-  }
-  while (**p >= '0' && **p <= '9') {
-    val = val * 10 + (**p - '0');
-    (*p)++;
+    p++;
   }
-  // Skip decimal part (we only support ints)
-  if (**p == '.') {
-    (*p)++;
-    while (**p >= '0' && **p <= '9')
-      (*p)++;
+  int64_t val = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    val = val * 10 + (*p++ - '0');
+  // Values are integers: fractions truncate toward zero, exponents scale.
+  if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+    double d = (double)val, scale = 0.1;
+    if (*p == '.')
+      for (p++; p < end && *p >= '0' && *p <= '9'; p++, scale /= 10)
+        d += (*p - '0') * scale;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+      int eneg = 0, e = 0;
+      p++;
+      if (p < end && (*p == '+' || *p == '-'))
+        eneg = *p++ == '-';
+      while (p < end && *p >= '0' && *p <= '9') {
+        if (e < 400)
+          e = e * 10 + (*p - '0');
+        p++;
+      }
+      d *= pow(10.0, eneg ? -e : e);
+    }
+    val = d >= 9.2e18 ? INT64_MAX : (int64_t)d;
   }
+  in->p = p;
   return stola_new_int(neg ? -val : val);
 }
 
-static StolaValue *json_parse_value(const char **p) {
-  json_skip_ws(p);
-  if (**p == '"')
-    return json_parse_string(p);
-  if (**p == '{') {
-    (*p)++;
+// JSON objects take ownership of the decoded key instead of copying it.
+static void json_dict_put(StolaValue *dict, char *key, StolaValue *val) {
+  StolaDict *d = &dict->as.dict_val;
+  for (int i = 0; i < d->count; i++) {
+    if (strcmp(d->entries[i].key, key) == 0) {
+      d->entries[i].value = val;
+      free(key);
+      return;
+    }
+  }
+  dict_ensure_capacity(d);
+  d->entries[d->count].key = key;
+  d->entries[d->count].value = val;
+  d->count++;
+}
+
+static int json_literal(JsonIn *in, const char *word, size_t n) {
+  if ((size_t)(in->end - in->p) < n || memcmp(in->p, word, n) != 0)
+    return 0;
+  in->p += n;
+  return 1;
+}
+
+static StolaValue *json_parse_value(JsonIn *in) {
+  json_skip_ws(in);
+  if (in->p >= in->end)
+    return stola_new_null();
+  char c = *in->p;
+  if (c == '"')
+    return stola_new_string_owned(json_parse_chars(in));
+  if ((c == '{' || c == '[') && in->depth >= JSON_MAX_DEPTH)
+    return stola_new_null();
+  if (c == '{') {
+    in->p++;
+    in->depth++;
     StolaValue *d = stola_new_dict();
-    json_skip_ws(p);
-    if (**p == '}') {
-      (*p)++;
+    json_skip_ws(in);
+    if (in->p < in->end && *in->p == '}') {
+      in->p++;
+      in->depth--;
       return d;
     }
-    while (1) {
-      json_skip_ws(p);
-      StolaValue *key = json_parse_string(p);
-      json_skip_ws(p);
-      if (**p == ':')
-        (*p)++;
-      StolaValue *val = json_parse_value(p);
-      stola_dict_set(d, key, val);
-      json_skip_ws(p);
-      if (**p == ',') {
-        (*p)++;
-        continue;
-      }
-      if (**p == '}') {
-        (*p)++;
+    while (in->p < in->end) {
+      json_skip_ws(in);
+      if (in->p >= in->end || *in->p != '"')
         break;
+      char *key = json_parse_chars(in);
+      json_skip_ws(in);
+      if (in->p < in->end && *in->p == ':')
+        in->p++;
+      json_dict_put(d, key, json_parse_value(in));
+      json_skip_ws(in);
+      if (in->p < in->end && *in->p == ',') {
+        in->p++;
+        continue;
       }
+      if (in->p < in->end && *in->p == '}')
+        in->p++;
       break;
     }
+    in->depth--;
     return d;
   }
-  if (**p == '[') {
-    (*p)++;
+  if (c == '[') {
+    in->p++;
+    in->depth++;
     StolaValue *a = stola_new_array();
-    json_skip_ws(p);
-    if (**p == ']') {
-      (*p)++;
+    json_skip_ws(in);
+    if (in->p < in->end && *in->p == ']') {
+      in->p++;
+      in->depth--;
       return a;
     }
-    while (1) {
-      StolaValue *val = json_parse_value(p);
-      stola_push(a, val);
-      json_skip_ws(p);
-      if (**p == ',') {
-        (*p)++;
+    while (in->p < in->end) {
+      stola_push(a, json_parse_value(in));
+      json_skip_ws(in);
+      if (in->p < in->end && *in->p == ',') {
+        in->p++;
         continue;
       }
-      if (**p == ']') {
-        (*p)++;
-        break;
-      }
+      if (in->p < in->end && *in->p == ']')
+        in->p++;
       break;
     }
+    in->depth--;
     return a;
   }
-  if (strncmp(*p, "true", 4) == 0) {
-    *p += 4;
+  if (json_literal(in, "true", 4))
     return stola_new_bool(1);
-  }
-  if (strncmp(*p, "false", 5) == 0) {
-    *p += 5;
+  if (json_literal(in, "false", 5))
     return stola_new_bool(0);
-  }
-  if (strncmp(*p, "null", 4) == 0) {
-    *p += 4;
+  if (json_literal(in, "null", 4))
     return stola_new_null();
-  }
-  if (**p == '-' || (**p >= '0' && **p <= '9'))
-    return json_parse_number(p);
+  if (c == '-' || (c >= '0' && c <= '9'))
+    return json_parse_number(in);
   return stola_new_null();
 }
 
 StolaValue *stola_json_decode(StolaValue *str) {
-  if (!str || str->type != STOLA_STRING)
+  const char *p;
+  size_t n;
+  if (!stola_str_span(str, &p, &n))
     return stola_new_null();
-  const char *p = str->as.str_val;
-  return json_parse_value(&p);
+  JsonIn in = {p, p + n, 0};
+  return json_parse_value(&in);
+}
+
+// ---- Streaming ----
+// json_parse_stream(source, callback, ctx) reads a file (path) or an open file
+// descriptor in chunks and calls callback(value, ctx) per top-level value, so
+// memory stays bounded by the largest single value rather than the input.
+// Newline-delimited / concatenated documents are delivered one by one and a
+// top-level array is delivered element by element. Returning false from the
+// callback stops the stream. Returns the number of values delivered, or -1
+// if the source could not be opened.
+
+#define JSON_STREAM_CHUNK (1 << 20)
+
+typedef StolaValue *(*JsonStreamFn)(StolaValue *, StolaValue *, StolaValue *,
+                                    StolaValue *);
+
+// Length of the complete value at s[0..n), or 0 if more input is needed.
+// Only brackets and string boundaries are tracked; the parser validates.
+static size_t json_value_end(const char *s, size_t n, int eof) {
+  size_t i = 0;
+  int depth = 0;
+  if (s[0] != '{' && s[0] != '[' && s[0] != '"') {
+    while (i < n && !json_is_ws(s[i]) && s[i] != ',' && s[i] != ']' &&
+           s[i] != '}')
+      i++;
+    return (i < n || eof) ? i : 0;
+  }
+  while (i < n) {
+    char c = s[i];
+    if (c == '"') {
+      i++;
+      for (;;) {
+        if (i >= n)
+          return 0;
+        i += json_string_scan((const unsigned char *)s + i, n - i);
+        if (i >= n)
+          return 0;
+        if (s[i] == '\\') {
+          i += 2;
+          continue;
+        }
+        i++;
+        break;
+      }
+      if (depth == 0)
+        return i;
+      continue;
+    }
+    if (c == '{' || c == '[')
+      depth++;
+    else if ((c == '}' || c == ']') && --depth == 0)
+      return i + 1;
+    i++;
+  }
+  return 0;
+}
+
+StolaValue *stola_json_parse_stream(StolaValue *source, StolaValue *callback,
+                                    StolaValue *ctx) {
+  JsonStreamFn fn = (JsonStreamFn)callback;
+  int fd, own = 0;
+  source = stola_as_string(source);
+  if (source && source->type == STOLA_STRING) {
+#ifdef _WIN32
+    fd = _open(source->as.str_val, _O_RDONLY | _O_BINARY);
+#else
+    fd = open(source->as.str_val, O_RDONLY);
+#endif
+    own = 1;
+  } else {
+    fd = (int)val_to_int(source);
+  }
+  if (fd < 0 || !fn)
+    return stola_new_int(-1);
+
+  size_t cap = JSON_STREAM_CHUNK, len = 0, pos = 0;
+  char *buf = (char *)malloc(cap);
+  int eof = 0, in_array = 0;
+  int64_t count = 0;
+  for (;;) {
+    while (pos < len && json_is_ws(buf[pos]))
+      pos++;
+    size_t n = 0;
+    if (pos < len) {
+      char c = buf[pos];
+      if (c == '[' && !in_array) {
+        in_array = 1;
+        pos++;
+        continue;
+      }
+      if (c == ']' && in_array) {
+        in_array = 0;
+        pos++;
+        continue;
+      }
+      if (c == ',' || c == ']' || c == '}') {
+        pos++;
+        continue;
+      }
+      n = json_value_end(buf + pos, len - pos, eof);
+      if (n) {
+        JsonIn in = {buf + pos, buf + pos + n, 0};
+        StolaValue *r = fn(json_parse_value(&in), ctx, NULL, NULL);
+        pos += n;
+        count++;
+        if (r && r->type == STOLA_BOOL && !r->as.bool_val)
+          break;
+        continue;
+      }
+    }
+    if (eof)
+      break;
+    // Need more input: keep the unconsumed tail and refill behind it.
+    memmove(buf, buf + pos, len - pos);
+    len -= pos;
+    pos = 0;
+    if (cap - len < JSON_STREAM_CHUNK / 2) {
+      cap *= 2;
+      buf = (char *)realloc(buf, cap);
+    }
+#ifdef _WIN32
+    int got = _read(fd, buf + len, (unsigned)(cap - len));
+#else
+    ssize_t got = read(fd, buf + len, cap - len);
+#endif
+    if (got <= 0)
+      eof = 1;
+    else
+      len += (size_t)got;
+  }
+  free(buf);
+  if (own) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+  }
+  return stola_new_int(count);
+}
+
+// ---- Lazy documents ----
+// json_lazy(str) indexes the document in one pass and returns a STOLA_JSON
+// handle. Indexing on a field or element materializes only that child:
+// scalars become ordinary values, objects and arrays become further handles.
+// Children are cached per document so repeated access returns the same value
+// (mutations stick), and any operation that needs the whole container
+// (push, assignment, printing) turns the handle into a plain dict/array in
+// place via stola_json_force.
+//
+// The index is a simdjson-style tape: stage 1 classifies 64 bytes at a time
+// into quote/backslash/whitespace/operator bitmasks and derives the
+// structural positions outside strings; each structural is appended to the
+// tape as it is found, with brackets matched on a stack so that every
+// container knows where its next sibling starts.
+
+typedef struct {
+  uint32_t off;  // byte offset of the token in the text
+  uint32_t next; // tape index of the following sibling
+} JsonTok;
+
+struct StolaJsonDoc {
+  const char *text;
+  size_t len;
+  JsonTok *tape;
+  uint32_t ntape;
+  // Materialized children by tape index (open addressing, ~0u = empty).
+  uint32_t *cache_tok;
+  StolaValue **cache_val;
+  uint32_t cache_cap, cache_count;
+  // Cursor for sequential element access and last computed length, so
+  // `while i less than length(a) ... a[i]` stays linear.
+  uint32_t seq_node, seq_index, seq_tok;
+  uint32_t len_node, len_val;
+  int forced; // some node was materialized, so raw spans may be stale
+};
+
+static void json_block_masks(const unsigned char *p, uint64_t *quote,
+                             uint64_t *bslash, uint64_t *ws, uint64_t *op) {
+  uint64_t q = 0, b = 0, w = 0, o = 0;
+#ifdef JSON_SSE2
+  const __m128i vq = _mm_set1_epi8('"'), vb = _mm_set1_epi8('\\');
+  const __m128i sp = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+  const __m128i lower = _mm_set1_epi8(0x20), ob = _mm_set1_epi8('{');
+  const __m128i cb = _mm_set1_epi8('}'), colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  for (int k = 0; k < 4; k++) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * k));
+    // '[' and ']' differ from '{' and '}' only in bit 0x20.
+    __m128i vl = _mm_or_si128(v, lower);
+    int sh = 16 * k;
+    q |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vq)) << sh;
+    b |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vb)) << sh;
+    w |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(
+             _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, nl)),
+             _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab))))
+         << sh;
+    o |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_or_si128(
+             _mm_or_si128(_mm_cmpeq_epi8(vl, ob), _mm_cmpeq_epi8(vl, cb)),
+             _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma))))
+         << sh;
+  }
+#else
+  for (int k = 0; k < 64; k++) {
+    uint64_t bit = 1ULL << k;
+    unsigned char c = p[k];
+    if (c == '"')
+      q |= bit;
+    else if (c == '\\')
+      b |= bit;
+    else if (json_is_ws((char)c))
+      w |= bit;
+    else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' ||
+             c == ',')
+      o |= bit;
+  }
+#endif
+  *quote = q;
+  *bslash = b;
+  *ws = w;
+  *op = o;
+}
+
+static inline uint64_t json_prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+static void json_tape_push(StolaJsonDoc *d, uint32_t *cap, uint32_t off) {
+  if (d->ntape == *cap) {
+    *cap *= 2;
+    d->tape = (JsonTok *)realloc(d->tape, sizeof(JsonTok) * *cap);
+  }
+  d->tape[d->ntape].off = off;
+  d->tape[d->ntape].next = d->ntape + 1;
+  d->ntape++;
+}
+
+// Builds d->tape. Returns 0 if the brackets do not balance.
+static int json_build_index(StolaJsonDoc *d) {
+  const unsigned char *text = (const unsigned char *)d->text;
+  uint32_t cap = (uint32_t)(d->len / 8) + 16, depth = 0, stack_cap = 64;
+  uint32_t *stack = (uint32_t *)malloc(sizeof(uint32_t) * stack_cap);
+  d->tape = (JsonTok *)malloc(sizeof(JsonTok) * cap);
+  d->ntape = 0;
+  uint64_t in_string = 0, escape_carry = 0, scalar_carry = 0;
+  int ok = 1;
+  for (size_t i = 0; i < d->len && ok; i += 64) {
+    unsigned char tail[64];
+    const unsigned char *blk = text + i;
+    if (d->len - i < 64) {
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, blk, d->len - i);
+      blk = tail;
+    }
+    uint64_t quote, bs, ws, op;
+    json_block_masks(blk, &quote, &bs, &ws, &op);
+    // Backslashes are rare: resolve which characters they escape serially.
+    uint64_t escaped = escape_carry;
+    escape_carry = 0;
+    for (uint64_t m = bs; m; m &= m - 1) {
+      int k = __builtin_ctzll(m);
+      if (escaped >> k & 1)
+        continue;
+      if (k == 63)
+        escape_carry = 1;
+      else
+        escaped |= 1ULL << (k + 1);
+    }
+    quote &= ~escaped;
+    // Inside-string mask covers the opening quote and the contents.
+    uint64_t str = json_prefix_xor(quote) ^ in_string;
+    in_string = (uint64_t)((int64_t)str >> 63);
+    uint64_t outside = ~str & ~quote;
+    uint64_t scalar = outside & ~ws & ~op;
+    uint64_t ends = scalar | (quote & ~str);
+    uint64_t starts = scalar & ~((ends << 1) | scalar_carry);
+    scalar_carry = ends >> 63;
+    uint64_t structural = (op & outside) | (quote & str) | starts;
+    for (; structural; structural &= structural - 1) {
+      uint32_t off = (uint32_t)(i + __builtin_ctzll(structural));
+      unsigned char c = text[off];
+      if (c == ':' || c == ',')
+        continue;
+      if (c == '}' || c == ']') {
+        // '{' + 2 == '}' and '[' + 2 == ']'
+        if (depth == 0 || text[d->tape[stack[depth - 1]].off] + 2 != c) {
+          ok = 0;
+          break;
+        }
+        uint32_t open = stack[--depth];
+        json_tape_push(d, &cap, off);
+        d->tape[open].next = d->ntape;
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        if (depth == stack_cap) {
+          stack_cap *= 2;
+          stack = (uint32_t *)realloc(stack, sizeof(uint32_t) * stack_cap);
+        }
+        stack[depth++] = d->ntape;
+      }
+      json_tape_push(d, &cap, off);
+    }
+  }
+  free(stack);
+  return ok && depth == 0 && d->ntape > 0;
+}
+
+static char json_tok_char(StolaJsonDoc *d, uint32_t tok) {
+  return tok < d->ntape ? d->text[d->tape[tok].off] : '\0';
+}
+
+static StolaValue *json_cache_get(StolaJsonDoc *d, uint32_t tok) {
+  if (!d->cache_cap)
+    return NULL;
+  for (uint32_t h = tok * 2654435761u & (d->cache_cap - 1);;
+       h = (h + 1) & (d->cache_cap - 1)) {
+    if (d->cache_tok[h] == tok)
+      return d->cache_val[h];
+    if (d->cache_tok[h] == ~0u)
+      return NULL;
+  }
+}
+
+static void json_cache_put(StolaJsonDoc *d, uint32_t tok, StolaValue *v) {
+  if ((d->cache_count + 1) * 2 > d->cache_cap) {
+    uint32_t old_cap = d->cache_cap, *old_tok = d->cache_tok;
+    StolaValue **old_val = d->cache_val;
+    d->cache_cap = old_cap ? old_cap * 2 : 16;
+    d->cache_tok = (uint32_t *)malloc(sizeof(uint32_t) * d->cache_cap);
+    d->cache_val = (StolaValue **)malloc(sizeof(StolaValue *) * d->cache_cap);
+    memset(d->cache_tok, 0xFF, sizeof(uint32_t) * d->cache_cap);
+    d->cache_count = 0;
+    for (uint32_t i = 0; i < old_cap; i++)
+      if (old_tok[i] != ~0u)
+        json_cache_put(d, old_tok[i], old_val[i]);
+    free(old_tok);
+    free(old_val);
+  }
+  uint32_t h = tok * 2654435761u & (d->cache_cap - 1);
+  while (d->cache_tok[h] != ~0u)
+    h = (h + 1) & (d->cache_cap - 1);
+  d->cache_tok[h] = tok;
+  d->cache_val[h] = v;
+  d->cache_count++;
+}
+
+static StolaValue *json_lazy_child(StolaJsonDoc *d, uint32_t tok) {
+  StolaValue *v = json_cache_get(d, tok);
+  if (v)
+    return v;
+  char c = json_tok_char(d, tok);
+  if (c == '{' || c == '[') {
+    v = (StolaValue *)malloc(sizeof(StolaValue));
+    v->type = STOLA_JSON;
+    v->as.json_val.doc = d;
+    v->as.json_val.tok = tok;
+  } else {
+    JsonIn in = {d->text + d->tape[tok].off, d->text + d->len, 0};
+    v = json_parse_value(&in);
+  }
+  json_cache_put(d, tok, v);
+  return v;
+}
+
+static int json_key_equals(StolaJsonDoc *d, uint32_t tok, const char *key) {
+  const char *raw = d->text + d->tape[tok].off + 1, *end = d->text + d->len;
+  size_t klen = strlen(key);
+  if ((size_t)(end - raw) > klen && memcmp(raw, key, klen) == 0 &&
+      raw[klen] == '"' && !memchr(key, '\\', klen))
+    return 1;
+  size_t run = json_string_scan((const unsigned char *)raw, end - raw);
+  if (raw + run >= end || raw[run] != '\\')
+    return 0;
+  JsonIn in = {raw - 1, end, 0};
+  char *decoded = json_parse_chars(&in);
+  int eq = strcmp(decoded, key) == 0;
+  free(decoded);
+  return eq;
+}
+
+// Tape index of the value for `key` in the object at `obj` (the last one,
+// as json_decode keeps), or 0 if absent.
+static uint32_t json_lazy_find(StolaJsonDoc *d, uint32_t obj,
+                               const char *key) {
+  uint32_t found = 0, close = d->tape[obj].next - 1;
+  for (uint32_t t = obj + 1; t + 1 < close; t = d->tape[t + 1].next)
+    if (json_tok_char(d, t) == '"' && json_key_equals(d, t, key))
+      found = t + 1;
+  return found;
+}
+
+static uint32_t json_lazy_index(StolaJsonDoc *d, uint32_t arr, int64_t i) {
+  uint32_t close = d->tape[arr].next - 1, t = arr + 1;
+  int64_t k = 0;
+  if (d->seq_node == arr && (int64_t)d->seq_index <= i) {
+    t = d->seq_tok;
+    k = d->seq_index;
+  }
+  for (; t < close && k < i; k++)
+    t = d->tape[t].next;
+  if (i < 0 || t >= close)
+    return 0;
+  d->seq_node = arr;
+  d->seq_index = (uint32_t)i;
+  d->seq_tok = t;
+  return t;
+}
+
+static StolaValue *json_lazy_field(StolaValue *node, const char *field) {
+  StolaJsonDoc *d = node->as.json_val.doc;
+  uint32_t tok = node->as.json_val.tok;
+  if (json_tok_char(d, tok) != '{')
+    return stola_new_null();
+  uint32_t v = json_lazy_find(d, tok, field);
+  return v ? json_lazy_child(d, v) : stola_new_null();
+}
+
+static StolaValue *json_lazy_get(StolaValue *node, StolaValue *key) {
+  StolaJsonDoc *d = node->as.json_val.doc;
+  uint32_t tok = node->as.json_val.tok;
+  if (json_tok_char(d, tok) == '{') {
+    char *k = value_to_cstr(key);
+    StolaValue *v = json_lazy_field(node, k);
+    free(k);
+    return v;
+  }
+  uint32_t t = json_lazy_index(d, tok, val_to_int(key));
+  return t ? json_lazy_child(d, t) : stola_new_null();
+}
+
+static int64_t json_lazy_length(StolaValue *node) {
+  StolaJsonDoc *d = node->as.json_val.doc;
+  uint32_t tok = node->as.json_val.tok, close = d->tape[tok].next - 1;
+  if (d->len_node == tok)
+    return d->len_val;
+  int obj = json_tok_char(d, tok) == '{';
+  uint32_t n = 0;
+  for (uint32_t t = tok + 1; t < close; t = d->tape[t].next)
+    n++;
+  if (obj)
+    n /= 2;
+  d->len_node = tok;
+  d->len_val = n;
+  return n;
+}
+
+void stola_json_force(StolaValue *val) {
+  if (!val || val->type != STOLA_JSON)
+    return;
+  StolaJsonDoc *d = val->as.json_val.doc;
+  uint32_t tok = val->as.json_val.tok, close = d->tape[tok].next - 1;
+  StolaValue *r;
+  if (json_tok_char(d, tok) == '{') {
+    r = stola_new_dict();
+    for (uint32_t t = tok + 1; t + 1 < close; t = d->tape[t + 1].next) {
+      JsonIn in = {d->text + d->tape[t].off, d->text + d->len, 0};
+      json_dict_put(r, json_parse_chars(&in), json_lazy_child(d, t + 1));
+    }
+  } else {
+    r = stola_new_array();
+    for (uint32_t t = tok + 1; t < close; t = d->tape[t].next)
+      stola_push(r, json_lazy_child(d, t));
+  }
+  *val = *r;
+  free(r);
+  d->forced = 1;
+}
+
+// Source-text size of a node, used to size json_encode's buffer.
+static size_t json_lazy_span(StolaValue *node) {
+  StolaJsonDoc *d = node->as.json_val.doc;
+  uint32_t tok = node->as.json_val.tok;
+  return d->tape[d->tape[tok].next - 1].off - d->tape[tok].off + 1;
+}
+
+static int json_lazy_is_object(StolaValue *node) {
+  return json_tok_char(node->as.json_val.doc, node->as.json_val.tok) == '{';
+}
+
+// Untouched documents are re-emitted by copying their source text; once a
+// node has been materialized (and possibly mutated) children are walked
+// through the cache instead.
+static void json_lazy_encode(StolaValue *node, JsonBuf *b) {
+  StolaJsonDoc *d = node->as.json_val.doc;
+  uint32_t tok = node->as.json_val.tok, close = d->tape[tok].next - 1;
+  if (!d->forced) {
+    jb_put(b, d->text + d->tape[tok].off, json_lazy_span(node));
+    return;
+  }
+  if (json_lazy_is_object(node)) {
+    jb_putc(b, '{');
+    for (uint32_t t = tok + 1; t + 1 < close; t = d->tape[t + 1].next) {
+      JsonIn in = {d->text + d->tape[t].off, d->text + d->len, 0};
+      char *key = json_parse_chars(&in);
+      if (t > tok + 1)
+        jb_putc(b, ',');
+      json_put_string(b, key, strlen(key));
+      free(key);
+      jb_putc(b, ':');
+      json_encode_internal(json_lazy_child(d, t + 1), b);
+    }
+    jb_putc(b, '}');
+  } else {
+    jb_putc(b, '[');
+    for (uint32_t t = tok + 1; t < close; t = d->tape[t].next) {
+      if (t > tok + 1)
+        jb_putc(b, ',');
+      json_encode_internal(json_lazy_child(d, t), b);
+    }
+    jb_putc(b, ']');
+  }
+}
+
+StolaValue *stola_json_lazy(StolaValue *str) {
+  const char *p;
+  size_t n;
+  if (!stola_str_span(str, &p, &n))
+    return stola_new_null();
+  StolaJsonDoc *d = (StolaJsonDoc *)calloc(1, sizeof(StolaJsonDoc));
+  d->text = p;
+  d->len = n;
+  d->seq_node = d->len_node = ~0u;
+  char c;
+  if (d->len > UINT32_MAX || !json_build_index(d) ||
+      ((c = json_tok_char(d, 0)) != '{' && c != '[')) {
+    // Scalars and malformed input go through the eager, lenient decoder.
+    free(d->tape);
+    free(d);
+    return stola_json_decode(str);
+  }
+  return json_lazy_child(d, 0);
 }
 
 // ============================================================
@@ -1187,12 +2193,25 @@ StolaValue *stola_current_time(void) {
   return stola_new_int((int64_t)time(NULL));
 }
 
+// Monotonic milliseconds, for measuring intervals (benchmarks, timeouts).
+StolaValue *stola_time_ms(void) {
+#ifdef _WIN32
+  return stola_new_int((int64_t)GetTickCount64());
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return stola_new_int((int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
 void stola_sleep(StolaValue *seconds) {
   if (!seconds)
     return;
   int64_t ms = val_to_int(seconds) * 1000;
   if (ms <= 0)
     return;
+  if (stola_coro_sleep(ms))
+    return;
 #ifdef _WIN32
   extern void __stdcall Sleep(unsigned long dwMilliseconds);
   Sleep((unsigned long)ms);
@@ -1235,8 +2254,13 @@ StolaValue *stola_round(StolaValue *val) {
 // ============================================================
 
 StolaValue *stola_read_file(StolaValue *path) {
+  path = stola_as_string(path);
   if (!path || path->type != STOLA_STRING)
     return stola_new_null();
+  char *data;
+  int io = stola_io_read_file(path->as.str_val, &data);
+  if (io >= 0)
+    return io ? stola_new_string_owned(data) : stola_new_null();
   FILE *f = fopen(path->as.str_val, "rb");
   if (!f)
     return stola_new_null();
@@ -1250,31 +2274,97 @@ StolaValue *stola_read_file(StolaValue *path) {
   return stola_new_string_owned(buf);
 }
 
+// Maps the file read-only and returns a view of it: nothing is copied and
+// pages are only read as they are touched, so scanning a file larger than
+// memory keeps RSS bounded by the kernel's page cache policy. The mapping
+// lives for the rest of the program, like any other string.
+StolaValue *stola_mmap_file(StolaValue *path) {
+  path = stola_as_string(path);
+  if (!path || path->type != STOLA_STRING)
+    return stola_new_null();
+#ifdef _WIN32
+  HANDLE f = CreateFileA(path->as.str_val, GENERIC_READ, FILE_SHARE_READ, NULL,
+                         OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (f == INVALID_HANDLE_VALUE)
+    return stola_new_null();
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(f, &size)) {
+    CloseHandle(f);
+    return stola_new_null();
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(f);
+    return stola_new_view("", 0);
+  }
+  HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(f);
+  if (!m)
+    return stola_new_null();
+  const char *p = (const char *)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(m);
+  if (!p)
+    return stola_new_null();
+  return stola_new_view(p, (size_t)size.QuadPart);
+#else
+  int fd = open(path->as.str_val, O_RDONLY);
+  if (fd < 0)
+    return stola_new_null();
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return stola_new_null();
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return stola_new_view("", 0);
+  }
+  void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return stola_new_null();
+  madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+  return stola_new_view((const char *)p, (size_t)st.st_size);
+#endif
+}
+
 StolaValue *stola_write_file(StolaValue *path, StolaValue *content) {
-  if (!path || path->type != STOLA_STRING || !content ||
-      content->type != STOLA_STRING)
+  const char *data;
+  size_t len;
+  path = stola_as_string(path);
+  if (!path || path->type != STOLA_STRING ||
+      !stola_str_span(content, &data, &len))
     return stola_new_bool(0);
+  int io = stola_io_write_file(path->as.str_val, data, len, 0);
+  if (io >= 0)
+    return stola_new_bool(io);
   FILE *f = fopen(path->as.str_val, "w");
   if (!f)
     return stola_new_bool(0);
-  fputs(content->as.str_val, f);
+  fwrite(data, 1, len, f);
   fclose(f);
   return stola_new_bool(1);
 }
 
 StolaValue *stola_append_file(StolaValue *path, StolaValue *content) {
-  if (!path || path->type != STOLA_STRING || !content ||
-      content->type != STOLA_STRING)
+  const char *data;
+  size_t len;
+  path = stola_as_string(path);
+  if (!path || path->type != STOLA_STRING ||
+      !stola_str_span(content, &data, &len))
     return stola_new_bool(0);
+  int io = stola_io_write_file(path->as.str_val, data, len, 1);
+  if (io >= 0)
+    return stola_new_bool(io);
   FILE *f = fopen(path->as.str_val, "a");
   if (!f)
     return stola_new_bool(0);
-  fputs(content->as.str_val, f);
+  fwrite(data, 1, len, f);
   fclose(f);
   return stola_new_bool(1);
 }
 
 StolaValue *stola_file_exists(StolaValue *path) {
+  path = stola_as_string(path);
   if (!path || path->type != STOLA_STRING)
     return stola_new_bool(0);
   FILE *f = fopen(path->as.str_val, "r");
@@ -1285,6 +2375,347 @@ StolaValue *stola_file_exists(StolaValue *path) {
   return stola_new_bool(0);
 }
 
+StolaValue *stola_delete_file(StolaValue *path) {
+  path = stola_as_string(path);
+  if (!path || path->type != STOLA_STRING)
+    return stola_new_bool(0);
+  return stola_new_bool(remove(path->as.str_val) == 0);
+}
+
+// ------------------------------------------------------------
+// File handles: file_open returns a handle (an int, like sockets and
+// pollers) to a descriptor with its own large read and write buffers, so
+// line-by-line reading and many small writes cost one system call per
+// buffer instead of one per call.
+// ------------------------------------------------------------
+
+#define STOLA_FILE_BUF (256 * 1024)
+
+#ifdef _WIN32
+#define file_sys_read(fd, p, n) _read(fd, p, (unsigned)(n))
+#define file_sys_write(fd, p, n) _write(fd, p, (unsigned)(n))
+#define file_sys_close _close
+#else
+#define file_sys_read read
+#define file_sys_write write
+#define file_sys_close close
+#endif
+
+typedef struct {
+  int fd; // -1 once closed; the struct itself is kept so stale handles are safe
+  char *rbuf, *wbuf;
+  size_t rpos, rlen, wlen;
+  int eof;
+} StolaFile;
+
+static StolaFile *file_from_handle(StolaValue *h) {
+  if (!h || h->type != STOLA_INT || !h->as.int_val)
+    return NULL;
+  StolaFile *f = (StolaFile *)(uintptr_t)h->as.int_val;
+  return f->fd >= 0 ? f : NULL;
+}
+
+static int file_flush_buf(StolaFile *f) {
+  size_t off = 0;
+  while (off < f->wlen) {
+    long n = (long)file_sys_write(f->fd, f->wbuf + off, f->wlen - off);
+    if (n <= 0) {
+      f->wlen = 0;
+      return 0;
+    }
+    off += (size_t)n;
+  }
+  f->wlen = 0;
+  return 1;
+}
+
+// Refills the read buffer, keeping unconsumed bytes. Returns bytes added.
+static size_t file_fill(StolaFile *f) {
+  if (f->eof)
+    return 0;
+  if (f->rpos > 0) {
+    memmove(f->rbuf, f->rbuf + f->rpos, f->rlen - f->rpos);
+    f->rlen -= f->rpos;
+    f->rpos = 0;
+  }
+  if (f->rlen == STOLA_FILE_BUF)
+    return 0;
+  long n = (long)file_sys_read(f->fd, f->rbuf + f->rlen, STOLA_FILE_BUF - f->rlen);
+  if (n <= 0) {
+    f->eof = 1;
+    return 0;
+  }
+  f->rlen += (size_t)n;
+  return (size_t)n;
+}
+
+// mode: "r", "w" (truncate) or "a" (append); a trailing "+" also allows
+// the other direction and "b" is accepted and ignored.
+StolaValue *stola_file_open(StolaValue *path, StolaValue *mode) {
+  path = stola_as_string(path);
+  if (!path || path->type != STOLA_STRING)
+    return stola_new_null();
+  mode = stola_as_string(mode);
+  const char *m = (mode && mode->type == STOLA_STRING) ? mode->as.str_val : "r";
+  int plus = strchr(m, '+') != NULL, flags;
+  if (m[0] == 'w')
+    flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+  else if (m[0] == 'a')
+    flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+  else
+    flags = plus ? O_RDWR : O_RDONLY;
+#ifdef _WIN32
+  int fd = _open(path->as.str_val, flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  int fd = open(path->as.str_val, flags, 0644);
+#endif
+  if (fd < 0)
+    return stola_new_null();
+  StolaFile *f = (StolaFile *)calloc(1, sizeof(StolaFile));
+  f->fd = fd;
+  if (m[0] == 'r' || plus)
+    f->rbuf = (char *)malloc(STOLA_FILE_BUF);
+  if (m[0] != 'r' || plus)
+    f->wbuf = (char *)malloc(STOLA_FILE_BUF);
+  return stola_new_int((int64_t)(uintptr_t)f);
+}
+
+// Next line without its "\n" (or "\r\n"); null at end of file.
+static char *file_next_line(StolaFile *f) {
+  size_t scanned = 0;
+  for (;;) {
+    char *start = f->rbuf + f->rpos;
+    size_t avail = f->rlen - f->rpos;
+    char *nl = (char *)memchr(start + scanned, '\n', avail - scanned);
+    if (nl || (f->eof && avail > 0) ||
+        (!nl && avail == STOLA_FILE_BUF)) {
+      // A line longer than the buffer is returned in buffer-sized pieces.
+      size_t len = nl ? (size_t)(nl - start) : avail;
+      f->rpos += nl ? len + 1 : len;
+      if (len > 0 && start[len - 1] == '\r' && nl)
+        len--;
+      char *line = (char *)malloc(len + 1);
+      memcpy(line, start, len);
+      line[len] = '\0';
+      return line;
+    }
+    if (f->eof)
+      return NULL;
+    scanned = avail;
+    if (f->wbuf && !file_flush_buf(f))
+      return NULL;
+    file_fill(f);
+  }
+}
+
+StolaValue *stola_file_read_line(StolaValue *handle) {
+  StolaFile *f = file_from_handle(handle);
+  if (!f || !f->rbuf)
+    return stola_new_null();
+  char *line = file_next_line(f);
+  return line ? stola_new_string_owned(line) : stola_new_null();
+}
+
+// Up to max bytes (whatever is buffered or one read); null at end of file.
+StolaValue *stola_file_read_chunk(StolaValue *handle, StolaValue *max) {
+  StolaFile *f = file_from_handle(handle);
+  if (!f || !f->rbuf)
+    return stola_new_null();
+  int64_t want = val_to_int(max);
+  if (want <= 0)
+    want = STOLA_FILE_BUF;
+  if (f->rpos == f->rlen)
+    file_fill(f);
+  size_t avail = f->rlen - f->rpos;
+  if (avail == 0)
+    return stola_new_null();
+  size_t n = avail < (size_t)want ? avail : (size_t)want;
+  char *out = (char *)malloc(n + 1);
+  memcpy(out, f->rbuf + f->rpos, n);
+  out[n] = '\0';
+  f->rpos += n;
+  return stola_new_string_owned(out);
+}
+
+StolaValue *stola_file_write(StolaValue *handle, StolaValue *data) {
+  StolaFile *f = file_from_handle(handle);
+  if (!f || !f->wbuf)
+    return stola_new_bool(0);
+  const char *p;
+  size_t n;
+  char *tmp = NULL;
+  if (!stola_str_span(data, &p, &n)) {
+    tmp = value_to_cstr(data);
+    p = tmp;
+    n = strlen(tmp);
+  }
+  int ok = 1;
+  if (f->wlen + n > STOLA_FILE_BUF)
+    ok = file_flush_buf(f);
+  if (ok && n >= STOLA_FILE_BUF) {
+    // Writes bigger than the buffer skip it entirely.
+    for (size_t off = 0; ok && off < n;) {
+      long w = (long)file_sys_write(f->fd, p + off, n - off);
+      if (w <= 0)
+        ok = 0;
+      else
+        off += (size_t)w;
+    }
+  } else if (ok) {
+    memcpy(f->wbuf + f->wlen, p, n);
+    f->wlen += n;
+  }
+  free(tmp);
+  return stola_new_bool(ok);
+}
+
+StolaValue *stola_file_flush(StolaValue *handle) {
+  StolaFile *f = file_from_handle(handle);
+  if (!f)
+    return stola_new_bool(0);
+  return stola_new_bool(!f->wbuf || file_flush_buf(f));
+}
+
+StolaValue *stola_file_close(StolaValue *handle) {
+  StolaFile *f = file_from_handle(handle);
+  if (!f)
+    return stola_new_bool(0);
+  int ok = !f->wbuf || file_flush_buf(f);
+  file_sys_close(f->fd);
+  f->fd = -1;
+  free(f->rbuf);
+  free(f->wbuf);
+  f->rbuf = f->wbuf = NULL;
+  return stola_new_bool(ok);
+}
+
+// ============================================================
+// Iteration (for x in ...)
+// ============================================================
+// stola_iter_begin turns any iterable into a STOLA_ITER and stola_iter_next
+// yields values until it returns NULL. Arrays yield elements, dicts and
+// structs their keys, strings their characters.
+
+StolaValue *stola_new_iter(StolaIterNext next, void *state) {
+  StolaValue *v = (StolaValue *)malloc(sizeof(StolaValue));
+  v->type = STOLA_ITER;
+  v->as.iter_val.next = next;
+  v->as.iter_val.state = state;
+  return v;
+}
+
+typedef struct {
+  StolaValue *src;
+  int64_t i;
+} IterIndex;
+
+static StolaValue *iter_array_next(void *state) {
+  IterIndex *it = (IterIndex *)state;
+  // The count is re-read every step, so pushes during the loop are seen.
+  if (it->i >= it->src->as.array_val.count)
+    return NULL;
+  return it->src->as.array_val.items[it->i++];
+}
+
+static StolaValue *iter_keys_next(void *state) {
+  IterIndex *it = (IterIndex *)state;
+  StolaDict *d = it->src->type == STOLA_DICT ? &it->src->as.dict_val
+                                             : &it->src->as.struct_val.fields;
+  if (it->i >= d->count)
+    return NULL;
+  return stola_new_string(d->entries[it->i++].key);
+}
+
+static StolaValue *iter_chars_next(void *state) {
+  IterIndex *it = (IterIndex *)state;
+  const char *p;
+  size_t n;
+  if (!stola_str_span(it->src, &p, &n) || (size_t)it->i >= n)
+    return NULL;
+  char *c = (char *)malloc(2);
+  c[0] = p[it->i++];
+  c[1] = '\0';
+  return stola_new_string_owned(c);
+}
+
+static StolaValue *iter_empty_next(void *state) {
+  (void)state;
+  return NULL;
+}
+
+StolaValue *stola_iter_begin(StolaValue *iterable) {
+  if (iterable && iterable->type == STOLA_ITER)
+    return iterable;
+  stola_json_force(iterable);
+  StolaIterNext next = iter_empty_next;
+  if (iterable) {
+    switch (iterable->type) {
+    case STOLA_ARRAY:
+      next = iter_array_next;
+      break;
+    case STOLA_DICT:
+    case STOLA_STRUCT:
+      next = iter_keys_next;
+      break;
+    case STOLA_STRING:
+    case STOLA_VIEW:
+      next = iter_chars_next;
+      break;
+    default:
+      break;
+    }
+  }
+  IterIndex *it = (IterIndex *)malloc(sizeof(IterIndex));
+  it->src = iterable;
+  it->i = 0;
+  return stola_new_iter(next, it);
+}
+
+StolaValue *stola_iter_next(StolaValue *iter) {
+  if (!iter || iter->type != STOLA_ITER)
+    return NULL;
+  return iter->as.iter_val.next(iter->as.iter_val.state);
+}
+
+typedef struct {
+  StolaFile *file;
+  int owned; // opened by lines(path): closed when exhausted
+  StolaValue *handle;
+} IterLines;
+
+static StolaValue *iter_lines_next(void *state) {
+  IterLines *it = (IterLines *)state;
+  if (!it->handle)
+    return NULL;
+  char *line = it->file->fd >= 0 ? file_next_line(it->file) : NULL;
+  if (line)
+    return stola_new_string_owned(line);
+  if (it->owned)
+    stola_file_close(it->handle);
+  it->handle = NULL;
+  return NULL;
+}
+
+// lines(path or handle): iterator over the lines of a file, read through a
+// file handle's buffer so memory stays constant regardless of file size.
+StolaValue *stola_lines(StolaValue *source) {
+  StolaValue *h = source;
+  int owned = 0;
+  source = stola_as_string(source);
+  if (source && source->type == STOLA_STRING) {
+    h = stola_file_open(source, stola_new_string("r"));
+    owned = 1;
+  }
+  StolaFile *f = file_from_handle(h);
+  if (!f || !f->rbuf)
+    return stola_new_iter(iter_empty_next, NULL);
+  IterLines *it = (IterLines *)malloc(sizeof(IterLines));
+  it->file = f;
+  it->owned = owned;
+  it->handle = h;
+  return stola_new_iter(iter_lines_next, it);
+}
+
 // ============================================================
 // Raw Memory Access (pointer operations — freestanding / bare-metal)
 // In hosted mode these are thin C wrappers; freestanding mode uses
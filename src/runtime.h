@@ -2,6 +2,7 @@
 #define RUNTIME_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 // ============================================================
 // StolasScript Tagged Value Runtime
@@ -17,12 +18,17 @@ typedef enum {
   STOLA_DICT,
   STOLA_STRUCT,
   STOLA_FUNCTION,
-  STOLA_NULL
+  STOLA_NULL,
+  STOLA_JSON, // object/array of a json_lazy document, materialized on demand
+  STOLA_VIEW, // read-only byte range (mmap_file and slices of it), no NUL
+  STOLA_ITER  // iterator driven by for-in (stola_iter_next until NULL)
 } StolaType;
 
 // Forward declarations
 typedef struct StolaValue StolaValue;
+typedef StolaValue *(*StolaIterNext)(void *state);
 typedef struct StolaDict StolaDict;
+typedef struct StolaJsonDoc StolaJsonDoc;
 
 // Dictionary entry (key-value pair)
 typedef struct {
@@ -58,6 +64,18 @@ struct StolaValue {
     StolaDict dict_val;
     StolaStruct struct_val;
     void *fn_ptr; // function pointer (for closures/callbacks)
+    struct {
+      StolaJsonDoc *doc;
+      uint32_t tok; // index of the node's opening bracket in the doc tape
+    } json_val;
+    struct {
+      const char *ptr;
+      size_t len;
+    } view_val;
+    struct {
+      StolaIterNext next; // returns NULL when exhausted
+      void *state;
+    } iter_val;
   } as;
 };
 
@@ -72,6 +90,13 @@ StolaValue *stola_new_null(void);
 StolaValue *stola_new_array(void);
 StolaValue *stola_new_dict(void);
 StolaValue *stola_new_struct(const char *type_name);
+StolaValue *stola_new_view(const char *ptr, size_t len); // borrows ptr
+
+// Bytes of a STOLA_STRING or STOLA_VIEW; returns 0 for anything else.
+int stola_str_span(StolaValue *val, const char **ptr, size_t *len);
+// val itself, or a STOLA_STRING copy of it when it is a view (paths, URLs
+// and other arguments that have to reach C as NUL-terminated strings).
+StolaValue *stola_as_string(StolaValue *val);
 
 // ============================================================
 // Type Inspection
@@ -176,19 +201,51 @@ StolaValue *stola_socket_connect(StolaValue *host, StolaValue *port);
 StolaValue *stola_socket_send(StolaValue *fd, StolaValue *data);
 StolaValue *stola_socket_receive(StolaValue *fd);
 void stola_socket_close(StolaValue *fd);
+StolaValue *stola_socket_receive_some(StolaValue *fd, StolaValue *max);
+StolaValue *stola_socket_receive_exact(StolaValue *fd, StolaValue *n);
+StolaValue *stola_socket_read_line(StolaValue *fd);
+StolaValue *stola_socket_set_nonblocking(StolaValue *fd, StolaValue *on);
+StolaValue *stola_dns_cache_flush(void);
+StolaValue *stola_dns_prewarm(StolaValue *hosts);
+StolaValue *stola_dns_cache_stats(void);
+StolaValue *stola_dns_set_ttl(StolaValue *ttl, StolaValue *negative_ttl);
 
 // ============================================================
 // JSON
 // ============================================================
 StolaValue *stola_json_encode(StolaValue *val);
 StolaValue *stola_json_decode(StolaValue *str);
+StolaValue *stola_json_parse_stream(StolaValue *source, StolaValue *callback,
+                                    StolaValue *ctx);
+StolaValue *stola_json_lazy(StolaValue *str);
+// Turns a STOLA_JSON node into a plain dict/array in place (children stay
+// lazy). No-op for any other value.
+void stola_json_force(StolaValue *val);
 
 // ============================================================
 // Time / System
 // ============================================================
 StolaValue *stola_current_time(void);
+StolaValue *stola_time_ms(void);
 void stola_sleep(StolaValue *seconds);
 
+// ============================================================
+// Coroutines (green threads, one scheduler per OS thread)
+// ============================================================
+StolaValue *stola_coro_spawn(void *func_ptr, StolaValue *arg);
+StolaValue *stola_coro_go(void *func_ptr, StolaValue *arg); // spawn, handle discarded
+StolaValue *stola_coro_yield(void);
+StolaValue *stola_coro_await(StolaValue *handle);
+int stola_coro_sleep(int64_t ms); // parks the running coroutine; 0 if none
+
+// ============================================================
+// I/O engine (io_uring when available, see builtins.c)
+// ============================================================
+// -1: no engine, caller falls back to stdio; otherwise 1 ok / 0 failed
+int stola_io_read_file(const char *path, char **out);
+int stola_io_write_file(const char *path, const char *data, size_t len, int append);
+StolaValue *stola_io_engine(void);
+
 // ============================================================
 // Math
 // ============================================================
@@ -201,9 +258,25 @@ StolaValue *stola_round(StolaValue *val);
 // File I/O
 // ============================================================
 StolaValue *stola_read_file(StolaValue *path);
+StolaValue *stola_mmap_file(StolaValue *path);
 StolaValue *stola_write_file(StolaValue *path, StolaValue *content);
 StolaValue *stola_append_file(StolaValue *path, StolaValue *content);
 StolaValue *stola_file_exists(StolaValue *path);
+StolaValue *stola_delete_file(StolaValue *path);
+StolaValue *stola_file_open(StolaValue *path, StolaValue *mode);
+StolaValue *stola_file_read_line(StolaValue *handle);
+StolaValue *stola_file_read_chunk(StolaValue *handle, StolaValue *max);
+StolaValue *stola_file_write(StolaValue *handle, StolaValue *data);
+StolaValue *stola_file_flush(StolaValue *handle);
+StolaValue *stola_file_close(StolaValue *handle);
+StolaValue *stola_lines(StolaValue *source);
+
+// ============================================================
+// Iteration — for-in loops compile to iter_begin + iter_next until NULL
+// ============================================================
+StolaValue *stola_new_iter(StolaIterNext next, void *state);
+StolaValue *stola_iter_begin(StolaValue *iterable);
+StolaValue *stola_iter_next(StolaValue *iter);
 
 // ============================================================
 // Raw Memory Access — useful for freestanding / bare-metal mode.
@@ -220,5 +293,15 @@ void stola_setup_runtime(void);
 // Native HTTP (WinHTTP, supports HTTPS)
 // ============================================================
 StolaValue *stola_http_fetch(StolaValue *url);
+StolaValue *stola_http_request(StolaValue *method, StolaValue *url,
+                               StolaValue *body, StolaValue *headers);
+StolaValue *stola_http_pipeline(StolaValue *requests);
+StolaValue *stola_http_set_timeout(StolaValue *ms);
+
+// Native HTTP/1.1 server (epoll workers on Linux, threads on Windows)
+StolaValue *stola_http_server_create(StolaValue *port, void *handler);
+StolaValue *stola_http_server_stop(StolaValue *port);
+StolaValue *stola_http_header(StolaValue *req, StolaValue *name);
+StolaValue *stola_http_headers(StolaValue *req);
 
 #endif // RUNTIME_H
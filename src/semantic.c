@@ -1,4 +1,9 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L /* strdup under -std=c11 */
+#endif
 #include "semantic.h"
+#include "intern.h"
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,7 +19,9 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node);
 
 static SymbolTable *create_symbol_table(SymbolTable *outer, int is_function) {
   SymbolTable *table = malloc(sizeof(SymbolTable));
-  table->symbols = NULL;
+  table->slots = NULL;
+  table->capacity = 0;
+  table->count = 0;
   table->is_function_scope = is_function;
 
   if (is_function || !outer) {
@@ -27,13 +34,8 @@ static SymbolTable *create_symbol_table(SymbolTable *outer, int is_function) {
 }
 
 static void free_symbol_table(SymbolTable *table) {
-  Symbol *sym = table->symbols;
-  while (sym) {
-    Symbol *next = sym->next;
-    free(sym->name);
-    free(sym);
-    sym = next;
-  }
+  // Symbols themselves belong to compile_arena
+  free(table->slots);
   free(table);
 }
 
@@ -44,14 +46,43 @@ static void analyzer_add_error(SemanticAnalyzer *analyzer, const char *msg) {
   analyzer->errors[analyzer->error_count - 1] = strdup(msg);
 }
 
+// Names are interned, so the pointer is the key.
+static Symbol **table_probe(SymbolTable *table, const char *name) {
+  uintptr_t h = ((uintptr_t)name >> 3) * (uintptr_t)0x9E3779B97F4A7C15ull;
+  int mask = table->capacity - 1;
+  int i = (int)(h >> 16) & mask;
+  while (table->slots[i] && table->slots[i]->name != name)
+    i = (i + 1) & mask;
+  return &table->slots[i];
+}
+
+static void table_insert(SymbolTable *table, Symbol *sym) {
+  // Keep the load factor under 3/4
+  if ((table->count + 1) * 4 > table->capacity * 3) {
+    Symbol **old = table->slots;
+    int old_capacity = table->capacity;
+    table->capacity = old_capacity ? old_capacity * 2 : 8;
+    table->slots = calloc(table->capacity, sizeof(Symbol *));
+    for (int i = 0; i < old_capacity; i++) {
+      if (old[i])
+        *table_probe(table, old[i]->name) = old[i];
+    }
+    free(old);
+  }
+  Symbol **slot = table_probe(table, sym->name);
+  if (!*slot)
+    table->count++;
+  *slot = sym; // redefinition in the same scope: newest wins
+}
+
 static Symbol *define_symbol(SemanticAnalyzer *analyzer, const char *name,
                              SymbolType type, int arity, const char *val_type) {
-  Symbol *sym = malloc(sizeof(Symbol));
-  sym->name = strdup(name);
+  Symbol *sym = arena_alloc(&compile_arena, sizeof(Symbol));
+  sym->name = intern_cstr(name);
   sym->type = type;
   sym->arity = arity;
-  sym->value_type = val_type ? strdup(val_type) : strdup("any");
-  sym->return_type = strdup("any");
+  sym->value_type = intern_cstr(val_type ? val_type : "any");
+  sym->return_type = intern_cstr("any");
   sym->param_types = NULL;
 
   if (type == SYMBOL_LOCAL) {
@@ -60,22 +91,21 @@ static Symbol *define_symbol(SemanticAnalyzer *analyzer, const char *name,
     sym->index = 0; // Globals might need a different allocation strategy later
   }
 
-  sym->next = analyzer->current_scope->symbols;
-  analyzer->current_scope->symbols = sym;
+  table_insert(analyzer->current_scope, sym);
   return sym;
 }
 
 Symbol *resolve_symbol(SemanticAnalyzer *analyzer, const char *name) {
-  SymbolTable *current = analyzer->current_scope;
-  while (current) {
-    Symbol *sym = current->symbols;
-    while (sym) {
-      if (strcmp(sym->name, name) == 0) {
-        return sym;
-      }
-      sym = sym->next;
-    }
-    current = current->outer;
+  const char *key = intern_find(name);
+  if (!key)
+    return NULL; // never interned, so never defined
+  for (SymbolTable *scope = analyzer->current_scope; scope;
+       scope = scope->outer) {
+    if (scope->count == 0)
+      continue;
+    Symbol *sym = *table_probe(scope, key);
+    if (sym)
+      return sym;
   }
   return NULL; // Not found
 }
@@ -133,32 +163,73 @@ void semantic_init(SemanticAnalyzer *analyzer, int is_freestanding) {
   define_symbol(analyzer, "socket_send", SYMBOL_FUNCTION, 2, "number");
   define_symbol(analyzer, "socket_receive", SYMBOL_FUNCTION, 1, "string");
   define_symbol(analyzer, "socket_close", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "socket_receive_some", SYMBOL_FUNCTION, 2, "string");
+  define_symbol(analyzer, "socket_receive_exact", SYMBOL_FUNCTION, 2, "string");
+  define_symbol(analyzer, "socket_read_line", SYMBOL_FUNCTION, 1, "string");
+  define_symbol(analyzer, "socket_set_nonblocking", SYMBOL_FUNCTION, 2, "bool");
+  define_symbol(analyzer, "dns_cache_flush", SYMBOL_FUNCTION, 0, "any");
+  define_symbol(analyzer, "dns_prewarm", SYMBOL_FUNCTION, 1, "number");
+  define_symbol(analyzer, "dns_cache_stats", SYMBOL_FUNCTION, 0, "any");
+  define_symbol(analyzer, "dns_set_ttl", SYMBOL_FUNCTION, 2, "any");
   define_symbol(analyzer, "ws_connect", SYMBOL_FUNCTION, 1, "number");
   define_symbol(analyzer, "ws_send", SYMBOL_FUNCTION, 2, "number");
   define_symbol(analyzer, "ws_receive", SYMBOL_FUNCTION, 1, "string");
+  define_symbol(analyzer, "ws_send_binary", SYMBOL_FUNCTION, 2, "number");
+  define_symbol(analyzer, "ws_broadcast", SYMBOL_FUNCTION, 2, "any");
+  define_symbol(analyzer, "ws_receive_message", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "ws_close", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "ws_server_create", SYMBOL_FUNCTION, 1, "number");
   define_symbol(analyzer, "ws_server_accept", SYMBOL_FUNCTION, 1, "number");
   define_symbol(analyzer, "ws_server_close", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "ws_server_run", SYMBOL_FUNCTION, 3, "bool");
+  define_symbol(analyzer, "ws_server_stop", SYMBOL_FUNCTION, 1, "bool");
   define_symbol(analyzer, "ws_select", SYMBOL_FUNCTION, 2, "any");
+  define_symbol(analyzer, "poller_create", SYMBOL_FUNCTION, 0, "number");
+  define_symbol(analyzer, "poller_add", SYMBOL_FUNCTION, 3, "bool");
+  define_symbol(analyzer, "poller_remove", SYMBOL_FUNCTION, 2, "bool");
+  define_symbol(analyzer, "poller_wait", SYMBOL_FUNCTION, 2, "any");
+  define_symbol(analyzer, "poller_close", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "json_encode", SYMBOL_FUNCTION, 1, "string");
   define_symbol(analyzer, "json_decode", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "json_parse_stream", SYMBOL_FUNCTION, 3, "int");
+  define_symbol(analyzer, "json_lazy", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "current_time", SYMBOL_FUNCTION, 0, "number");
+  define_symbol(analyzer, "time_ms", SYMBOL_FUNCTION, 0, "number");
   define_symbol(analyzer, "sleep", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "random", SYMBOL_FUNCTION, 0, "number");
   define_symbol(analyzer, "floor", SYMBOL_FUNCTION, 1, "number");
   define_symbol(analyzer, "ceil", SYMBOL_FUNCTION, 1, "number");
   define_symbol(analyzer, "round", SYMBOL_FUNCTION, 1, "number");
   define_symbol(analyzer, "read_file", SYMBOL_FUNCTION, 1, "string");
+  define_symbol(analyzer, "mmap_file", SYMBOL_FUNCTION, 1, "string");
   define_symbol(analyzer, "write_file", SYMBOL_FUNCTION, 2, "bool");
   define_symbol(analyzer, "append_file", SYMBOL_FUNCTION, 2, "bool");
+  define_symbol(analyzer, "io_engine", SYMBOL_FUNCTION, 0, "string");
   define_symbol(analyzer, "file_exists", SYMBOL_FUNCTION, 1, "bool");
+  define_symbol(analyzer, "delete_file", SYMBOL_FUNCTION, 1, "bool");
+  define_symbol(analyzer, "file_open", SYMBOL_FUNCTION, 2, "int");
+  define_symbol(analyzer, "file_read_line", SYMBOL_FUNCTION, 1, "string");
+  define_symbol(analyzer, "file_read_chunk", SYMBOL_FUNCTION, 2, "string");
+  define_symbol(analyzer, "file_write", SYMBOL_FUNCTION, 2, "bool");
+  define_symbol(analyzer, "file_flush", SYMBOL_FUNCTION, 1, "bool");
+  define_symbol(analyzer, "file_close", SYMBOL_FUNCTION, 1, "bool");
+  define_symbol(analyzer, "lines", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "http_fetch", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "http_request", SYMBOL_FUNCTION, 4, "any");
+  define_symbol(analyzer, "http_pipeline", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "http_set_timeout", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "http_server_create", SYMBOL_FUNCTION, 2, "number");
+  define_symbol(analyzer, "http_server_stop", SYMBOL_FUNCTION, 1, "bool");
+  define_symbol(analyzer, "http_header", SYMBOL_FUNCTION, 2, "any");
+  define_symbol(analyzer, "http_headers", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "thread_spawn", SYMBOL_FUNCTION, 2, "number");
   define_symbol(analyzer, "thread_join", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "mutex_create", SYMBOL_FUNCTION, 0, "number");
   define_symbol(analyzer, "mutex_lock", SYMBOL_FUNCTION, 1, "any");
   define_symbol(analyzer, "mutex_unlock", SYMBOL_FUNCTION, 1, "any");
+  define_symbol(analyzer, "spawn", SYMBOL_FUNCTION, 2, "number");
+  define_symbol(analyzer, "yield", SYMBOL_FUNCTION, 0, "any");
+  define_symbol(analyzer, "await", SYMBOL_FUNCTION, 1, "any");
 }
 
 void semantic_free(SemanticAnalyzer *analyzer) {
@@ -230,8 +301,8 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
       if (strstr(code, "hlt") || strstr(code, "lgdt") ||
           strstr(code, "lidt") || strstr(code, "in ") ||
           strstr(code, "out ")) {
-        printf("[StolasScript Warning] Privileged instruction(s) in 'asm {}' "
-               "block outside --freestanding mode.\n");
+        fprintf(stderr, "[StolasScript Warning] Privileged instruction(s) in "
+                        "'asm {}' block outside --freestanding mode.\n");
       }
     }
     break;
@@ -240,9 +311,10 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
   case AST_FUNCTION_DECL: {
     // Warn if interrupt function is used outside freestanding mode
     if (node->as.function_decl.is_interrupt && !analyzer->is_freestanding) {
-      printf("[StolasScript Warning] 'interrupt function %s' should be used "
-             "with --freestanding (kernel/bare-metal context).\n",
-             node->as.function_decl.name);
+      fprintf(stderr,
+              "[StolasScript Warning] 'interrupt function %s' should be used "
+              "with --freestanding (kernel/bare-metal context).\n",
+              node->as.function_decl.name);
     }
 
     // Register function first for recursion
@@ -251,10 +323,10 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
         node->as.function_decl.param_count, node->as.function_decl.return_type);
 
     if (func_sym) {
-      func_sym->param_types = malloc(sizeof(char *) * func_sym->arity);
+      func_sym->param_types =
+          arena_alloc(&compile_arena, sizeof(char *) * func_sym->arity);
       for (int i = 0; i < func_sym->arity; i++) {
-        func_sym->param_types[i] =
-            strdup(node->as.function_decl.param_types[i]);
+        func_sym->param_types[i] = node->as.function_decl.param_types[i];
       }
     }
 
@@ -326,9 +398,10 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
         if (strcmp(node->as.assignment.type_annotation, "any") != 0 &&
             strcmp(sym->value_type, "any") != 0 &&
             strcmp(sym->value_type, node->as.assignment.type_annotation) != 0) {
-          printf("[StolasScript Warning] Relajación de tipo dinámica: Variable "
-                 "'%s' estaba tipada como '%s', pero se asigna de tipo '%s'\n",
-                 name, sym->value_type, node->as.assignment.type_annotation);
+          fprintf(stderr,
+                  "[StolasScript Warning] Relajación de tipo dinámica: Variable "
+                  "'%s' estaba tipada como '%s', pero se asigna de tipo '%s'\n",
+                  name, sym->value_type, node->as.assignment.type_annotation);
         }
       }
     } else {
@@ -339,7 +412,9 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
   }
 
   case AST_IDENTIFIER: {
+    // Cached on the node so later passes (codegen) need not resolve again
     Symbol *sym = resolve_symbol(analyzer, node->as.identifier.value);
+    node->as.identifier.symbol = sym;
     if (!sym) {
       char msg[256];
       snprintf(msg, sizeof(msg), "Undefined variable or function '%s'",
@@ -356,8 +431,7 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
     // But we can check arity if the function identifier resolves to an
     // ahead-of-time function or builtin
     if (node->as.call_expr.function->type == AST_IDENTIFIER) {
-      Symbol *sym = resolve_symbol(
-          analyzer, node->as.call_expr.function->as.identifier.value);
+      Symbol *sym = node->as.call_expr.function->as.identifier.symbol;
       if (sym && sym->type == SYMBOL_FUNCTION) {
         // Check arity
         // For now, struct initialization is parsed as Call Expr! So struct has
@@ -384,6 +458,7 @@ static void analyze_node(SemanticAnalyzer *analyzer, ASTNode *node) {
     if (node->as.new_expr.class_name->type == AST_IDENTIFIER) {
       Symbol *sym = resolve_symbol(
           analyzer, node->as.new_expr.class_name->as.identifier.value);
+      node->as.new_expr.class_name->as.identifier.symbol = sym;
       if (!sym || sym->type != SYMBOL_CLASS) {
         char msg[256];
         snprintf(msg, sizeof(msg), "Cannot instantiate non-class '%s'",
@@ -12,19 +12,24 @@ typedef enum {
   SYMBOL_C_FUNCTION
 } SymbolType;
 
+// Symbols live in compile_arena, so pointers cached in the AST (see
+// IdentifierNode.symbol) stay valid after their scope is left.
 typedef struct Symbol {
-  char *name;
+  char *name;         // interned
   SymbolType type;
   int index;          // Local var index or global var offset
   int arity;          // For functions
   char *value_type;   // Variable type e.g "number"
   char *return_type;  // Func return type
   char **param_types; // Func param types
-  struct Symbol *next;
 } Symbol;
 
+// One scope: an open-addressing table keyed by the interned name pointer,
+// chained to the enclosing scope through `outer`.
 typedef struct SymbolTable {
-  Symbol *symbols;
+  Symbol **slots;     // NULL until the first symbol is defined
+  int capacity;       // power of two
+  int count;
   int local_count;
   int is_function_scope;
   struct SymbolTable *outer;
@@ -83,9 +83,10 @@ typedef enum {
 
 typedef struct {
   TokenType type;
-  char *literal; // Null-terminated string representing the token's text
-  int line;      // Line number for error reporting
-  int column;    // Column number
+  const char *literal; // Token text: a slice of the source, not terminated
+  int length;          // Number of bytes in literal
+  int line;            // Line number for error reporting
+  int column;          // Column number
 } Token;
 
 #endif // TOKEN_H
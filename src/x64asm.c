@@ -0,0 +1,1603 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include "x64asm.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================
+// Buffers and symbols
+// ============================================================
+
+static void buf_reserve(X64Buffer *b, size_t extra) {
+  if (b->size + extra <= b->capacity)
+    return;
+  size_t cap = b->capacity ? b->capacity : 4096;
+  while (cap < b->size + extra)
+    cap *= 2;
+  b->data = realloc(b->data, cap);
+  b->capacity = cap;
+}
+
+static void buf_put(X64Buffer *b, const void *p, size_t n) {
+  if (n == 0) // empty sections pass p == NULL; memcpy must not see it
+    return;
+  buf_reserve(b, n);
+  memcpy(b->data + b->size, p, n);
+  b->size += n;
+}
+
+static void buf_byte(X64Buffer *b, uint8_t v) {
+  buf_reserve(b, 1);
+  b->data[b->size++] = v;
+}
+
+// Little-endian integer of n bytes
+static void buf_le(X64Buffer *b, uint64_t v, int n) {
+  buf_reserve(b, n);
+  for (int i = 0; i < n; i++)
+    b->data[b->size++] = (uint8_t)(v >> (8 * i));
+}
+
+static void patch_le(uint8_t *p, uint64_t v, int n) {
+  for (int i = 0; i < n; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+// A rel32/disp32 field waiting for its symbol. `trailing` counts the
+// immediate bytes that follow the field inside the instruction.
+typedef struct {
+  X64Section section;
+  uint64_t offset;
+  int symbol;
+  int64_t addend;
+  int trailing;
+  X64RelocType type;
+} Fixup;
+
+typedef struct {
+  X64Object *obj;
+  X64Section section;
+  int line;
+  int in_comment; // inside /* ... */ spanning lines
+  int *slots;     // symbol hash: index + 1, 0 = empty
+  int slot_capacity;
+  int symbol_capacity;
+  Fixup *fixups;
+  int fixup_count;
+  int fixup_capacity;
+  int reloc_capacity;
+} Asm;
+
+static int fail(Asm *a, const char *fmt, ...) {
+  int n = snprintf(a->obj->error, sizeof(a->obj->error), "line %d: ", a->line);
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(a->obj->error + n, sizeof(a->obj->error) - n, fmt, ap);
+  va_end(ap);
+  return 0;
+}
+
+static X64Buffer *cur(Asm *a) { return &a->obj->sections[a->section]; }
+
+static uint32_t name_hash(const char *s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int *symbol_slot(Asm *a, const char *name, size_t len) {
+  size_t mask = a->slot_capacity - 1;
+  size_t i = name_hash(name, len) & mask;
+  for (;;) {
+    int *slot = &a->slots[i];
+    if (*slot == 0)
+      return slot;
+    const char *s = a->obj->symbols[*slot - 1].name;
+    if (strncmp(s, name, len) == 0 && s[len] == '\0')
+      return slot;
+    i = (i + 1) & mask;
+  }
+}
+
+// Find or create the symbol `name[0..len)`
+static int symbol_get(Asm *a, const char *name, size_t len) {
+  if (a->obj->symbol_count * 4 >= a->slot_capacity * 3) {
+    int old_capacity = a->slot_capacity;
+    int *old = a->slots;
+    a->slot_capacity = old_capacity ? old_capacity * 2 : 1024;
+    a->slots = calloc(a->slot_capacity, sizeof(int));
+    for (int i = 0; i < old_capacity; i++) {
+      if (old[i]) {
+        const char *s = a->obj->symbols[old[i] - 1].name;
+        *symbol_slot(a, s, strlen(s)) = old[i];
+      }
+    }
+    free(old);
+  }
+
+  int *slot = symbol_slot(a, name, len);
+  if (*slot)
+    return *slot - 1;
+
+  X64Object *obj = a->obj;
+  if (obj->symbol_count == a->symbol_capacity) {
+    a->symbol_capacity = a->symbol_capacity ? a->symbol_capacity * 2 : 256;
+    obj->symbols =
+        realloc(obj->symbols, a->symbol_capacity * sizeof(X64Symbol));
+  }
+  X64Symbol *sym = &obj->symbols[obj->symbol_count];
+  memset(sym, 0, sizeof(*sym));
+  sym->name = malloc(len + 1);
+  memcpy(sym->name, name, len);
+  sym->name[len] = '\0';
+  *slot = ++obj->symbol_count;
+  return obj->symbol_count - 1;
+}
+
+int x64_find_symbol(const X64Object *obj, const char *name) {
+  for (int i = 0; i < obj->symbol_count; i++)
+    if (strcmp(obj->symbols[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+static void add_fixup(Asm *a, int symbol, int64_t addend, int trailing,
+                      X64RelocType type) {
+  if (a->fixup_count == a->fixup_capacity) {
+    a->fixup_capacity = a->fixup_capacity ? a->fixup_capacity * 2 : 256;
+    a->fixups = realloc(a->fixups, a->fixup_capacity * sizeof(Fixup));
+  }
+  Fixup *f = &a->fixups[a->fixup_count++];
+  f->section = a->section;
+  f->offset = cur(a)->size;
+  f->symbol = symbol;
+  f->addend = addend;
+  f->trailing = trailing;
+  f->type = type;
+}
+
+static void add_reloc(Asm *a, X64Section section, uint64_t offset,
+                      X64RelocType type, int symbol, int64_t addend) {
+  X64Object *obj = a->obj;
+  if (obj->reloc_count == a->reloc_capacity) {
+    a->reloc_capacity = a->reloc_capacity ? a->reloc_capacity * 2 : 256;
+    obj->relocs = realloc(obj->relocs, a->reloc_capacity * sizeof(X64Reloc));
+  }
+  X64Symbol *sym = &obj->symbols[symbol];
+  X64Reloc *r = &obj->relocs[obj->reloc_count++];
+  r->section = section;
+  r->offset = offset;
+  r->type = type;
+  r->symbol = symbol;
+  r->target_section = sym->section;
+  r->addend = addend;
+  if (sym->section != X64_UNDEF)
+    r->addend += (int64_t)sym->offset;
+  else
+    sym->is_referenced = 1;
+}
+
+// ============================================================
+// Lexical helpers
+// ============================================================
+
+static int is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static int is_ident(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '.' || c == '$';
+}
+
+static char lower(char c) { return (c >= 'A' && c <= 'Z') ? c + 32 : c; }
+
+// Case-insensitive compare of s[0..len) with the lowercase word `w`
+static int word_eq(const char *s, size_t len, const char *w) {
+  for (size_t i = 0; i < len; i++)
+    if (lower(s[i]) != w[i])
+      return 0;
+  return w[len] == '\0';
+}
+
+static char *trim(char *s) {
+  while (is_space(*s))
+    s++;
+  char *e = s + strlen(s);
+  while (e > s && is_space(e[-1]))
+    *--e = '\0';
+  return s;
+}
+
+// GAS integer syntax: 0x.. hex, 0b.. binary, leading 0 octal, else decimal.
+// Returns 1 when all of s[0..len) is a number.
+static int parse_number(const char *s, size_t len, int64_t *out) {
+  if (len == 0)
+    return 0;
+  uint64_t v = 0;
+  size_t i = 0;
+  int base = 10;
+  if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+    base = 16;
+    i = 2;
+  } else if (len > 2 && s[0] == '0' && (s[1] == 'b' || s[1] == 'B')) {
+    base = 2;
+    i = 2;
+  } else if (len > 1 && s[0] == '0') {
+    base = 8;
+    i = 1;
+  }
+  for (; i < len; i++) {
+    char c = lower(s[i]);
+    int d;
+    if (c >= '0' && c <= '9')
+      d = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      d = c - 'a' + 10;
+    else
+      return 0;
+    if (d >= base)
+      return 0;
+    v = v * base + d;
+  }
+  *out = (int64_t)v;
+  return 1;
+}
+
+// ============================================================
+// Operands
+// ============================================================
+
+#define REG_RIP 16
+
+enum { OP_NONE, OP_REG, OP_IMM, OP_MEM, OP_SYM };
+
+typedef struct {
+  int kind;
+  int size;  // bytes; 0 = unspecified (immediates, memory without ptr)
+  int reg;   // OP_REG
+  int rex8;  // spl/bpl/sil/dil: encodable only with a REX prefix
+  int high8; // ah/ch/dh/bh: encodable only without one
+  int base;  // OP_MEM: -1 none, REG_RIP for rip-relative
+  int index; // -1 none
+  int scale;
+  int64_t value; // immediate, displacement or symbol addend
+  int symbol;    // -1 none
+} Operand;
+
+static const char *const reg64[16] = {"rax", "rcx", "rdx", "rbx",
+                                      "rsp", "rbp", "rsi", "rdi"};
+static const char *const reg32[8] = {"eax", "ecx", "edx", "ebx",
+                                     "esp", "ebp", "esi", "edi"};
+static const char *const reg16[8] = {"ax", "cx", "dx", "bx",
+                                     "sp", "bp", "si", "di"};
+static const char *const reg8[8] = {"al", "cl", "dl", "bl",
+                                    "spl", "bpl", "sil", "dil"};
+static const char *const reg8h[4] = {"ah", "ch", "dh", "bh"};
+
+// Register named s[0..len): fills num/size/flags, returns 1 if found
+static int lookup_reg(const char *s, size_t len, Operand *op) {
+  op->rex8 = op->high8 = 0;
+  if (word_eq(s, len, "rip")) {
+    op->reg = REG_RIP;
+    op->size = 8;
+    return 1;
+  }
+  for (int i = 0; i < 8; i++) {
+    if (word_eq(s, len, reg64[i])) {
+      op->reg = i, op->size = 8;
+      return 1;
+    }
+    if (word_eq(s, len, reg32[i])) {
+      op->reg = i, op->size = 4;
+      return 1;
+    }
+    if (word_eq(s, len, reg16[i])) {
+      op->reg = i, op->size = 2;
+      return 1;
+    }
+    if (word_eq(s, len, reg8[i])) {
+      op->reg = i, op->size = 1, op->rex8 = i >= 4;
+      return 1;
+    }
+    if (i < 4 && word_eq(s, len, reg8h[i])) {
+      op->reg = i + 4, op->size = 1, op->high8 = 1;
+      return 1;
+    }
+  }
+  // r8..r15 with optional d/w/b suffix
+  if (len >= 2 && lower(s[0]) == 'r' && s[1] >= '0' && s[1] <= '9') {
+    size_t i = 1;
+    int n = 0;
+    while (i < len && s[i] >= '0' && s[i] <= '9')
+      n = n * 10 + (s[i++] - '0');
+    if (n < 8 || n > 15)
+      return 0;
+    int size = 8;
+    if (i < len) {
+      char c = lower(s[i++]);
+      size = c == 'd' ? 4 : c == 'w' ? 2 : c == 'b' ? 1 : 0;
+      if (!size || i != len)
+        return 0;
+    }
+    op->reg = n;
+    op->size = size;
+    return 1;
+  }
+  return 0;
+}
+
+// "sym", "sym + 8", "-16", "4*8"... : numbers and at most one symbol
+// combined with + and -. Sets kind to OP_IMM or OP_SYM.
+static int parse_expr(Asm *a, char *s, Operand *op) {
+  op->value = 0;
+  op->symbol = -1;
+  int sign = 1;
+  char *p = s;
+  while (*p) {
+    while (is_space(*p))
+      p++;
+    if (*p == '+' || *p == '-') {
+      if (*p == '-')
+        sign = -sign;
+      p++;
+      continue;
+    }
+    char *start = p;
+    while (is_ident(*p) || *p == '*')
+      p++;
+    size_t len = p - start;
+    if (len == 0)
+      return fail(a, "bad expression '%s'", s);
+    int64_t v;
+    char *star = memchr(start, '*', len);
+    if (star) {
+      int64_t l, r;
+      if (!parse_number(start, star - start, &l) ||
+          !parse_number(star + 1, p - star - 1, &r))
+        return fail(a, "bad expression '%s'", s);
+      op->value += sign * l * r;
+    } else if (parse_number(start, len, &v)) {
+      op->value += sign * v;
+    } else {
+      if (op->symbol >= 0 || sign < 0)
+        return fail(a, "unsupported symbol expression '%s'", s);
+      op->symbol = symbol_get(a, start, len);
+    }
+    sign = 1;
+  }
+  op->kind = op->symbol >= 0 ? OP_SYM : OP_IMM;
+  return 1;
+}
+
+// [base + index*scale + disp] and [rip + sym + disp]
+static int parse_memory(Asm *a, char *s, Operand *op) {
+  op->kind = OP_MEM;
+  op->base = op->index = -1;
+  op->scale = 1;
+  op->value = 0;
+  op->symbol = -1;
+  int sign = 1;
+  char *p = s;
+  while (*p) {
+    while (is_space(*p))
+      p++;
+    if (!*p)
+      break;
+    if (*p == '+' || *p == '-') {
+      if (*p == '-')
+        sign = -sign;
+      p++;
+      continue;
+    }
+    char *start = p;
+    while (is_ident(*p) || *p == '*' || is_space(*p)) {
+      if (is_space(*p)) {
+        // allow "rcx * 8" but stop before the next +/- term
+        char *q = p;
+        while (is_space(*q))
+          q++;
+        if (*q != '*' && (q == p || q[-1] != '*') && !(p > start && p[-1] == '*'))
+          break;
+      }
+      p++;
+    }
+    char term[128];
+    size_t len = p - start;
+    if (len == 0 || len >= sizeof(term))
+      return fail(a, "bad memory operand '[%s]'", s);
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++)
+      if (!is_space(start[i]))
+        term[n++] = start[i];
+    term[n] = '\0';
+
+    Operand r;
+    int64_t v;
+    char *star = strchr(term, '*');
+    if (star) {
+      *star = '\0';
+      const char *reg = term, *num = star + 1;
+      if (!lookup_reg(reg, strlen(reg), &r)) {
+        reg = star + 1;
+        num = term;
+      }
+      if (!lookup_reg(reg, strlen(reg), &r) || r.size != 8 ||
+          !parse_number(num, strlen(num), &v) ||
+          (v != 1 && v != 2 && v != 4 && v != 8) || op->index >= 0 ||
+          sign < 0 || r.reg == 4)
+        return fail(a, "bad index in '[%s]'", s);
+      op->index = r.reg;
+      op->scale = (int)v;
+    } else if (lookup_reg(term, n, &r)) {
+      if (r.size != 8 || sign < 0)
+        return fail(a, "bad register in '[%s]'", s);
+      if (op->base < 0)
+        op->base = r.reg;
+      else if (op->index < 0 && r.reg != 4 && r.reg != REG_RIP)
+        op->index = r.reg;
+      else
+        return fail(a, "too many registers in '[%s]'", s);
+    } else if (parse_number(term, n, &v)) {
+      op->value += sign * v;
+    } else {
+      if (op->symbol >= 0 || sign < 0)
+        return fail(a, "unsupported symbol expression in '[%s]'", s);
+      op->symbol = symbol_get(a, term, n);
+    }
+    sign = 1;
+  }
+  if (op->symbol >= 0 && (op->base != REG_RIP || op->index >= 0))
+    return fail(a, "symbols in memory operands need [rip + sym]");
+  if (op->base == REG_RIP && op->index >= 0)
+    return fail(a, "rip cannot be combined with an index");
+  if (op->value < INT32_MIN || op->value > INT32_MAX)
+    return fail(a, "displacement out of range");
+  return 1;
+}
+
+static int parse_operand(Asm *a, char *s, Operand *op) {
+  memset(op, 0, sizeof(*op));
+  op->base = op->index = op->symbol = -1;
+  s = trim(s);
+
+  static const struct {
+    const char *word;
+    int size;
+  } ptr_sizes[] = {{"byte", 1}, {"word", 2}, {"dword", 4}, {"qword", 8}};
+  int size = 0;
+  for (int i = 0; i < 4; i++) {
+    size_t n = strlen(ptr_sizes[i].word);
+    if (word_eq(s, n, ptr_sizes[i].word) && is_space(s[n])) {
+      char *rest = trim(s + n);
+      if (word_eq(rest, 3, "ptr") && !is_ident(rest[3])) {
+        size = ptr_sizes[i].size;
+        s = trim(rest + 3);
+      }
+      break;
+    }
+  }
+
+  if (*s == '[') {
+    char *end = strchr(s, ']');
+    if (!end || *trim(end + 1))
+      return fail(a, "bad memory operand '%s'", s);
+    *end = '\0';
+    if (!parse_memory(a, s + 1, op))
+      return 0;
+    op->size = size;
+    return 1;
+  }
+  if (size)
+    return fail(a, "'ptr' needs a memory operand");
+  if (lookup_reg(s, strlen(s), op)) {
+    if (op->reg == REG_RIP)
+      return fail(a, "rip is only valid in memory operands");
+    op->kind = OP_REG;
+    return 1;
+  }
+  if (word_eq(s, 6, "offset") && is_space(s[6]))
+    return fail(a, "'offset' is not supported; use lea reg, [rip + sym]");
+  return parse_expr(a, s, op);
+}
+
+// ============================================================
+// Encoding
+// ============================================================
+
+static int fits8(int64_t v) { return v >= -128 && v <= 127; }
+static int fits32(int64_t v) { return v >= INT32_MIN && v <= INT32_MAX; }
+
+// Prefixes, opcode, ModRM/SIB/displacement for `rm` with `regfield` in the
+// reg bits. `regop` (optional) is the register behind `regfield`.
+// `imm_size` immediate bytes follow (written by the caller).
+static int emit_modrm(Asm *a, int size, const uint8_t *opcode, int opcode_len,
+                      int regfield, const Operand *regop, const Operand *rm,
+                      int imm_size) {
+  X64Buffer *b = cur(a);
+  int rex = 0, need_rex = 0, no_rex = 0;
+  if (size == 8)
+    rex |= 8;
+  if (regfield & 8)
+    rex |= 4;
+  if (regop && regop->kind == OP_REG) {
+    need_rex |= regop->rex8;
+    no_rex |= regop->high8;
+  }
+  if (rm->kind == OP_REG) {
+    if (rm->reg & 8)
+      rex |= 1;
+    need_rex |= rm->rex8;
+    no_rex |= rm->high8;
+  } else {
+    if (rm->base >= 0 && rm->base != REG_RIP && (rm->base & 8))
+      rex |= 1;
+    if (rm->index >= 0 && (rm->index & 8))
+      rex |= 2;
+  }
+  if ((rex || need_rex) && no_rex)
+    return fail(a, "ah/bh/ch/dh cannot be used with this operand");
+
+  if (size == 2)
+    buf_byte(b, 0x66);
+  if (rex || need_rex)
+    buf_byte(b, 0x40 | rex);
+  buf_put(b, opcode, opcode_len);
+
+  int reg_bits = (regfield & 7) << 3;
+  if (rm->kind == OP_REG) {
+    buf_byte(b, 0xC0 | reg_bits | (rm->reg & 7));
+    return 1;
+  }
+
+  if (rm->base == REG_RIP) {
+    buf_byte(b, 0x05 | reg_bits);
+    if (rm->symbol >= 0) {
+      add_fixup(a, rm->symbol, rm->value, imm_size, X64_RELOC_PC32);
+      buf_le(b, 0, 4);
+    } else {
+      buf_le(b, (uint32_t)rm->value, 4);
+    }
+    return 1;
+  }
+
+  int scale_bits = rm->scale == 8 ? 3 : rm->scale == 4 ? 2 : rm->scale == 2;
+  if (rm->base < 0) {
+    // absolute [disp32] or [index*scale + disp32]: SIB with no base
+    buf_byte(b, 0x04 | reg_bits);
+    int index = rm->index >= 0 ? rm->index & 7 : 4;
+    buf_byte(b, (scale_bits << 6) | (index << 3) | 5);
+    buf_le(b, (uint32_t)rm->value, 4);
+    return 1;
+  }
+
+  int mod;
+  if (rm->value == 0 && (rm->base & 7) != 5)
+    mod = 0;
+  else if (fits8(rm->value))
+    mod = 1;
+  else
+    mod = 2;
+  if (rm->index >= 0 || (rm->base & 7) == 4) {
+    int index = rm->index >= 0 ? rm->index & 7 : 4;
+    buf_byte(b, (mod << 6) | reg_bits | 4);
+    buf_byte(b, (scale_bits << 6) | (index << 3) | (rm->base & 7));
+  } else {
+    buf_byte(b, (mod << 6) | reg_bits | (rm->base & 7));
+  }
+  if (mod == 1)
+    buf_byte(b, (uint8_t)rm->value);
+  else if (mod == 2)
+    buf_le(b, (uint32_t)rm->value, 4);
+  return 1;
+}
+
+static int is_rm(const Operand *op) {
+  return op->kind == OP_REG || op->kind == OP_MEM;
+}
+
+// Operand size of an instruction from its register/ptr operands
+static int op_size(Asm *a, const Operand *x, const Operand *y) {
+  int sx = x ? x->size : 0, sy = (y && y->kind == OP_REG) ? y->size : 0;
+  if (sx && sy && sx != sy)
+    return fail(a, "operand size mismatch");
+  if (!sx && !sy)
+    return fail(a, "operand size not specified (use byte/word/dword/qword "
+                   "ptr)");
+  return sx ? sx : sy;
+}
+
+// Write an immediate of `size` bytes, checking its range
+static int emit_imm(Asm *a, int64_t v, int size) {
+  if ((size == 1 && (v < -128 || v > 255)) ||
+      (size == 2 && (v < -32768 || v > 65535)) ||
+      (size == 4 && (v < INT32_MIN || v > (int64_t)UINT32_MAX)))
+    return fail(a, "immediate out of range");
+  buf_le(cur(a), (uint64_t)v, size);
+  return 1;
+}
+
+// add/or/adc/sbb/and/sub/xor/cmp: `digit` is the /n of the 0x80 group
+static int enc_alu(Asm *a, int digit, Operand *dst, Operand *src) {
+  if (!is_rm(dst))
+    return fail(a, "invalid destination");
+  if (src->kind == OP_IMM) {
+    int size = op_size(a, dst, NULL);
+    if (!size)
+      return 0;
+    if (size == 1) {
+      uint8_t op = 0x80;
+      return emit_modrm(a, 1, &op, 1, digit, NULL, dst, 1) &&
+             emit_imm(a, src->value, 1);
+    }
+    if (size == 8 && !fits32(src->value))
+      return fail(a, "immediate out of range");
+    int imm = fits8(src->value) ? 1 : (size == 2 ? 2 : 4);
+    uint8_t op = imm == 1 ? 0x83 : 0x81;
+    return emit_modrm(a, size, &op, 1, digit, NULL, dst, imm) &&
+           emit_imm(a, src->value, imm);
+  }
+  if (src->kind == OP_REG) {
+    int size = op_size(a, dst, src);
+    if (!size)
+      return 0;
+    uint8_t op = (uint8_t)(digit * 8 + (size == 1 ? 0 : 1));
+    return emit_modrm(a, size, &op, 1, src->reg, src, dst, 0);
+  }
+  if (src->kind == OP_MEM && dst->kind == OP_REG) {
+    int size = op_size(a, src, dst);
+    if (!size)
+      return 0;
+    uint8_t op = (uint8_t)(digit * 8 + (size == 1 ? 2 : 3));
+    return emit_modrm(a, size, &op, 1, dst->reg, dst, src, 0);
+  }
+  return fail(a, "invalid operands");
+}
+
+static int enc_mov(Asm *a, Operand *dst, Operand *src) {
+  X64Buffer *b = cur(a);
+  if (src->kind == OP_REG && is_rm(dst)) {
+    int size = op_size(a, dst, src);
+    if (!size)
+      return 0;
+    uint8_t op = size == 1 ? 0x88 : 0x89;
+    return emit_modrm(a, size, &op, 1, src->reg, src, dst, 0);
+  }
+  if (src->kind == OP_MEM && dst->kind == OP_REG) {
+    int size = op_size(a, src, dst);
+    if (!size)
+      return 0;
+    uint8_t op = size == 1 ? 0x8A : 0x8B;
+    return emit_modrm(a, size, &op, 1, dst->reg, dst, src, 0);
+  }
+  if (src->kind == OP_IMM && dst->kind == OP_REG && dst->size == 8 &&
+      !fits32(src->value)) {
+    // movabs reg, imm64
+    buf_byte(b, 0x48 | (dst->reg >> 3));
+    buf_byte(b, 0xB8 + (dst->reg & 7));
+    buf_le(b, (uint64_t)src->value, 8);
+    return 1;
+  }
+  if (src->kind == OP_IMM && dst->kind == OP_REG && dst->size != 8) {
+    // B0+r / B8+r with an immediate of the register's size
+    if (dst->size == 2)
+      buf_byte(b, 0x66);
+    if ((dst->reg & 8) || dst->rex8) {
+      if (dst->high8)
+        return fail(a, "invalid register");
+      buf_byte(b, 0x40 | (dst->reg >> 3));
+    }
+    buf_byte(b, (dst->size == 1 ? 0xB0 : 0xB8) + (dst->reg & 7));
+    return emit_imm(a, src->value, dst->size);
+  }
+  if (src->kind == OP_IMM && is_rm(dst)) {
+    int size = op_size(a, dst, NULL);
+    if (!size)
+      return 0;
+    int imm = size == 8 ? 4 : size;
+    if (size == 8 && !fits32(src->value))
+      return fail(a, "immediate out of range");
+    uint8_t op = size == 1 ? 0xC6 : 0xC7;
+    return emit_modrm(a, size, &op, 1, 0, NULL, dst, imm) &&
+           emit_imm(a, src->value, imm);
+  }
+  if (src->kind == OP_SYM)
+    return fail(a, "symbol addresses need lea reg, [rip + sym]");
+  return fail(a, "invalid operands");
+}
+
+// F6/F7 group (not neg mul imul div idiv), FE/FF (inc dec)
+static int enc_unary(Asm *a, uint8_t op8, uint8_t op, int digit, Operand *x) {
+  if (!is_rm(x))
+    return fail(a, "invalid operand");
+  int size = op_size(a, x, NULL);
+  if (!size)
+    return 0;
+  uint8_t opcode = size == 1 ? op8 : op;
+  return emit_modrm(a, size, &opcode, 1, digit, NULL, x, 0);
+}
+
+static int enc_shift(Asm *a, int digit, Operand *x, Operand *count) {
+  if (!is_rm(x))
+    return fail(a, "invalid operand");
+  int size = op_size(a, x, NULL);
+  if (!size)
+    return 0;
+  int byte = size == 1;
+  if (count->kind == OP_REG && count->reg == 1 && count->size == 1) {
+    uint8_t op = byte ? 0xD2 : 0xD3;
+    return emit_modrm(a, size, &op, 1, digit, NULL, x, 0);
+  }
+  if (count->kind != OP_IMM)
+    return fail(a, "shift count must be an immediate or cl");
+  if (count->value == 1) {
+    uint8_t op = byte ? 0xD0 : 0xD1;
+    return emit_modrm(a, size, &op, 1, digit, NULL, x, 0);
+  }
+  uint8_t op = byte ? 0xC0 : 0xC1;
+  return emit_modrm(a, size, &op, 1, digit, NULL, x, 1) &&
+         emit_imm(a, count->value, 1);
+}
+
+// jmp/jcc/call to a label. `short_op` (0 = none) is the rel8 opcode, used
+// when the label is already defined close enough behind us.
+static int enc_branch(Asm *a, const uint8_t *op, int op_len, uint8_t short_op,
+                      Operand *target) {
+  if (target->kind != OP_SYM)
+    return fail(a, "branch target must be a label");
+  X64Buffer *b = cur(a);
+  X64Symbol *sym = &a->obj->symbols[target->symbol];
+  if (short_op && sym->section == a->section) {
+    int64_t rel = (int64_t)sym->offset + target->value - (int64_t)(b->size + 2);
+    if (fits8(rel)) {
+      buf_byte(b, short_op);
+      buf_byte(b, (uint8_t)rel);
+      return 1;
+    }
+  }
+  buf_put(b, op, op_len);
+  add_fixup(a, target->symbol, target->value, 0, X64_RELOC_PLT32);
+  buf_le(b, 0, 4);
+  return 1;
+}
+
+static const struct {
+  const char *name;
+  int cc;
+} conditions[] = {
+    {"o", 0},   {"no", 1},  {"b", 2},   {"c", 2},    {"nae", 2}, {"ae", 3},
+    {"nb", 3},  {"nc", 3},  {"e", 4},   {"z", 4},    {"ne", 5},  {"nz", 5},
+    {"be", 6},  {"na", 6},  {"a", 7},   {"nbe", 7},  {"s", 8},   {"ns", 9},
+    {"p", 10},  {"pe", 10}, {"np", 11}, {"po", 11},  {"l", 12},  {"nge", 12},
+    {"ge", 13}, {"nl", 13}, {"le", 14}, {"ng", 14},  {"g", 15},  {"nle", 15},
+    {NULL, 0}};
+
+static int condition_code(const char *suffix) {
+  for (int i = 0; conditions[i].name; i++)
+    if (strcmp(conditions[i].name, suffix) == 0)
+      return conditions[i].cc;
+  return -1;
+}
+
+// Instructions without operands
+static const struct {
+  const char *name;
+  uint8_t bytes[3];
+  int len;
+} plain_ops[] = {
+    {"ret", {0xC3}, 1},          {"cqo", {0x48, 0x99}, 2},
+    {"cdq", {0x99}, 1},          {"cdqe", {0x48, 0x98}, 2},
+    {"nop", {0x90}, 1},          {"hlt", {0xF4}, 1},
+    {"cli", {0xFA}, 1},          {"sti", {0xFB}, 1},
+    {"leave", {0xC9}, 1},        {"int3", {0xCC}, 1},
+    {"iretq", {0x48, 0xCF}, 2},  {"iret", {0xCF}, 1},
+    {"syscall", {0x0F, 0x05}, 2}, {"pushfq", {0x9C}, 1},
+    {"popfq", {0x9D}, 1},        {"pause", {0xF3, 0x90}, 2},
+    {"ud2", {0x0F, 0x0B}, 2},    {"cpuid", {0x0F, 0xA2}, 2},
+    {"rdtsc", {0x0F, 0x31}, 2},  {"clc", {0xF8}, 1},
+    {"stc", {0xF9}, 1},          {"cld", {0xFC}, 1},
+    {"std", {0xFD}, 1},          {NULL, {0}, 0}};
+
+static int encode(Asm *a, const char *mn, Operand *ops, int n) {
+  X64Buffer *b = cur(a);
+  Operand *x = &ops[0], *y = &ops[1];
+
+  if (n == 0) {
+    for (int i = 0; plain_ops[i].name; i++) {
+      if (strcmp(mn, plain_ops[i].name) == 0) {
+        buf_put(b, plain_ops[i].bytes, plain_ops[i].len);
+        return 1;
+      }
+    }
+  }
+
+  static const char *const alu[] = {"add", "or",  "adc", "sbb",
+                                    "and", "sub", "xor", "cmp"};
+  for (int i = 0; i < 8; i++)
+    if (strcmp(mn, alu[i]) == 0)
+      return n == 2 ? enc_alu(a, i, x, y) : fail(a, "%s needs 2 operands", mn);
+
+  if (strcmp(mn, "mov") == 0)
+    return n == 2 ? enc_mov(a, x, y) : fail(a, "mov needs 2 operands");
+
+  if (strcmp(mn, "lea") == 0) {
+    if (n != 2 || x->kind != OP_REG || y->kind != OP_MEM || x->size < 2)
+      return fail(a, "lea needs reg, [mem]");
+    uint8_t op = 0x8D;
+    return emit_modrm(a, x->size, &op, 1, x->reg, x, y, 0);
+  }
+
+  if (strcmp(mn, "push") == 0 || strcmp(mn, "pop") == 0) {
+    int push = mn[1] == 'u';
+    if (n != 1)
+      return fail(a, "%s needs 1 operand", mn);
+    if (x->kind == OP_REG) {
+      if (x->size != 8)
+        return fail(a, "%s needs a 64-bit register", mn);
+      if (x->reg & 8)
+        buf_byte(b, 0x41);
+      buf_byte(b, (push ? 0x50 : 0x58) + (x->reg & 7));
+      return 1;
+    }
+    if (x->kind == OP_IMM && push) {
+      if (fits8(x->value)) {
+        buf_byte(b, 0x6A);
+        buf_byte(b, (uint8_t)x->value);
+        return 1;
+      }
+      if (!fits32(x->value))
+        return fail(a, "immediate out of range");
+      buf_byte(b, 0x68);
+      buf_le(b, (uint32_t)x->value, 4);
+      return 1;
+    }
+    if (x->kind == OP_MEM) {
+      if (x->size && x->size != 8)
+        return fail(a, "%s needs a qword operand", mn);
+      uint8_t op = push ? 0xFF : 0x8F;
+      return emit_modrm(a, 4, &op, 1, push ? 6 : 0, NULL, x, 0);
+    }
+    return fail(a, "invalid operand");
+  }
+
+  if (strcmp(mn, "test") == 0) {
+    if (n != 2 || !is_rm(x))
+      return fail(a, "invalid operands");
+    if (y->kind == OP_REG) {
+      int size = op_size(a, x, y);
+      if (!size)
+        return 0;
+      uint8_t op = size == 1 ? 0x84 : 0x85;
+      return emit_modrm(a, size, &op, 1, y->reg, y, x, 0);
+    }
+    if (y->kind == OP_IMM) {
+      int size = op_size(a, x, NULL);
+      if (!size)
+        return 0;
+      int imm = size == 8 ? 4 : size;
+      uint8_t op = size == 1 ? 0xF6 : 0xF7;
+      return emit_modrm(a, size, &op, 1, 0, NULL, x, imm) &&
+             emit_imm(a, y->value, imm);
+    }
+    return fail(a, "invalid operands");
+  }
+
+  if (strcmp(mn, "movzx") == 0 || strcmp(mn, "movsx") == 0) {
+    if (n != 2 || x->kind != OP_REG || !is_rm(y))
+      return fail(a, "%s needs reg, r/m", mn);
+    int src = y->size;
+    if (src != 1 && src != 2)
+      return fail(a, "%s source must be byte or word", mn);
+    uint8_t op[2] = {0x0F, (uint8_t)((mn[3] == 'z' ? 0xB6 : 0xBE) +
+                                     (src == 2))};
+    return emit_modrm(a, x->size, op, 2, x->reg, x, y, 0);
+  }
+
+  if (strcmp(mn, "movsxd") == 0) {
+    if (n != 2 || x->kind != OP_REG || x->size != 8 || !is_rm(y) ||
+        (y->size && y->size != 4))
+      return fail(a, "movsxd needs r64, r/m32");
+    uint8_t op = 0x63;
+    return emit_modrm(a, 8, &op, 1, x->reg, x, y, 0);
+  }
+
+  if (strcmp(mn, "imul") == 0) {
+    if (n == 1)
+      return enc_unary(a, 0xF6, 0xF7, 5, x);
+    if (x->kind != OP_REG)
+      return fail(a, "imul destination must be a register");
+    Operand *src = n == 3 || y->kind != OP_IMM ? y : x;
+    Operand *imm = n == 3 ? &ops[2] : (y->kind == OP_IMM ? y : NULL);
+    if (!is_rm(src) || (src->kind == OP_REG && src->size != x->size))
+      return fail(a, "invalid operands");
+    if (!imm) {
+      uint8_t op[2] = {0x0F, 0xAF};
+      return emit_modrm(a, x->size, op, 2, x->reg, x, src, 0);
+    }
+    if (imm->kind != OP_IMM)
+      return fail(a, "invalid operands");
+    int size = fits8(imm->value) ? 1 : (x->size == 2 ? 2 : 4);
+    uint8_t op = size == 1 ? 0x6B : 0x69;
+    return emit_modrm(a, x->size, &op, 1, x->reg, x, src, size) &&
+           emit_imm(a, imm->value, size);
+  }
+
+  static const struct {
+    const char *name;
+    int digit;
+  } unary[] = {{"not", 2}, {"neg", 3}, {"mul", 4}, {"div", 6}, {"idiv", 7},
+               {NULL, 0}};
+  for (int i = 0; unary[i].name; i++)
+    if (strcmp(mn, unary[i].name) == 0)
+      return n == 1 ? enc_unary(a, 0xF6, 0xF7, unary[i].digit, x)
+                    : fail(a, "%s needs 1 operand", mn);
+  if (strcmp(mn, "inc") == 0 || strcmp(mn, "dec") == 0)
+    return n == 1 ? enc_unary(a, 0xFE, 0xFF, mn[0] == 'd', x)
+                  : fail(a, "%s needs 1 operand", mn);
+
+  static const struct {
+    const char *name;
+    int digit;
+  } shifts[] = {{"rol", 0}, {"ror", 1}, {"rcl", 2}, {"rcr", 3}, {"shl", 4},
+                {"sal", 4}, {"shr", 5}, {"sar", 7}, {NULL, 0}};
+  for (int i = 0; shifts[i].name; i++)
+    if (strcmp(mn, shifts[i].name) == 0)
+      return n == 2 ? enc_shift(a, shifts[i].digit, x, y)
+                    : fail(a, "%s needs 2 operands", mn);
+
+  if (strcmp(mn, "jmp") == 0 || strcmp(mn, "call") == 0) {
+    int call = mn[0] == 'c';
+    if (n != 1)
+      return fail(a, "%s needs 1 operand", mn);
+    if (is_rm(x)) {
+      if (x->kind == OP_REG && x->size != 8)
+        return fail(a, "%s needs a 64-bit register", mn);
+      uint8_t op = 0xFF;
+      return emit_modrm(a, 4, &op, 1, call ? 2 : 4, NULL, x, 0);
+    }
+    uint8_t op = call ? 0xE8 : 0xE9;
+    return enc_branch(a, &op, 1, call ? 0 : 0xEB, x);
+  }
+
+  int cc;
+  if (mn[0] == 'j' && (cc = condition_code(mn + 1)) >= 0) {
+    if (n != 1)
+      return fail(a, "%s needs 1 operand", mn);
+    uint8_t op[2] = {0x0F, (uint8_t)(0x80 + cc)};
+    return enc_branch(a, op, 2, (uint8_t)(0x70 + cc), x);
+  }
+  if (strncmp(mn, "set", 3) == 0 && (cc = condition_code(mn + 3)) >= 0) {
+    if (n != 1 || !is_rm(x) || (x->size && x->size != 1))
+      return fail(a, "%s needs a byte operand", mn);
+    uint8_t op[2] = {0x0F, (uint8_t)(0x90 + cc)};
+    return emit_modrm(a, 0, op, 2, 0, NULL, x, 0);
+  }
+  if (strncmp(mn, "cmov", 4) == 0 && (cc = condition_code(mn + 4)) >= 0) {
+    if (n != 2 || x->kind != OP_REG || !is_rm(y) || x->size == 1)
+      return fail(a, "%s needs reg, r/m", mn);
+    uint8_t op[2] = {0x0F, (uint8_t)(0x40 + cc)};
+    return emit_modrm(a, op_size(a, x, y), op, 2, x->reg, x, y, 0);
+  }
+
+  if (strcmp(mn, "int") == 0) {
+    if (n != 1 || x->kind != OP_IMM)
+      return fail(a, "int needs an immediate");
+    buf_byte(b, 0xCD);
+    return emit_imm(a, x->value, 1);
+  }
+
+  // in al/ax/eax, dx|imm8   and   out dx|imm8, al/ax/eax
+  if (strcmp(mn, "in") == 0 || strcmp(mn, "out") == 0) {
+    int in = mn[0] == 'i';
+    Operand *acc = in ? x : y, *port = in ? y : x;
+    if (n != 2 || acc->kind != OP_REG || acc->reg != 0 || acc->size == 8 ||
+        acc->high8)
+      return fail(a, "%s needs al, ax or eax", mn);
+    if (acc->size == 2)
+      buf_byte(b, 0x66);
+    int wide = acc->size != 1;
+    if (port->kind == OP_REG && port->reg == 2 && port->size == 2) {
+      buf_byte(b, (in ? 0xEC : 0xEE) + wide);
+      return 1;
+    }
+    if (port->kind != OP_IMM)
+      return fail(a, "%s port must be dx or an immediate", mn);
+    buf_byte(b, (in ? 0xE4 : 0xE6) + wide);
+    return emit_imm(a, port->value, 1);
+  }
+
+  static const struct {
+    const char *name;
+    int digit;
+  } table_ops[] = {{"sgdt", 0}, {"sidt", 1}, {"lgdt", 2}, {"lidt", 3},
+                   {"invlpg", 7}, {NULL, 0}};
+  for (int i = 0; table_ops[i].name; i++) {
+    if (strcmp(mn, table_ops[i].name) == 0) {
+      if (n != 1 || x->kind != OP_MEM)
+        return fail(a, "%s needs a memory operand", mn);
+      uint8_t op[2] = {0x0F, 0x01};
+      return emit_modrm(a, 0, op, 2, table_ops[i].digit, NULL, x, 0);
+    }
+  }
+
+  return fail(a, "unsupported instruction '%s'", mn);
+}
+
+// ============================================================
+// Directives
+// ============================================================
+
+// .ascii/.asciz string with GAS escapes
+static int emit_string(Asm *a, char **pp, int terminate) {
+  char *p = *pp;
+  X64Buffer *b = cur(a);
+  if (*p != '"')
+    return fail(a, "expected string");
+  p++;
+  while (*p && *p != '"') {
+    char c = *p++;
+    if (c != '\\') {
+      buf_byte(b, (uint8_t)c);
+      continue;
+    }
+    c = *p++;
+    switch (c) {
+    case 'n': buf_byte(b, '\n'); break;
+    case 't': buf_byte(b, '\t'); break;
+    case 'r': buf_byte(b, '\r'); break;
+    case 'b': buf_byte(b, '\b'); break;
+    case 'f': buf_byte(b, '\f'); break;
+    case 'x': {
+      int v = 0, digits = 0;
+      for (;;) {
+        char h = lower(*p);
+        int d = (h >= '0' && h <= '9') ? h - '0'
+                : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : -1;
+        if (d < 0)
+          break;
+        v = (v * 16 + d) & 0xFF;
+        digits++;
+        p++;
+      }
+      buf_byte(b, digits ? (uint8_t)v : 'x');
+      break;
+    }
+    case '\0':
+      return fail(a, "unterminated string");
+    default:
+      if (c >= '0' && c <= '7') {
+        int v = c - '0';
+        for (int i = 0; i < 2 && *p >= '0' && *p <= '7'; i++)
+          v = v * 8 + (*p++ - '0');
+        buf_byte(b, (uint8_t)v);
+      } else {
+        buf_byte(b, (uint8_t)c); // \\, \" and unknown escapes
+      }
+    }
+  }
+  if (*p != '"')
+    return fail(a, "unterminated string");
+  if (terminate)
+    buf_byte(b, 0);
+  *pp = p + 1;
+  return 1;
+}
+
+static int set_section(Asm *a, const char *name) {
+  if (strcmp(name, ".text") == 0)
+    a->section = X64_TEXT;
+  else if (strcmp(name, ".data") == 0 || strcmp(name, ".rodata") == 0)
+    a->section = X64_DATA;
+  else if (strncmp(name, ".note.GNU-stack", 15) == 0)
+    return 1; // always emitted by the ELF writer
+  else
+    return fail(a, "unsupported section '%s'", name);
+  return 1;
+}
+
+// Split s at top-level commas (outside brackets and quotes) in place
+static int split_operands(char *s, char **parts, int max) {
+  int n = 0, depth = 0, quoted = 0;
+  s = trim(s);
+  if (!*s)
+    return 0;
+  parts[n++] = s;
+  for (char *p = s; *p; p++) {
+    if (*p == '"' && (p == s || p[-1] != '\\'))
+      quoted = !quoted;
+    else if (!quoted && *p == '[')
+      depth++;
+    else if (!quoted && *p == ']')
+      depth--;
+    else if (!quoted && depth == 0 && *p == ',') {
+      *p = '\0';
+      if (n == max)
+        return -1;
+      parts[n++] = p + 1;
+    }
+  }
+  return n;
+}
+
+static int directive(Asm *a, const char *name, char *args) {
+  X64Buffer *b = cur(a);
+  if (strcmp(name, ".intel_syntax") == 0) {
+    if (!word_eq(args, strlen(args), "noprefix"))
+      return fail(a, "only .intel_syntax noprefix is supported");
+    return 1;
+  }
+  if (strcmp(name, ".text") == 0 || strcmp(name, ".data") == 0)
+    return set_section(a, name);
+  if (strcmp(name, ".section") == 0) {
+    char *comma = strchr(args, ',');
+    if (comma)
+      *comma = '\0';
+    return set_section(a, trim(args));
+  }
+  if (strcmp(name, ".global") == 0 || strcmp(name, ".globl") == 0) {
+    char *parts[16];
+    int n = split_operands(args, parts, 16);
+    for (int i = 0; i < n; i++) {
+      char *s = trim(parts[i]);
+      int sym = symbol_get(a, s, strlen(s)); // may move the symbol array
+      a->obj->symbols[sym].is_global = 1;
+    }
+    return n > 0 ? 1 : fail(a, "%s needs a symbol", name);
+  }
+  if (strcmp(name, ".extern") == 0 || strcmp(name, ".type") == 0 ||
+      strcmp(name, ".size") == 0 || strcmp(name, ".file") == 0)
+    return 1; // undefined symbols are external anyway
+  if (strcmp(name, ".ascii") == 0 || strcmp(name, ".asciz") == 0 ||
+      strcmp(name, ".string") == 0) {
+    char *p = trim(args);
+    for (;;) {
+      if (!emit_string(a, &p, strcmp(name, ".ascii") != 0))
+        return 0;
+      p = trim(p);
+      if (*p != ',')
+        break;
+      p = trim(p + 1);
+    }
+    return *p ? fail(a, "junk after string") : 1;
+  }
+  int width = strcmp(name, ".byte") == 0                                  ? 1
+              : strcmp(name, ".word") == 0 || strcmp(name, ".short") == 0 ? 2
+              : strcmp(name, ".long") == 0 || strcmp(name, ".int") == 0   ? 4
+              : strcmp(name, ".quad") == 0                                ? 8
+                                                                          : 0;
+  if (width) {
+    char *parts[64];
+    int n = split_operands(args, parts, 64);
+    if (n <= 0)
+      return fail(a, "%s needs values", name);
+    for (int i = 0; i < n; i++) {
+      Operand v;
+      if (!parse_expr(a, trim(parts[i]), &v))
+        return 0;
+      if (v.kind == OP_SYM) {
+        if (width != 8)
+          return fail(a, "symbol values need .quad");
+        add_fixup(a, v.symbol, v.value, 0, X64_RELOC_ABS64);
+        buf_le(b, 0, 8);
+      } else if (width == 8) {
+        buf_le(b, (uint64_t)v.value, 8);
+      } else if (!emit_imm(a, v.value, width)) {
+        return 0;
+      }
+    }
+    return 1;
+  }
+  if (strcmp(name, ".zero") == 0 || strcmp(name, ".space") == 0 ||
+      strcmp(name, ".skip") == 0) {
+    int64_t n;
+    char *s = trim(args);
+    if (!parse_number(s, strlen(s), &n) || n < 0)
+      return fail(a, "%s needs a size", name);
+    buf_reserve(b, (size_t)n);
+    memset(b->data + b->size, 0, (size_t)n);
+    b->size += (size_t)n;
+    return 1;
+  }
+  if (strcmp(name, ".align") == 0 || strcmp(name, ".balign") == 0 ||
+      strcmp(name, ".p2align") == 0) {
+    int64_t n;
+    char *comma = strchr(args, ',');
+    if (comma)
+      *comma = '\0';
+    char *s = trim(args);
+    if (!parse_number(s, strlen(s), &n) || n < 0 || n > 4096)
+      return fail(a, "%s needs an alignment", name);
+    if (name[1] == 'p')
+      n = (int64_t)1 << n;
+    if (n & (n - 1))
+      return fail(a, "alignment must be a power of two");
+    while (n && b->size % n)
+      buf_byte(b, a->section == X64_TEXT ? 0x90 : 0);
+    return 1;
+  }
+  return fail(a, "unsupported directive '%s'", name);
+}
+
+// ============================================================
+// Driver
+// ============================================================
+
+static int define_label(Asm *a, const char *name, size_t len) {
+  int index = symbol_get(a, name, len);
+  X64Symbol *sym = &a->obj->symbols[index];
+  if (sym->section != X64_UNDEF)
+    return fail(a, "symbol '%s' is already defined", sym->name);
+  sym->section = a->section;
+  sym->offset = cur(a)->size;
+  return 1;
+}
+
+static int statement(Asm *a, char *s) {
+  s = trim(s);
+  // Labels ("name:") may precede a statement on the same line
+  for (;;) {
+    char *p = s;
+    while (is_ident(*p))
+      p++;
+    if (p == s || *p != ':')
+      break;
+    if (!define_label(a, s, p - s))
+      return 0;
+    s = trim(p + 1);
+  }
+  if (!*s)
+    return 1;
+
+  char *p = s;
+  while (is_ident(*p))
+    p++;
+  size_t len = p - s;
+  if (len == 0 || len > 15)
+    return fail(a, "syntax error near '%s'", s);
+  char mn[16];
+  for (size_t i = 0; i < len; i++)
+    mn[i] = lower(s[i]);
+  mn[len] = '\0';
+  if (*p && !is_space(*p))
+    return fail(a, "syntax error near '%s'", s);
+
+  if (mn[0] == '.') {
+    memcpy(mn, s, len); // directive names keep their case
+    return directive(a, mn, trim(p));
+  }
+
+  char *parts[3];
+  int n = split_operands(p, parts, 3);
+  if (n < 0)
+    return fail(a, "too many operands");
+  Operand ops[3];
+  for (int i = 0; i < n; i++)
+    if (!parse_operand(a, parts[i], &ops[i]))
+      return 0;
+  return encode(a, mn, ops, n);
+}
+
+// Strip comments (//, #, /* */) outside strings, then run each
+// ';'-separated statement
+static int assemble_line(Asm *a, char *line) {
+  char *out = line;
+  int quoted = 0;
+  for (char *p = line; *p; p++) {
+    if (a->in_comment) {
+      if (p[0] == '*' && p[1] == '/') {
+        a->in_comment = 0;
+        p++;
+        *out++ = ' ';
+      }
+      continue;
+    }
+    if (quoted) {
+      if (*p == '\\' && p[1]) {
+        *out++ = *p++;
+      } else if (*p == '"') {
+        quoted = 0;
+      }
+      *out++ = *p;
+      continue;
+    }
+    if (*p == '"') {
+      quoted = 1;
+    } else if (p[0] == '/' && p[1] == '*') {
+      a->in_comment = 1;
+      p++;
+      continue;
+    } else if ((p[0] == '/' && p[1] == '/') || *p == '#') {
+      break;
+    }
+    *out++ = *p;
+  }
+  *out = '\0';
+
+  // ';' separates statements (as in GAS for x86)
+  char *s = line;
+  for (;;) {
+    char *end = s;
+    int q = 0;
+    while (*end && (q || *end != ';')) {
+      if (*end == '"' && (end == s || end[-1] != '\\'))
+        q = !q;
+      end++;
+    }
+    int last = *end == '\0';
+    *end = '\0';
+    if (!statement(a, s))
+      return 0;
+    if (last)
+      return 1;
+    s = end + 1;
+  }
+}
+
+static int resolve_fixups(Asm *a) {
+  X64Object *obj = a->obj;
+  for (int i = 0; i < a->fixup_count; i++) {
+    Fixup *f = &a->fixups[i];
+    X64Symbol *sym = &obj->symbols[f->symbol];
+    uint8_t *field = obj->sections[f->section].data + f->offset;
+    if (f->type == X64_RELOC_ABS64) {
+      add_reloc(a, f->section, f->offset, X64_RELOC_ABS64, f->symbol,
+                f->addend);
+      continue;
+    }
+    // rel32 is measured from the end of the instruction
+    int64_t end = (int64_t)f->offset + 4 + f->trailing;
+    if (sym->section == f->section) {
+      int64_t rel = (int64_t)sym->offset + f->addend - end;
+      if (!fits32(rel)) {
+        a->line = 0;
+        return fail(a, "branch to '%s' out of range", sym->name);
+      }
+      patch_le(field, (uint64_t)rel, 4);
+    } else {
+      X64RelocType type = sym->section == X64_UNDEF ? f->type : X64_RELOC_PC32;
+      add_reloc(a, f->section, f->offset, type, f->symbol,
+                f->addend - 4 - f->trailing);
+    }
+  }
+  return 1;
+}
+
+int x64_assemble(X64Object *obj, const char *source, size_t len) {
+  Asm a;
+  memset(&a, 0, sizeof(a));
+  a.obj = obj;
+  a.section = X64_TEXT;
+
+  int ok = 1;
+  char small[256];
+  char *line = small;
+  size_t line_capacity = sizeof(small);
+  size_t pos = 0;
+  while (ok && pos < len) {
+    size_t end = pos;
+    while (end < len && source[end] != '\n')
+      end++;
+    size_t n = end - pos;
+    if (n + 1 > line_capacity) {
+      line_capacity = n + 1;
+      line = line == small ? malloc(line_capacity)
+                           : realloc(line, line_capacity);
+    }
+    memcpy(line, source + pos, n);
+    line[n] = '\0';
+    a.line++;
+    ok = assemble_line(&a, line);
+    pos = end + 1;
+  }
+  if (line != small)
+    free(line);
+
+  ok = ok && resolve_fixups(&a);
+  free(a.slots);
+  free(a.fixups);
+  return ok;
+}
+
+void x64_free(X64Object *obj) {
+  for (int i = 0; i < X64_SECTION_COUNT; i++)
+    free(obj->sections[i].data);
+  for (int i = 0; i < obj->symbol_count; i++)
+    free(obj->symbols[i].name);
+  free(obj->symbols);
+  free(obj->relocs);
+  memset(obj, 0, sizeof(*obj));
+}
+
+// ============================================================
+// ELF64 relocatable object
+// ============================================================
+
+enum {
+  SHN_TEXT = 1,
+  SHN_DATA,
+  SHN_RELA_TEXT,
+  SHN_RELA_DATA,
+  SHN_SYMTAB,
+  SHN_STRTAB,
+  SHN_SHSTRTAB,
+  SHN_NOTE_STACK,
+  SHN_COUNT
+};
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHF_WRITE 1
+#define SHF_ALLOC 2
+#define SHF_EXECINSTR 4
+#define SHF_INFO_LINK 0x40
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_SECTION 3
+
+typedef struct {
+  uint32_t name, type;
+  uint64_t flags, offset, size;
+  uint32_t link, info;
+  uint64_t align, entsize;
+} SectionHeader;
+
+static void put_symbol(X64Buffer *b, uint32_t name, int bind, int type,
+                       uint16_t shndx, uint64_t value) {
+  buf_le(b, name, 4);
+  buf_byte(b, (uint8_t)((bind << 4) | type));
+  buf_byte(b, 0);
+  buf_le(b, shndx, 2);
+  buf_le(b, value, 8);
+  buf_le(b, 0, 8);
+}
+
+static void put_relocs(X64Buffer *b, const X64Object *obj, X64Section section,
+                       const int *elf_index) {
+  static const uint32_t elf_type[] = {1, 2, 4}; // R_X86_64_64, PC32, PLT32
+  for (int i = 0; i < obj->reloc_count; i++) {
+    const X64Reloc *r = &obj->relocs[i];
+    if (r->section != section)
+      continue;
+    uint64_t sym = r->target_section == X64_TEXT   ? 1
+                   : r->target_section == X64_DATA ? 2
+                                                   : elf_index[r->symbol];
+    buf_le(b, r->offset, 8);
+    buf_le(b, (sym << 32) | elf_type[r->type], 8);
+    buf_le(b, (uint64_t)r->addend, 8);
+  }
+}
+
+static void align_to(X64Buffer *b, size_t n) {
+  while (b->size % n)
+    buf_byte(b, 0);
+}
+
+int x64_write_elf(const X64Object *obj, const char *path) {
+  X64Buffer file = {0}, symtab = {0}, strtab = {0};
+  int *elf_index = calloc(obj->symbol_count + 1, sizeof(int));
+  if (!elf_index)
+    return 0;
+
+  // Symbols: null, the two section symbols, locals, then globals. .L
+  // labels stay out of the table, as with GAS.
+  buf_byte(&strtab, 0);
+  put_symbol(&symtab, 0, 0, 0, 0, 0);
+  put_symbol(&symtab, 0, STB_LOCAL, STT_SECTION, SHN_TEXT, 0);
+  put_symbol(&symtab, 0, STB_LOCAL, STT_SECTION, SHN_DATA, 0);
+  int count = 3;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < obj->symbol_count; i++) {
+      const X64Symbol *s = &obj->symbols[i];
+      int defined = s->section != X64_UNDEF;
+      int global = s->is_global || !defined;
+      if (pass != global || (!defined && !s->is_referenced) ||
+          (defined && !s->is_global && strncmp(s->name, ".L", 2) == 0))
+        continue;
+      elf_index[i] = count++;
+      put_symbol(&symtab, (uint32_t)strtab.size,
+                 global ? STB_GLOBAL : STB_LOCAL, STT_NOTYPE,
+                 s->section == X64_TEXT   ? SHN_TEXT
+                 : s->section == X64_DATA ? SHN_DATA
+                                          : 0,
+                 s->offset);
+      buf_put(&strtab, s->name, strlen(s->name) + 1);
+    }
+    if (pass == 0)
+      elf_index[obj->symbol_count] = count; // first global
+  }
+
+  static const char shstrtab[] = "\0.text\0.data\0.rela.text\0.rela.data\0"
+                                 ".symtab\0.strtab\0.shstrtab\0"
+                                 ".note.GNU-stack";
+  static const uint32_t shname[SHN_COUNT] = {0, 1, 7, 13, 24, 35, 43, 51, 61};
+
+  SectionHeader sh[SHN_COUNT];
+  memset(sh, 0, sizeof(sh));
+  buf_reserve(&file, 64);
+  memset(file.data, 0, 64);
+  file.size = 64;
+
+  align_to(&file, 16);
+  sh[SHN_TEXT] = (SectionHeader){shname[SHN_TEXT], SHT_PROGBITS,
+                                 SHF_ALLOC | SHF_EXECINSTR, file.size,
+                                 obj->sections[X64_TEXT].size, 0, 0, 16, 0};
+  buf_put(&file, obj->sections[X64_TEXT].data, obj->sections[X64_TEXT].size);
+
+  align_to(&file, 8);
+  sh[SHN_DATA] = (SectionHeader){shname[SHN_DATA], SHT_PROGBITS,
+                                 SHF_ALLOC | SHF_WRITE, file.size,
+                                 obj->sections[X64_DATA].size, 0, 0, 8, 0};
+  buf_put(&file, obj->sections[X64_DATA].data, obj->sections[X64_DATA].size);
+
+  for (int s = 0; s < 2; s++) {
+    int shn = s == 0 ? SHN_RELA_TEXT : SHN_RELA_DATA;
+    align_to(&file, 8);
+    size_t start = file.size;
+    put_relocs(&file, obj, s == 0 ? X64_TEXT : X64_DATA, elf_index);
+    sh[shn] = (SectionHeader){shname[shn], SHT_RELA, SHF_INFO_LINK, start,
+                              file.size - start, SHN_SYMTAB,
+                              s == 0 ? SHN_TEXT : SHN_DATA, 8, 24};
+  }
+
+  align_to(&file, 8);
+  sh[SHN_SYMTAB] = (SectionHeader){shname[SHN_SYMTAB], SHT_SYMTAB, 0,
+                                   file.size, symtab.size, SHN_STRTAB,
+                                   (uint32_t)elf_index[obj->symbol_count], 8,
+                                   24};
+  buf_put(&file, symtab.data, symtab.size);
+
+  sh[SHN_STRTAB] = (SectionHeader){shname[SHN_STRTAB], SHT_STRTAB, 0,
+                                   file.size, strtab.size, 0, 0, 1, 0};
+  buf_put(&file, strtab.data, strtab.size);
+
+  sh[SHN_SHSTRTAB] = (SectionHeader){shname[SHN_SHSTRTAB], SHT_STRTAB, 0,
+                                     file.size, sizeof(shstrtab), 0, 0, 1, 0};
+  buf_put(&file, shstrtab, sizeof(shstrtab));
+
+  sh[SHN_NOTE_STACK] = (SectionHeader){shname[SHN_NOTE_STACK], SHT_PROGBITS,
+                                       0, file.size, 0, 0, 0, 1, 0};
+
+  align_to(&file, 8);
+  uint64_t shoff = file.size;
+  for (int i = 0; i < SHN_COUNT; i++) {
+    buf_le(&file, sh[i].name, 4);
+    buf_le(&file, sh[i].type, 4);
+    buf_le(&file, sh[i].flags, 8);
+    buf_le(&file, 0, 8); // addr
+    buf_le(&file, sh[i].offset, 8);
+    buf_le(&file, sh[i].size, 8);
+    buf_le(&file, sh[i].link, 4);
+    buf_le(&file, sh[i].info, 4);
+    buf_le(&file, sh[i].align, 8);
+    buf_le(&file, sh[i].entsize, 8);
+  }
+
+  // ELF header
+  static const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 2, 1, 1, 0};
+  uint8_t *h = file.data;
+  memcpy(h, ident, 16);
+  patch_le(h + 16, 1, 2);  // ET_REL
+  patch_le(h + 18, 62, 2); // EM_X86_64
+  patch_le(h + 20, 1, 4);  // EV_CURRENT
+  patch_le(h + 40, shoff, 8);
+  patch_le(h + 52, 64, 2); // e_ehsize
+  patch_le(h + 58, 64, 2); // e_shentsize
+  patch_le(h + 60, SHN_COUNT, 2);
+  patch_le(h + 62, SHN_SHSTRTAB, 2);
+
+  FILE *out = fopen(path, "wb");
+  int ok = out && fwrite(file.data, 1, file.size, out) == file.size;
+  if (out)
+    ok = fclose(out) == 0 && ok;
+
+  free(file.data);
+  free(symtab.data);
+  free(strtab.data);
+  free(elf_index);
+  return ok;
+}
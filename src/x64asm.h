@@ -0,0 +1,70 @@
+#ifndef X64ASM_H
+#define X64ASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// In-process assembler for the Intel-syntax (noprefix) subset that codegen
+// emits, plus the common instructions found in `asm { }` blocks. Text is
+// encoded straight into section buffers; references that cannot be resolved
+// inside one section become relocations, so the result can be written as a
+// relocatable ELF object (x64_write_elf) or loaded in-process.
+//
+// Jumps to labels that are already defined use the short form when the
+// target is in range; all other branches use rel32.
+
+typedef enum { X64_UNDEF, X64_TEXT, X64_DATA, X64_SECTION_COUNT } X64Section;
+
+typedef enum {
+  X64_RELOC_ABS64, // R_X86_64_64: .quad sym
+  X64_RELOC_PC32,  // R_X86_64_PC32: [rip + sym]
+  X64_RELOC_PLT32  // R_X86_64_PLT32: call/jmp sym
+} X64RelocType;
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+  size_t capacity;
+} X64Buffer;
+
+typedef struct {
+  char *name;
+  X64Section section; // X64_UNDEF until the label is defined
+  uint64_t offset;
+  int is_global;     // .global / .globl
+  int is_referenced; // used by an unresolved relocation
+} X64Symbol;
+
+// Against `symbol` when it is undefined, otherwise against the start of
+// `target_section` with the symbol's offset folded into `addend`.
+typedef struct {
+  X64Section section; // section holding the field
+  uint64_t offset;    // of the field within `section`
+  X64RelocType type;
+  int symbol;
+  X64Section target_section;
+  int64_t addend;
+} X64Reloc;
+
+typedef struct {
+  X64Buffer sections[X64_SECTION_COUNT]; // [X64_UNDEF] unused
+  X64Symbol *symbols;
+  int symbol_count;
+  X64Reloc *relocs;
+  int reloc_count;
+  char error[256]; // "line N: ..." after a failed x64_assemble
+} X64Object;
+
+// Assemble `len` bytes of source into `obj` (zero-initialise it first).
+// Returns 1 on success, 0 with obj->error set; x64_free `obj` either way.
+int x64_assemble(X64Object *obj, const char *source, size_t len);
+
+// Symbol index by name, -1 when absent.
+int x64_find_symbol(const X64Object *obj, const char *name);
+
+// Write `obj` as an ELF64 relocatable object. Returns 1 on success.
+int x64_write_elf(const X64Object *obj, const char *path);
+
+void x64_free(X64Object *obj);
+
+#endif // X64ASM_H
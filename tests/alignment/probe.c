@@ -0,0 +1,18 @@
+// C side of tests/alignment/calls.stola (tests/check_alignment.sh). The
+// script binds these with c_function, so every call goes through generated
+// code and then stola_invoke_c_function.
+#include <stdint.h>
+#include <stdio.h>
+
+static int64_t misaligned;
+
+// Built with frame pointers: RBP is 16-byte aligned exactly when RSP was at
+// the call. printf with a double then runs glibc's SSE register spills.
+int64_t sonda(int64_t x) {
+  if ((uintptr_t)__builtin_frame_address(0) % 16 != 0)
+    misaligned++;
+  printf("%.2f\n", (double)x / 4);
+  return x;
+}
+
+int64_t desalineadas(void) { return misaligned; }
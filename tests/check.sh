@@ -0,0 +1,19 @@
+#!/bin/sh
+# Full test run (`make check`): every tests/test_*.stola, compiled and
+# linked with the runtime, then every tests/check_*.sh script.
+. tests/lib.sh
+
+for f in tests/test_*.stola; do
+  name=$(basename "$f" .stola)
+  if ! build "$f" "$T/$name"; then fail "$name no compila"; continue; fi
+  out=$("$T/$name" 2>&1); rc=$?
+  echo "$out" | grep -E '^(PASS|FAIL)'
+  if [ $rc -ne 0 ] || echo "$out" | grep -q FAIL; then fail "$name"; fi
+done
+for c in tests/check_*.sh; do
+  echo "== $c"
+  sh "$c" || fail "$c"
+done
+rm -rf .stola_cache
+echo "$failures fallo(s)"
+finish
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Stack alignment at call sites: tests/alignment/calls.stola calls into
+# tests/alignment/probe.c, which counts calls that arrive with RSP off 16
+# bytes and prints doubles with printf. torcido() holds an asm block, so its
+# unit must fall back to run-time realignment and every other unit must not.
+. tests/lib.sh
+
+$CC -O0 -fno-omit-frame-pointer -c tests/alignment/probe.c -o "$T/probe.o" ||
+  { fail "tests/alignment/probe.c no compila"; finish; exit; }
+$S tests/alignment/calls.stola "$T/calls.s" >"$T/s.log" 2>&1 ||
+  { cat "$T/s.log"; fail "calls.stola no compila"; finish; exit; }
+
+total=$(grep -c 'and rsp, -16' "$T/calls.s")
+torcido=$(awk '/^torcido:/,/epilogue: torcido/' "$T/calls.s" |
+  grep -c 'and rsp, -16')
+if [ "$torcido" -gt 0 ] && [ "$torcido" -eq "$total" ]; then
+  pass "solo la unidad con asm se realinea en tiempo de ejecucion"
+else
+  fail "realineado en tiempo de ejecucion: $torcido en torcido, $total en total"
+fi
+
+objs=$(runtime_objs) || { fail "runtime no compila"; finish; exit; }
+$CC "$T/calls.s" "$T/probe.o" $objs $LIBS -o "$T/calls" 2>"$T/ld.log" ||
+  { cat "$T/ld.log"; fail "calls no enlaza"; finish; exit; }
+"$T/calls" >"$T/calls.out" 2>&1
+if [ $? -eq 0 ] && cmp -s "$T/calls.out" tests/alignment/calls.expected; then
+  pass "llamadas anidadas alineadas (printf con double)"
+else
+  diff tests/alignment/calls.expected "$T/calls.out" | head -20
+  fail "llamadas anidadas alineadas"
+fi
+finish
@@ -0,0 +1,22 @@
+#!/bin/sh
+# test_io_engine.stola under each I/O engine: STOLA_IO_ENGINE=io_uring must
+# report io_uring where the kernel has it, and =epoll must fall back.
+. tests/lib.sh
+
+build tests/test_io_engine.stola "$T/io" || { fail "test_io_engine no compila"; finish; exit; }
+for engine in io_uring epoll; do
+  out=$(STOLA_IO_ENGINE=$engine "$T/io" 2>&1)
+  motor=$(echo "$out" | sed -n 's/^motor: //p')
+  if [ "$engine" = io_uring ] && [ "$motor" = epoll ]; then
+    skip "io_uring no disponible en este kernel"
+    continue
+  fi
+  if [ "$motor" != "$engine" ]; then
+    fail "STOLA_IO_ENGINE=$engine activó '$motor'"
+  elif echo "$out" | grep -q FAIL || [ "$(echo "$out" | grep -c PASS)" -ne 3 ]; then
+    echo "$out"; fail "test_io_engine con $engine"
+  else
+    pass "test_io_engine con $engine"
+  fi
+done
+finish
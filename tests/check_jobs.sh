@@ -0,0 +1,20 @@
+#!/bin/sh
+# Parallel code generation must not change the output: every test program
+# is compiled with -j 1 and -j 8 (without the module cache) and the two .s
+# files are compared byte for byte.
+. tests/lib.sh
+
+for f in tests/*.stola tests/*/*.stola; do
+  name=$(echo "$f" | sed 's|^tests/||; s|/|_|g; s|\.stola$||')
+  if ! $S --no-cache -j 1 "$f" "$T/$name.j1.s" >"$T/s.log" 2>&1 ||
+     ! $S --no-cache -j 8 "$f" "$T/$name.j8.s" >"$T/s.log" 2>&1; then
+    cat "$T/s.log"
+    fail "$name no compila"
+  elif cmp -s "$T/$name.j1.s" "$T/$name.j8.s"; then
+    pass "-j 1 / -j 8 $name"
+  else
+    diff "$T/$name.j1.s" "$T/$name.j8.s" | head -20
+    fail "-j 1 / -j 8 $name"
+  fi
+done
+finish
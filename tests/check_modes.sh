@@ -0,0 +1,39 @@
+#!/bin/sh
+# Output modes must agree: every tests/test_*.stola is built through the
+# .s path and through the built-in assembler (-c -o x.o), both are linked
+# with the runtime, and it is also run in-process with `s run`; all three
+# must print the same thing.
+. tests/lib.sh
+
+# `s run` loads the runtime from STOLA_RUNTIME
+$CC -O2 -fPIC -shared -o "$T/libstola.so" src/runtime.c src/builtins.c \
+  -lpthread -ldl -lm || { fail "libstola.so no compila"; finish; exit; }
+export STOLA_RUNTIME="$T/libstola.so"
+
+for f in tests/test_*.stola; do
+  name=$(basename "$f" .stola)
+  if ! build "$f" "$T/$name"; then fail "$name no compila (.s)"; continue; fi
+  if ! $S -c -o "$T/$name.o" "$f" >"$T/s.log" 2>&1; then
+    cat "$T/s.log"
+    fail "$name no compila (-c)"
+    continue
+  fi
+  if ! link "$T/$name.obj" "$T/$name.o"; then fail "$name no enlaza (-c)"; continue; fi
+  "$T/$name" >"$T/$name.want" 2>/dev/null
+  "$T/$name.obj" >"$T/$name.got" 2>/dev/null
+  if cmp -s "$T/$name.want" "$T/$name.got"; then
+    pass "-c $name"
+  else
+    diff "$T/$name.want" "$T/$name.got" | head -20
+    fail "-c $name"
+  fi
+  # Compiler warnings go to stderr, which is not compared here
+  $S run "$f" >"$T/$name.run" 2>"$T/$name.err"
+  if cmp -s "$T/$name.want" "$T/$name.run"; then
+    pass "run $name"
+  else
+    diff "$T/$name.want" "$T/$name.run" | head -20
+    fail "run $name"
+  fi
+done
+finish
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Golden cases for the peephole pass (src/peephole.c): every
+# tests/peephole/<case>.s is run through the pass and compared with
+# <case>.expected, or with itself when there is none (nothing may change).
+. tests/lib.sh
+
+$CC -O2 -o "$T/filter" tests/peephole/filter.c src/peephole.c ||
+  { fail "tests/peephole/filter.c no compila"; finish; exit; }
+for f in tests/peephole/*.s; do
+  name=$(basename "$f" .s)
+  want=tests/peephole/$name.expected
+  [ -f "$want" ] || want=$f
+  "$T/filter" <"$f" >"$T/$name.out"
+  if cmp -s "$T/$name.out" "$want"; then
+    pass "peephole $name"
+  else
+    diff "$want" "$T/$name.out"
+    fail "peephole $name"
+  fi
+done
+finish
@@ -0,0 +1,36 @@
+# Shared helpers for tests/check*.sh.  Run from the repository root after
+# `make`; S and CC override the compiler and the C compiler used to link.
+S=${S:-./s}
+CC=${CC:-gcc}
+LIBS="-lpthread -ldl -rdynamic -lm"
+T=$(mktemp -d)
+trap 'rm -rf "$T"' EXIT
+failures=0
+
+pass() { echo "PASS: $*"; }
+fail() { echo "FAIL: $*"; failures=$((failures + 1)); }
+skip() { echo "SKIP: $*"; }
+
+# runtime.o / builtins.o, compiled once per script
+runtime_objs() {
+  if [ ! -f "$T/builtins.o" ]; then
+    $CC -O2 -c src/runtime.c -o "$T/runtime.o" &&
+    $CC -O2 -c src/builtins.c -o "$T/builtins.o" || return 1
+  fi
+  echo "$T/runtime.o $T/builtins.o"
+}
+
+# link <exe> <input.s|input.o>: link generated code with the runtime
+link() {
+  objs=$(runtime_objs) || return 1
+  $CC "$2" $objs $LIBS -o "$1" 2>"$T/ld.log" || { cat "$T/ld.log"; return 1; }
+}
+
+# build <file.stola> <exe>: compile to assembly and link
+build() {
+  $S "$1" "$2.s" >"$T/s.log" 2>&1 || { cat "$T/s.log"; return 1; }
+  link "$2" "$2.s"
+}
+
+# Exit status of a check script: 0 if nothing failed
+finish() { [ "$failures" -eq 0 ]; }
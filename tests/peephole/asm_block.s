@@ -0,0 +1,17 @@
+# the body of an asm { } block is copied as written; the same code outside
+# it is optimized
+f:
+    /* asm block */
+    push rax
+    pop rbx
+    pop rcx
+    push rcx
+    mov rcx, 5
+    add rbx, rcx
+    mov rcx, 0
+    jmp .Lx
+.Lx:
+    /* end asm block */
+    push rax
+    pop rbx
+    ret
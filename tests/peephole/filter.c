@@ -0,0 +1,21 @@
+// Runs the peephole pass over stdin and writes the result to stdout, for
+// the golden cases in this directory (tests/check_peephole.sh).
+#include "../../src/peephole.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(void) {
+  size_t cap = 1 << 16, len = 0, n;
+  char *text = malloc(cap);
+  while ((n = fread(text + len, 1, cap - len, stdin)) > 0) {
+    len += n;
+    if (len == cap)
+      text = realloc(text, cap *= 2);
+  }
+  size_t out_len;
+  char *out = peephole_optimize(text, len, &out_len);
+  fwrite(out, 1, out_len, stdout);
+  free(out);
+  free(text);
+  return 0;
+}
@@ -0,0 +1,10 @@
+# mov R, imm then one use of R: use the immediate when R is dead afterwards
+f:
+    mov rcx, 5
+    add rbx, rcx
+    mov rcx, rdx
+    mov rax, 1
+    push rax
+    pop rdi
+    mov rax, rdi
+    ret
@@ -0,0 +1,16 @@
+# R read again later, a 64-bit immediate in an ALU op, a memory
+# destination, R live at the label
+f:
+    mov rcx, 5
+    add rbx, rcx
+    add rdx, rcx
+    mov rax, 4294967296
+    add rbx, rax
+    mov rax, 0
+    mov r11, 7
+    mov [rbp - 8], r11
+    mov r11, 0
+    mov rsi, 3
+    cmp rdi, rsi
+.L1:
+    ret
@@ -0,0 +1,8 @@
+# jumps to the label right after them, also past other labels
+f:
+    jmp .L1
+.L1:
+    je .L3
+.L2:
+.L3:
+    ret
@@ -0,0 +1,8 @@
+f:
+    jmp .L1
+    nop
+.L1:
+    jne .L2
+    ret
+.L2:
+    ret
@@ -0,0 +1,13 @@
+# nothing is rewritten across a label
+f:
+    push rax
+.L1:
+    pop rbx
+    pop rcx
+.L2:
+    push rcx
+    mov rdx, 5
+.L3:
+    add rbx, rdx
+    mov rdx, 0
+    ret
@@ -0,0 +1,10 @@
+# add rsp, N ... sub rsp, N / call: the padding around consecutive calls
+f:
+    sub rsp, 8
+    call g
+    add rsp, 8
+    mov rdi, rax
+    sub rsp, 8
+    call h
+    add rsp, 8
+    ret
@@ -0,0 +1,15 @@
+# flags read in between, sizes differ, no call after the sub
+f:
+    sub rsp, 8
+    call g
+    add rsp, 8
+    setl al
+    sub rsp, 8
+    call h
+    add rsp, 8
+    mov rdi, rax
+    sub rsp, 16
+    call h
+    add rsp, 8
+    sub rsp, 8
+    ret
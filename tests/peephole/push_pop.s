@@ -0,0 +1,19 @@
+# push X / pop Y -> mov Y, X; nothing when X == Y
+f:
+    push rax
+    pop rbx
+    push rcx
+    pop rcx
+    push 7
+    pop rdx
+# across stack-free work that leaves Y alone
+    push rax
+    mov rcx, 1
+    add rcx, rsi
+    pop rdx
+# nested pairs fold inside out
+    push rax
+    push rbx
+    pop rsi
+    pop rdi
+    ret
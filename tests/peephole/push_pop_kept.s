@@ -0,0 +1,12 @@
+# Y used in between, RSP touched in between, a call in between
+f:
+    push rax
+    mov rbx, 1
+    pop rbx
+    push rax
+    mov rcx, [rsp]
+    pop rdx
+    push rax
+    call g
+    pop rdx
+    ret
@@ -0,0 +1,17 @@
+# restore RSP after one call and realign for the next with only register
+# work in between: the first alignment is kept
+f:
+    mov r10, rsp
+    and rsp, -16
+    sub rsp, 16
+    mov [rsp + 8], r10
+    call g
+    mov rsp, [rsp + 8]
+    mov rdi, rax
+    mov r10, rsp
+    and rsp, -16
+    sub rsp, 16
+    mov [rsp + 8], r10
+    call h
+    mov rsp, [rsp + 8]
+    ret
@@ -0,0 +1,16 @@
+# r10 or the stack touched between the calls: both alignments stay
+f:
+    mov r10, rsp
+    and rsp, -16
+    sub rsp, 16
+    mov [rsp + 8], r10
+    call g
+    mov rsp, [rsp + 8]
+    push rax
+    mov r10, rsp
+    and rsp, -16
+    sub rsp, 16
+    mov [rsp + 8], r10
+    call h
+    mov rsp, [rsp + 8]
+    ret
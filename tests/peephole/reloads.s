@@ -0,0 +1,12 @@
+# pop X / push X -> mov X, [rsp]
+f:
+    pop rax
+    push rax
+# reload of what was just pushed
+    push rbx
+    mov rbx, [rsp]
+# repeated frame reload and self copy
+    mov rcx, [rbp - 8]
+    mov rcx, [rbp - 8]
+    mov rdx, rdx
+    ret
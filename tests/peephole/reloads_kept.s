@@ -0,0 +1,8 @@
+# a second load from memory outside the frame may read a device register;
+# a reload whose source names the destination reads a new address
+f:
+    mov rax, [rdi]
+    mov rax, [rdi]
+    mov rcx, [rbp - 8 + rcx]
+    mov rcx, [rbp - 8 + rcx]
+    ret